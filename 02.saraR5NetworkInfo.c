@@ -99,14 +99,15 @@ int main(void)
   /* Buffer to store the response from the module. */
 
 
-  for (int cid = 0; cid < MAX_OPS; ++cid) {
+  // cid 0: the first contexts the module reports, one per entry
+  apnResult = saraR5GetAPN(0, apn, ip, &pdpType);
 
-	  apnResult = saraR5GetAPN(cid, apn, ip, &pdpType);
+  if (apnResult == SARA_R5_ERROR_SUCCESS) {
 
-	  if (apnResult == SARA_R5_ERROR_SUCCESS) {
+	  for (int op = 0; op < MAX_OPS; ++op) {
 
-		  if (!(ip[cid].first_ip == 0 && ip[cid].second_ip == 0 && ip[cid].third_ip == 0 && ip[cid].fourth_ip == 0)) {
-		  printf("APN: %s, IP: %d.%d.%d.%d\n", apn[cid].apn, ip[cid].first_ip, ip[cid].second_ip, ip[cid].third_ip, ip[cid].fourth_ip);
+		  if (!(ip[op].first_ip == 0 && ip[op].second_ip == 0 && ip[op].third_ip == 0 && ip[op].fourth_ip == 0)) {
+		  printf("APN: %s, IP: %d.%d.%d.%d\n", apn[op].apn, ip[op].first_ip, ip[op].second_ip, ip[op].third_ip, ip[op].fourth_ip);
 		  }
 	  }
   }
@@ -97,23 +97,23 @@ int main(void)
 	  // Clear buffer before reusing it
 	  memset(resposta, 0, STANDARD_RESPONSE_BUFFER_SIZE);
 
-// Proceed with PDP actions
-	  if (saraR5PerformPDPaction(1, SARA_R5_PSD_ACTION_DESACTIVATE, resposta, sizeof(resposta)) != SARA_R5_ERROR_SUCCESS) {
-		  printf("Warning: performPDPaction (deactivate profile) failed. Probably because no profile was active.\n");
-	  }
-	  HAL_Delay(1000);
+// Proceed with PDP actions, sent back to back in one batch
+	  SARA_R5_command_result pdp[3] = {0};
 
-	  memset(resposta, 0, STANDARD_RESPONSE_BUFFER_SIZE);
+	  saraR5BatchBegin();
+	  saraR5PerformPDPactionAsync(1, SARA_R5_PSD_ACTION_DESACTIVATE, NULL, 0, saraR5StoreResult, &pdp[0]);
+	  saraR5PerformPDPactionAsync(1, SARA_R5_PSD_ACTION_LOAD, NULL, 0, saraR5StoreResult, &pdp[1]);
+	  saraR5PerformPDPactionAsync(1, SARA_R5_PSD_ACTION_ACTIVATE, NULL, 0, saraR5StoreResult, &pdp[2]);
+	  saraR5BatchRun();
 
-	  if (saraR5PerformPDPaction(1, SARA_R5_PSD_ACTION_LOAD, resposta, sizeof(resposta)) != SARA_R5_ERROR_SUCCESS) {
+	  if (pdp[0].error != SARA_R5_ERROR_SUCCESS) {
+		  printf("Warning: performPDPaction (deactivate profile) failed. Probably because no profile was active.\n");
+	  }
+	  if (pdp[1].error != SARA_R5_ERROR_SUCCESS) {
 		  printf("performPDPaction (load from NVM) failed! Freezing... \n");
 		  while(1);
 	  }
-	  HAL_Delay(1000);
-
-	  memset(resposta, 0, STANDARD_RESPONSE_BUFFER_SIZE);
-
-	  if (saraR5PerformPDPaction(1, SARA_R5_PSD_ACTION_ACTIVATE, resposta, sizeof(resposta)) != SARA_R5_ERROR_SUCCESS) {
+	  if (pdp[2].error != SARA_R5_ERROR_SUCCESS) {
 		  printf("performPDPaction (activate profile) failed!\n");
 	  }
 
@@ -61,12 +61,9 @@ int main(void)
 	Ip_adress ip[MAX_OPS];
 	myApn apn[MAX_OPS];
 	SARA_R5_pdp_type Type;
-	int localport;
-	int sock;
-	unsigned long port = 55055;
+	unsigned int port = 55055;
 	const char *message = "Hello, World!";
 	const char *address = "35.180.39.173";
-	Ip_adress my_ip = {35, 180, 39, 173};
 
   /* USER CODE END 1 */
 
@@ -107,63 +104,34 @@ int main(void)
 	  printf("Error obtaining APN and IP! Freezing... !\n");
 	  while(1);
   }
-  HAL_Delay(100);
 
-  // 2. Activate PDP Action
-      memset(resposta, 0, sizeof(resposta));
-      if (saraR5PerformPDPaction(1, SARA_R5_PSD_ACTION_DESACTIVATE, resposta, sizeof(resposta)) != SARA_R5_ERROR_SUCCESS) {
+  // 2. Activate PDP Action, the three actions are sent back to back
+      SARA_R5_command_result pdp[3] = {0};
+
+      saraR5BatchBegin();
+      saraR5PerformPDPactionAsync(1, SARA_R5_PSD_ACTION_DESACTIVATE, NULL, 0, saraR5StoreResult, &pdp[0]);
+      saraR5PerformPDPactionAsync(1, SARA_R5_PSD_ACTION_LOAD, NULL, 0, saraR5StoreResult, &pdp[1]);
+      saraR5PerformPDPactionAsync(1, SARA_R5_PSD_ACTION_ACTIVATE, NULL, 0, saraR5StoreResult, &pdp[2]);
+      saraR5BatchRun();
+
+      if (pdp[0].error != SARA_R5_ERROR_SUCCESS) {
           printf("Warning: performPDPaction (deactivate profile) failed. Probably because no profile was active.\n");
       }
-      HAL_Delay(1000);
-
-      memset(resposta, 0, sizeof(resposta));
-      if (saraR5PerformPDPaction(1, SARA_R5_PSD_ACTION_LOAD, resposta, sizeof(resposta)) != SARA_R5_ERROR_SUCCESS) {
+      if (pdp[1].error != SARA_R5_ERROR_SUCCESS) {
           printf("performPDPaction (load from NVM) failed! Freezing...\n");
           while(1);
       }
-      HAL_Delay(1000);
-
-      memset(resposta, 0, sizeof(resposta));
-      if (saraR5PerformPDPaction(1, SARA_R5_PSD_ACTION_ACTIVATE, resposta, sizeof(resposta)) != SARA_R5_ERROR_SUCCESS) {
+      if (pdp[2].error != SARA_R5_ERROR_SUCCESS) {
           printf("performPDPaction (activate profile) failed! Freezing...\n");
           while(1);
       }
-      HAL_Delay(2000);
-
-  // 3. Open Socket
-      memset(resposta, 0, sizeof(resposta));
-      localport = 0;
-      sock = saraR5SocketOpen(SARA_R5_UDP, localport);
-
-      if(sock < 0) {
-          printf("SocketOpen failed! Freezing...\n");
-          while(1);
-      }
 
-      HAL_Delay(100);
-  // 4. Connect to Server
-      memset(resposta, 0, sizeof(resposta));
-      if (saraR5SocketConnect(sock, my_ip, port, resposta, sizeof(resposta)) != SARA_R5_ERROR_SUCCESS) {
-    	  printf("Error connecting to server! Freezing...\n");
-    	  while(1);
-      }
-
-      HAL_Delay(100);
-
-  // 5. Write 1 or more message
-      if (saraR5SocketWriteUDP(sock, address, port, message, strlen(message)) != SARA_R5_ERROR_SUCCESS) {
+  // 3. Send the message: the first send opens and connects a socket, the next ones reuse it
+      if (saraR5SocketSend(SARA_R5_UDP, address, port, (const uint8_t *)message, strlen(message)) != SARA_R5_ERROR_SUCCESS) {
     	  printf("Error writing to socket! Freezing...\n");
     	  while(1);
       }
 
-      HAL_Delay(100);
-  // 6. Close Socket
-      memset(resposta, 0, sizeof(resposta));
-      if (saraR5socketClose(sock, SARA_R5_10_SEC_TIMEOUT, resposta, sizeof(resposta)) != SARA_R5_ERROR_SUCCESS) {
-    	  printf("Error closing socket! Freezing...\n");
-    	  while(1);
-      }
-
 	HAL_Delay(100);
   /* USER CODE BEGIN WHILE */
 
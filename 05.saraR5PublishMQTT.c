@@ -65,54 +65,38 @@ bool saraR5disconnectMQTT(void){
 	    }
 	}
 
-bool saraR5configureMQTTClient(void) {
+bool saraR5setupMQTT(void) {
     char buffer[STANDARD_RESPONSE_BUFFER_SIZE] = "";
     const char *clientId = "IulianCellular";
-    uint8_t clientResult = saraR5SetMQTTclientId(clientId, buffer, sizeof buffer);
-    HAL_Delay(1000);
-
-    if (clientResult == SARA_R5_ERROR_SUCCESS) {
-        printf("MQTT client configured successfully.\n");
-        memset(buffer, 0, STANDARD_RESPONSE_BUFFER_SIZE);
-        return true;
-    } else {
-        printf("Error configuring MQTT client: %d\n", clientResult);
-        memset(buffer, 0, STANDARD_RESPONSE_BUFFER_SIZE);
-        return false;
-    }
-}
-
-bool saraR5configureMQTTServer(void) {
-    char buffer[STANDARD_RESPONSE_BUFFER_SIZE] = "";
     const char *serverName = "test.mosquitto.org";
     int port = 1883;
+    SARA_R5_command_result client = {0}, server = {0}, login = {0};
 
-    uint8_t serverResult = saraR5SetMQTTserver(serverName, port, buffer, sizeof buffer);
+    // Client ID and server are chained on one line, the login follows right after
+    saraR5BatchBegin();
+    saraR5SetMQTTclientIdAsync(clientId, NULL, 0, saraR5StoreResult, &client);
+    saraR5SetMQTTserverAsync(serverName, port, NULL, 0, saraR5StoreResult, &server);
+    saraR5MQTTconectAsync(buffer, sizeof buffer, saraR5StoreResult, &login);
+    saraR5BatchRun();
 
-    if (serverResult == SARA_R5_ERROR_SUCCESS) {
-        printf("MQTT server configured successfully.\n");
-        memset(buffer, 0, STANDARD_RESPONSE_BUFFER_SIZE);
-        return true;
-    } else {
-        printf("Error configuring MQTT server: %d\n", serverResult);
-        memset(buffer, 0, STANDARD_RESPONSE_BUFFER_SIZE);
+    if (client.error != SARA_R5_ERROR_SUCCESS) {
+        printf("Error configuring MQTT client: %d\n", client.error);
         return false;
     }
-}
+    printf("MQTT client configured successfully.\n");
 
-bool saraR5connectMQTT(void) {
-    char buffer3[STANDARD_RESPONSE_BUFFER_SIZE] = "";
-    uint8_t connectResult = saraR5MQTTconect(buffer3, sizeof buffer3);
+    if (server.error != SARA_R5_ERROR_SUCCESS) {
+        printf("Error configuring MQTT server: %d\n", server.error);
+        return false;
+    }
+    printf("MQTT server configured successfully.\n");
 
-    if (connectResult == SARA_R5_ERROR_SUCCESS) {
-        printf("MQTT connection successful.\n");
-        memset(buffer3, 0, STANDARD_RESPONSE_BUFFER_SIZE); // Clear the buffer
-        return true;
-    } else {
-        printf("Error establishing MQTT connection: %d\n", connectResult);
-        memset(buffer3, 0, STANDARD_RESPONSE_BUFFER_SIZE); // Clear the buffer
+    if (login.error != SARA_R5_ERROR_SUCCESS) {
+        printf("Error establishing MQTT connection: %d\n", login.error);
         return false;
     }
+    printf("MQTT connection successful.\n");
+    return true;
 }
 
 bool saraR5publishMQTTTopic(void) {
@@ -126,12 +110,12 @@ bool saraR5publishMQTTTopic(void) {
 	sprintf(message, "Temperatura actual: %d", randomTemperature);
 
     const char *topic = "/uoc/iulian";
-    uint8_t topicLength = strlen(topic);
+    size_t topicLength = strlen(topic);
     int QoS = 0; // Quality of Service level
     int retain = 0; // Retain flag
     uint8_t hex_mode = 0; // Hexadecimal mode
     //const uint8_t *message = (const uint8_t *)"Iulian";
-    uint8_t messageLength = strlen((const char *)message);
+    size_t messageLength = strlen((const char *)message);
 
     uint8_t result = saraR5PublishMQTT(topic, topicLength, buffer, sizeof buffer, QoS, retain, hex_mode, (const uint8_t *)message, messageLength);
 
@@ -194,47 +178,36 @@ int main(void)
   	  printf("Error obtaining APN and IP! Freezing... !\n");
   	  while(1);
     }
-    HAL_Delay(100);
 
-    // 2. Activate PDP Action
-    memset(resposta, 0, sizeof(resposta));
-    if (saraR5PerformPDPaction(1, SARA_R5_PSD_ACTION_DESACTIVATE, resposta, sizeof(resposta)) != SARA_R5_ERROR_SUCCESS) {
+    // 2. Activate PDP Action, the three actions are sent back to back
+    SARA_R5_command_result pdp[3] = {0};
+
+    saraR5BatchBegin();
+    saraR5PerformPDPactionAsync(1, SARA_R5_PSD_ACTION_DESACTIVATE, NULL, 0, saraR5StoreResult, &pdp[0]);
+    saraR5PerformPDPactionAsync(1, SARA_R5_PSD_ACTION_LOAD, NULL, 0, saraR5StoreResult, &pdp[1]);
+    saraR5PerformPDPactionAsync(1, SARA_R5_PSD_ACTION_ACTIVATE, NULL, 0, saraR5StoreResult, &pdp[2]);
+    saraR5BatchRun();
+
+    if (pdp[0].error != SARA_R5_ERROR_SUCCESS) {
     	printf("Warning: performPDPaction (deactivate profile) failed. Probably because no profile was active.\n");
 	}
-	HAL_Delay(1000);
-
-	memset(resposta, 0, sizeof(resposta));
-	if (saraR5PerformPDPaction(1, SARA_R5_PSD_ACTION_LOAD, resposta, sizeof(resposta)) != SARA_R5_ERROR_SUCCESS) {
+	if (pdp[1].error != SARA_R5_ERROR_SUCCESS) {
 		printf("performPDPaction (load from NVM) failed! Freezing...\n");
 		while(1);
 	}
-        HAL_Delay(1000);
-
-	memset(resposta, 0, sizeof(resposta));
-	if (saraR5PerformPDPaction(1, SARA_R5_PSD_ACTION_ACTIVATE, resposta, sizeof(resposta)) != SARA_R5_ERROR_SUCCESS) {
+	if (pdp[2].error != SARA_R5_ERROR_SUCCESS) {
 		printf("performPDPaction (activate profile) failed! Freezing...\n");
 		while(1);
 	}
-	HAL_Delay(2000);
 
 	// Disconnect MQTT (if necessary)
 	if (!saraR5disconnectMQTT()) {
 		printf("Initial MQTT disconnection failed. Attempting to continue...\n");
 	}
 
-	// Configure MQTT client
-	if (!saraR5configureMQTTClient()) {
-		printf("Error configuring MQTT client. Terminating program.\n");
-		return -1; // Terminate the program if client configuration fails
-	}
-
-	if (!saraR5configureMQTTServer()) {
-		printf("Error configuring MQTT server. Terminating program.\n");
-		return -1;
-	}
-
-	if (!saraR5connectMQTT()) {
-		printf("Failed to establish MQTT connection. This could be due to network issues. Please check the configuration and network status, and try again.\n");
+	// Configure the MQTT client and server, then log in
+	if (!saraR5setupMQTT()) {
+		printf("Failed to set up the MQTT connection. This could be due to network issues. Please check the configuration and network status, and try again.\n");
 		return -1;
 	}
 
@@ -0,0 +1,231 @@
+#include "Sara_R5_at_tokenizer.h"
+#include "string.h"
+#include "limits.h"
+
+#define SARA_R5_AT_CME_ERROR_PREFIX "+CME ERROR:"
+#define SARA_R5_AT_CMS_ERROR_PREFIX "+CMS ERROR:"
+#define SARA_R5_AT_CONNECT "CONNECT"
+
+/**
+ * Initializes a tokenizer for a new AT transaction.
+ * @param tokenizer The tokenizer to initialize.
+ * @param onLine Function called for every intermediate line, or NULL.
+ * @param context Pointer passed back to onLine.
+ */
+void saraR5AtTokenizerInit(SARA_R5_at_tokenizer *tokenizer, SARA_R5_at_line_callback onLine, void *context)
+{
+	tokenizer->onLine = onLine;
+	tokenizer->context = context;
+	tokenizer->onPartial = NULL;
+	tokenizer->onUrc = NULL;
+	tokenizer->urcContext = NULL;
+	saraR5AtTokenizerReset(tokenizer);
+}
+
+/**
+ * Installs a handler for the lines that do not fit in the line buffer. Instead of being truncated, such a line is
+ * handed to onPartial in pieces of SARA_R5_AT_LINE_BUFFER_SIZE - 1 characters, and its last piece goes to onLine.
+ * A long line is always an intermediate line: it is never checked for a final result code or a URC.
+ * @param tokenizer The tokenizer.
+ * @param onPartial The handler, or NULL to truncate long lines. Gets the context of onLine.
+ */
+void saraR5AtTokenizerSetPartialHandler(SARA_R5_at_tokenizer *tokenizer, SARA_R5_at_line_callback onPartial)
+{
+	tokenizer->onPartial = onPartial;
+}
+
+/**
+ * Installs a filter that takes the unsolicited result codes out of the transaction.
+ * The lines it accepts are neither final result codes nor intermediate lines.
+ * @param tokenizer The tokenizer.
+ * @param onUrc The filter, or NULL.
+ * @param context Pointer passed back to onUrc.
+ */
+void saraR5AtTokenizerSetUrcFilter(SARA_R5_at_tokenizer *tokenizer, SARA_R5_at_urc_filter onUrc, void *context)
+{
+	tokenizer->onUrc = onUrc;
+	tokenizer->urcContext = context;
+}
+
+/**
+ * Clears the tokenizer state so it can follow a new transaction. The line handler is kept.
+ * @param tokenizer The tokenizer to reset.
+ */
+void saraR5AtTokenizerReset(SARA_R5_at_tokenizer *tokenizer)
+{
+	tokenizer->line[0] = '\0';
+	tokenizer->lineLength = 0;
+	tokenizer->lineTruncated = false;
+	tokenizer->lineContinued = false;
+	tokenizer->result = SARA_R5_AT_RESULT_NONE;
+	tokenizer->errorCode = -1;
+	tokenizer->promptExpected = false;
+}
+
+/**
+ * Makes the tokenizer stop on the '@' prompt of the transaction in progress (SARA_R5_AT_RESULT_PROMPT).
+ * The module sends it without a line terminator and then waits for the data, so it cannot wait for a line end.
+ * Once the data is sent, a reset lets the tokenizer follow the rest of the answer.
+ * @param tokenizer The tokenizer.
+ */
+void saraR5AtTokenizerExpectPrompt(SARA_R5_at_tokenizer *tokenizer)
+{
+	tokenizer->promptExpected = true;
+}
+
+/**
+ * Tells if the final result code of the transaction has been received.
+ * @param tokenizer The tokenizer to check.
+ * @return true if the transaction is finished, false otherwise.
+ */
+bool saraR5AtTokenizerDone(const SARA_R5_at_tokenizer *tokenizer)
+{
+	return tokenizer->result != SARA_R5_AT_RESULT_NONE;
+}
+
+/**
+ * Reads the number of a "+CME ERROR: <n>" line, within the line length.
+ * @return The number, or -1 for a verbose or malformed error (or one that does not fit in an int).
+ */
+static int saraR5AtTokenizerErrorCode(const char *line, size_t len, size_t start)
+{
+	int code = 0;
+	size_t i = start;
+
+	while (i < len && line[i] == ' ')
+	{
+		i++;
+	}
+	if (i == len)
+	{
+		return -1;
+	}
+	for (; i < len; i++)
+	{
+		if (line[i] < '0' || line[i] > '9' || code > (INT_MAX - 9) / 10)
+		{
+			return -1;
+		}
+		code = code * 10 + (line[i] - '0');
+	}
+	return code;
+}
+
+/**
+ * Classifies a complete line as a final result code, a URC or an intermediate line.
+ * A final result code is kept in 'line'.
+ * @param tokenizer The tokenizer holding the line.
+ */
+static void saraR5AtTokenizerEndLine(SARA_R5_at_tokenizer *tokenizer)
+{
+	const char *line = tokenizer->line;
+	size_t len = tokenizer->lineLength;
+
+	if (tokenizer->lineContinued)
+	{
+		// Last piece of a long line
+		if (tokenizer->onLine != NULL)
+		{
+			tokenizer->onLine(line, len, tokenizer->context);
+		}
+	}
+	else if (len == 2 && memcmp(line, "OK", 2) == 0)
+	{
+		tokenizer->result = SARA_R5_AT_RESULT_OK;
+	}
+	else if (len == 5 && memcmp(line, "ERROR", 5) == 0)
+	{
+		tokenizer->result = SARA_R5_AT_RESULT_ERROR;
+	}
+	else if (len == 7 && memcmp(line, "ABORTED", 7) == 0)
+	{
+		tokenizer->result = SARA_R5_AT_RESULT_ABORTED;
+	}
+	else if (strncmp(line, SARA_R5_AT_CME_ERROR_PREFIX, strlen(SARA_R5_AT_CME_ERROR_PREFIX)) == 0)
+	{
+		tokenizer->result = SARA_R5_AT_RESULT_CME_ERROR;
+		tokenizer->errorCode = saraR5AtTokenizerErrorCode(line, len, strlen(SARA_R5_AT_CME_ERROR_PREFIX));
+	}
+	else if (strncmp(line, SARA_R5_AT_CMS_ERROR_PREFIX, strlen(SARA_R5_AT_CMS_ERROR_PREFIX)) == 0)
+	{
+		tokenizer->result = SARA_R5_AT_RESULT_CMS_ERROR;
+		tokenizer->errorCode = saraR5AtTokenizerErrorCode(line, len, strlen(SARA_R5_AT_CMS_ERROR_PREFIX));
+	}
+	else if (strncmp(line, SARA_R5_AT_CONNECT, strlen(SARA_R5_AT_CONNECT)) == 0 &&
+			 (len == strlen(SARA_R5_AT_CONNECT) || line[strlen(SARA_R5_AT_CONNECT)] == ' '))
+	{
+		tokenizer->result = SARA_R5_AT_RESULT_CONNECT;
+	}
+	else if (tokenizer->onUrc == NULL || !tokenizer->onUrc(line, len, tokenizer->urcContext))
+	{
+		// Not unsolicited: part of the answer
+		if (tokenizer->onLine != NULL)
+		{
+			tokenizer->onLine(line, len, tokenizer->context);
+		}
+	}
+
+	if (saraR5AtTokenizerDone(tokenizer))
+	{
+		return;
+	}
+
+	tokenizer->line[0] = '\0';
+	tokenizer->lineLength = 0;
+	tokenizer->lineTruncated = false;
+	tokenizer->lineContinued = false;
+}
+
+/**
+ * Feeds received bytes to the tokenizer. Lines end on LF, CR is dropped and empty lines are skipped.
+ * Consumption stops right after the line holding the final result code, or the expected '@' prompt, so the bytes that
+ * follow (e.g. unsolicited result codes, or the raw data after CONNECT) are left to the caller.
+ * @param tokenizer The tokenizer to feed.
+ * @param data The received bytes.
+ * @param len The number of received bytes.
+ * @return The number of bytes consumed.
+ */
+size_t saraR5AtTokenizerFeed(SARA_R5_at_tokenizer *tokenizer, const uint8_t *data, size_t len)
+{
+	size_t i = 0;
+
+	while (i < len && !saraR5AtTokenizerDone(tokenizer))
+	{
+		char c = (char)data[i++];
+
+		if (c == '\r')
+		{
+			continue;
+		}
+		if (c == '@' && tokenizer->promptExpected && tokenizer->lineLength == 0 && !tokenizer->lineContinued)
+		{
+			tokenizer->result = SARA_R5_AT_RESULT_PROMPT;
+		}
+		else if (c == '\n')
+		{
+			if (tokenizer->lineLength > 0 || tokenizer->lineContinued)
+			{
+				saraR5AtTokenizerEndLine(tokenizer);
+			}
+		}
+		else if (tokenizer->lineLength < SARA_R5_AT_LINE_BUFFER_SIZE - 1)
+		{
+			tokenizer->line[tokenizer->lineLength++] = c;
+			tokenizer->line[tokenizer->lineLength] = '\0';
+		}
+		else if (tokenizer->onPartial != NULL)
+		{
+			// Hand over the full buffer and go on with the rest of the line
+			tokenizer->onPartial(tokenizer->line, tokenizer->lineLength, tokenizer->context);
+			tokenizer->lineContinued = true;
+			tokenizer->line[0] = c;
+			tokenizer->line[1] = '\0';
+			tokenizer->lineLength = 1;
+		}
+		else
+		{
+			tokenizer->lineTruncated = true;
+		}
+	}
+	return i;
+}
@@ -0,0 +1,56 @@
+#ifndef SARA_R5_AT_TOKENIZER_H
+#define SARA_R5_AT_TOKENIZER_H
+
+// INCLUDES
+#include "stdint.h"
+#include "stddef.h"
+#include "stdbool.h"
+
+#define SARA_R5_AT_LINE_BUFFER_SIZE 256 // Longest line kept, longer lines are truncated or handed over in pieces
+
+// Final result codes that end an AT transaction
+typedef enum
+{
+  SARA_R5_AT_RESULT_NONE = 0,  // Transaction still running
+  SARA_R5_AT_RESULT_OK,        // "OK"
+  SARA_R5_AT_RESULT_ERROR,     // "ERROR"
+  SARA_R5_AT_RESULT_CME_ERROR, // "+CME ERROR: <err>"
+  SARA_R5_AT_RESULT_CMS_ERROR, // "+CMS ERROR: <err>"
+  SARA_R5_AT_RESULT_CONNECT,   // "CONNECT", raw data follows (e.g. AT+USODL)
+  SARA_R5_AT_RESULT_ABORTED,   // "ABORTED", the command was cancelled by a character (e.g. AT+COPS=?)
+  SARA_R5_AT_RESULT_PROMPT     // "@" at the start of a line, the module waits for the data (AT+USOWR, AT+USOST)
+} SARA_R5_at_result_t;
+
+// Called for every intermediate line (e.g. "+USOCR: 0"), without the line terminator
+typedef void (*SARA_R5_at_line_callback)(const char *line, size_t len, void *context);
+
+// Called before the line callback, returns true when the line is an unsolicited result code it has taken
+typedef bool (*SARA_R5_at_urc_filter)(const char *line, size_t len, void *context);
+
+// Streaming line tokenizer for one AT transaction
+typedef struct
+{
+  char line[SARA_R5_AT_LINE_BUFFER_SIZE]; // Line being assembled, then the final result code, always null terminated
+  size_t lineLength;                      // Characters stored in 'line'
+  bool lineTruncated;                     // The current line did not fit in 'line'
+  bool lineContinued;                     // The start of the current line went to onPartial
+  SARA_R5_at_result_t result;             // Final result code, NONE while running
+  int errorCode;                          // Value of +CME/+CMS ERROR, -1 otherwise or for a verbose error
+  bool promptExpected;                    // A '@' starting a line is the data prompt, not the start of a line
+  SARA_R5_at_line_callback onLine;        // Intermediate line handler (may be NULL)
+  void *context;                          // Passed back to onLine and onPartial
+  SARA_R5_at_line_callback onPartial;     // Piece of a line longer than 'line', the end goes to onLine (may be NULL)
+  SARA_R5_at_urc_filter onUrc;            // URC filter (may be NULL)
+  void *urcContext;                       // Passed back to onUrc
+} SARA_R5_at_tokenizer;
+
+// FUNCTIONS FOR THE AT TOKENIZER
+void saraR5AtTokenizerInit(SARA_R5_at_tokenizer *tokenizer, SARA_R5_at_line_callback onLine, void *context);
+void saraR5AtTokenizerSetPartialHandler(SARA_R5_at_tokenizer *tokenizer, SARA_R5_at_line_callback onPartial);
+void saraR5AtTokenizerSetUrcFilter(SARA_R5_at_tokenizer *tokenizer, SARA_R5_at_urc_filter onUrc, void *context);
+void saraR5AtTokenizerReset(SARA_R5_at_tokenizer *tokenizer);
+void saraR5AtTokenizerExpectPrompt(SARA_R5_at_tokenizer *tokenizer);
+size_t saraR5AtTokenizerFeed(SARA_R5_at_tokenizer *tokenizer, const uint8_t *data, size_t len);
+bool saraR5AtTokenizerDone(const SARA_R5_at_tokenizer *tokenizer);
+
+#endif // SARA_R5_AT_TOKENIZER_H
@@ -0,0 +1,598 @@
+#include "Sara_R5_cmux.h"
+#include "string.h"
+
+// States of the frame decoder
+enum
+{
+	SARA_R5_CMUX_WAIT_FLAG = 0,
+	SARA_R5_CMUX_WAIT_ADDRESS,
+	SARA_R5_CMUX_WAIT_CONTROL,
+	SARA_R5_CMUX_WAIT_LENGTH,
+	SARA_R5_CMUX_WAIT_LENGTH2,
+	SARA_R5_CMUX_WAIT_DATA,
+	SARA_R5_CMUX_WAIT_FCS,
+	SARA_R5_CMUX_WAIT_END
+};
+
+// Remainder of the FCS check over a frame received without error
+#define SARA_R5_CMUX_FCS_GOOD 0xCF
+
+/**
+ * Runs the 27.010 CRC-8 (x^8 + x^2 + x + 1, reflected) over some bytes.
+ */
+static uint8_t saraR5CmuxCrc(uint8_t crc, const uint8_t *data, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x01) ? (uint8_t)((crc >> 1) ^ 0xE0) : (uint8_t)(crc >> 1);
+		}
+	}
+	return crc;
+}
+
+/**
+ * Computes the frame check sequence of a frame: it covers the address, control and length fields, and for a
+ * UI frame the information field as well.
+ * @param data The bytes covered, without the opening flag.
+ * @param len The number of header bytes.
+ * @return The FCS byte to send after the information field.
+ */
+uint8_t saraR5CmuxFcs(const uint8_t *data, size_t len)
+{
+	return (uint8_t)(0xFF - saraR5CmuxCrc(0xFF, data, len));
+}
+
+/**
+ * Builds the address, control and length fields of a frame.
+ * @param header Where to store the fields, at least 4 bytes.
+ * @param dlci The channel.
+ * @param control The frame type, with the P/F bit.
+ * @param commandResponse The C/R bit of the address.
+ * @param len The length of the information field.
+ * @return The number of bytes stored in 'header'.
+ */
+size_t saraR5CmuxHeader(uint8_t *header, uint8_t dlci, uint8_t control, bool commandResponse, size_t len)
+{
+	size_t count = 0;
+
+	header[count++] = (uint8_t)((dlci << 2) | (commandResponse ? 0x02 : 0x00) | 0x01);
+	header[count++] = control;
+	if (len <= 0x7F)
+	{
+		header[count++] = (uint8_t)((len << 1) | 0x01);
+	}
+	else
+	{
+		header[count++] = (uint8_t)((len & 0x7F) << 1);
+		header[count++] = (uint8_t)(len >> 7);
+	}
+	return count;
+}
+
+/**
+ * Gets a frame decoder ready to look for the next opening flag. The error counters are kept.
+ * @param parser The decoder.
+ */
+void saraR5CmuxParserReset(SARA_R5_cmux_parser *parser)
+{
+	parser->state = SARA_R5_CMUX_WAIT_FLAG;
+	parser->headerLength = 0;
+	parser->length = 0;
+	parser->received = 0;
+}
+
+/**
+ * Feeds one received byte to the frame decoder. Frames with a wrong FCS or length are dropped,
+ * and the decoder hunts for the next flag.
+ * @param parser The decoder.
+ * @param byte The received byte.
+ * @return true when a valid frame is complete: its fields are in 'dlci', 'control', 'info' and 'length'.
+ */
+bool saraR5CmuxParse(SARA_R5_cmux_parser *parser, uint8_t byte)
+{
+	uint8_t crc;
+
+	switch (parser->state)
+	{
+	case SARA_R5_CMUX_WAIT_FLAG:
+		if (byte == SARA_R5_CMUX_FLAG)
+		{
+			parser->state = SARA_R5_CMUX_WAIT_ADDRESS;
+		}
+		break;
+	case SARA_R5_CMUX_WAIT_ADDRESS:
+		if (byte == SARA_R5_CMUX_FLAG)
+		{
+			break; // Several flags between frames
+		}
+		parser->headerLength = 0;
+		parser->header[parser->headerLength++] = byte;
+		parser->dlci = (uint8_t)(byte >> 2);
+		parser->commandResponse = (byte & 0x02) != 0;
+		parser->state = SARA_R5_CMUX_WAIT_CONTROL;
+		break;
+	case SARA_R5_CMUX_WAIT_CONTROL:
+		parser->header[parser->headerLength++] = byte;
+		parser->control = byte;
+		parser->state = SARA_R5_CMUX_WAIT_LENGTH;
+		break;
+	case SARA_R5_CMUX_WAIT_LENGTH:
+		parser->header[parser->headerLength++] = byte;
+		parser->length = byte >> 1;
+		parser->received = 0;
+		parser->state = (byte & 0x01) ? SARA_R5_CMUX_WAIT_DATA : SARA_R5_CMUX_WAIT_LENGTH2;
+		break;
+	case SARA_R5_CMUX_WAIT_LENGTH2:
+		parser->header[parser->headerLength++] = byte;
+		parser->length |= (size_t)byte << 7;
+		parser->state = SARA_R5_CMUX_WAIT_DATA;
+		break;
+	case SARA_R5_CMUX_WAIT_DATA:
+		parser->info[parser->received++] = byte;
+		break;
+	case SARA_R5_CMUX_WAIT_FCS:
+		crc = saraR5CmuxCrc(0xFF, parser->header, parser->headerLength);
+		// The FCS of a UI frame also covers its information field
+		if ((parser->control & (uint8_t)~SARA_R5_CMUX_PF) == SARA_R5_CMUX_UI)
+		{
+			crc = saraR5CmuxCrc(crc, parser->info, parser->length);
+		}
+		if (saraR5CmuxCrc(crc, &byte, 1) != SARA_R5_CMUX_FCS_GOOD)
+		{
+			parser->badFcs++;
+			saraR5CmuxParserReset(parser);
+			return false;
+		}
+		parser->state = SARA_R5_CMUX_WAIT_END;
+		return false;
+	case SARA_R5_CMUX_WAIT_END:
+		if (byte != SARA_R5_CMUX_FLAG)
+		{
+			parser->badFrames++;
+			saraR5CmuxParserReset(parser);
+			return false;
+		}
+		parser->state = SARA_R5_CMUX_WAIT_ADDRESS; // The closing flag may open the next frame
+		return true;
+	}
+
+	// Check the length as soon as it is known, and once the information field is complete
+	if (parser->state == SARA_R5_CMUX_WAIT_DATA)
+	{
+		if (parser->length > SARA_R5_CMUX_FRAME_SIZE)
+		{
+			parser->badFrames++;
+			saraR5CmuxParserReset(parser);
+		}
+		else if (parser->received == parser->length)
+		{
+			parser->state = SARA_R5_CMUX_WAIT_FCS;
+		}
+	}
+	return false;
+}
+
+/**
+ * Sends one frame on the physical link: the information field is sent from where it is.
+ */
+static bool saraR5CmuxSendFrame(SARA_R5_cmux *mux, uint8_t dlci, uint8_t control, bool commandResponse, const uint8_t *info, size_t len)
+{
+	uint8_t header[5];
+	uint8_t trailer[2];
+	size_t headerLength;
+
+	header[0] = SARA_R5_CMUX_FLAG;
+	headerLength = 1 + saraR5CmuxHeader(&header[1], dlci, control, commandResponse, len);
+	trailer[0] = saraR5CmuxFcs(&header[1], headerLength - 1);
+	trailer[1] = SARA_R5_CMUX_FLAG;
+
+	return mux->physical->send(mux->physical->context, header, headerLength) &&
+		   (len == 0 || mux->physical->send(mux->physical->context, info, len)) &&
+		   mux->physical->send(mux->physical->context, trailer, sizeof(trailer));
+}
+
+/**
+ * Sends a message on the control channel.
+ */
+static bool saraR5CmuxSendMessage(SARA_R5_cmux *mux, uint8_t type, const uint8_t *values, size_t len)
+{
+	uint8_t message[4];
+
+	message[0] = type;
+	message[1] = (uint8_t)((len << 1) | 0x01);
+	if (len > 0)
+	{
+		memcpy(&message[2], values, len);
+	}
+	return saraR5CmuxSendFrame(mux, 0, SARA_R5_CMUX_UIH, true, message, 2 + len);
+}
+
+/**
+ * Tells the module to stop or resume sending on a channel (MSC with the FC bit).
+ */
+static void saraR5CmuxSetFlow(SARA_R5_cmux *mux, SARA_R5_cmux_channel *channel, bool stop)
+{
+	uint8_t values[2];
+
+	values[0] = (uint8_t)((channel->dlci << 2) | 0x03);
+	values[1] = (uint8_t)(SARA_R5_CMUX_MSC_SIGNALS | (stop ? SARA_R5_CMUX_MSC_FC : 0));
+	if (saraR5CmuxSendMessage(mux, SARA_R5_CMUX_MSG_MSC, values, sizeof(values)))
+	{
+		channel->stopped = stop;
+	}
+}
+
+/**
+ * Handles a message received on the control channel. Commands are answered with the same values.
+ */
+static void saraR5CmuxMessage(SARA_R5_cmux *mux, const uint8_t *info, size_t len)
+{
+	uint8_t type;
+	size_t valueLength;
+	const uint8_t *values;
+	uint8_t answer[4];
+
+	if (len < 2)
+	{
+		return;
+	}
+	type = info[0];
+	valueLength = info[1] >> 1;
+	values = &info[2];
+	if (valueLength > len - 2)
+	{
+		return; // Truncated
+	}
+
+	if ((type & SARA_R5_CMUX_MSG_CR) == 0)
+	{
+		// Response to one of our commands, only the close down one matters
+		if (type == (SARA_R5_CMUX_MSG_CLD & (uint8_t)~SARA_R5_CMUX_MSG_CR))
+		{
+			mux->closed = true;
+		}
+		return;
+	}
+
+	switch (type)
+	{
+	case SARA_R5_CMUX_MSG_MSC:
+		if (valueLength >= 2)
+		{
+			uint8_t dlci = values[0] >> 2;
+
+			if (dlci >= 1 && dlci <= SARA_R5_CMUX_CHANNELS)
+			{
+				mux->channels[dlci].peerStopped = (values[1] & SARA_R5_CMUX_MSC_FC) != 0;
+			}
+		}
+		break;
+	case SARA_R5_CMUX_MSG_FCON:
+		mux->stopped = false;
+		break;
+	case SARA_R5_CMUX_MSG_FCOFF:
+		mux->stopped = true;
+		break;
+	case SARA_R5_CMUX_MSG_CLD:
+		mux->closed = true;
+		break;
+	default:
+		saraR5CmuxSendMessage(mux, SARA_R5_CMUX_MSG_NSC, &type, 1);
+		return;
+	}
+
+	// Answer with the same values
+	if (valueLength > sizeof(answer) - 2)
+	{
+		valueLength = sizeof(answer) - 2;
+	}
+	answer[0] = type & (uint8_t)~SARA_R5_CMUX_MSG_CR;
+	answer[1] = (uint8_t)((valueLength << 1) | 0x01);
+	memcpy(&answer[2], values, valueLength);
+	saraR5CmuxSendFrame(mux, 0, SARA_R5_CMUX_UIH, true, answer, 2 + valueLength);
+}
+
+/**
+ * Handles a frame just decoded.
+ */
+static void saraR5CmuxFrame(SARA_R5_cmux *mux)
+{
+	SARA_R5_cmux_parser *parser = &mux->parser;
+	SARA_R5_cmux_channel *channel;
+
+	if (parser->dlci > SARA_R5_CMUX_CHANNELS)
+	{
+		return; // Channel not handled here
+	}
+	channel = &mux->channels[parser->dlci];
+
+	switch (parser->control & (uint8_t)~SARA_R5_CMUX_PF)
+	{
+	case SARA_R5_CMUX_UA:
+	case SARA_R5_CMUX_DM:
+		channel->reply = parser->control & (uint8_t)~SARA_R5_CMUX_PF;
+		break;
+	case SARA_R5_CMUX_SABM:
+		channel->open = true;
+		saraR5CmuxSendFrame(mux, parser->dlci, SARA_R5_CMUX_UA | SARA_R5_CMUX_PF, false, NULL, 0);
+		break;
+	case SARA_R5_CMUX_DISC:
+		channel->open = false;
+		saraR5CmuxSendFrame(mux, parser->dlci, SARA_R5_CMUX_UA | SARA_R5_CMUX_PF, false, NULL, 0);
+		break;
+	case SARA_R5_CMUX_UIH:
+	case SARA_R5_CMUX_UI:
+		if (parser->dlci == 0)
+		{
+			saraR5CmuxMessage(mux, parser->info, parser->length);
+			break;
+		}
+		saraR5RingBufferWrite(&channel->ring, parser->info, parser->length);
+		// Ask the module to pause before the channel overflows
+		if (!channel->stopped && saraR5RingBufferFree(&channel->ring) < SARA_R5_CMUX_CHANNEL_BUFFER_SIZE / 4)
+		{
+			saraR5CmuxSetFlow(mux, channel, true);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * Reads the bytes received on the physical link and sorts the frames into their channel.
+ * The channel transports call it themselves, the application only needs it while no channel is read.
+ * @param mux The multiplexer.
+ */
+void saraR5CmuxPoll(SARA_R5_cmux *mux)
+{
+	uint8_t chunk[64];
+	size_t count;
+
+	while ((count = mux->physical->receive(mux->physical->context, chunk, sizeof(chunk))) > 0)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			if (saraR5CmuxParse(&mux->parser, chunk[i]))
+			{
+				saraR5CmuxFrame(mux);
+			}
+		}
+	}
+}
+
+/**
+ * Sends a SABM or DISC and waits for the UA, sending it again up to SARA_R5_CMUX_RETRIES times.
+ */
+static bool saraR5CmuxRequest(SARA_R5_cmux *mux, uint8_t dlci, uint8_t control)
+{
+	SARA_R5_cmux_channel *channel = &mux->channels[dlci];
+	SARA_R5_transport *physical = mux->physical;
+
+	for (int attempt = 0; attempt < SARA_R5_CMUX_RETRIES; attempt++)
+	{
+		uint32_t start = physical->nowMs(physical->context);
+
+		channel->reply = 0;
+		if (!saraR5CmuxSendFrame(mux, dlci, control | SARA_R5_CMUX_PF, true, NULL, 0))
+		{
+			return false;
+		}
+		while (channel->reply == 0 && (physical->nowMs(physical->context) - start) < SARA_R5_CMUX_REPLY_TIMEOUT)
+		{
+			physical->wait(physical->context, SARA_R5_CMUX_REPLY_TIMEOUT - (physical->nowMs(physical->context) - start));
+			saraR5CmuxPoll(mux);
+		}
+		if (channel->reply != 0)
+		{
+			return channel->reply == SARA_R5_CMUX_UA;
+		}
+	}
+	return false;
+}
+
+/**
+ * Sends the bytes written by the library on a channel, in frames of at most SARA_R5_CMUX_FRAME_SIZE bytes.
+ * Waits while the module has stopped the channel (MSC) or the whole link (FCoff).
+ */
+static bool saraR5CmuxChannelSend(void *context, const uint8_t *data, size_t len)
+{
+	SARA_R5_cmux_channel *channel = (SARA_R5_cmux_channel *)context;
+	SARA_R5_cmux *mux = channel->mux;
+	SARA_R5_transport *physical = mux->physical;
+
+	if (!channel->open)
+	{
+		return false;
+	}
+
+	while (len > 0)
+	{
+		size_t piece = (len > SARA_R5_CMUX_FRAME_SIZE) ? SARA_R5_CMUX_FRAME_SIZE : len;
+		uint32_t start = physical->nowMs(physical->context);
+
+		saraR5CmuxPoll(mux);
+		while (channel->peerStopped || mux->stopped)
+		{
+			if ((physical->nowMs(physical->context) - start) >= SARA_R5_CMUX_FLOW_TIMEOUT)
+			{
+				return false; // The module never resumed
+			}
+			physical->wait(physical->context, 10);
+			saraR5CmuxPoll(mux);
+		}
+
+		if (!saraR5CmuxSendFrame(mux, channel->dlci, SARA_R5_CMUX_UIH, true, data, piece))
+		{
+			return false;
+		}
+		data += piece;
+		len -= piece;
+	}
+	return true;
+}
+
+/**
+ * Hands out the bytes received on a channel, and lets the module resume once they are read.
+ */
+static size_t saraR5CmuxChannelReceive(void *context, uint8_t *data, size_t len)
+{
+	SARA_R5_cmux_channel *channel = (SARA_R5_cmux_channel *)context;
+	size_t count;
+
+	saraR5CmuxPoll(channel->mux);
+	count = saraR5RingBufferRead(&channel->ring, data, len);
+	if (channel->stopped && saraR5RingBufferAvailable(&channel->ring) < SARA_R5_CMUX_CHANNEL_BUFFER_SIZE / 4)
+	{
+		saraR5CmuxSetFlow(channel->mux, channel, false);
+	}
+	return count;
+}
+
+/**
+ * Waits for bytes on the physical link when the channel has nothing to read.
+ * Returns early when bytes arrive for another channel.
+ */
+static void saraR5CmuxChannelWait(void *context, uint32_t ms)
+{
+	SARA_R5_cmux_channel *channel = (SARA_R5_cmux_channel *)context;
+	SARA_R5_transport *physical = channel->mux->physical;
+
+	saraR5CmuxPoll(channel->mux);
+	if (saraR5RingBufferAvailable(&channel->ring) == 0)
+	{
+		physical->wait(physical->context, ms);
+		saraR5CmuxPoll(channel->mux);
+	}
+}
+
+/**
+ * Reads the clock of the physical link.
+ */
+static uint32_t saraR5CmuxChannelNowMs(void *context)
+{
+	SARA_R5_cmux_channel *channel = (SARA_R5_cmux_channel *)context;
+
+	return channel->mux->physical->nowMs(channel->mux->physical->context);
+}
+
+/**
+ * Initializes a multiplexer on top of a link already switched to CMUX mode (AT+CMUX answered OK).
+ * No channel is open yet: open DLCI 0, then the channels to use, with saraR5CmuxOpen.
+ * @param mux Storage for the multiplexer. Must live as long as its channels are used.
+ * @param physical The serial link to the module.
+ */
+void saraR5CmuxInit(SARA_R5_cmux *mux, SARA_R5_transport *physical)
+{
+	memset(mux, 0, sizeof(*mux));
+	mux->physical = physical;
+	saraR5CmuxParserReset(&mux->parser);
+
+	for (uint8_t dlci = 0; dlci <= SARA_R5_CMUX_CHANNELS; dlci++)
+	{
+		SARA_R5_cmux_channel *channel = &mux->channels[dlci];
+
+		channel->mux = mux;
+		channel->dlci = dlci;
+		saraR5RingBufferInit(&channel->ring, channel->storage, sizeof(channel->storage));
+		channel->transport.send = saraR5CmuxChannelSend;
+		channel->transport.receive = saraR5CmuxChannelReceive;
+		channel->transport.wait = saraR5CmuxChannelWait;
+		channel->transport.nowMs = saraR5CmuxChannelNowMs;
+		channel->transport.setBaudRate = NULL; // The rate belongs to the physical link
+		channel->transport.context = channel;
+	}
+}
+
+/**
+ * Opens a channel (SABM / UA). DLCI 0, the control channel, must be opened first.
+ * @param mux The multiplexer.
+ * @param dlci The channel, 0 to SARA_R5_CMUX_CHANNELS.
+ * @return true if the module accepted the channel, false otherwise.
+ */
+bool saraR5CmuxOpen(SARA_R5_cmux *mux, uint8_t dlci)
+{
+	if (dlci > SARA_R5_CMUX_CHANNELS)
+	{
+		return false;
+	}
+	mux->channels[dlci].open = saraR5CmuxRequest(mux, dlci, SARA_R5_CMUX_SABM);
+	return mux->channels[dlci].open;
+}
+
+/**
+ * Closes a channel (DISC / UA). Bytes not read yet are dropped.
+ * @param mux The multiplexer.
+ * @param dlci The channel.
+ * @return true if the module acknowledged, false otherwise. The channel is closed in both cases.
+ */
+bool saraR5CmuxCloseChannel(SARA_R5_cmux *mux, uint8_t dlci)
+{
+	bool acknowledged;
+
+	if (dlci > SARA_R5_CMUX_CHANNELS || !mux->channels[dlci].open)
+	{
+		return false;
+	}
+	acknowledged = saraR5CmuxRequest(mux, dlci, SARA_R5_CMUX_DISC);
+	mux->channels[dlci].open = false;
+	saraR5RingBufferClear(&mux->channels[dlci].ring);
+	return acknowledged;
+}
+
+/**
+ * Closes every channel, then sends CLD so the module goes back to plain AT commands on the physical link.
+ * @param mux The multiplexer.
+ * @return true if the module acknowledged the close down, false otherwise.
+ */
+bool saraR5CmuxClose(SARA_R5_cmux *mux)
+{
+	SARA_R5_transport *physical = mux->physical;
+	uint32_t start;
+
+	for (uint8_t dlci = 1; dlci <= SARA_R5_CMUX_CHANNELS; dlci++)
+	{
+		if (mux->channels[dlci].open)
+		{
+			saraR5CmuxCloseChannel(mux, dlci);
+		}
+	}
+
+	mux->closed = false;
+	if (!saraR5CmuxSendMessage(mux, SARA_R5_CMUX_MSG_CLD, NULL, 0))
+	{
+		return false;
+	}
+
+	// The module answers with a CLD response, then leaves the multiplexer mode
+	start = physical->nowMs(physical->context);
+	while ((physical->nowMs(physical->context) - start) < SARA_R5_CMUX_REPLY_TIMEOUT)
+	{
+		saraR5CmuxPoll(mux);
+		if (mux->closed)
+		{
+			break;
+		}
+		physical->wait(physical->context, SARA_R5_CMUX_REPLY_TIMEOUT - (physical->nowMs(physical->context) - start));
+	}
+	mux->channels[0].open = false;
+	return mux->closed;
+}
+
+/**
+ * Gets the transport of a channel, to be handed to saraR5SetTransport or used directly for data.
+ * @param mux The multiplexer.
+ * @param dlci The channel, 1 to SARA_R5_CMUX_CHANNELS.
+ * @return The transport, or NULL if the DLCI is out of range.
+ */
+SARA_R5_transport *saraR5CmuxChannel(SARA_R5_cmux *mux, uint8_t dlci)
+{
+	if (dlci == 0 || dlci > SARA_R5_CMUX_CHANNELS)
+	{
+		return NULL;
+	}
+	return &mux->channels[dlci].transport;
+}
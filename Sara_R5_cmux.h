@@ -0,0 +1,94 @@
+#ifndef SARA_R5_CMUX_H
+#define SARA_R5_CMUX_H
+
+// INCLUDES
+#include "Sara_R5_transport.h"
+#include "Sara_R5_ring_buffer.h"
+
+#ifndef SARA_R5_CMUX_CHANNELS
+#define SARA_R5_CMUX_CHANNELS 3 // Virtual channels, DLCI 1 to SARA_R5_CMUX_CHANNELS
+#endif
+#ifndef SARA_R5_CMUX_CHANNEL_BUFFER_SIZE
+#define SARA_R5_CMUX_CHANNEL_BUFFER_SIZE 512 // Bytes received on one channel and not read yet
+#endif
+#define SARA_R5_CMUX_FRAME_SIZE 127     // N1, largest information field (set by AT+CMUX)
+#define SARA_R5_CMUX_REPLY_TIMEOUT 1000 // T1, wait for the UA to a SABM / DISC
+#define SARA_R5_CMUX_RETRIES 3          // N2, SABM / DISC sent before giving up
+#define SARA_R5_CMUX_FLOW_TIMEOUT 5000  // Longest time a send waits for the module to accept data
+
+// Frame fields (3GPP TS 27.010, basic option)
+#define SARA_R5_CMUX_FLAG 0xF9
+#define SARA_R5_CMUX_SABM 0x2F
+#define SARA_R5_CMUX_UA 0x63
+#define SARA_R5_CMUX_DM 0x0F
+#define SARA_R5_CMUX_DISC 0x43
+#define SARA_R5_CMUX_UIH 0xEF
+#define SARA_R5_CMUX_UI 0x03
+#define SARA_R5_CMUX_PF 0x10
+
+// Control channel (DLCI 0) messages, command versions (the response clears 0x02)
+#define SARA_R5_CMUX_MSG_MSC 0xE3   // Modem status, carries the flow control bit of one channel
+#define SARA_R5_CMUX_MSG_FCON 0xA3  // Flow on, every channel
+#define SARA_R5_CMUX_MSG_FCOFF 0x63 // Flow off, every channel
+#define SARA_R5_CMUX_MSG_CLD 0xC3   // Close down, back to AT mode
+#define SARA_R5_CMUX_MSG_NSC 0x11   // Command not supported (response)
+#define SARA_R5_CMUX_MSG_CR 0x02    // Command bit of the message type
+#define SARA_R5_CMUX_MSC_FC 0x02    // Flow control bit of the MSC signals
+#define SARA_R5_CMUX_MSC_SIGNALS 0x8D // DV, RTR, RTC and EA set
+
+// Frame decoder, fed one byte at a time
+typedef struct
+{
+  uint8_t state;                          // Field expected next
+  uint8_t header[4];                      // Address, control and length bytes, for the FCS
+  size_t headerLength;                    // Bytes stored in 'header'
+  size_t length;                          // Announced information length
+  size_t received;                        // Information bytes received
+  uint8_t info[SARA_R5_CMUX_FRAME_SIZE];  // Information field
+  uint8_t dlci;                           // Channel of the frame
+  uint8_t control;                        // Frame type, with the P/F bit
+  bool commandResponse;                   // C/R bit of the address
+  unsigned long badFcs;                   // Frames dropped on a wrong FCS
+  unsigned long badFrames;                // Frames dropped on a wrong length or closing flag
+} SARA_R5_cmux_parser;
+
+typedef struct SARA_R5_cmux SARA_R5_cmux;
+
+// Virtual channel, seen by the library as a transport
+typedef struct
+{
+  SARA_R5_cmux *mux;                                      // Multiplexer the channel belongs to
+  uint8_t dlci;                                           // Data link connection identifier
+  bool open;                                              // SABM acknowledged
+  uint8_t reply;                                          // Last UA / DM received, 0 while waiting
+  bool peerStopped;                                       // The module asked us to stop sending (MSC FC)
+  bool stopped;                                           // We asked the module to stop sending
+  uint8_t storage[SARA_R5_CMUX_CHANNEL_BUFFER_SIZE];      // Storage of 'ring'
+  SARA_R5_ring_buffer ring;                               // Bytes received on the channel
+  SARA_R5_transport transport;                            // Transport handed to the library
+} SARA_R5_cmux_channel;
+
+struct SARA_R5_cmux
+{
+  SARA_R5_transport *physical;                            // Serial link to the module
+  SARA_R5_cmux_parser parser;                             // Decoder of the received frames
+  SARA_R5_cmux_channel channels[SARA_R5_CMUX_CHANNELS + 1]; // Indexed by DLCI, 0 is the control channel
+  bool stopped;                                           // The module sent FCoff
+  bool closed;                                            // The module sent CLD
+};
+
+// FUNCTIONS FOR CMUX FRAMES
+uint8_t saraR5CmuxFcs(const uint8_t *data, size_t len);
+size_t saraR5CmuxHeader(uint8_t *header, uint8_t dlci, uint8_t control, bool commandResponse, size_t len);
+void saraR5CmuxParserReset(SARA_R5_cmux_parser *parser);
+bool saraR5CmuxParse(SARA_R5_cmux_parser *parser, uint8_t byte);
+
+// FUNCTIONS FOR THE CMUX MULTIPLEXER
+void saraR5CmuxInit(SARA_R5_cmux *mux, SARA_R5_transport *physical);
+bool saraR5CmuxOpen(SARA_R5_cmux *mux, uint8_t dlci);
+bool saraR5CmuxCloseChannel(SARA_R5_cmux *mux, uint8_t dlci);
+bool saraR5CmuxClose(SARA_R5_cmux *mux);
+void saraR5CmuxPoll(SARA_R5_cmux *mux);
+SARA_R5_transport *saraR5CmuxChannel(SARA_R5_cmux *mux, uint8_t dlci);
+
+#endif // SARA_R5_CMUX_H
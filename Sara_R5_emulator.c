@@ -0,0 +1,1621 @@
+#include "Sara_R5_emulator.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "ctype.h"
+
+#define SARA_R5_EMU_OK "\r\nOK\r\n"
+#define SARA_R5_EMU_ERROR "\r\nERROR\r\n"
+#define SARA_R5_EMU_ANSWER_SIZE 512
+#define SARA_R5_EMU_ADDRESS_SIZE 16 // Dotted IPv4 address given by the emulated DNS, with its terminator
+#define SARA_R5_EMU_TLS_FULL_BYTES 5000 // Air bytes of a full TLS handshake (certificate chain included)
+#define SARA_R5_EMU_TLS_RESUMED_BYTES 400 // Air bytes of a resumed one
+#define SARA_R5_EMU_MAX_GARBAGE 16
+#define SARA_R5_EMU_IP "10.64.12.7"
+#define SARA_R5_EMU_ABORTED "\r\nABORTED\r\n"
+#define SARA_R5_EMU_PEER_IP "192.0.2.10" // Remote end of the sockets, sender of the datagrams
+#define SARA_R5_EMU_PEER_PORT 7
+
+// Answer to AT+COPS=?, longer than one tokenizer line as a real scan in a busy area
+#define SARA_R5_EMU_OPERATORS                                                                                       \
+	"\r\n+COPS: (2,\"Emu Telecom\",\"EMU\",\"99901\",7),(1,\"Other Net\",\"OTH\",\"99902\",7),"                   \
+	"(3,\"Blocked Net\",\"BLK\",\"99903\",9),(1,\"Roaming Partner One\",\"RP1\",\"99904\",7),"                    \
+	"(1,\"Roaming Partner Two\",\"RP2\",\"99905\",9),(1,\"Emu Telecom NB-IoT\",\"EMU NB\",\"99906\",9),"           \
+	"(3,\"Border Network\",\"BRD\",\"99907\",7),,(0,1,2,3,4),(0,1,2)\r\n\r\nOK\r\n"
+
+/**
+ * Fills a configuration with latencies close to a SARA-R5 on LTE-M at 115200 baud, and no faults.
+ * @param config The configuration to fill.
+ */
+void saraR5EmulatorDefaultConfig(SARA_R5_emulator_config *config)
+{
+	memset(config, 0, sizeof(*config));
+	config->baud = 115200;
+	config->seed = 1;
+	config->latency[SARA_R5_EMU_CMD_AT] = (SARA_R5_emulator_latency){1, 5};
+	config->latency[SARA_R5_EMU_CMD_COPS] = (SARA_R5_emulator_latency){20, 60};
+	config->latency[SARA_R5_EMU_CMD_CGDCONT] = (SARA_R5_emulator_latency){5, 15};
+	config->latency[SARA_R5_EMU_CMD_UPSDA] = (SARA_R5_emulator_latency){100, 800};
+	config->latency[SARA_R5_EMU_CMD_SOCKET] = (SARA_R5_emulator_latency){5, 20};
+	config->latency[SARA_R5_EMU_CMD_USOCO] = (SARA_R5_emulator_latency){10, 40};
+	config->latency[SARA_R5_EMU_CMD_USOST] = (SARA_R5_emulator_latency){20, 80};
+	config->latency[SARA_R5_EMU_CMD_MQTT] = (SARA_R5_emulator_latency){5, 30};
+	config->latency[SARA_R5_EMU_CMD_DNS] = (SARA_R5_emulator_latency){200, 800};
+	config->latency[SARA_R5_EMU_CMD_OTHER] = (SARA_R5_emulator_latency){1, 5};
+	config->urcLatency = (SARA_R5_emulator_latency){200, 1500};
+	config->peerLatency = (SARA_R5_emulator_latency){40, 120};
+	config->scanLatency = (SARA_R5_emulator_latency){2000, 6000};
+	config->handshakeLatency = (SARA_R5_emulator_latency){1500, 3000};
+	config->resumedLatency = (SARA_R5_emulator_latency){300, 600};
+}
+
+/**
+ * Draws the next pseudo random number (xorshift32), so runs are reproducible from the seed.
+ */
+static uint32_t saraR5EmuRandom(SARA_R5_emulator *emulator)
+{
+	uint32_t x = emulator->random;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	emulator->random = x;
+	return x;
+}
+
+/**
+ * Returns true with the given chance in percent.
+ */
+static bool saraR5EmuRoll(SARA_R5_emulator *emulator, uint8_t percent)
+{
+	return percent > 0 && (saraR5EmuRandom(emulator) % 100) < percent;
+}
+
+/**
+ * Draws a delay in microseconds from a latency model.
+ */
+static uint64_t saraR5EmuDelayUs(SARA_R5_emulator *emulator, SARA_R5_emulator_latency latency)
+{
+	uint32_t ms = latency.minMs;
+
+	if (latency.maxMs > latency.minMs)
+	{
+		ms += saraR5EmuRandom(emulator) % (latency.maxMs - latency.minMs + 1);
+	}
+	return (uint64_t)ms * 1000u;
+}
+
+/**
+ * Time one byte needs on the line (start + 8 data + stop bits).
+ */
+static uint64_t saraR5EmuByteTimeUs(const SARA_R5_emulator *emulator, size_t bytes)
+{
+	return ((uint64_t)bytes * 10u * 1000000u) / emulator->moduleBaud;
+}
+
+/**
+ * Queues bytes towards the library. They start to leave 'delayUs' from now,
+ * or once the line is free, and then flow at line rate.
+ */
+static bool saraR5EmuQueue(SARA_R5_emulator *emulator, const char *data, size_t len, uint64_t delayUs)
+{
+	SARA_R5_emulator_segment *segment;
+	uint64_t start = emulator->nowUs + delayUs;
+
+	if (len == 0)
+	{
+		return true;
+	}
+	if (emulator->segmentCount == SARA_R5_EMU_MAX_SEGMENTS || saraR5RingBufferFree(&emulator->output) < len)
+	{
+		return false; // Output full, the bytes are lost as on an overrun line
+	}
+
+	if (start < emulator->lineFreeUs)
+	{
+		start = emulator->lineFreeUs;
+	}
+
+	segment = &emulator->segments[(emulator->segmentHead + emulator->segmentCount) % SARA_R5_EMU_MAX_SEGMENTS];
+	segment->startUs = start;
+	segment->len = len;
+	segment->delivered = 0;
+	emulator->segmentCount++;
+	saraR5RingBufferWrite(&emulator->output, (const uint8_t *)data, len);
+	emulator->lineFreeUs = start + saraR5EmuByteTimeUs(emulator, len);
+	return true;
+}
+
+/**
+ * Puts a CMUX frame on the line at once. The emulator is the responding station.
+ */
+static bool saraR5EmuSendFrame(SARA_R5_emulator *emulator, uint8_t dlci, uint8_t control, bool commandResponse, const uint8_t *info, size_t len)
+{
+	uint8_t frame[SARA_R5_CMUX_FRAME_SIZE + 7];
+	size_t count = 1;
+	size_t headerLength;
+
+	frame[0] = SARA_R5_CMUX_FLAG;
+	headerLength = saraR5CmuxHeader(&frame[count], dlci, control, commandResponse, len);
+	frame[count + headerLength + len] = saraR5CmuxFcs(&frame[count], headerLength);
+	count += headerLength;
+	if (len > 0)
+	{
+		memcpy(&frame[count], info, len);
+	}
+	count += len + 1;
+	frame[count++] = SARA_R5_CMUX_FLAG;
+	return saraR5EmuQueue(emulator, (const char *)frame, count, 0);
+}
+
+/**
+ * Puts the CMUX frames whose time has come on the line, unless the library has stopped their channel.
+ */
+static void saraR5EmuReleaseFrames(SARA_R5_emulator *emulator)
+{
+	size_t i = 0;
+
+	while (i < emulator->frameCount)
+	{
+		SARA_R5_emulator_frame *frame = &emulator->frames[i];
+
+		if (frame->dueUs > emulator->nowUs || emulator->muxStopped[frame->dlci])
+		{
+			i++;
+			continue;
+		}
+		saraR5EmuSendFrame(emulator, frame->dlci, SARA_R5_CMUX_UIH, false, frame->info, frame->len);
+		emulator->frameCount--;
+		memmove(frame, frame + 1, (emulator->frameCount - i) * sizeof(emulator->frames[0]));
+	}
+}
+
+/**
+ * Sends bytes towards the library 'delayUs' from now: as they are, or in CMUX mode in UIH frames
+ * on the channel of the command being answered. Frames of different channels do not wait for each other.
+ */
+static bool saraR5EmuOutput(SARA_R5_emulator *emulator, const char *data, size_t len, uint64_t delayUs)
+{
+	if (!emulator->mux)
+	{
+		return saraR5EmuQueue(emulator, data, len, delayUs);
+	}
+
+	while (len > 0)
+	{
+		SARA_R5_emulator_frame *frame;
+		size_t piece = (len > SARA_R5_CMUX_FRAME_SIZE) ? SARA_R5_CMUX_FRAME_SIZE : len;
+
+		if (emulator->frameCount == SARA_R5_EMU_MAX_FRAMES)
+		{
+			return false; // Output full, the bytes are lost
+		}
+		frame = &emulator->frames[emulator->frameCount++];
+		frame->dueUs = emulator->nowUs + delayUs;
+		frame->dlci = emulator->channel;
+		frame->len = piece;
+		memcpy(frame->info, data, piece);
+		data += piece;
+		len -= piece;
+	}
+	saraR5EmuReleaseFrames(emulator);
+	return true;
+}
+
+/**
+ * Queues the answer to a command after 'delay' microseconds, applying the configured faults.
+ * The answer may hold any byte (e.g. the data of AT+USORD).
+ */
+static void saraR5EmuAnswerAfter(SARA_R5_emulator *emulator, uint64_t delay, const char *answer, size_t len)
+{
+	size_t okLength = strlen(SARA_R5_EMU_OK);
+
+	if (emulator->chainFailed)
+	{
+		return; // An earlier command of the ';' chained line failed
+	}
+
+	if (saraR5EmuRoll(emulator, emulator->config.errorPercent))
+	{
+		emulator->stats.faults++;
+		answer = SARA_R5_EMU_ERROR;
+		len = strlen(answer);
+	}
+
+	// In a ';' chained line only the last command, or the first failing one, gives a final result code
+	if (len == strlen(SARA_R5_EMU_ERROR) && memcmp(answer, SARA_R5_EMU_ERROR, len) == 0)
+	{
+		emulator->chainFailed = true;
+	}
+	else if (emulator->chainContinues && len >= okLength && memcmp(&answer[len - okLength], SARA_R5_EMU_OK, okLength) == 0)
+	{
+		len -= okLength;
+	}
+
+	if (saraR5EmuRoll(emulator, emulator->config.garbagePercent))
+	{
+		char garbage[SARA_R5_EMU_MAX_GARBAGE];
+		size_t count = 1 + saraR5EmuRandom(emulator) % SARA_R5_EMU_MAX_GARBAGE;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			garbage[i] = (char)(saraR5EmuRandom(emulator) & 0xFF);
+		}
+		emulator->stats.faults++;
+		saraR5EmuQueue(emulator, garbage, count, delay);
+		delay = 0;
+	}
+
+	if (len > 1 && saraR5EmuRoll(emulator, emulator->config.truncatePercent))
+	{
+		emulator->stats.faults++;
+		len = 1 + saraR5EmuRandom(emulator) % (len - 1);
+	}
+
+	saraR5EmuOutput(emulator, answer, len, delay);
+}
+
+/**
+ * Queues the answer to a command after the latency of its family, see saraR5EmuAnswerAfter.
+ */
+static void saraR5EmuAnswerBytes(SARA_R5_emulator *emulator, SARA_R5_emulator_command family, const char *answer, size_t len)
+{
+	saraR5EmuAnswerAfter(emulator, saraR5EmuDelayUs(emulator, emulator->config.latency[family]), answer, len);
+}
+
+/**
+ * Queues a text answer to a command, see saraR5EmuAnswerBytes.
+ */
+static void saraR5EmuAnswer(SARA_R5_emulator *emulator, SARA_R5_emulator_command family, const char *answer)
+{
+	saraR5EmuAnswerBytes(emulator, family, answer, strlen(answer));
+}
+
+/**
+ * Keeps a URC until the virtual clock reaches 'dueUs'. It is then sent after what is already on the line.
+ */
+static bool saraR5EmuAddUrc(SARA_R5_emulator *emulator, const char *urc, uint64_t dueUs)
+{
+	SARA_R5_emulator_urc *entry;
+	int len;
+
+	if (emulator->urcCount == SARA_R5_EMU_MAX_URCS)
+	{
+		return false;
+	}
+	entry = &emulator->urcs[emulator->urcCount];
+	len = snprintf(entry->text, sizeof(entry->text), "\r\n%s\r\n", urc);
+	if (len < 0 || (size_t)len >= sizeof(entry->text))
+	{
+		return false;
+	}
+	entry->len = (size_t)len;
+	entry->dueUs = dueUs;
+	emulator->urcCount++;
+	return true;
+}
+
+/**
+ * Puts the URCs whose time has come on the line.
+ */
+static void saraR5EmuReleaseUrcs(SARA_R5_emulator *emulator)
+{
+	uint8_t channel = emulator->channel;
+	size_t i = 0;
+
+	// In CMUX mode URCs come on their own channel, whatever the command being answered
+	emulator->channel = SARA_R5_EMU_URC_CHANNEL;
+	while (i < emulator->urcCount)
+	{
+		if (emulator->urcs[i].dueUs > emulator->nowUs)
+		{
+			i++;
+			continue;
+		}
+		saraR5EmuOutput(emulator, emulator->urcs[i].text, emulator->urcs[i].len, 0);
+		emulator->urcCount--;
+		memmove(&emulator->urcs[i], &emulator->urcs[i + 1], (emulator->urcCount - i) * sizeof(emulator->urcs[0]));
+	}
+	emulator->channel = channel;
+}
+
+/**
+ * Queues an unsolicited result code some time after the current command.
+ */
+static void saraR5EmuUrc(SARA_R5_emulator *emulator, const char *urc)
+{
+	saraR5EmuAddUrc(emulator, urc, emulator->nowUs + saraR5EmuDelayUs(emulator, emulator->config.urcLatency));
+}
+
+/**
+ * Schedules an unsolicited result code (e.g. "+UUSORD: 0,12") to be sent after 'delayMs'.
+ * @param emulator The emulator.
+ * @param urc The URC text without line terminators.
+ * @param delayMs Delay from the current virtual time.
+ * @return true if the URC was queued, false if too many URCs are waiting.
+ */
+bool saraR5EmulatorScheduleUrc(SARA_R5_emulator *emulator, const char *urc, uint32_t delayMs)
+{
+	return saraR5EmuAddUrc(emulator, urc, emulator->nowUs + (uint64_t)delayMs * 1000u);
+}
+
+/**
+ * Keeps bytes sent by the remote end of a socket and announces them with +UUSORD (+UUSORF for UDP),
+ * giving the number of bytes waiting, once the virtual clock reaches 'dueUs'.
+ */
+static bool saraR5EmuSocketReceive(SARA_R5_emulator *emulator, int socket, const uint8_t *data, size_t len, uint64_t dueUs)
+{
+	char urc[SARA_R5_EMU_URC_SIZE];
+	size_t *stored = &emulator->socketDataLength[socket];
+
+	if (len > SARA_R5_EMU_SOCKET_BUFFER_SIZE - *stored)
+	{
+		return false; // The module buffer is full, the bytes are lost
+	}
+	memcpy(&emulator->socketData[socket][*stored], data, len);
+	*stored += len;
+	snprintf(urc, sizeof(urc), "%s: %d,%u", emulator->socketUdp[socket] ? "+UUSORF" : "+UUSORD", socket, (unsigned)*stored);
+	return saraR5EmuAddUrc(emulator, urc, dueUs);
+}
+
+/**
+ * Makes the remote end of an open socket send bytes. The module keeps them until AT+USORD / AT+USORF
+ * and announces them with +UUSORD / +UUSORF after 'delayMs'.
+ * @param emulator The emulator.
+ * @param socket The socket, created with AT+USOCR.
+ * @param data The bytes.
+ * @param len The number of bytes.
+ * @param delayMs Delay from the current virtual time.
+ * @return true if the bytes were kept, false if the socket is not open or its buffer is full.
+ */
+bool saraR5EmulatorSocketData(SARA_R5_emulator *emulator, int socket, const uint8_t *data, size_t len, uint32_t delayMs)
+{
+	if (socket < 0 || socket >= SARA_R5_EMU_NUM_SOCKETS || !emulator->socketOpen[socket])
+	{
+		return false;
+	}
+	return saraR5EmuSocketReceive(emulator, socket, data, len, emulator->nowUs + (uint64_t)delayMs * 1000u);
+}
+
+/**
+ * Makes the remote end (or the network) close an open socket: the module frees its ID at once, or keeps it
+ * for AT+USOCO when 'closeKeepsId' is set, and reports it with +UUSOCL after 'delayMs'. The bytes not read yet are lost.
+ * @param emulator The emulator.
+ * @param socket The socket, created with AT+USOCR.
+ * @param delayMs Delay of the URC from the current virtual time.
+ * @return true if the socket was closed, false if it is not open or too many URCs are waiting.
+ */
+bool saraR5EmulatorSocketClose(SARA_R5_emulator *emulator, int socket, uint32_t delayMs)
+{
+	char urc[SARA_R5_EMU_URC_SIZE];
+
+	if (socket < 0 || socket >= SARA_R5_EMU_NUM_SOCKETS || !emulator->socketOpen[socket])
+	{
+		return false;
+	}
+	emulator->socketOpen[socket] = emulator->config.closeKeepsId;
+	emulator->socketConnected[socket] = false;
+	emulator->socketDataLength[socket] = 0;
+	snprintf(urc, sizeof(urc), "+UUSOCL: %d", socket);
+	return saraR5EmuAddUrc(emulator, urc, emulator->nowUs + (uint64_t)delayMs * 1000u);
+}
+
+/**
+ * Answers AT+USORD=<socket>,<length> and AT+USORF=<socket>,<length>: hands out the oldest bytes received,
+ * as they are or as hex digits. A length of 0 asks for the number of bytes waiting.
+ */
+static void saraR5EmuSocketRead(SARA_R5_emulator *emulator, int socket, bool udp, const char *args)
+{
+	static const char hexDigits[] = "0123456789ABCDEF";
+	static const char end[] = "\"\r\n" SARA_R5_EMU_OK;
+	char answer[64 + 2 * SARA_R5_EMU_MAX_PAYLOAD + 16];
+	const char *name = udp ? "+USORF" : "+USORD";
+	size_t *stored = &emulator->socketDataLength[socket];
+	int requested = -1;
+	size_t count;
+	int len;
+
+	if (sscanf(args, "=%*d,%d", &requested) != 1 || requested < 0 || requested > SARA_R5_EMU_MAX_PAYLOAD ||
+		(emulator->hexMode && requested > SARA_R5_EMU_MAX_PAYLOAD / 2))
+	{
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_SOCKET, SARA_R5_EMU_ERROR);
+		return;
+	}
+	if (requested == 0)
+	{
+		snprintf(answer, sizeof(answer), "\r\n%s: %d,%u\r\n\r\nOK\r\n", name, socket, (unsigned)*stored);
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_SOCKET, answer);
+		return;
+	}
+
+	count = (*stored < (size_t)requested) ? *stored : (size_t)requested;
+	if (udp)
+	{
+		len = snprintf(answer, sizeof(answer), "\r\n%s: %d,\"%s\",%d,%u,\"", name, socket, SARA_R5_EMU_PEER_IP, SARA_R5_EMU_PEER_PORT, (unsigned)count);
+	}
+	else
+	{
+		len = snprintf(answer, sizeof(answer), "\r\n%s: %d,%u,\"", name, socket, (unsigned)count);
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		uint8_t byte = emulator->socketData[socket][i];
+
+		if (emulator->hexMode)
+		{
+			answer[len++] = hexDigits[byte >> 4];
+			answer[len++] = hexDigits[byte & 0x0F];
+		}
+		else
+		{
+			answer[len++] = (char)byte;
+		}
+	}
+	memcpy(&answer[len], end, sizeof(end) - 1);
+	len += (int)(sizeof(end) - 1);
+	*stored -= count;
+	memmove(emulator->socketData[socket], &emulator->socketData[socket][count], *stored);
+	saraR5EmuAnswerBytes(emulator, SARA_R5_EMU_CMD_SOCKET, answer, (size_t)len);
+}
+
+/**
+ * Answers AT+COPS.
+ */
+static void saraR5EmuCops(SARA_R5_emulator *emulator, const char *args)
+{
+	if (strcmp(args, "=?") == 0)
+	{
+		// The list comes once the scan is over, see saraR5EmuReleaseScan
+		emulator->scanDueUs = emulator->nowUs + saraR5EmuDelayUs(emulator, emulator->config.scanLatency);
+		emulator->scanChannel = emulator->channel;
+	}
+	else if (strcmp(args, "?") == 0)
+	{
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_AT, "\r\n+COPS: 0,0,\"Emu Telecom\",7\r\n\r\nOK\r\n");
+	}
+	else
+	{
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_COPS, SARA_R5_EMU_OK);
+	}
+}
+
+/**
+ * Answers the AT+COPS=? scan whose time has come.
+ */
+static void saraR5EmuReleaseScan(SARA_R5_emulator *emulator)
+{
+	uint8_t channel = emulator->channel;
+
+	if (emulator->scanDueUs == 0 || emulator->scanDueUs > emulator->nowUs)
+	{
+		return;
+	}
+	emulator->scanDueUs = 0;
+	emulator->channel = emulator->scanChannel;
+	saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_COPS, SARA_R5_EMU_OPERATORS);
+	emulator->channel = channel;
+}
+
+/**
+ * Answers AT+CGDCONT.
+ */
+static void saraR5EmuCgdcont(SARA_R5_emulator *emulator, const char *args)
+{
+	if (strcmp(args, "?") == 0)
+	{
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_CGDCONT,
+						"\r\n+CGDCONT: 1,\"IP\",\"emu.apn.mnc001.mcc999.gprs\",\"" SARA_R5_EMU_IP "\",0,0,0,2,0,0,0,0,0,0\r\n"
+						"+CGDCONT: 2,\"IPV4V6\",\"ims\",\"10.64.12.8 32.1.13.184.0.0.0.0.0.0.0.0.0.0.0.1\",0,0,0,2,0,0,0,0,0,0\r\n"
+						"\r\nOK\r\n");
+	}
+	else
+	{
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_CGDCONT, SARA_R5_EMU_OK);
+	}
+}
+
+/**
+ * Answers AT+UPSDA. Activation is followed by +UUPSDA.
+ */
+static void saraR5EmuUpsda(SARA_R5_emulator *emulator, const char *args)
+{
+	int profile = 0;
+	int action = -1;
+
+	if (sscanf(args, "=%d,%d", &profile, &action) != 2)
+	{
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_OTHER, SARA_R5_EMU_ERROR);
+		return;
+	}
+
+	saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_UPSDA, SARA_R5_EMU_OK);
+	if (action == 3)
+	{
+		char urc[64];
+		snprintf(urc, sizeof(urc), "+UUPSDA: 0,\"%s\"", SARA_R5_EMU_IP);
+		saraR5EmuUrc(emulator, urc);
+	}
+}
+
+/**
+ * Drains the bytes of a TCP socket the remote end has acknowledged since the last call, at 'ackBytesPerSec'.
+ */
+static void saraR5EmuSocketAck(SARA_R5_emulator *emulator, int socket)
+{
+	uint64_t rate = emulator->config.ackBytesPerSec;
+	uint64_t acked;
+
+	if (rate == 0 || emulator->socketUnacked[socket] == 0)
+	{
+		emulator->socketUnacked[socket] = 0;
+		emulator->socketAckUs[socket] = emulator->nowUs;
+		return;
+	}
+	acked = (emulator->nowUs - emulator->socketAckUs[socket]) * rate / 1000000u;
+	if (acked >= emulator->socketUnacked[socket])
+	{
+		emulator->socketUnacked[socket] = 0;
+		emulator->socketAckUs[socket] = emulator->nowUs;
+		return;
+	}
+	emulator->socketUnacked[socket] -= (size_t)acked;
+	emulator->socketAckUs[socket] += acked * 1000000u / rate;
+}
+
+/**
+ * Answers the AT+USOST / AT+USOWR whose data is in 'payload', and hands the data to the remote end.
+ */
+static void saraR5EmuSocketSent(SARA_R5_emulator *emulator)
+{
+	char answer[SARA_R5_EMU_ANSWER_SIZE];
+	size_t accepted = emulator->payloadLength;
+
+	if (emulator->payloadTcp)
+	{
+		size_t unacked;
+
+		// TCP data only fits in what the send buffer has left
+		saraR5EmuSocketAck(emulator, emulator->payloadSocket);
+		unacked = emulator->socketUnacked[emulator->payloadSocket];
+		if (emulator->config.sendBufferBytes > 0)
+		{
+			size_t room = (unacked < emulator->config.sendBufferBytes) ? emulator->config.sendBufferBytes - unacked : 0;
+
+			accepted = (accepted < room) ? accepted : room;
+		}
+		emulator->socketUnacked[emulator->payloadSocket] += accepted;
+	}
+	emulator->stats.socketBytes += accepted;
+
+	snprintf(answer, sizeof(answer), "\r\n+%s: %d,%u\r\n\r\nOK\r\n", emulator->payloadTcp ? "USOWR" : "USOST",
+			 emulator->payloadSocket, (unsigned)accepted);
+	saraR5EmuAnswer(emulator, (!emulator->payloadTcp && emulator->payloadNamed) ? SARA_R5_EMU_CMD_DNS : SARA_R5_EMU_CMD_USOST, answer);
+	if (emulator->config.socketEcho && accepted > 0)
+	{
+		// The remote end sends the data back
+		saraR5EmuSocketReceive(emulator, emulator->payloadSocket, emulator->payload, accepted,
+							   emulator->nowUs + saraR5EmuDelayUs(emulator, emulator->config.peerLatency));
+	}
+}
+
+/**
+ * Runs the TLS handshake of a security profile: a full one, or the resumption of the session of the last one
+ * when the profile has session resumption turned on.
+ * @return The time the handshake takes (us).
+ */
+static uint64_t saraR5EmuHandshakeUs(SARA_R5_emulator *emulator, uint8_t profile)
+{
+	emulator->stats.tlsHandshakes++;
+	if (emulator->tlsResumption[profile] && emulator->tlsSession[profile])
+	{
+		emulator->stats.tlsResumed++;
+		emulator->stats.tlsBytes += SARA_R5_EMU_TLS_RESUMED_BYTES;
+		return saraR5EmuDelayUs(emulator, emulator->config.resumedLatency);
+	}
+	emulator->tlsSession[profile] = emulator->tlsResumption[profile];
+	emulator->stats.tlsBytes += SARA_R5_EMU_TLS_FULL_BYTES;
+	return saraR5EmuDelayUs(emulator, emulator->config.handshakeLatency);
+}
+
+/**
+ * Answers AT+USECPRF. The profile alone resets it; of the parameters only the session resumption (13) changes
+ * the emulated handshakes, the others are accepted.
+ */
+static void saraR5EmuSecurityProfile(SARA_R5_emulator *emulator, const char *args)
+{
+	int profile = -1;
+	int op = -1;
+	int value = 0;
+	int count = sscanf(args, "=%d,%d,%d", &profile, &op, &value);
+
+	if (count < 1 || profile < 0 || profile >= SARA_R5_EMU_TLS_PROFILES)
+	{
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_AT, SARA_R5_EMU_ERROR);
+		return;
+	}
+	if (count == 1)
+	{
+		emulator->tlsResumption[profile] = false;
+		emulator->tlsSession[profile] = false;
+	}
+	else if (op == 13)
+	{
+		emulator->tlsResumption[profile] = (value == 1);
+		emulator->tlsSession[profile] = false;
+	}
+	saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_AT, SARA_R5_EMU_OK);
+}
+
+/**
+ * Tells whether a quoted address field holds a host name rather than an IPv4 or IPv6 address.
+ */
+static bool saraR5EmuHostName(const char *field)
+{
+	bool letter = false;
+
+	for (field++; *field != '"' && *field != '\0'; field++)
+	{
+		if (*field == ':')
+		{
+			return false;
+		}
+		letter = letter || isalpha((unsigned char)*field);
+	}
+	return letter;
+}
+
+/**
+ * Resolves the quoted host name at the start of 'field' as the network DNS would: every name gets an address of
+ * 198.51.100.0/24 drawn from its characters, except the names ending in ".invalid", which do not resolve.
+ * @return false if the field holds no quoted name, or the name does not resolve.
+ */
+static bool saraR5EmuResolve(SARA_R5_emulator *emulator, const char *field, char *address, size_t size)
+{
+	const char *end = (field[0] == '"') ? strchr(field + 1, '"') : NULL;
+	uint32_t hash = 2166136261u; // FNV-1a
+
+	if (end == NULL || end == field + 1)
+	{
+		return false;
+	}
+	emulator->stats.dnsLookups++;
+	if (end - field > 8 && strncmp(end - 8, ".invalid", 8) == 0)
+	{
+		return false;
+	}
+	for (const char *c = field + 1; c < end; c++)
+	{
+		hash = (hash ^ (uint8_t)*c) * 16777619u;
+	}
+	snprintf(address, size, "198.51.100.%u", (unsigned)(1 + hash % 254));
+	return true;
+}
+
+/**
+ * Answers AT+UDNSRN=0,"<name>" (host name to IPv4 address).
+ */
+static void saraR5EmuDns(SARA_R5_emulator *emulator, const char *args)
+{
+	char address[SARA_R5_EMU_ADDRESS_SIZE];
+	char answer[SARA_R5_EMU_ANSWER_SIZE];
+
+	if (strncmp(args, "=0,", 3) != 0 || !saraR5EmuResolve(emulator, args + 3, address, sizeof(address)))
+	{
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_DNS, SARA_R5_EMU_ERROR);
+		return;
+	}
+	snprintf(answer, sizeof(answer), "\r\n+UDNSRN: \"%s\"\r\n\r\nOK\r\n", address);
+	saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_DNS, answer);
+}
+
+/**
+ * Reads the hex digits of the <data> field of AT+USOST in hex mode ("<digits>"), into 'payload'.
+ * @return true if the field holds exactly 'length' bytes.
+ */
+static bool saraR5EmuHexData(SARA_R5_emulator *emulator, const char *field, size_t length)
+{
+	size_t count = 0;
+
+	if (*field++ != '"')
+	{
+		return false;
+	}
+	for (; count < length && isxdigit((unsigned char)field[0]) && isxdigit((unsigned char)field[1]); field += 2)
+	{
+		char pair[3] = {field[0], field[1], '\0'};
+
+		emulator->payload[count++] = (uint8_t)strtoul(pair, NULL, 16);
+	}
+	return count == length && field[0] == '"' && field[1] == '\0';
+}
+
+/**
+ * Answers AT+USOCR, AT+USOCL, AT+USOCO, AT+USOSEC, AT+USODL, AT+USORD, AT+USORF, AT+USOCTL, AT+USOST and AT+USOWR.
+ */
+static void saraR5EmuSocket(SARA_R5_emulator *emulator, const char *name, const char *args)
+{
+	char answer[SARA_R5_EMU_ANSWER_SIZE];
+	int socket = -1;
+	int value = 0;
+
+	if (strcmp(name, "USOCR") == 0)
+	{
+		for (socket = 0; socket < SARA_R5_EMU_NUM_SOCKETS && emulator->socketOpen[socket]; socket++)
+		{
+		}
+		if (sscanf(args, "=%d", &value) != 1 || (value != 6 && value != 17) || socket == SARA_R5_EMU_NUM_SOCKETS)
+		{
+			saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_SOCKET, SARA_R5_EMU_ERROR);
+			return;
+		}
+		emulator->socketOpen[socket] = true;
+		emulator->socketUdp[socket] = (value == 17);
+		emulator->socketSecure[socket] = false;
+		emulator->socketDataLength[socket] = 0;
+		emulator->socketUnacked[socket] = 0;
+		snprintf(answer, sizeof(answer), "\r\n+USOCR: %d\r\n\r\nOK\r\n", socket);
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_SOCKET, answer);
+		return;
+	}
+
+	sscanf(args, "=%d", &socket);
+	if (socket < 0 || socket >= SARA_R5_EMU_NUM_SOCKETS || !emulator->socketOpen[socket])
+	{
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_SOCKET, SARA_R5_EMU_ERROR);
+		return;
+	}
+
+	if (strcmp(name, "USOCL") == 0)
+	{
+		emulator->socketOpen[socket] = false;
+		emulator->socketConnected[socket] = false;
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_SOCKET, SARA_R5_EMU_OK);
+	}
+	else if (strcmp(name, "USOCO") == 0)
+	{
+		// A host name is resolved first, on every connection, and a secure socket answers after its TLS handshake
+		const char *field = strchr(args, '"');
+		bool named = (field != NULL && saraR5EmuHostName(field));
+		char address[SARA_R5_EMU_ADDRESS_SIZE];
+		uint64_t delay;
+
+		if (named && !saraR5EmuResolve(emulator, field, address, sizeof(address)))
+		{
+			saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_DNS, SARA_R5_EMU_ERROR);
+			return;
+		}
+		delay = saraR5EmuDelayUs(emulator, emulator->config.latency[named ? SARA_R5_EMU_CMD_DNS : SARA_R5_EMU_CMD_USOCO]);
+		if (emulator->socketSecure[socket])
+		{
+			delay += saraR5EmuHandshakeUs(emulator, emulator->socketProfile[socket]);
+		}
+		emulator->socketConnected[socket] = true;
+		saraR5EmuAnswerAfter(emulator, delay, SARA_R5_EMU_OK, strlen(SARA_R5_EMU_OK));
+	}
+	else if (strcmp(name, "USOSEC") == 0)
+	{
+		// AT+USOSEC=<socket>,<1|0>[,<profile>], before the connection
+		int secure = -1;
+		int profile = 0;
+
+		if (sscanf(args, "=%d,%d,%d", &socket, &secure, &profile) < 2 || (secure != 0 && secure != 1) ||
+			profile < 0 || profile >= SARA_R5_EMU_TLS_PROFILES || emulator->socketConnected[socket] || emulator->socketUdp[socket])
+		{
+			saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_SOCKET, SARA_R5_EMU_ERROR);
+			return;
+		}
+		emulator->socketSecure[socket] = (secure == 1);
+		emulator->socketProfile[socket] = (uint8_t)profile;
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_SOCKET, SARA_R5_EMU_OK);
+	}
+	else if (strcmp(name, "USORD") == 0 || strcmp(name, "USORF") == 0)
+	{
+		saraR5EmuSocketRead(emulator, socket, name[4] == 'F', args);
+	}
+	else if (strcmp(name, "USODL") == 0)
+	{
+		if (!emulator->socketConnected[socket])
+		{
+			saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_SOCKET, SARA_R5_EMU_ERROR);
+			return;
+		}
+		// Everything after the command is socket data, until the escape sequence
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_SOCKET, "\r\nCONNECT\r\n");
+		emulator->directLink = true;
+		emulator->directChannel = emulator->channel;
+		emulator->directLastUs = emulator->nowUs;
+		emulator->escapeDueUs = 0;
+	}
+	else if (strcmp(name, "USOST") == 0)
+	{
+		// AT+USOST=<socket>,"<address>",<port>,<length> then '@' and the binary payload,
+		// or AT+USOST=<socket>,"<address>",<port>,<length>,"<hex digits>" in hex mode
+		// A host name is resolved first, as for AT+USOCO
+		const char *address = strchr(args, '"');
+		const char *fields = (address != NULL) ? strchr(address + 1, '"') : NULL;
+		bool named = (address != NULL && saraR5EmuHostName(address));
+		char resolved[SARA_R5_EMU_ADDRESS_SIZE];
+		int port = 0;
+		long length = 0;
+		int consumed = 0;
+
+		if (fields == NULL || sscanf(fields + 1, ",%d,%ld%n", &port, &length, &consumed) != 2 ||
+			length <= 0 || length > SARA_R5_EMU_MAX_PAYLOAD)
+		{
+			saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_USOST, SARA_R5_EMU_ERROR);
+			return;
+		}
+		if (named && !saraR5EmuResolve(emulator, address, resolved, sizeof(resolved)))
+		{
+			saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_DNS, SARA_R5_EMU_ERROR);
+			return;
+		}
+		emulator->payloadNamed = named;
+		emulator->payloadSocket = socket;
+		emulator->payloadLength = (size_t)length;
+		emulator->payloadTcp = false;
+		fields += 1 + consumed;
+		if (*fields == ',')
+		{
+			if (!emulator->hexMode || !saraR5EmuHexData(emulator, fields + 1, (size_t)length))
+			{
+				saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_USOST, SARA_R5_EMU_ERROR);
+				return;
+			}
+			saraR5EmuSocketSent(emulator);
+			return;
+		}
+		emulator->payloadPending = (size_t)length;
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_AT, "\r\n@");
+	}
+	else if (strcmp(name, "USOWR") == 0)
+	{
+		// AT+USOWR=<socket>,<length> then '@' and the binary payload, on a connected TCP socket
+		int length = 0;
+
+		if (sscanf(args, "=%d,%d", &socket, &length) != 2 || strchr(args, '"') != NULL || length <= 0 ||
+			length > SARA_R5_EMU_MAX_PAYLOAD || emulator->socketUdp[socket] || !emulator->socketConnected[socket])
+		{
+			saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_USOST, SARA_R5_EMU_ERROR);
+			return;
+		}
+		emulator->payloadSocket = socket;
+		emulator->payloadLength = (size_t)length;
+		emulator->payloadPending = (size_t)length;
+		emulator->payloadTcp = true;
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_AT, "\r\n@");
+	}
+	else if (strcmp(name, "USOCTL") == 0)
+	{
+		// AT+USOCTL=<socket>,<param_id>: only 11, the TCP bytes not acknowledged yet, is modelled
+		int param = -1;
+
+		if (sscanf(args, "=%d,%d", &socket, &param) != 2)
+		{
+			saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_SOCKET, SARA_R5_EMU_ERROR);
+			return;
+		}
+		saraR5EmuSocketAck(emulator, socket);
+		snprintf(answer, sizeof(answer), "\r\n+USOCTL: %d,%d,%u\r\n\r\nOK\r\n", socket, param,
+				 (param == 11) ? (unsigned)emulator->socketUnacked[socket] : 0u);
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_SOCKET, answer);
+	}
+	else
+	{
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_OTHER, SARA_R5_EMU_ERROR);
+	}
+}
+
+/**
+ * Answers AT+UMQTT and AT+UMQTTC. Login is followed by +UUMQTTC.
+ */
+static void saraR5EmuMqtt(SARA_R5_emulator *emulator, const char *name, const char *args)
+{
+	char answer[SARA_R5_EMU_ANSWER_SIZE];
+	int op = -1;
+
+	sscanf(args, "=%d", &op);
+	if (strcmp(name, "UMQTT") == 0)
+	{
+		if (op == 11)
+		{
+			// AT+UMQTT=11,<1|0>[,<profile>]: the login runs a TLS handshake with the profile
+			int secure = 0;
+			int profile = 0;
+
+			sscanf(args, "=11,%d,%d", &secure, &profile);
+			emulator->mqttSecure = (secure == 1 && profile >= 0 && profile < SARA_R5_EMU_TLS_PROFILES);
+			emulator->mqttProfile = emulator->mqttSecure ? (uint8_t)profile : 0;
+		}
+		snprintf(answer, sizeof(answer), "\r\n+UMQTT: %d,1\r\n\r\nOK\r\n", op);
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_MQTT, (op >= 0) ? answer : SARA_R5_EMU_ERROR);
+		return;
+	}
+
+	switch (op)
+	{
+	case 0: // Logout
+		snprintf(answer, sizeof(answer), "\r\n+UMQTTC: 0,%d\r\n\r\nOK\r\n", emulator->mqttLoggedIn ? 1 : 0);
+		emulator->mqttLoggedIn = false;
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_MQTT, answer);
+		break;
+	case 1: // Login
+		emulator->mqttLoggedIn = true;
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_MQTT, "\r\n+UMQTTC: 1,1\r\n\r\nOK\r\n");
+		if (emulator->mqttSecure)
+		{
+			saraR5EmuAddUrc(emulator, "+UUMQTTC: 1,0", emulator->nowUs + saraR5EmuDelayUs(emulator, emulator->config.urcLatency) +
+													   saraR5EmuHandshakeUs(emulator, emulator->mqttProfile));
+			break;
+		}
+		saraR5EmuUrc(emulator, "+UUMQTTC: 1,0");
+		break;
+	case 2: // Publish
+	case 4: // Subscribe
+	case 5: // Unsubscribe
+		if (!emulator->mqttLoggedIn)
+		{
+			saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_MQTT, SARA_R5_EMU_ERROR);
+			break;
+		}
+		snprintf(answer, sizeof(answer), "\r\n+UMQTTC: %d,1\r\n\r\nOK\r\n", op);
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_MQTT, answer);
+		break;
+	default:
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_MQTT, SARA_R5_EMU_ERROR);
+		break;
+	}
+}
+
+/**
+ * Answers AT+IPR. The new rate applies once the OK has left the line.
+ */
+static void saraR5EmuIpr(SARA_R5_emulator *emulator, unsigned long baud)
+{
+	switch (baud)
+	{
+	case 9600:
+	case 19200:
+	case 38400:
+	case 57600:
+	case 115200:
+	case 230400:
+	case 460800:
+	case 921600:
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_AT, SARA_R5_EMU_OK);
+		emulator->pendingBaud = (uint32_t)baud;
+		break;
+	default:
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_AT, SARA_R5_EMU_ERROR);
+		break;
+	}
+}
+
+/**
+ * Executes one command line. As on the module, what comes before "AT" is ignored (e.g. a "+++" sent in command mode).
+ */
+static void saraR5EmuRunCommand(SARA_R5_emulator *emulator, const char *line)
+{
+	char name[16];
+	size_t nameLength = 0;
+	const char *args;
+
+	emulator->stats.commands++;
+
+	while (*line != '\0' && strncmp(line, "AT", 2) != 0 && strncmp(line, "at", 2) != 0)
+	{
+		line++;
+	}
+	if (*line == '\0')
+	{
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_OTHER, SARA_R5_EMU_ERROR);
+		return;
+	}
+	line += 2;
+
+	if (*line == '\0')
+	{
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_AT, SARA_R5_EMU_OK);
+		return;
+	}
+	if (strcmp(line, "E0") == 0 || strcmp(line, "E1") == 0)
+	{
+		emulator->echo = (line[1] == '1');
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_AT, SARA_R5_EMU_OK);
+		return;
+	}
+	if (strcmp(line, "&W") == 0)
+	{
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_AT, SARA_R5_EMU_OK);
+		return;
+	}
+	if (strncmp(line, "+IFC=", 5) == 0)
+	{
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_AT, emulator->config.noFlowControl ? SARA_R5_EMU_ERROR : SARA_R5_EMU_OK);
+		return;
+	}
+	if (strncmp(line, "+CMUX=", 6) == 0)
+	{
+		// The OK still goes out as plain text, everything after it is framed
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_AT, SARA_R5_EMU_OK);
+		emulator->mux = true;
+		emulator->channel = 1;
+		saraR5CmuxParserReset(&emulator->muxParser);
+		memset(emulator->muxCommandLength, 0, sizeof(emulator->muxCommandLength));
+		memset(emulator->muxStopped, 0, sizeof(emulator->muxStopped));
+		return;
+	}
+	if (strncmp(line, "+IPR=", 5) == 0)
+	{
+		saraR5EmuIpr(emulator, strtoul(line + 5, NULL, 10));
+		return;
+	}
+	if (*line != '+')
+	{
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_OTHER, SARA_R5_EMU_ERROR);
+		return;
+	}
+
+	// Split "+NAME<args>" where args starts with '=' or '?'
+	line++;
+	while (line[nameLength] != '\0' && line[nameLength] != '=' && line[nameLength] != '?' && nameLength < sizeof(name) - 1)
+	{
+		name[nameLength] = line[nameLength];
+		nameLength++;
+	}
+	name[nameLength] = '\0';
+	args = line + nameLength;
+
+	if (strcmp(name, "COPS") == 0)
+	{
+		saraR5EmuCops(emulator, args);
+	}
+	else if (strcmp(name, "CGDCONT") == 0)
+	{
+		saraR5EmuCgdcont(emulator, args);
+	}
+	else if (strcmp(name, "UPSDA") == 0)
+	{
+		saraR5EmuUpsda(emulator, args);
+	}
+	else if (strncmp(name, "USO", 3) == 0)
+	{
+		saraR5EmuSocket(emulator, name, args);
+	}
+	else if (strcmp(name, "USECPRF") == 0)
+	{
+		saraR5EmuSecurityProfile(emulator, args);
+	}
+	else if (strcmp(name, "UDNSRN") == 0)
+	{
+		saraR5EmuDns(emulator, args);
+	}
+	else if (strcmp(name, "UDCONF") == 0)
+	{
+		int hex = 0;
+
+		if (sscanf(args, "=1,%d", &hex) == 1)
+		{
+			emulator->hexMode = (hex == 1);
+		}
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_SOCKET, SARA_R5_EMU_OK);
+	}
+	else if (strncmp(name, "UMQTT", 5) == 0)
+	{
+		saraR5EmuMqtt(emulator, name, args);
+	}
+	else
+	{
+		saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_OTHER, SARA_R5_EMU_ERROR);
+	}
+}
+
+/**
+ * Executes one command line (without the final CR). Commands chained with ';' run in turn,
+ * the ones after the first come without "AT".
+ */
+static void saraR5EmuCommand(SARA_R5_emulator *emulator, const char *line)
+{
+	char part[SARA_R5_EMU_COMMAND_BUFFER_SIZE + 2];
+	bool quoted = false;
+	size_t start = 0;
+
+	emulator->chainFailed = false;
+	for (size_t i = 0;; i++)
+	{
+		char c = line[i];
+
+		if (c == '"')
+		{
+			quoted = !quoted;
+		}
+		if (c != '\0' && (c != ';' || quoted))
+		{
+			continue;
+		}
+
+		snprintf(part, sizeof(part), "%s%.*s", (start == 0) ? "" : "AT", (int)(i - start), &line[start]);
+		emulator->chainContinues = (c == ';');
+		saraR5EmuRunCommand(emulator, part);
+		if (c == '\0' || emulator->chainFailed)
+		{
+			break;
+		}
+		start = i + 1;
+	}
+	emulator->chainContinues = false;
+	emulator->chainFailed = false;
+}
+
+/**
+ * Hands socket data to the remote end, which sends it back when 'socketEcho' is set.
+ */
+static void saraR5EmuPeer(SARA_R5_emulator *emulator, const uint8_t *data, size_t len)
+{
+	emulator->stats.directLinkBytes += len;
+	if (emulator->config.socketEcho)
+	{
+		saraR5EmuOutput(emulator, (const char *)data, len, saraR5EmuDelayUs(emulator, emulator->config.peerLatency));
+	}
+}
+
+/**
+ * Handles the bytes received in direct link mode. "+++" alone after a guard time of silence is
+ * the escape sequence; it only takes effect if the guard time passes again without data.
+ * 'escapeMissPercent' makes the module take it as data, and stay in the link.
+ */
+static void saraR5EmuDirectInput(SARA_R5_emulator *emulator, const uint8_t *data, size_t len)
+{
+	const uint64_t guardUs = (uint64_t)SARA_R5_EMU_ESCAPE_GUARD_MS * 1000u;
+	bool quiet = (emulator->sendStartUs - emulator->directLastUs) >= guardUs;
+
+	if (emulator->escapeDueUs != 0)
+	{
+		// Data within the guard time: the "+++" was data after all
+		emulator->escapeDueUs = 0;
+		saraR5EmuPeer(emulator, (const uint8_t *)"+++", 3);
+	}
+	emulator->directLastUs = emulator->nowUs;
+
+	if (quiet && len == 3 && memcmp(data, "+++", 3) == 0)
+	{
+		if (!saraR5EmuRoll(emulator, emulator->config.escapeMissPercent))
+		{
+			emulator->escapeDueUs = emulator->nowUs + guardUs;
+			return;
+		}
+		emulator->stats.faults++;
+	}
+	saraR5EmuPeer(emulator, data, len);
+}
+
+/**
+ * Ends the direct link once the guard time after "+++" has passed.
+ */
+static void saraR5EmuDirectLinkEscape(SARA_R5_emulator *emulator)
+{
+	uint8_t channel = emulator->channel;
+	size_t len = 14;
+
+	if (emulator->escapeDueUs == 0 || emulator->nowUs < emulator->escapeDueUs)
+	{
+		return;
+	}
+	emulator->directLink = false;
+	emulator->escapeDueUs = 0;
+	emulator->channel = emulator->directChannel;
+	if (saraR5EmuRoll(emulator, emulator->config.truncatePercent))
+	{
+		emulator->stats.faults++;
+		len = 1 + saraR5EmuRandom(emulator) % (len - 1);
+	}
+	saraR5EmuOutput(emulator, "\r\nDISCONNECT\r\n", len, 0);
+	emulator->channel = channel;
+}
+
+/**
+ * Handles the bytes of one channel: command lines, the payload after a '@' prompt, or direct link data.
+ */
+static void saraR5EmuInput(SARA_R5_emulator *emulator, const uint8_t *data, size_t len, char *command, size_t *commandLength)
+{
+	size_t echoStart = 0;
+
+	if (emulator->directLink && (!emulator->mux || emulator->channel == emulator->directChannel))
+	{
+		saraR5EmuDirectInput(emulator, data, len);
+		return;
+	}
+
+	for (size_t i = 0; i < len; i++)
+	{
+		char c = (char)data[i];
+
+		if (emulator->payloadPending > 0)
+		{
+			emulator->payload[emulator->payloadLength - emulator->payloadPending] = (uint8_t)c;
+			if (--emulator->payloadPending == 0)
+			{
+				saraR5EmuSocketSent(emulator);
+			}
+			echoStart = i + 1; // The payload is never echoed
+			continue;
+		}
+
+		if (emulator->scanDueUs != 0 && (!emulator->mux || emulator->channel == emulator->scanChannel))
+		{
+			// Any character aborts the scan, and is dropped
+			emulator->scanDueUs = 0;
+			saraR5EmuAnswer(emulator, SARA_R5_EMU_CMD_AT, SARA_R5_EMU_ABORTED);
+			echoStart = i + 1;
+			continue;
+		}
+
+		if (c == '\r')
+		{
+			if (emulator->echo)
+			{
+				saraR5EmuOutput(emulator, (const char *)&data[echoStart], i + 1 - echoStart, 0);
+			}
+			echoStart = i + 1;
+			command[*commandLength] = '\0';
+			if (*commandLength > 0)
+			{
+				saraR5EmuCommand(emulator, command); // Empty lines are ignored
+			}
+			*commandLength = 0;
+		}
+		else if (c != '\n' && *commandLength < SARA_R5_EMU_COMMAND_BUFFER_SIZE - 1)
+		{
+			command[(*commandLength)++] = c;
+		}
+	}
+
+	if (emulator->echo && echoStart < len && emulator->payloadPending == 0)
+	{
+		saraR5EmuOutput(emulator, (const char *)&data[echoStart], len - echoStart, 0);
+	}
+}
+
+/**
+ * Leaves CMUX mode: the line carries plain AT commands again.
+ */
+static void saraR5EmuMuxEnd(SARA_R5_emulator *emulator)
+{
+	emulator->mux = false;
+	emulator->frameCount = 0;
+	emulator->channel = 0;
+}
+
+/**
+ * Handles a message of the control channel (DLCI 0).
+ */
+static void saraR5EmuMuxMessage(SARA_R5_emulator *emulator, const uint8_t *info, size_t len)
+{
+	uint8_t answer[4];
+
+	if (len < 2 || (info[0] & SARA_R5_CMUX_MSG_CR) == 0)
+	{
+		return; // Responses to our own commands need nothing
+	}
+
+	if (info[0] == SARA_R5_CMUX_MSG_MSC && len >= 4)
+	{
+		uint8_t dlci = info[2] >> 2;
+
+		if (dlci <= SARA_R5_CMUX_CHANNELS)
+		{
+			emulator->muxStopped[dlci] = (info[3] & SARA_R5_CMUX_MSC_FC) != 0;
+		}
+		memcpy(answer, info, 4);
+		answer[0] &= ~SARA_R5_CMUX_MSG_CR;
+		saraR5EmuSendFrame(emulator, 0, SARA_R5_CMUX_UIH, false, answer, 4);
+		saraR5EmuReleaseFrames(emulator);
+	}
+	else if (info[0] == SARA_R5_CMUX_MSG_CLD)
+	{
+		answer[0] = SARA_R5_CMUX_MSG_CLD & ~SARA_R5_CMUX_MSG_CR;
+		answer[1] = 0x01;
+		saraR5EmuSendFrame(emulator, 0, SARA_R5_CMUX_UIH, false, answer, 2);
+		saraR5EmuMuxEnd(emulator);
+	}
+	else
+	{
+		answer[0] = SARA_R5_CMUX_MSG_NSC & ~SARA_R5_CMUX_MSG_CR;
+		answer[1] = 0x03;
+		answer[2] = info[0];
+		saraR5EmuSendFrame(emulator, 0, SARA_R5_CMUX_UIH, false, answer, 3);
+	}
+}
+
+/**
+ * Handles one CMUX frame sent by the library.
+ */
+static void saraR5EmuMuxFrame(SARA_R5_emulator *emulator)
+{
+	SARA_R5_cmux_parser *parser = &emulator->muxParser;
+	uint8_t control = parser->control & ~SARA_R5_CMUX_PF;
+
+	if (parser->dlci > SARA_R5_CMUX_CHANNELS)
+	{
+		saraR5EmuSendFrame(emulator, parser->dlci, SARA_R5_CMUX_DM | SARA_R5_CMUX_PF, true, NULL, 0);
+		return;
+	}
+
+	if (control == SARA_R5_CMUX_SABM || control == SARA_R5_CMUX_DISC)
+	{
+		saraR5EmuSendFrame(emulator, parser->dlci, SARA_R5_CMUX_UA | SARA_R5_CMUX_PF, true, NULL, 0);
+		if (control == SARA_R5_CMUX_DISC && parser->dlci == 0)
+		{
+			saraR5EmuMuxEnd(emulator);
+		}
+	}
+	else if (control == SARA_R5_CMUX_UIH || control == SARA_R5_CMUX_UI)
+	{
+		if (parser->dlci == 0)
+		{
+			saraR5EmuMuxMessage(emulator, parser->info, parser->length);
+		}
+		else
+		{
+			emulator->channel = parser->dlci;
+			saraR5EmuInput(emulator, parser->info, parser->length, emulator->muxCommand[parser->dlci], &emulator->muxCommandLength[parser->dlci]);
+		}
+	}
+}
+
+/**
+ * Receives the bytes written by the library: plain AT traffic, or CMUX frames once AT+CMUX succeeded.
+ */
+static bool saraR5EmuSend(void *context, const uint8_t *data, size_t len)
+{
+	SARA_R5_emulator *emulator = (SARA_R5_emulator *)context;
+
+	// URCs that came before the command are already on the line
+	saraR5EmuDirectLinkEscape(emulator);
+	saraR5EmuReleaseScan(emulator);
+	saraR5EmuReleaseUrcs(emulator);
+	saraR5EmuReleaseFrames(emulator);
+
+	// The library is blocked while the bytes go out
+	emulator->sendStartUs = emulator->nowUs;
+	emulator->nowUs += saraR5EmuByteTimeUs(emulator, len);
+	emulator->stats.bytesToModule += len;
+
+	// Both sides must run at the same rate for the module to understand anything
+	if (emulator->hostBaud != emulator->moduleBaud)
+	{
+		emulator->commandLength = 0;
+		return true;
+	}
+
+	if (!emulator->mux)
+	{
+		saraR5EmuInput(emulator, data, len, emulator->command, &emulator->commandLength);
+		return true;
+	}
+
+	for (size_t i = 0; i < len && emulator->mux; i++)
+	{
+		if (saraR5CmuxParse(&emulator->muxParser, data[i]))
+		{
+			saraR5EmuMuxFrame(emulator);
+		}
+	}
+	return true;
+}
+
+/**
+ * Number of bytes of the oldest segment already on the line at the current time.
+ */
+static size_t saraR5EmuReadyBytes(const SARA_R5_emulator *emulator)
+{
+	const SARA_R5_emulator_segment *segment;
+	uint64_t sent;
+
+	if (emulator->segmentCount == 0)
+	{
+		return 0;
+	}
+	segment = &emulator->segments[emulator->segmentHead];
+	if (emulator->nowUs < segment->startUs)
+	{
+		return 0;
+	}
+
+	sent = ((emulator->nowUs - segment->startUs) * emulator->moduleBaud) / 10000000u + 1;
+	if (sent > segment->len)
+	{
+		sent = segment->len;
+	}
+	return (size_t)sent - segment->delivered;
+}
+
+/**
+ * Hands out the bytes that have left the line.
+ */
+static size_t saraR5EmuReceive(void *context, uint8_t *data, size_t len)
+{
+	SARA_R5_emulator *emulator = (SARA_R5_emulator *)context;
+	size_t total = 0;
+
+	saraR5EmuDirectLinkEscape(emulator);
+	saraR5EmuReleaseScan(emulator);
+	saraR5EmuReleaseUrcs(emulator);
+	saraR5EmuReleaseFrames(emulator);
+	while (total < len && emulator->segmentCount > 0)
+	{
+		SARA_R5_emulator_segment *segment = &emulator->segments[emulator->segmentHead];
+		size_t ready = saraR5EmuReadyBytes(emulator);
+
+		if (ready > len - total)
+		{
+			ready = len - total;
+		}
+		saraR5RingBufferRead(&emulator->output, &data[total], ready);
+		if (emulator->hostBaud != emulator->moduleBaud || (emulator->config.maxBaud != 0 && emulator->moduleBaud > emulator->config.maxBaud))
+		{
+			// Wrong rate, or faster than the wiring: the library only sees noise
+			for (size_t i = 0; i < ready; i++)
+			{
+				data[total + i] ^= 0xA5;
+			}
+		}
+		segment->delivered += ready;
+		total += ready;
+
+		if (segment->delivered < segment->len)
+		{
+			break; // The rest of the segment is still on the line
+		}
+		emulator->segmentHead = (emulator->segmentHead + 1) % SARA_R5_EMU_MAX_SEGMENTS;
+		emulator->segmentCount--;
+	}
+
+	if (emulator->pendingBaud != 0 && emulator->segmentCount == 0)
+	{
+		emulator->moduleBaud = emulator->pendingBaud;
+		emulator->pendingBaud = 0;
+	}
+
+	emulator->stats.bytesFromModule += total;
+	return total;
+}
+
+/**
+ * Makes the module ask the library to stop or resume sending on a channel (MSC with the FC bit).
+ * @param emulator The emulator, in CMUX mode.
+ * @param dlci The channel.
+ * @param stop true to stop the library, false to let it send again.
+ * @return true if the message is on the line, false if the emulator is not in CMUX mode.
+ */
+bool saraR5EmulatorMuxFlow(SARA_R5_emulator *emulator, uint8_t dlci, bool stop)
+{
+	uint8_t message[4];
+
+	if (!emulator->mux)
+	{
+		return false;
+	}
+	message[0] = SARA_R5_CMUX_MSG_MSC;
+	message[1] = (2 << 1) | 0x01;
+	message[2] = (uint8_t)((dlci << 2) | 0x03);
+	message[3] = SARA_R5_CMUX_MSC_SIGNALS | (stop ? SARA_R5_CMUX_MSC_FC : 0);
+	return saraR5EmuSendFrame(emulator, 0, SARA_R5_CMUX_UIH, false, message, sizeof(message));
+}
+
+/**
+ * Moves the virtual clock to the next byte on the line, or by 'ms' if nothing comes before.
+ */
+static void saraR5EmuWait(void *context, uint32_t ms)
+{
+	SARA_R5_emulator *emulator = (SARA_R5_emulator *)context;
+	uint64_t limit = emulator->nowUs + (uint64_t)ms * 1000u;
+
+	saraR5EmuDirectLinkEscape(emulator);
+	saraR5EmuReleaseScan(emulator);
+	saraR5EmuReleaseUrcs(emulator);
+	saraR5EmuReleaseFrames(emulator);
+	if (saraR5EmuReadyBytes(emulator) > 0)
+	{
+		return;
+	}
+
+	// Wake up at the end of the escape guard time
+	if (emulator->escapeDueUs != 0 && emulator->escapeDueUs < limit)
+	{
+		limit = emulator->escapeDueUs;
+	}
+
+	// Wake up at the end of the scan
+	if (emulator->scanDueUs != 0 && emulator->scanDueUs < limit)
+	{
+		limit = emulator->scanDueUs;
+	}
+
+	// Wake up for the next URC or CMUX frame
+	for (size_t i = 0; i < emulator->urcCount; i++)
+	{
+		if (emulator->urcs[i].dueUs < limit)
+		{
+			limit = emulator->urcs[i].dueUs;
+		}
+	}
+	for (size_t i = 0; i < emulator->frameCount; i++)
+	{
+		if (emulator->frames[i].dueUs < limit && !emulator->muxStopped[emulator->frames[i].dlci])
+		{
+			limit = emulator->frames[i].dueUs;
+		}
+	}
+
+	if (emulator->segmentCount > 0)
+	{
+		const SARA_R5_emulator_segment *segment = &emulator->segments[emulator->segmentHead];
+		uint64_t next = segment->startUs + saraR5EmuByteTimeUs(emulator, segment->delivered);
+
+		if (next < limit)
+		{
+			limit = (next > emulator->nowUs) ? next : emulator->nowUs + 1;
+		}
+	}
+	emulator->nowUs = limit;
+}
+
+/**
+ * Changes the rate of the library side of the line.
+ */
+static bool saraR5EmuSetBaudRate(void *context, uint32_t baud, bool rtsCts)
+{
+	SARA_R5_emulator *emulator = (SARA_R5_emulator *)context;
+
+	(void)rtsCts;
+	emulator->hostBaud = baud;
+	return true;
+}
+
+/**
+ * Reads the virtual clock.
+ */
+static uint32_t saraR5EmuNowMs(void *context)
+{
+	SARA_R5_emulator *emulator = (SARA_R5_emulator *)context;
+
+	return (uint32_t)(emulator->nowUs / 1000u);
+}
+
+/**
+ * Starts an emulated SARA-R5 and builds the transport the library uses to talk to it.
+ * The emulator runs on a virtual clock, so a whole session takes milliseconds of real time
+ * and two runs with the same configuration produce the same bytes at the same virtual times.
+ * @param emulator Storage for the emulator state. Must live as long as the transport.
+ * @param transport The transport to fill.
+ * @param config The configuration, or NULL for saraR5EmulatorDefaultConfig.
+ */
+void saraR5EmulatorInit(SARA_R5_emulator *emulator, SARA_R5_transport *transport, const SARA_R5_emulator_config *config)
+{
+	memset(emulator, 0, sizeof(*emulator));
+	if (config != NULL)
+	{
+		emulator->config = *config;
+	}
+	else
+	{
+		saraR5EmulatorDefaultConfig(&emulator->config);
+	}
+	if (emulator->config.baud == 0)
+	{
+		emulator->config.baud = 115200;
+	}
+	emulator->random = (emulator->config.seed != 0) ? emulator->config.seed : 1;
+	emulator->echo = true; // Power-on default of the module
+	emulator->moduleBaud = emulator->config.baud;
+	emulator->hostBaud = emulator->config.baud;
+	saraR5RingBufferInit(&emulator->output, emulator->outputStorage, sizeof(emulator->outputStorage));
+
+	transport->send = saraR5EmuSend;
+	transport->receive = saraR5EmuReceive;
+	transport->wait = saraR5EmuWait;
+	transport->nowMs = saraR5EmuNowMs;
+	transport->setBaudRate = saraR5EmuSetBaudRate;
+	transport->context = emulator;
+}
@@ -0,0 +1,174 @@
+#ifndef SARA_R5_EMULATOR_H
+#define SARA_R5_EMULATOR_H
+
+// INCLUDES
+#include "Sara_R5_transport.h"
+#include "Sara_R5_ring_buffer.h"
+#include "Sara_R5_cmux.h"
+
+#define SARA_R5_EMU_OUTPUT_BUFFER_SIZE 4096  // Bytes queued towards the library
+#define SARA_R5_EMU_MAX_SEGMENTS 32          // Answers / URCs queued at the same time
+#define SARA_R5_EMU_COMMAND_BUFFER_SIZE 1536 // Longest command line understood (AT+USOST with 512 bytes as hex digits)
+#define SARA_R5_EMU_NUM_SOCKETS 6
+#define SARA_R5_EMU_SOCKET_BUFFER_SIZE 2048  // Bytes received from the remote end of one socket and not read yet
+#define SARA_R5_EMU_MAX_PAYLOAD 1024         // Largest payload after a '@' prompt, largest AT+USORD read
+#define SARA_R5_EMU_MAX_URCS 8               // URCs waiting for their time
+#define SARA_R5_EMU_URC_SIZE 96              // Longest URC, with its line terminators
+#define SARA_R5_EMU_MAX_FRAMES 16            // CMUX frames waiting for their time
+#define SARA_R5_EMU_URC_CHANNEL 1            // CMUX channel carrying the URCs
+#define SARA_R5_EMU_ESCAPE_GUARD_MS 1000     // ATS12: silence required around "+++"
+#define SARA_R5_EMU_TLS_PROFILES 5           // Security profiles of AT+USECPRF
+
+// Command families with their own latency model
+typedef enum
+{
+  SARA_R5_EMU_CMD_AT = 0,  // AT, ATE0, ATE1, AT&W, AT+IPR, AT+IFC, AT+CMUX
+  SARA_R5_EMU_CMD_COPS,    // AT+COPS
+  SARA_R5_EMU_CMD_CGDCONT, // AT+CGDCONT
+  SARA_R5_EMU_CMD_UPSDA,   // AT+UPSDA
+  SARA_R5_EMU_CMD_SOCKET,  // AT+USOCR, AT+USOCL, AT+USODL, AT+USORD, AT+USORF, AT+USOCTL, AT+UDCONF
+  SARA_R5_EMU_CMD_USOCO,   // AT+USOCO
+  SARA_R5_EMU_CMD_USOST,   // AT+USOST, AT+USOWR
+  SARA_R5_EMU_CMD_MQTT,    // AT+UMQTT, AT+UMQTTC
+  SARA_R5_EMU_CMD_DNS,     // AT+UDNSRN, AT+USOCO to a host name (the DNS query dominates)
+  SARA_R5_EMU_CMD_OTHER,   // Anything else (answered with ERROR)
+  SARA_R5_EMU_CMD_COUNT
+} SARA_R5_emulator_command;
+
+// Answer delay drawn uniformly in [minMs, maxMs]
+typedef struct
+{
+  uint32_t minMs;
+  uint32_t maxMs;
+} SARA_R5_emulator_latency;
+
+typedef struct
+{
+  uint32_t baud;                                           // Line rate at power on, used to pace every byte (8N1)
+  uint32_t maxBaud;                                        // Fastest rate the wiring carries cleanly (0: no limit)
+  bool noFlowControl;                                      // RTS/CTS not wired: AT+IFC answers ERROR
+  uint32_t seed;                                           // Seed of the pseudo random generator
+  SARA_R5_emulator_latency latency[SARA_R5_EMU_CMD_COUNT]; // Per command answer delay
+  SARA_R5_emulator_latency urcLatency;                     // Delay of the URCs that follow a command
+  SARA_R5_emulator_latency peerLatency;                    // Round trip to the remote end of the sockets
+  SARA_R5_emulator_latency scanLatency;                    // Network scan of AT+COPS=?, abortable until its answer
+  SARA_R5_emulator_latency handshakeLatency;               // Full TLS handshake of a secure socket or MQTT login
+  SARA_R5_emulator_latency resumedLatency;                 // TLS handshake resuming the session of the last one
+  bool socketEcho;                                         // The remote end sends back what it receives (direct link, AT+USOST, AT+USOWR)
+  bool closeKeepsId;                                       // A socket closed by the remote end keeps its ID until AT+USOCL, AT+USOCO connects it again
+  uint32_t ackBytesPerSec;                                 // Rate the remote end acknowledges TCP data (0: at once)
+  size_t sendBufferBytes;                                  // TCP data not acknowledged yet a socket holds, AT+USOWR takes no more (0: no limit)
+  uint8_t garbagePercent;                                  // Chance of noise before an answer
+  uint8_t truncatePercent;                                 // Chance of an answer cut in the middle
+  uint8_t errorPercent;                                    // Chance of ERROR instead of the answer
+  uint8_t escapeMissPercent;                               // Chance of a direct link "+++" taken as data
+} SARA_R5_emulator_config;
+
+typedef struct
+{
+  unsigned long commands;        // Command lines processed
+  unsigned long faults;          // Faults injected
+  unsigned long bytesToModule;   // Bytes written by the library
+  unsigned long bytesFromModule; // Bytes read by the library
+  unsigned long directLinkBytes; // Socket data received in direct link mode
+  unsigned long socketBytes;     // Socket data accepted by AT+USOST and AT+USOWR
+  unsigned long dnsLookups;      // Host names resolved over the air (AT+UDNSRN, AT+USOCO or AT+USOST to a name)
+  unsigned long tlsHandshakes;   // TLS handshakes of the secure sockets and MQTT logins
+  unsigned long tlsResumed;      // Those that resumed the session of the last one
+  unsigned long tlsBytes;        // Air bytes of the handshakes
+} SARA_R5_emulator_stats;
+
+// Output queued towards the library, released byte by byte at line rate from 'startUs'
+typedef struct
+{
+  uint64_t startUs; // Time the first byte leaves the line
+  size_t len;       // Bytes in the segment
+  size_t delivered; // Bytes already read by the library
+} SARA_R5_emulator_segment;
+
+// URC sent once the virtual clock reaches 'dueUs'
+typedef struct
+{
+  uint64_t dueUs;
+  size_t len;
+  char text[SARA_R5_EMU_URC_SIZE];
+} SARA_R5_emulator_urc;
+
+// Information field of a CMUX frame sent once the virtual clock reaches 'dueUs' and its channel is not stopped
+typedef struct
+{
+  uint64_t dueUs;
+  uint8_t dlci;
+  size_t len;
+  uint8_t info[SARA_R5_CMUX_FRAME_SIZE];
+} SARA_R5_emulator_frame;
+
+typedef struct
+{
+  SARA_R5_emulator_config config;
+  SARA_R5_emulator_stats stats;
+  uint64_t nowUs;                                  // Virtual clock in microseconds
+  uint32_t random;                                 // Generator state
+  bool echo;                                       // ATE state
+  uint32_t moduleBaud;                             // Rate of the module side of the line
+  uint32_t hostBaud;                               // Rate the library side was set to
+  uint32_t pendingBaud;                            // AT+IPR rate applied once the OK has left
+  char command[SARA_R5_EMU_COMMAND_BUFFER_SIZE];   // Command line being received
+  size_t commandLength;                            // Characters stored in 'command'
+  size_t payloadPending;                           // Bytes still expected after a '@' prompt
+  size_t payloadLength;                            // Size announced by AT+USOST / AT+USOWR
+  int payloadSocket;                               // Socket of the payload being received
+  bool payloadTcp;                                 // The payload came with AT+USOWR, not AT+USOST
+  bool payloadNamed;                               // The AT+USOST went to a host name, its answer takes the DNS latency
+  bool socketOpen[SARA_R5_EMU_NUM_SOCKETS];        // Sockets created with AT+USOCR
+  bool socketConnected[SARA_R5_EMU_NUM_SOCKETS];   // Sockets connected with AT+USOCO
+  bool socketUdp[SARA_R5_EMU_NUM_SOCKETS];         // Sockets created for UDP, their data is announced by +UUSORF
+  uint8_t socketData[SARA_R5_EMU_NUM_SOCKETS][SARA_R5_EMU_SOCKET_BUFFER_SIZE]; // Received from the remote end
+  size_t socketDataLength[SARA_R5_EMU_NUM_SOCKETS];                            // Bytes waiting in 'socketData'
+  size_t socketUnacked[SARA_R5_EMU_NUM_SOCKETS];   // Bytes written with AT+USOWR the remote end has not acknowledged
+  uint64_t socketAckUs[SARA_R5_EMU_NUM_SOCKETS];   // Time up to which 'socketUnacked' is drained
+  uint8_t payload[SARA_R5_EMU_MAX_PAYLOAD];        // Payload received after the '@' prompt
+  bool hexMode;                                    // AT+UDCONF=1,1: socket data is read as hex digits
+  bool mqttLoggedIn;                               // AT+UMQTTC=1 succeeded
+  bool mqttSecure;                                 // AT+UMQTT=11,1: the login runs a TLS handshake
+  uint8_t mqttProfile;                             // Its security profile
+  bool socketSecure[SARA_R5_EMU_NUM_SOCKETS];      // Sockets bound to a security profile with AT+USOSEC
+  uint8_t socketProfile[SARA_R5_EMU_NUM_SOCKETS];  // Their profile
+  bool tlsResumption[SARA_R5_EMU_TLS_PROFILES];    // AT+USECPRF=<profile>,13,1: session resumption turned on
+  bool tlsSession[SARA_R5_EMU_TLS_PROFILES];       // A handshake of the profile succeeded, its session can be resumed
+  uint8_t outputStorage[SARA_R5_EMU_OUTPUT_BUFFER_SIZE];
+  SARA_R5_ring_buffer output;                      // Bytes of every queued segment
+  SARA_R5_emulator_segment segments[SARA_R5_EMU_MAX_SEGMENTS];
+  size_t segmentHead;                              // Oldest queued segment
+  size_t segmentCount;                             // Segments queued
+  uint64_t lineFreeUs;                             // Time the last queued byte leaves the line
+  SARA_R5_emulator_urc urcs[SARA_R5_EMU_MAX_URCS]; // URCs not sent yet
+  size_t urcCount;                                 // Entries used in 'urcs'
+  bool chainContinues;                             // More ';' chained commands follow the one running
+  bool chainFailed;                                // A chained command failed, the rest of the line is skipped
+  bool mux;                                        // AT+CMUX answered, the line carries 27.010 frames
+  uint8_t channel;                                 // CMUX channel the answers go to
+  SARA_R5_cmux_parser muxParser;                   // Decoder of the frames sent by the library
+  char muxCommand[SARA_R5_CMUX_CHANNELS + 1][SARA_R5_EMU_COMMAND_BUFFER_SIZE]; // Command line being received per channel
+  size_t muxCommandLength[SARA_R5_CMUX_CHANNELS + 1];                              // Characters stored in 'muxCommand'
+  bool muxStopped[SARA_R5_CMUX_CHANNELS + 1];      // Channels the library has stopped (MSC FC)
+  SARA_R5_emulator_frame frames[SARA_R5_EMU_MAX_FRAMES]; // Frames not sent yet
+  size_t frameCount;                               // Entries used in 'frames'
+  bool directLink;                                 // AT+USODL answered CONNECT, the input is socket data
+  uint8_t directChannel;                           // CMUX channel of the direct link
+  uint64_t sendStartUs;                            // Time the bytes being handled started to arrive
+  uint64_t directLastUs;                           // Time the last direct link byte arrived
+  uint64_t escapeDueUs;                            // "+++" received, the link ends at this time (0: none)
+  uint64_t scanDueUs;                              // End of the AT+COPS=? scan running (0: none)
+  uint8_t scanChannel;                             // CMUX channel of the scan
+} SARA_R5_emulator;
+
+// FUNCTIONS FOR THE MODULE EMULATOR
+void saraR5EmulatorDefaultConfig(SARA_R5_emulator_config *config);
+void saraR5EmulatorInit(SARA_R5_emulator *emulator, SARA_R5_transport *transport, const SARA_R5_emulator_config *config);
+bool saraR5EmulatorScheduleUrc(SARA_R5_emulator *emulator, const char *urc, uint32_t delayMs);
+bool saraR5EmulatorMuxFlow(SARA_R5_emulator *emulator, uint8_t dlci, bool stop);
+bool saraR5EmulatorSocketData(SARA_R5_emulator *emulator, int socket, const uint8_t *data, size_t len, uint32_t delayMs);
+bool saraR5EmulatorSocketClose(SARA_R5_emulator *emulator, int socket, uint32_t delayMs);
+
+#endif // SARA_R5_EMULATOR_H
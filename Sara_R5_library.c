@@ -1,24 +1,211 @@
-#include "SARA_R5_library.h"
+#include "Sara_R5_library.h"
 
+#ifndef SARA_R5_HOST
 extern UART_HandleTypeDef huart1;
 
+// Default link used when the application does not install a transport
+static SARA_R5_stm32_transport saraR5DefaultPort;
+static SARA_R5_transport saraR5DefaultTransport;
+#endif
+
+// Link to the module
+static SARA_R5_transport *saraR5Transport = NULL;
+
+// Received bytes not consumed yet. Filled from the transport, drained by the receive functions.
+static uint8_t saraR5RxStorage[SARA_R5_RX_RING_BUFFER_SIZE];
+static SARA_R5_ring_buffer saraR5RxRing = {saraR5RxStorage, SARA_R5_RX_RING_BUFFER_SIZE, 0, 0, 0};
+
+// Tokenizer following the AT transaction in progress
+static SARA_R5_at_tokenizer saraR5Tokenizer;
+
+// Unsolicited result codes, taken out of the answers and read between commands
+static SARA_R5_urc_table saraR5Urcs;
+static SARA_R5_at_tokenizer saraR5UrcTokenizer;
+static bool saraR5UrcsReady = false;
+static char saraR5ResponsePrefix[SARA_R5_URC_PREFIX_SIZE]; // "+XXX" of the command in progress, its own lines are never URCs
+
+// Response buffer the lines of the answer in progress are copied to
+static char *saraR5ResponseData = NULL;
+static size_t saraR5ResponseSize = 0;
+static size_t *saraR5ResponseStored = NULL;
+static SARA_R5_response_handler saraR5ResponseHandler = NULL; // Gets the answer in progress as it arrives (may be NULL)
+static void *saraR5ResponseHandlerContext = NULL;
+
+// Commands waiting to be sent, the oldest one is in progress once 'saraR5QueueActive' is set
+static SARA_R5_command saraR5Queue[SARA_R5_COMMAND_QUEUE_SIZE];
+static size_t saraR5QueueHead = 0;
+static size_t saraR5QueueCount = 0;
+static bool saraR5QueueActive = false;
+static uint32_t saraR5QueueStart = 0;        // Time the command in progress was sent
+static unsigned long saraR5QueueTimeout = 0; // Time allowed for its answer
+static size_t saraR5QueueStored = 0;         // Bytes of its answer stored in its response buffer
+static size_t saraR5QueueChained = 0;        // Queued commands sent together on its line
+static bool saraR5QueueHold = false;         // Set by saraR5BatchBegin, nothing new is sent
+static bool saraR5QueueAborted = false;      // The command in progress was sent the abort character
+static bool saraR5QueuePrompted = false;     // The command in progress got its '@' prompt, its data is due
+static uint32_t saraR5QueuePromptTime = 0;   // Time the prompt was received
+
+// Line of ';' chained commands in progress
+static SARA_R5_segment saraR5ChainSegments[SARA_R5_CHAIN_MAX_SEGMENTS];
+
+// Socket direct link: while it runs the line carries raw data and the command queue is held
+static bool saraR5DirectLinkActive = false;
+static uint32_t saraR5DirectLinkLastSend = 0; // Time of the last byte written, for the escape guard
+static SARA_R5_direct_link_stats saraR5DirectLinkStats;
+
+// Bytes received on the sockets, see saraR5SocketRead
+static SARA_R5_socket_rx saraR5SocketRx[SARA_R5_NUM_SOCKETS];
+static bool saraR5SocketHex = false; // AT+UDCONF=1,1 was sent: socket data is exchanged as hex digits
+
+// State of the socket IDs, see saraR5SocketAcquire
+static SARA_R5_socket_slot saraR5SocketSlots[SARA_R5_NUM_SOCKETS];
+
+// UDP send queue, see saraR5UdpQueueSend
+static SARA_R5_udp_datagram saraR5UdpQueue[SARA_R5_UDP_QUEUE_DATAGRAMS];
+static bool saraR5UdpQueueCoalesce = false;                       // Records to the same destination share a datagram
+static size_t saraR5UdpQueueMtu = SARA_R5_UDP_QUEUE_MTU;          // Largest datagram built
+static uint32_t saraR5UdpQueueLatency = SARA_R5_UDP_QUEUE_LATENCY; // Time a datagram waits for more records (ms)
+static SARA_R5_udp_queue_stats saraR5UdpQueueStats;
+static uint32_t saraR5UdpQueueStatsStart = 0; // Time the statistics were reset
+
+// Host name resolution cache, see saraR5ResolveHost
+static SARA_R5_dns_entry saraR5DnsCache[SARA_R5_DNS_CACHE_SIZE];
+static size_t saraR5DnsCapacity = SARA_R5_DNS_CACHE_SIZE;        // Entries in use, 0 turns the cache off
+static uint32_t saraR5DnsTtl = SARA_R5_DNS_TTL;                  // Time a resolved address is reused (ms)
+static uint32_t saraR5DnsNegativeTtl = SARA_R5_DNS_NEGATIVE_TTL; // Time a name that did not resolve is remembered (ms)
+static SARA_R5_dns_stats saraR5DnsStats;
+
+// TLS security profiles, see saraR5SecurityProfileSet
+static bool saraR5SecurityResumption[SARA_R5_SECURITY_PROFILES]; // Session resumption turned on
+static bool saraR5SecuritySession[SARA_R5_SECURITY_PROFILES];    // A handshake succeeded since, the next one offers its session
+static SARA_R5_security_stats saraR5SecurityStats[SARA_R5_SECURITY_PROFILES];
+static int saraR5MqttSecurity = SARA_R5_SECURITY_NONE; // Profile of the MQTT client, see saraR5SetMQTTsecurity
+static uint32_t saraR5MqttLoginTime = 0;                // Time the login of the secure MQTT client was queued (ms)
+static bool saraR5MqttLoginPending = false;             // Its +UUMQTTC is awaited to time the handshake
+
+// Layouts of the answers parsed with the schema parser. The AT+COPS=? and AT+CGDCONT? answers keep parsers of their
+// own (saraR5OperatorParserFeed, saraR5PdpParserFeed): an operator list holds several records per line, between
+// parentheses and next to tuples of another layout, and a context holds two addresses in one field, IPv6 ones in
+// colon notation, then a number of parameters that depends on the module.
+static const SARA_R5_field saraR5SocketCreatedFields[] = {
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_socket_created, socket),
+};
+static const SARA_R5_response_schema saraR5SocketCreatedSchema = SARA_R5_SCHEMA("+USOCR:", SARA_R5_socket_created, saraR5SocketCreatedFields);
+static const SARA_R5_field saraR5SocketWrittenFields[] = {
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_socket_written, socket),
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_socket_written, length),
+};
+static const SARA_R5_response_schema saraR5SocketWrittenSchema = SARA_R5_SCHEMA("+USOWR:", SARA_R5_socket_written, saraR5SocketWrittenFields);
+static const SARA_R5_response_schema saraR5SocketSentSchema = SARA_R5_SCHEMA("+USOST:", SARA_R5_socket_written, saraR5SocketWrittenFields);
+static const SARA_R5_field saraR5SocketControlFields[] = {
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_socket_control, socket),
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_socket_control, param),
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_socket_control, value),
+};
+static const SARA_R5_response_schema saraR5SocketControlSchema = SARA_R5_SCHEMA("+USOCTL:", SARA_R5_socket_control, saraR5SocketControlFields);
+static const SARA_R5_field saraR5DnsAnswerFields[] = {
+	SARA_R5_FIELD(SARA_R5_FIELD_IP, SARA_R5_dns_answer, ip),
+};
+static const SARA_R5_response_schema saraR5DnsAnswerSchema = SARA_R5_SCHEMA("+UDNSRN:", SARA_R5_dns_answer, saraR5DnsAnswerFields);
+
+// Response buffers of the command functions: a static pool with SARA_R5_NO_HEAP, the heap otherwise
+#ifdef SARA_R5_NO_HEAP
+static char saraR5Scratch[SARA_R5_SCRATCH_SIZE];
+#endif
+static size_t saraR5ScratchInUse = 0;
+static size_t saraR5ScratchPeak = 0;
+static unsigned long saraR5ScratchAllocations = 0;
+static unsigned long saraR5ScratchFailures = 0;
+
 /**
  * Allocates memory for an array of 'num' characters and initializes it to zero.
+ * With SARA_R5_NO_HEAP the memory comes from a static pool of SARA_R5_SCRATCH_SIZE bytes used as a stack:
+ * each library call gives back what it took before returning, so the pool never fragments.
  * @param num The number of characters to allocate.
  * @return A pointer to the allocated memory, or NULL if the allocation fails.
  */
 char *saraR5CallocChar(size_t num)
 {
+	char *memory;
+
+#ifdef SARA_R5_NO_HEAP
+	if (num > sizeof(saraR5Scratch) - saraR5ScratchInUse)
+	{
+		saraR5ScratchFailures++;
+		return NULL;
+	}
+	memory = &saraR5Scratch[saraR5ScratchInUse];
+	memset(memory, 0, num);
+#else
 	// Allocate memory for an array of 'num' characters and initialize to zero
-	char *memory = calloc(num, sizeof(char));
+	memory = calloc(num, sizeof(char));
 	if (memory == NULL)
 	{
-		// Handle the error, e.g., return NULL or print an error message
+		saraR5ScratchFailures++;
 		return NULL;
 	}
+#endif
+
+	saraR5ScratchAllocations++;
+	saraR5ScratchInUse += num;
+	if (saraR5ScratchInUse > saraR5ScratchPeak)
+	{
+		saraR5ScratchPeak = saraR5ScratchInUse;
+	}
 	return memory;
 }
 
+/**
+ * Gives back memory taken with saraR5CallocChar.
+ * With SARA_R5_NO_HEAP this also gives back everything allocated after it.
+ * @param memory The memory, may be NULL.
+ * @param num The size passed to saraR5CallocChar.
+ */
+void saraR5FreeChar(char *memory, size_t num)
+{
+	if (memory == NULL)
+	{
+		return;
+	}
+
+#ifdef SARA_R5_NO_HEAP
+	(void)num;
+	if ((size_t)(memory - saraR5Scratch) < saraR5ScratchInUse)
+	{
+		saraR5ScratchInUse = (size_t)(memory - saraR5Scratch);
+	}
+#else
+	free(memory);
+	saraR5ScratchInUse -= num;
+#endif
+}
+
+/**
+ * Reports the RAM used by the library: the static buffers, sized by the SARA_R5_* macros, and the
+ * response buffers taken by the command functions. With SARA_R5_NO_HEAP, SARA_R5_SCRATCH_SIZE must be
+ * at least 'scratchPeak' after the application has gone through all its command functions.
+ * @param footprint The report to fill.
+ */
+void saraR5GetFootprint(SARA_R5_footprint *footprint)
+{
+	footprint->receive = sizeof(saraR5RxStorage) + sizeof(saraR5RxRing) + sizeof(saraR5Tokenizer) + sizeof(saraR5UrcTokenizer);
+	footprint->commandQueue = sizeof(saraR5Queue) + sizeof(saraR5ChainSegments);
+	footprint->urcTable = sizeof(saraR5Urcs);
+	footprint->sockets = sizeof(saraR5SocketRx) + sizeof(saraR5SocketSlots);
+	footprint->udpQueue = sizeof(saraR5UdpQueue);
+	footprint->dnsCache = sizeof(saraR5DnsCache);
+#ifdef SARA_R5_NO_HEAP
+	footprint->scratch = sizeof(saraR5Scratch);
+#else
+	footprint->scratch = 0;
+#endif
+	footprint->total = footprint->receive + footprint->commandQueue + footprint->urcTable + footprint->sockets + footprint->udpQueue + footprint->dnsCache + footprint->scratch;
+	footprint->scratchInUse = saraR5ScratchInUse;
+	footprint->scratchPeak = saraR5ScratchPeak;
+	footprint->allocations = saraR5ScratchAllocations;
+	footprint->failures = saraR5ScratchFailures;
+}
+
 /**
  * Initializes the SARA R5 module by sending specific commands and checking responses.
  * @param expectedResponse The response string expected from the module.
@@ -28,12 +215,19 @@ char *saraR5CallocChar(size_t num)
 bool saraR5Init(const char *expectedResponse, const char *buffer)
 {
 
+	// Start from an empty reception
+	saraR5RxFlush();
+
 	// Desactivate echo
 	if (!saraR5SendCommand((const uint8_t *)SARA_R5_COMMAND_ECHO_DESACTIVATE))
 	{
 		return false; // Failed to send ECHO DESACTIVATE command
 	}
 
+	// Wait for the reply to ATE0 (it may still carry the echo), only the AT reply is checked
+	saraR5ReceiveResponse(buffer, STANDARD_RESPONSE_BUFFER_SIZE, SARA_R5_STANDARD_RESPONSE_TIMEOUT);
+	saraR5RxFlush();
+
 	// Send AT command
 	if (!saraR5SendCommand((const uint8_t *)SARA_R5_COMMAND_AT))
 	{
@@ -41,7 +235,7 @@ bool saraR5Init(const char *expectedResponse, const char *buffer)
 	}
 
 	// Receive OK to continue
-	saraR5ReceiveCommand(buffer, STANDARD_RESPONSE_BUFFER_SIZE, SARA_R5_10_SEC_TIMEOUT);
+	saraR5ReceiveResponse(buffer, STANDARD_RESPONSE_BUFFER_SIZE, SARA_R5_10_SEC_TIMEOUT);
 
 	// Check if the expected response is in the buffer
 	if (strcmp(buffer, expectedResponse) == 0)
@@ -54,6 +248,87 @@ bool saraR5Init(const char *expectedResponse, const char *buffer)
 	}
 }
 
+/**
+ * Installs the link used to talk to the module (STM32 UART, POSIX serial/pty, loopback, ...).
+ * @param transport The transport to use. It must live as long as the library uses it.
+ */
+void saraR5SetTransport(SARA_R5_transport *transport)
+{
+	saraR5Transport = transport;
+	saraR5RingBufferClear(&saraR5RxRing);
+}
+
+/**
+ * Gets the link used to talk to the module. On target the HAL UART huart1 is used by default.
+ * @return The transport in use, or NULL if none is installed.
+ */
+SARA_R5_transport *saraR5GetTransport(void)
+{
+#ifndef SARA_R5_HOST
+	if (saraR5Transport == NULL)
+	{
+		saraR5TransportStm32Init(&saraR5DefaultTransport, &saraR5DefaultPort, &huart1);
+		saraR5Transport = &saraR5DefaultTransport;
+	}
+#endif
+	return saraR5Transport;
+}
+
+/**
+ * Reads the clock of the transport.
+ * @return The time in milliseconds, or 0 if no transport is installed.
+ */
+uint32_t saraR5NowMs(void)
+{
+	SARA_R5_transport *transport = saraR5GetTransport();
+
+	return (transport != NULL) ? transport->nowMs(transport->context) : 0;
+}
+
+/**
+ * Moves the bytes received by the transport into the reception ring buffer.
+ * @return The number of bytes moved.
+ */
+static size_t saraR5RxPump(void)
+{
+	SARA_R5_transport *transport = saraR5GetTransport();
+	size_t total = 0;
+
+	if (transport == NULL)
+	{
+		return 0;
+	}
+
+	// Stop when the ring is full, the rest stays in the transport
+	while (saraR5RingBufferFree(&saraR5RxRing) > 0)
+	{
+		uint8_t chunk[SARA_R5_RX_CHUNK_SIZE];
+		size_t space = saraR5RingBufferFree(&saraR5RxRing);
+		size_t count = transport->receive(transport->context, chunk, (space < sizeof(chunk)) ? space : sizeof(chunk));
+		if (count == 0)
+		{
+			break;
+		}
+		saraR5RingBufferWrite(&saraR5RxRing, chunk, count);
+		total += count;
+	}
+	return total;
+}
+
+/**
+ * Waits for new bytes from the transport.
+ * @param ms The maximum time to wait in milliseconds.
+ */
+static void saraR5RxWait(uint32_t ms)
+{
+	SARA_R5_transport *transport = saraR5GetTransport();
+
+	if (transport != NULL)
+	{
+		transport->wait(transport->context, ms);
+	}
+}
+
 /**
  * Sends data via UART.
  * @param data Pointer to the data to be sent.
@@ -62,35 +337,101 @@ bool saraR5Init(const char *expectedResponse, const char *buffer)
  */
 bool saraR5SendDataUART(const uint8_t *data, uint32_t size)
 {
-	// Send data via UART
-	if (HAL_UART_Transmit(&huart1, data, size, HAL_MAX_DELAY) == HAL_OK)
+	SARA_R5_transport *transport = saraR5GetTransport();
+
+	if (transport == NULL)
 	{
-		return true; // Successful transmission
+		return false; // No link to the module
 	}
-	else
+
+	// Send data through the transport
+	return transport->send(transport->context, data, size);
+}
+
+/**
+ * Feeds bytes into the reception ring buffer as if they had come from the module.
+ * Lets the receive functions run against an in-memory byte source.
+ * @param data Pointer to the bytes to feed.
+ * @param len The number of bytes to feed.
+ */
+void saraR5RxFeed(const uint8_t *data, size_t len)
+{
+	saraR5RingBufferWrite(&saraR5RxRing, data, len);
+}
+
+/**
+ * Gets the number of received bytes waiting to be read.
+ * @return The number of bytes received and not read yet.
+ */
+size_t saraR5RxAvailable(void)
+{
+	saraR5RxPump();
+	return saraR5RingBufferAvailable(&saraR5RxRing);
+}
+
+/**
+ * Discards every received byte not read yet.
+ */
+void saraR5RxFlush(void)
+{
+	do
 	{
-		return false; // Transmission error
-	}
+		saraR5RingBufferClear(&saraR5RxRing);
+	} while (saraR5RxPump() > 0);
+	saraR5RingBufferClear(&saraR5RxRing);
 }
 
 /**
  * Receives data via UART.
+ * Returns as soon as the buffer is full or the line stays idle for SARA_R5_RX_IDLE_TIME ms after
+ * at least one byte, instead of waiting for 'size' bytes. The data is always terminated with a null character.
  * @param buffer Pointer to the buffer where received data will be stored.
- * @param size The number of bytes to receive.
+ * @param size The size of the buffer in bytes.
  * @param timeout The timeout in milliseconds.
- * @return true if reception is successful, false otherwise.
+ * @return true if some data was received, false otherwise.
  */
-bool saraR5ReceiveDataUART(const uint8_t *buffer, uint8_t size, unsigned long timeout)
+bool saraR5ReceiveDataUART(const uint8_t *buffer, size_t size, unsigned long timeout)
 {
-	// Receive data via UART
-	if (HAL_UART_Receive(&huart1, (uint8_t *)buffer, size, timeout) == HAL_OK)
+	uint8_t *data = (uint8_t *)buffer;
+	size_t received = 0;
+	uint32_t start = saraR5NowMs();
+	uint32_t lastByte = start;
+
+	if (data == NULL || size == 0)
 	{
-		return true; // Successful reception
+		return false;
 	}
-	else
+
+	// Keep the last byte for the terminator
+	size_t capacity = size - 1;
+
+	while (received < capacity)
 	{
-		return false; // Error in reception
+		uint32_t now;
+
+		saraR5RxPump();
+		size_t count = saraR5RingBufferRead(&saraR5RxRing, &data[received], capacity - received);
+		now = saraR5NowMs();
+		if (count > 0)
+		{
+			received += count;
+			lastByte = now;
+			continue;
+		}
+		// Everything received so far was followed by an idle line: the answer is complete
+		if (received > 0 && (now - lastByte) >= SARA_R5_RX_IDLE_TIME)
+		{
+			break;
+		}
+		if ((now - start) >= timeout)
+		{
+			break;
+		}
+		saraR5RxWait((received > 0) ? SARA_R5_RX_IDLE_TIME : timeout - (now - start));
 	}
+
+	data[received] = '\0';
+	return received > 0;
 }
 
 /**
@@ -100,7 +441,7 @@ bool saraR5ReceiveDataUART(const uint8_t *buffer, uint8_t size, unsigned long ti
  * @param timeout The timeout in milliseconds.
  * @return true if reception is successful, false otherwise.
  */
-bool saraR5ReceiveCommand(const char *buffer, uint8_t size, unsigned long timeout)
+bool saraR5ReceiveCommand(const char *buffer, size_t size, unsigned long timeout)
 {
 	// Receive command using saraR5ReceiveDataUART function
 	return saraR5ReceiveDataUART((uint8_t *)buffer, size, timeout);
@@ -119,713 +460,4448 @@ bool saraR5SendCommand(const uint8_t *command)
 }
 
 /**
- * Sends a command and waits for a specific response using the saraR5SendCommand and saraR5ReceiveCommand functions.
- * @param command Pointer to a string containing the command to be sent.
- * @param expectedResponse Pointer to a string containing the expected response to check for in the received data.
- * @param buffer Pointer to a buffer where the received data will be stored.
- * @param size The number of bytes to be read into the buffer.
- * @param timeout The timeout in milliseconds for receiving the response.
- * @return true if the function gets the right response in time, false if it does not.
+ * Formats an unsigned integer in decimal for a command segment. The digits are written from the end of
+ * 'digits' backwards, so they never need to be reversed.
+ * @param digits Storage for the digits, at least SARA_R5_SEGMENT_INT_SIZE bytes. Must live until the segment is sent.
+ * @param value The value to format.
+ * @return A segment pointing to the digits (not null terminated).
  */
-bool saraR5SendCommandWithResponse(const char *command, const char *expectedResponse, const char *buffer, uint8_t size, unsigned long timeout)
+SARA_R5_segment saraR5SegmentUint(char *digits, unsigned long value)
 {
-	// Use saraR5SendCommand function to send command
-	saraR5SendCommand((const uint8_t *)command);
-	// Use saraR5ReceiveCommand function to receive command
-	saraR5ReceiveCommand(buffer, size, timeout);
-	// See if the expected response "\r\nOK\r\n" is in the buffer
-	if (strstr(buffer, expectedResponse) != NULL)
+	char *end = &digits[SARA_R5_SEGMENT_INT_SIZE];
+	char *start = end;
+
+	do
 	{
-		return true;
-	}
-	else
+		*--start = (char)('0' + value % 10);
+		value /= 10;
+	} while (value > 0);
+	return (SARA_R5_segment){start, (size_t)(end - start)};
+}
+
+/**
+ * Formats an integer in decimal for a command segment.
+ * @param digits Storage for the digits, at least SARA_R5_SEGMENT_INT_SIZE bytes. Must live until the segment is sent.
+ * @param value The value to format.
+ * @return A segment pointing to the digits (not null terminated).
+ */
+SARA_R5_segment saraR5SegmentInt(char *digits, long value)
+{
+	unsigned long magnitude = (value < 0) ? 0ul - (unsigned long)value : (unsigned long)value;
+	SARA_R5_segment segment = saraR5SegmentUint(digits, magnitude);
+
+	if (value < 0)
 	{
-		return false;
+		char *sign = (char *)segment.data - 1;
+
+		*sign = '-';
+		segment.data = sign;
+		segment.len++;
 	}
+	return segment;
 }
 
 /**
- * Performs an action on a PDP (Packet Data Protocol) profile.
- * @param profile The PDP profile number.
- * @param action The action to perform on the PDP profile.
- * @param buffer A place to store data received from the action.
- * @param size How big the buffer is in bytes.
- * @return A number indicating if the action was successful, ran out of memory,
- *         encountered an error, or got no response.
+ * Builds a command segment from a null terminated string.
+ * @param str The string. Must live until the segment is sent.
+ * @return A segment pointing to the characters of the string.
  */
-uint8_t saraR5PerformPDPaction(int profile, SARA_R5_pdp_actions_t action, const char *buffer, uint8_t size)
+SARA_R5_segment saraR5SegmentString(const char *str)
 {
+	return (SARA_R5_segment){str, strlen(str)};
+}
 
-	char *command;
+/**
+ * Tells if a character cannot appear as it is between the quotes of a string parameter.
+ */
+static bool saraR5NeedsEscape(char c)
+{
+	return c == '"' || c == '\\' || (unsigned char)c < 0x20;
+}
 
-	// Calls the calloc function
-	/**
-	 * Allocates extra memory for the command string, adding 32 bytes to the length of SARA_R5_MESSAGE_PDP_ACTION.
-	 * This buffer space accommodates additional command parameters and ensures safety against buffer overflow.
-	 */
-	command = saraR5CallocChar(strlen(SARA_R5_MESSAGE_PDP_ACTION) + MESSAGE_PDP_ACTION_EXTRA_MEMORY);
+/**
+ * Builds the segment of a string parameter, to be sent between quotes. '"', '\' and control characters are
+ * written as '\' followed by two hex digits. A string without them is sent from where it is, without a copy.
+ * @param storage Storage for the escaped copy. Must live until the segment is sent.
+ * @param size The size of 'storage': 'len' plus 2 per escaped character, at most 3 * 'len'.
+ * @param str The characters, without the quotes. Must live until the segment is sent.
+ * @param len The number of characters.
+ * @return The segment, or a segment with NULL data if the escaped copy does not fit. Such a segment is refused
+ *         when the command is sent or queued.
+ */
+SARA_R5_segment saraR5SegmentQuoted(char *storage, size_t size, const void *str, size_t len)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	const char *chars = (const char *)str;
+	size_t count = 0;
+	size_t i = 0;
 
-	if (command == NULL)
-		return SARA_R5_ERROR_OUT_OF_MEMORY;
-	// Save the command as e.g "AT+UPSDA = 2,2"
-	sprintf(command, "%s=%d,%d\r", SARA_R5_MESSAGE_PDP_ACTION, profile, action);
+	while (i < len && !saraR5NeedsEscape(chars[i]))
+	{
+		i++;
+	}
+	if (i == len)
+	{
+		return (SARA_R5_segment){str, len};
+	}
 
-	// Send command and check response
-	if (!saraR5SendCommandWithResponse(command, SARA_RESPONSE_OK, buffer, size, SARA_R5_10_SEC_TIMEOUT))
+	if (i > size)
 	{
-		// If we receive Error or Nothing we free memory and return Error
-		if (strstr(buffer, SARA_RESPONSE_ERROR))
+		return (SARA_R5_segment){NULL, 0};
+	}
+	memcpy(storage, chars, i);
+	count = i;
+	for (; i < len; i++)
+	{
+		if (!saraR5NeedsEscape(chars[i]))
 		{
-			free(command);
-			return SARA_R5_ERROR_ERROR;
+			if (count == size)
+			{
+				return (SARA_R5_segment){NULL, 0};
+			}
+			storage[count++] = chars[i];
+			continue;
 		}
-		else
+		if (size - count < 3)
 		{
-			free(command);
-			return SARA_R5_ERROR_NO_RESPONSE;
+			return (SARA_R5_segment){NULL, 0};
 		}
+		storage[count++] = '\\';
+		storage[count++] = hex[(unsigned char)chars[i] >> 4];
+		storage[count++] = hex[(unsigned char)chars[i] & 0x0F];
 	}
-	free(command);
-	return SARA_R5_ERROR_SUCCESS;
+	return (SARA_R5_segment){storage, count};
 }
 
 /**
- * Gets a list of mobile network operators available.
- * @param opRet Where to store the list of operators.
- * @param maxOps The maximum number of operators to find.
- * @param buffer A place to store data received from the action.
- * @param size How big the buffer is in bytes.
- * @return The number of operators found, or an error code if something goes wrong.
+ * Builds the segment of a string parameter like saraR5SegmentQuoted, with storage for the escaped copy taken by
+ * saraR5CallocChar at the size the string needs, so any string the command could carry fits.
+ * @param storage Set to the storage taken, NULL if the string is sent from where it is.
+ * @param size Set to the size of the storage. Give it back with saraR5FreeChar(*storage, *size) once the command is sent.
+ * @return The segment, or a segment with NULL data if the storage could not be taken.
  */
-uint8_t saraR5GetOperators(SARA_R5_operator_stats *opRet, int maxOps, const char *buffer, uint8_t size)
+static SARA_R5_segment saraR5SegmentQuotedAlloc(char **storage, size_t *size, const void *str, size_t len)
 {
+	const char *chars = (const char *)str;
+	size_t escapes = 0;
 
-	uint8_t opsSeen = 0;
-	char *response;
-	char *command;
-	int op = 0;
-	char *opBegin;
-	char *opEnd;
-	int stat;
-	char longOp[SIZE_LONG_OP];
-	char shortOp[SIZE_SHORT_OP];
-	int act;
-	unsigned long numOp;
-
-	// Allocate memory for command
-	// This extra buffer space accommodates additional command parameters and ensures security against buffer overflow.
-	command = saraR5CallocChar(strlen(SARA_R5_OPERATOR_SELECTION) + OPERATOR_SELECTION_EXTRA_MEMORY);
-	if (command == NULL)
+	*storage = NULL;
+	*size = 0;
+	for (size_t i = 0; i < len; i++)
 	{
-		return SARA_R5_ERROR_OUT_OF_MEMORY;
+		escapes += saraR5NeedsEscape(chars[i]);
+	}
+	if (escapes == 0)
+	{
+		return (SARA_R5_segment){str, len};
 	}
 
-	// Send the AT+COPS = ?, to see the available networks
-	sprintf(command, "%s=?\r", SARA_R5_OPERATOR_SELECTION);
+	*storage = saraR5CallocChar(len + 2 * escapes);
+	if (*storage == NULL)
+	{
+		return (SARA_R5_segment){NULL, 0};
+	}
+	*size = len + 2 * escapes;
+	return saraR5SegmentQuoted(*storage, *size, str, len);
+}
+
+// The two hex digits of every byte value, so a byte is encoded with one lookup
+#define SARA_R5_HEX_DIGIT(n) ((char)(((n) < 10) ? '0' + (n) : 'A' + (n) - 10))
+#define SARA_R5_HEX_PAIR(b) {SARA_R5_HEX_DIGIT((b) >> 4), SARA_R5_HEX_DIGIT((b) & 0x0F)}
+#define SARA_R5_HEX_ROW(h)                                                                                   \
+	SARA_R5_HEX_PAIR((h) + 0x0), SARA_R5_HEX_PAIR((h) + 0x1), SARA_R5_HEX_PAIR((h) + 0x2), SARA_R5_HEX_PAIR((h) + 0x3), \
+	SARA_R5_HEX_PAIR((h) + 0x4), SARA_R5_HEX_PAIR((h) + 0x5), SARA_R5_HEX_PAIR((h) + 0x6), SARA_R5_HEX_PAIR((h) + 0x7), \
+	SARA_R5_HEX_PAIR((h) + 0x8), SARA_R5_HEX_PAIR((h) + 0x9), SARA_R5_HEX_PAIR((h) + 0xA), SARA_R5_HEX_PAIR((h) + 0xB), \
+	SARA_R5_HEX_PAIR((h) + 0xC), SARA_R5_HEX_PAIR((h) + 0xD), SARA_R5_HEX_PAIR((h) + 0xE), SARA_R5_HEX_PAIR((h) + 0xF)
+static const char saraR5HexPairs[256][2] = {
+	SARA_R5_HEX_ROW(0x00), SARA_R5_HEX_ROW(0x10), SARA_R5_HEX_ROW(0x20), SARA_R5_HEX_ROW(0x30),
+	SARA_R5_HEX_ROW(0x40), SARA_R5_HEX_ROW(0x50), SARA_R5_HEX_ROW(0x60), SARA_R5_HEX_ROW(0x70),
+	SARA_R5_HEX_ROW(0x80), SARA_R5_HEX_ROW(0x90), SARA_R5_HEX_ROW(0xA0), SARA_R5_HEX_ROW(0xB0),
+	SARA_R5_HEX_ROW(0xC0), SARA_R5_HEX_ROW(0xD0), SARA_R5_HEX_ROW(0xE0), SARA_R5_HEX_ROW(0xF0),
+};
+
+/**
+ * Builds the segment of binary data sent as hex digits (e.g. the hex mode of AT+UMQTTC or AT+USOST).
+ * The digits come from a table of the 256 pairs, four bytes (eight digits) at a time.
+ * @param storage Storage for the digits, at least 2 * 'len' bytes. Must live until the segment is sent.
+ * @param size The size of 'storage'.
+ * @param data The bytes to send.
+ * @param len The number of bytes.
+ * @return The segment, or a segment with NULL data if the digits do not fit.
+ */
+SARA_R5_segment saraR5SegmentHex(char *storage, size_t size, const uint8_t *data, size_t len)
+{
+	char *out = storage;
+	size_t i = 0;
 
-	// Allocate memory for response
-	int responseSize = (maxOps + 1) * RESPONSE_EXTRA_MEMORY;
-	response = saraR5CallocChar(responseSize);
-	if (response == NULL)
+	if (len > size / 2)
 	{
-		free(command);
-		return SARA_R5_ERROR_OUT_OF_MEMORY;
+		return (SARA_R5_segment){NULL, 0};
+	}
+	for (; i + 4 <= len; i += 4, out += 8)
+	{
+		memcpy(&out[0], saraR5HexPairs[data[i]], 2);
+		memcpy(&out[2], saraR5HexPairs[data[i + 1]], 2);
+		memcpy(&out[4], saraR5HexPairs[data[i + 2]], 2);
+		memcpy(&out[6], saraR5HexPairs[data[i + 3]], 2);
+	}
+	for (; i < len; i++, out += 2)
+	{
+		memcpy(out, saraR5HexPairs[data[i]], 2);
 	}
+	return (SARA_R5_segment){storage, 2 * len};
+}
 
-	// Send AT+COPS = 0,0 to set to automatic
-	saraR5AutomaticOperatorSelection(buffer, size);
-	if (!saraR5SendCommandWithResponse(command, SARA_RESPONSE_OK, response, size, SARA_R5_3_MIN_TIMEOUT))
+/**
+ * Tells if every segment of a command was built, i.e. none of them overflowed its storage.
+ */
+static bool saraR5SegmentsValid(const SARA_R5_segment *segments, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
 	{
-		free(command);
-		free(response);
-		if (strstr(buffer, SARA_RESPONSE_ERROR))
+		if (segments[i].data == NULL)
 		{
-			return SARA_R5_ERROR_ERROR;
+			return false;
 		}
-		return SARA_R5_ERROR_NO_RESPONSE;
 	}
-	// Parse the response to extract operator information
-	opBegin = response;
+	return true;
+}
 
-	// Sample responses format: +COPS: (1,"313 100","313 100","313100",8),(2,"AT&T","AT&T","310410",8), ...
-	for (; op < maxOps; op++)
+/**
+ * Sends a command given as a list of segments, streaming each one to the transport as it is.
+ * The command is never assembled in memory, so topics and payloads are sent from where they are.
+ * @param segments The pieces of the command, in order.
+ * @param count The number of segments.
+ * @return true if every segment was sent, false otherwise.
+ */
+bool saraR5SendSegments(const SARA_R5_segment *segments, size_t count)
+{
+	if (!saraR5SegmentsValid(segments, count))
 	{
-		opBegin = strchr(opBegin, '(');
-
-		opEnd = strchr(opBegin, ')');
-		memset(longOp, 0, sizeof(longOp));
-		memset(shortOp, 0, sizeof(shortOp));
-		int sscanRead = sscanf(opBegin, "(%d,\"%[^\"]\",\"%[^\"]\",\"%lu\",%d)%*s", &stat, longOp, shortOp, &numOp, &act);
-		// Search for other possible patterns here
-		if (sscanRead == 5)
+		return false;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		if (segments[i].len > 0 && !saraR5SendDataUART((const uint8_t *)segments[i].data, segments[i].len))
 		{
-			opRet[op].stat = stat;
-			strcpy(opRet[op].longOp, longOp);
-			strcpy(opRet[op].shortOp, shortOp);
-			opRet[op].numOp = numOp;
-			opRet[op].act = act;
-			opsSeen += 1;
+			return false;
 		}
-		opBegin = opEnd + 1;
-		// Move opBegin to beginning of next value
 	}
-
-	free(command);
-	free(response);
-	return opsSeen;
+	return true;
 }
 
 /**
- * Gets the Access Point Name (APN) and IP address information for a mobile network.
- * @param cid The context ID for which the APN information is requested.
- * @param apn Where to store the APN information.
- * @param ip Where to store the IP address information.
- * @param pdpType Where to store the type of Packet Data Protocol (PDP).
- * @return A number indicating if the function was successful, or an error code if something went wrong.
+ * Appends one line of the answer to the response buffer, between "\r\n" as the module sends it.
+ * A long line comes in several pieces: only its first piece is preceded, and its last one followed, by "\r\n".
  */
-uint8_t saraR5GetAPN(int cid, myApn *apn, Ip_adress *ip, SARA_R5_pdp_type *pdpType)
+static void saraR5ResponseAppend(const char *line, size_t len, bool lineStart, bool lineEnd)
 {
+	size_t stored;
+	size_t copy;
 
-	char *command;
-	char *response;
-	int op = 0;
-	bool success = false;
-
-	// Allocate memory for the command
-	// This extra buffer space accommodates additional command parameters and ensures security against buffer overflow.
-	command = saraR5CallocChar(strlen(SARA_R5_MESSAGE_PDP_DEF) + MESSAGE_PDP_DEF_EXTRA_MEMORY);
-	if (command == NULL)
+	if (saraR5ResponseData == NULL || saraR5ResponseSize == 0)
 	{
-		return SARA_R5_ERROR_OUT_OF_MEMORY;
+		return;
 	}
 
-	// Ask for active PDP context
-	sprintf(command, "%s?\r", SARA_R5_MESSAGE_PDP_DEF);
-
-	// Allocate memory for the response
-	response = saraR5CallocChar(RESPONSE_MEMORY);
-	if (response == NULL)
+	stored = *saraR5ResponseStored;
+	for (size_t part = 0; part < 3; part++)
 	{
-		free(command);
-		return SARA_R5_ERROR_OUT_OF_MEMORY;
-	}
+		const char *piece = (part == 1) ? line : "\r\n";
+		size_t pieceLength = (part == 1) ? len : 2;
 
-	// Send command and check response
-	if (!saraR5SendCommandWithResponse(command, SARA_RESPONSE_OK, response, LARGE_RESPONSE_BUFFER_SIZE, SARA_R5_STANDARD_RESPONSE_TIMEOUT))
-	{
-		if (strstr(response, SARA_RESPONSE_ERROR))
+		if ((part == 0 && !lineStart) || (part == 2 && !lineEnd))
 		{
-			free(command);
-			return SARA_R5_ERROR_ERROR;
+			continue;
 		}
-	}
-
-	// Parse the response to extract APN information
-	int rcid = -1;
-	char *searchPtr = response;
-	// Sample responses:
-	//  +CGDCONT: 1,"IP","payandgo.o2.co.uk.mnc010.mcc234.gprs","10.160.182.234",0,0,0,2,0,0,0,0,0,0
-	for (; op < MAX_OPS; op++)
-	{
-		int scanned = 0;
-		// Find the first/next occurrence of +CGDCONT:
-		searchPtr = strstr(searchPtr, "+CGDCONT:");
-		if (searchPtr != NULL)
-		{
-
-			char strPdpType[SIZE_PDP_TYPE] = "";
-			char strApn[SIZE_APN];
-			int ipOct[SIZE_OCT_IP] = {0};
 
-			searchPtr += strlen("+CGDCONT:");
-			while (*searchPtr == ' ')
-				searchPtr++; // Skip spaces
-
-			scanned = sscanf(searchPtr, "%d,\"%[^\"]\",\"%[^\"]\",\"%d.%d.%d.%d", &rcid, strPdpType, strApn, &ipOct[0], &ipOct[1], &ipOct[2], &ipOct[3]);
-			if (scanned == 7)
-			{
-				success = true;
-				// If scanned == 7 we can save the result
-				strcpy(apn[op].apn, strApn);
-				ip[op].first_ip = ipOct[0];
-				ip[op].second_ip = ipOct[1];
-				ip[op].third_ip = ipOct[2];
-				ip[op].fourth_ip = ipOct[3];
-
-				if (pdpType)
-				{
-					*pdpType = (0 == strcmp(strPdpType, "IPV4V6")) ? PDP_TYPE_IPV4V6 : (0 == strcmp(strPdpType, "IPV6")) ? PDP_TYPE_IPV6
-																				   : (0 == strcmp(strPdpType, "IP"))	 ? PDP_TYPE_IP
-																														 : PDP_TYPE_INVALID;
-				}
-			}
-		}
-		else // We don't have a match so let's clear the APN and IP address
+		copy = saraR5ResponseSize - 1 - stored;
+		if (copy > pieceLength)
 		{
-			if (apn)
-				apn->apn[0] = '\0';
-			if (pdpType)
-				*pdpType = PDP_TYPE_INVALID;
-			if (ip)
-				memset(ip, 0, sizeof(*ip));
+			copy = pieceLength;
 		}
+		memcpy(&saraR5ResponseData[stored], piece, copy);
+		stored += copy;
 	}
-	free(command);
-	free(response);
-	return success ? SARA_R5_ERROR_SUCCESS : SARA_R5_ERROR_NO_RESPONSE; // Returns SUCCESS if at least one context was processed, otherwise returns NO_RESPONSE
+	saraR5ResponseData[stored] = '\0';
+	*saraR5ResponseStored = stored;
 }
 
-uint8_t saraR5SetAPN(uint8_t cid, SARA_R5_pdp_type pdpType, char *apn, const char *buffer, uint8_t size)
+/**
+ * Line callback of the AT tokenizer: keeps the intermediate lines of the answer, or the end of a long one.
+ */
+static void saraR5ResponseLine(const char *line, size_t len, void *context)
 {
-
-	char *command;
-	char pdpStr[8] = "";
-
-	// Allocate memory for the command string
-	// This extra buffer space accommodates additional command parameters and ensures security against buffer overflow.
-	command = saraR5CallocChar(strlen(SARA_R5_MESSAGE_PDP_DEF) + strlen(apn + APN_EXTRA_MEMORY));
-	if (command == NULL)
+	(void)context;
+	saraR5ResponseAppend(line, len, !saraR5Tokenizer.lineContinued, true);
+	if (saraR5ResponseHandler != NULL)
 	{
-		return SARA_R5_ERROR_OUT_OF_MEMORY;
+		saraR5ResponseHandler(line, len, true, saraR5ResponseHandlerContext);
 	}
+}
 
-	// Convert PDP type to string representation
-	switch (pdpType)
+/**
+ * Partial line callback of the AT tokenizer: keeps a piece of a line longer than the tokenizer line buffer.
+ */
+static void saraR5ResponsePartial(const char *line, size_t len, void *context)
+{
+	(void)context;
+	saraR5ResponseAppend(line, len, !saraR5Tokenizer.lineContinued, false);
+	if (saraR5ResponseHandler != NULL)
 	{
-	case PDP_TYPE_INVALID:
-		free(command);
-		return SARA_R5_ERROR_UNEXPECTED_PARAM;
-	case PDP_TYPE_IP:
-		memcpy(pdpStr, "IP", 2);
-		break;
-	case PDP_TYPE_NONIP:
-		memcpy(pdpStr, "NONIP", 5);
-		break;
-	case PDP_TYPE_IPV4V6:
-		memcpy(pdpStr, "IPV4V6", 6);
-		break;
-	case PDP_TYPE_IPV6:
-		memcpy(pdpStr, "IPV6", 4);
-		break;
+		saraR5ResponseHandler(line, len, false, saraR5ResponseHandlerContext);
 	}
+}
 
-	// Send the command AT+CGDCONT = CID, TYPE, APN
-	sprintf(command, "%s=%d,\"%s\",\"%s\"\r", SARA_R5_MESSAGE_PDP_DEF, cid, pdpStr, apn);
+/**
+ * Counts a TLS handshake of a profile, full or resumed, with the time of the connection it belongs to.
+ */
+static void saraR5SecurityHandshake(int profile, bool success, uint32_t elapsedMs)
+{
+	SARA_R5_security_stats *stats = &saraR5SecurityStats[profile];
 
-	if (!saraR5SendCommandWithResponse((const char *)command, (const char *)SARA_RESPONSE_OK, buffer, size, SARA_R5_10_SEC_TIMEOUT))
+	if (!success)
 	{
-		if (strstr(buffer, SARA_RESPONSE_ERROR))
-		{
-			free(command);
-			return SARA_R5_ERROR_ERROR;
-		}
-		else
+		stats->failures++;
+		saraR5SecuritySession[profile] = false; // Nothing to resume, the next handshake is a full one
+		return;
+	}
+	if (saraR5SecurityResumption[profile] && saraR5SecuritySession[profile])
+	{
+		stats->resumedHandshakes++;
+		stats->resumedMs += elapsedMs;
+	}
+	else
+	{
+		stats->fullHandshakes++;
+		stats->fullMs += elapsedMs;
+	}
+	stats->lastMs = elapsedMs;
+	saraR5SecuritySession[profile] = saraR5SecurityResumption[profile];
+}
+
+/**
+ * Times the handshake of a secure MQTT login with its "+UUMQTTC: 1,<result>" URC, before the URC is dispatched.
+ */
+static void saraR5MqttLoginSeen(const char *line, size_t len)
+{
+	static const char login[] = "+UUMQTTC: 1,";
+
+	if (!saraR5MqttLoginPending || len < sizeof(login) || memcmp(line, login, sizeof(login) - 1) != 0)
+	{
+		return;
+	}
+	saraR5MqttLoginPending = false;
+	saraR5SecurityHandshake(saraR5MqttSecurity, line[sizeof(login) - 1] == '0', saraR5NowMs() - saraR5MqttLoginTime);
+}
+
+/**
+ * URC filter of the AT tokenizers: hands the unsolicited lines to their handler.
+ * Lines starting like the command in progress (e.g. "+CEREG: 0,1" after AT+CEREG?) belong to its answer.
+ */
+static bool saraR5UrcFilter(const char *line, size_t len, void *context)
+{
+	size_t prefixLength = strlen(saraR5ResponsePrefix);
+
+	(void)context;
+	if (prefixLength > 0 && len > prefixLength && line[prefixLength] == ':' && memcmp(line, saraR5ResponsePrefix, prefixLength) == 0)
+	{
+		return false;
+	}
+	saraR5MqttLoginSeen(line, len);
+	return saraR5UrcDispatch(&saraR5Urcs, line, len);
+}
+
+/**
+ * Gets the reception state of a socket, or NULL for an invalid socket ID.
+ */
+static SARA_R5_socket_rx *saraR5SocketRxGet(long socket)
+{
+	if (socket < 0 || socket >= SARA_R5_NUM_SOCKETS)
+	{
+		return NULL;
+	}
+	return &saraR5SocketRx[socket];
+}
+
+/**
+ * Forgets what was received on a socket, when its ID is given to a new socket or closed.
+ */
+static void saraR5SocketRxReset(int socket)
+{
+	SARA_R5_socket_rx *rx = saraR5SocketRxGet(socket);
+
+	if (rx == NULL)
+	{
+		return;
+	}
+	saraR5RingBufferInit(&rx->ring, rx->storage, sizeof(rx->storage));
+	rx->pending = 0;
+	rx->udp = false;
+	rx->announced = false; // A read still running completes, its bytes are dropped with the ring
+}
+
+/**
+ * URC handler of +UUSOCL ("+UUSOCL: <socket>"): the module closed a socket, e.g. when the remote end did.
+ * Its endpoint is kept, saraR5SocketAcquire connects a new socket to it when it is needed again.
+ */
+static void saraR5SocketClosedUrc(const SARA_R5_urc *urc, void *context)
+{
+	long socket = saraR5UrcFieldInt(urc, 0, -1);
+
+	(void)context;
+	if (saraR5SocketRxGet(socket) == NULL)
+	{
+		return;
+	}
+	if (saraR5SocketSlots[socket].state != SARA_R5_SOCKET_FREE)
+	{
+		saraR5SocketSlots[socket].state = SARA_R5_SOCKET_CLOSED;
+	}
+	saraR5SocketRxReset((int)socket);
+}
+
+/**
+ * URC handler of +UUSORD and +UUSORF ("+UUSORD: <socket>,<length>"): the module holds data for a socket.
+ * The read is queued by saraR5Poll.
+ */
+static void saraR5SocketRxUrc(const SARA_R5_urc *urc, void *context)
+{
+	SARA_R5_socket_rx *rx = saraR5SocketRxGet(saraR5UrcFieldInt(urc, 0, -1));
+	long length = saraR5UrcFieldInt(urc, 1, -1);
+
+	(void)context;
+	if (rx == NULL || length < 0)
+	{
+		return;
+	}
+	rx->udp = (strcmp(urc->name, "+UUSORF") == 0);
+	rx->pending = (size_t)length;
+	rx->announced = rx->reading;
+}
+
+/**
+ * Takes one character of the data field: the bytes as they are, or two hex digits per byte in hex mode.
+ */
+static void saraR5SocketRxData(SARA_R5_socket_rx *rx, char c)
+{
+	uint8_t digit;
+
+	rx->dataLeft--;
+	if (!saraR5SocketHex)
+	{
+		saraR5RingBufferWrite(&rx->ring, (const uint8_t *)&c, 1); // The ring counts what does not fit
+		return;
+	}
+
+	if (c >= '0' && c <= '9')
+	{
+		digit = (uint8_t)(c - '0');
+	}
+	else if (c >= 'A' && c <= 'F')
+	{
+		digit = (uint8_t)(c - 'A' + 10);
+	}
+	else if (c >= 'a' && c <= 'f')
+	{
+		digit = (uint8_t)(c - 'a' + 10);
+	}
+	else
+	{
+		rx->dataLeft = 0; // Not hex data, the rest of the answer is dropped
+		return;
+	}
+	if (rx->hexHigh == 0xFF)
+	{
+		rx->hexHigh = digit;
+		return;
+	}
+	digit = (uint8_t)((rx->hexHigh << 4) | digit);
+	saraR5RingBufferWrite(&rx->ring, &digit, 1);
+	rx->hexHigh = 0xFF;
+}
+
+/**
+ * Response handler of AT+USORD / AT+USORF: writes the data of "+USORD: <socket>,<length>,"<data>"" (or
+ * "+USORF: <socket>,"<ip>",<port>,<length>,"<data>"") straight into the ring of the socket.
+ * The data is <length> bytes long, so quotes in it are taken as data. In text mode a line break in the
+ * data ends the line of the tokenizer: hex mode is the one for binary data.
+ */
+static void saraR5SocketRxFeed(const char *data, size_t len, bool lineEnd, void *context)
+{
+	SARA_R5_socket_rx *rx = (SARA_R5_socket_rx *)context;
+	const char *prefix = rx->udp ? "+USORF:" : "+USORD:";
+	uint8_t lengthField = rx->udp ? 3 : 1;
+
+	for (size_t i = 0; i < len && !rx->skipLine; i++)
+	{
+		char c = data[i];
+
+		if (rx->prefixLength < strlen(prefix))
+		{
+			// Still matching the start of the line
+			if (c != prefix[rx->prefixLength])
+			{
+				rx->skipLine = true;
+			}
+			rx->prefixLength++;
+		}
+		else if (rx->inData)
+		{
+			if (rx->dataLeft > 0)
+			{
+				saraR5SocketRxData(rx, c);
+			}
+		}
+		else if (c == ',')
+		{
+			rx->field++;
+		}
+		else if (c == '"' && rx->field == lengthField + 1)
+		{
+			rx->inData = true;
+			rx->dataLeft = saraR5SocketHex ? 2 * rx->length : rx->length;
+			rx->hexHigh = 0xFF;
+		}
+		else if (c >= '0' && c <= '9' && rx->field == lengthField && rx->length <= SARA_R5_SOCKET_MAX_READ)
+		{
+			rx->length = rx->length * 10 + (size_t)(c - '0');
+		}
+	}
+
+	if (lineEnd)
+	{
+		rx->prefixLength = 0;
+		rx->skipLine = false;
+		rx->inData = false;
+		rx->field = 0;
+	}
+}
+
+/**
+ * Completion callback of AT+USORD / AT+USORF: counts the bytes read out of the module.
+ */
+static void saraR5SocketRxDone(uint8_t error, SARA_R5_at_result_t result, int errorCode, const char *response, void *context)
+{
+	SARA_R5_socket_rx *rx = (SARA_R5_socket_rx *)context;
+
+	(void)result;
+	(void)errorCode;
+	(void)response;
+	rx->reading = false;
+	if (error != SARA_R5_ERROR_SUCCESS || rx->length == 0)
+	{
+		rx->pending = 0; // Nothing left, the module announces the next bytes with a new URC
+	}
+	else if (!rx->announced)
+	{
+		// A URC received meanwhile already gave the new count, at worst it makes one empty read
+		rx->pending = (rx->pending > rx->length) ? rx->pending - rx->length : 0;
+	}
+	rx->announced = false;
+}
+
+/**
+ * Queues a read for every socket with data waiting in the module and room in its ring.
+ * When the queue is full, the read is queued by a later call.
+ */
+static void saraR5SocketRxService(void)
+{
+	for (int socket = 0; socket < SARA_R5_NUM_SOCKETS; socket++)
+	{
+		SARA_R5_socket_rx *rx = &saraR5SocketRx[socket];
+		size_t count = saraR5SocketHex ? SARA_R5_SOCKET_MAX_READ_HEX : SARA_R5_SOCKET_MAX_READ;
+		char socketDigits[SARA_R5_SEGMENT_INT_SIZE];
+		char countDigits[SARA_R5_SEGMENT_INT_SIZE];
+
+		if (rx->reading || rx->pending == 0 || rx->ring.buffer == NULL)
+		{
+			continue;
+		}
+		if (count > rx->pending)
+		{
+			count = rx->pending;
+		}
+		if (count > saraR5RingBufferFree(&rx->ring))
+		{
+			count = saraR5RingBufferFree(&rx->ring);
+		}
+		if (count == 0)
+		{
+			continue; // Waits for saraR5SocketRead to make room
+		}
+
+		SARA_R5_segment command[] = {
+			SARA_R5_SEGMENT_LITERAL(SARA_R5_READ_SOCKET "="),
+			saraR5SegmentInt(socketDigits, socket),
+			SARA_R5_SEGMENT_LITERAL(","),
+			saraR5SegmentUint(countDigits, (unsigned long)count),
+			SARA_R5_SEGMENT_LITERAL("\r"),
+		};
+		if (rx->udp)
+		{
+			command[0].data = SARA_R5_READ_UDP_SOCKET "=";
+		}
+		rx->length = 0;
+		rx->prefixLength = 0;
+		rx->skipLine = false;
+		rx->inData = false;
+		rx->field = 0;
+		if (saraR5SubmitCommandStreamed(command, SARA_R5_SEGMENT_COUNT(command), SARA_R5_SOCKET_READ_TIMEOUT, saraR5SocketRxFeed, rx, saraR5SocketRxDone, rx) == SARA_R5_ERROR_SUCCESS)
+		{
+			rx->reading = true;
+		}
+	}
+}
+
+/**
+ * Sets up the URC table and the tokenizers the first time they are needed.
+ */
+static void saraR5UrcSetup(void)
+{
+	if (saraR5UrcsReady)
+	{
+		return;
+	}
+	saraR5UrcTableInit(&saraR5Urcs);
+	saraR5UrcRegister(&saraR5Urcs, "+UUSORD", saraR5SocketRxUrc, NULL);
+	saraR5UrcRegister(&saraR5Urcs, "+UUSORF", saraR5SocketRxUrc, NULL);
+	saraR5UrcRegister(&saraR5Urcs, "+UUSOCL", saraR5SocketClosedUrc, NULL);
+	for (int socket = 0; socket < SARA_R5_NUM_SOCKETS; socket++)
+	{
+		saraR5SocketRxReset(socket);
+	}
+	saraR5AtTokenizerInit(&saraR5Tokenizer, saraR5ResponseLine, NULL);
+	saraR5AtTokenizerSetPartialHandler(&saraR5Tokenizer, saraR5ResponsePartial);
+	saraR5AtTokenizerSetUrcFilter(&saraR5Tokenizer, saraR5UrcFilter, NULL);
+	saraR5AtTokenizerInit(&saraR5UrcTokenizer, NULL, NULL);
+	saraR5AtTokenizerSetUrcFilter(&saraR5UrcTokenizer, saraR5UrcFilter, NULL);
+	saraR5UrcsReady = true;
+}
+
+/**
+ * Remembers the "+XXX" name of a command, so the lines of its answer are not mistaken for URCs.
+ */
+static void saraR5ResponsePrefixSet(const SARA_R5_segment *segments, size_t count)
+{
+	const char *command = (count > 0) ? (const char *)segments[0].data : NULL;
+	size_t len = 0;
+
+	if (command != NULL && segments[0].len > 3 && memcmp(command, "AT+", 3) == 0)
+	{
+		command += 2;
+		while (len < segments[0].len - 2 && len < sizeof(saraR5ResponsePrefix) - 1 && strchr("=?;\r", command[len]) == NULL)
+		{
+			len++;
+		}
+		memcpy(saraR5ResponsePrefix, command, len);
+	}
+	saraR5ResponsePrefix[len] = '\0';
+}
+
+/**
+ * Reads the bytes received while no command is in progress and hands the URCs to their handler.
+ * Other lines are stale and dropped. A line cut in the middle is kept by the tokenizer.
+ */
+static void saraR5UrcProcess(void)
+{
+	uint8_t chunk[SARA_R5_RX_CHUNK_SIZE];
+	size_t count;
+
+	saraR5UrcSetup();
+	saraR5ResponsePrefix[0] = '\0';
+	saraR5RxPump();
+	while ((count = saraR5RingBufferRead(&saraR5RxRing, chunk, sizeof(chunk))) > 0)
+	{
+		size_t consumed = 0;
+
+		while (consumed < count)
+		{
+			consumed += saraR5AtTokenizerFeed(&saraR5UrcTokenizer, &chunk[consumed], count - consumed);
+			if (saraR5AtTokenizerDone(&saraR5UrcTokenizer))
+			{
+				saraR5AtTokenizerReset(&saraR5UrcTokenizer); // Stray result code
+			}
+		}
+		saraR5RxPump();
+	}
+}
+
+/**
+ * Moves one chunk of received bytes into the AT tokenizer, keeping a copy of the answer lines
+ * and handing them to 'handler' (may be NULL).
+ * URCs are taken out of the answer, and only the bytes that belong to the answer are consumed.
+ * @return true if some bytes were processed, false if nothing was waiting.
+ */
+static bool saraR5ResponseStep(char *data, size_t size, size_t *stored, SARA_R5_response_handler handler, void *handlerContext)
+{
+	uint8_t chunk[SARA_R5_RX_CHUNK_SIZE];
+
+	saraR5UrcSetup();
+	saraR5RxPump();
+	size_t count = saraR5RingBufferPeek(&saraR5RxRing, chunk, sizeof(chunk));
+	if (count == 0)
+	{
+		return false;
+	}
+
+	// Only consume what belongs to this answer
+	saraR5ResponseData = data;
+	saraR5ResponseSize = size;
+	saraR5ResponseStored = stored;
+	saraR5ResponseHandler = handler;
+	saraR5ResponseHandlerContext = handlerContext;
+	size_t consumed = saraR5AtTokenizerFeed(&saraR5Tokenizer, chunk, count);
+	saraR5RingBufferRead(&saraR5RxRing, NULL, consumed);
+
+	// The final result code ends the copy of the answer for the callers that parse the buffer themselves
+	if (saraR5AtTokenizerDone(&saraR5Tokenizer) && saraR5Tokenizer.result != SARA_R5_AT_RESULT_PROMPT)
+	{
+		saraR5ResponseAppend(saraR5Tokenizer.line, saraR5Tokenizer.lineLength, true, true);
+	}
+	saraR5ResponseData = NULL;
+	saraR5ResponseHandler = NULL;
+	return true;
+}
+
+/**
+ * Receives the answer to a command until its final result code (OK, ERROR, +CME ERROR, +CMS ERROR).
+ * The bytes are fed to the AT tokenizer as they arrive, so the function returns as soon as the
+ * module has finished answering. Bytes received after the final result code are left for the next read.
+ * @param buffer Pointer to a buffer where the raw answer will be stored (may be NULL). It is null terminated.
+ * @param size The size of the buffer in bytes.
+ * @param timeout The timeout in milliseconds.
+ * @return true if a final result code was received in time, false otherwise.
+ */
+bool saraR5ReceiveResponse(const char *buffer, size_t size, unsigned long timeout)
+{
+	char *data = (char *)buffer;
+	size_t stored = 0;
+	uint32_t start = saraR5NowMs();
+	uint32_t elapsed = 0;
+
+	saraR5AtTokenizerReset(&saraR5Tokenizer);
+	saraR5ResponsePrefix[0] = '\0';
+	if (data != NULL && size > 0)
+	{
+		data[0] = '\0';
+	}
+
+	do
+	{
+		if (!saraR5ResponseStep(data, size, &stored, NULL, NULL))
+		{
+			saraR5RxWait(timeout - elapsed);
+		}
+		elapsed = saraR5NowMs() - start;
+	} while (!saraR5AtTokenizerDone(&saraR5Tokenizer) && elapsed < timeout);
+
+	return saraR5AtTokenizerDone(&saraR5Tokenizer);
+}
+
+/**
+ * Adds a command at the end of the queue.
+ * @param copy Copy the bytes of the segments into the queue, otherwise they must live until the command is over.
+ */
+static uint8_t saraR5QueuePush(const SARA_R5_segment *segments, size_t count, bool copy, const char *buffer, size_t size, unsigned long timeout, bool chainable, SARA_R5_command_callback callback, void *context)
+{
+	SARA_R5_command *command;
+
+	if (saraR5QueueCount == SARA_R5_COMMAND_QUEUE_SIZE)
+	{
+		return SARA_R5_ERROR_OUT_OF_MEMORY; // Queue full
+	}
+	if (saraR5DirectLinkActive)
+	{
+		return SARA_R5_ERROR_ERROR; // The module would take the command for data
+	}
+	if (!saraR5SegmentsValid(segments, count))
+	{
+		return SARA_R5_ERROR_UNEXPECTED_PARAM; // A parameter did not fit its segment storage
+	}
+
+	command = &saraR5Queue[(saraR5QueueHead + saraR5QueueCount) % SARA_R5_COMMAND_QUEUE_SIZE];
+	command->overflow = NULL;
+	if (copy)
+	{
+		char *storage = command->storage;
+		size_t length = 0;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			length += segments[i].len;
+		}
+		if (length > sizeof(command->storage))
+		{
+#ifdef SARA_R5_NO_HEAP
+			return SARA_R5_ERROR_UNEXPECTED_PARAM; // Longer than SARA_R5_COMMAND_LINE_SIZE, the scratch pool is a stack
+#else
+			command->overflow = saraR5CallocChar(length);
+			if (command->overflow == NULL)
+			{
+				return SARA_R5_ERROR_OUT_OF_MEMORY;
+			}
+			storage = command->overflow;
+#endif
+		}
+		length = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			memcpy(&storage[length], segments[i].data, segments[i].len);
+			length += segments[i].len;
+		}
+		command->copy.data = storage;
+		command->copy.len = length;
+		command->segments = &command->copy;
+		command->count = 1;
+	}
+	else
+	{
+		command->segments = segments;
+		command->count = count;
+	}
+	command->response = (char *)buffer;
+	command->responseSize = size;
+	command->timeout = timeout;
+	command->chainable = chainable;
+	command->callback = callback;
+	command->context = context;
+	command->handler = NULL;
+	command->handlerContext = NULL;
+	command->payload.data = NULL;
+	command->payload.len = 0;
+	saraR5QueueCount++;
+	return SARA_R5_ERROR_SUCCESS;
+}
+
+/**
+ * Maps a final result code to the error reported to the callbacks.
+ */
+static uint8_t saraR5ResultError(SARA_R5_at_result_t result)
+{
+	switch (result)
+	{
+	case SARA_R5_AT_RESULT_OK:
+	case SARA_R5_AT_RESULT_CONNECT:
+		return SARA_R5_ERROR_SUCCESS;
+	case SARA_R5_AT_RESULT_NONE:
+		return SARA_R5_ERROR_NO_RESPONSE;
+	default:
+		return SARA_R5_ERROR_ERROR;
+	}
+}
+
+// What saraR5QueueFinish keeps of a finished command once its slot is free
+typedef struct
+{
+	char *response;
+	size_t responseSize;
+	SARA_R5_command_callback callback;
+	void *context;
+} SARA_R5_finished_command;
+
+/**
+ * Removes the commands sent on the line in progress from the queue, then reports their result.
+ * The first one gets the raw answer, the others an empty response.
+ */
+static void saraR5QueueFinish(void)
+{
+	SARA_R5_finished_command finished[SARA_R5_COMMAND_QUEUE_SIZE];
+	size_t count = (saraR5QueueChained > 0) ? saraR5QueueChained : 1;
+	SARA_R5_at_result_t result = saraR5Tokenizer.result;
+	uint8_t error = saraR5ResultError(result);
+
+	// The slots are free before the callbacks run, so they can submit the next commands
+	for (size_t i = 0; i < count; i++)
+	{
+		finished[i].response = saraR5Queue[saraR5QueueHead].response;
+		finished[i].responseSize = saraR5Queue[saraR5QueueHead].responseSize;
+		finished[i].callback = saraR5Queue[saraR5QueueHead].callback;
+		finished[i].context = saraR5Queue[saraR5QueueHead].context;
+		saraR5FreeChar(saraR5Queue[saraR5QueueHead].overflow, saraR5Queue[saraR5QueueHead].copy.len);
+		saraR5QueueHead = (saraR5QueueHead + 1) % SARA_R5_COMMAND_QUEUE_SIZE;
+		saraR5QueueCount--;
+	}
+	saraR5QueueActive = false;
+	saraR5QueueChained = 0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const char *response = (finished[i].responseSize > 0) ? finished[i].response : NULL;
+
+		if (finished[i].callback != NULL)
+		{
+			finished[i].callback(error, result, saraR5Tokenizer.errorCode, response, finished[i].context);
+		}
+	}
+}
+
+/**
+ * Checks that a command looks like "AT...\r", so it can be cut into a chained line.
+ */
+static bool saraR5ChainFits(const SARA_R5_command *command)
+{
+	const SARA_R5_segment *first;
+	const SARA_R5_segment *last;
+
+	if (!command->chainable || command->count == 0)
+	{
+		return false;
+	}
+	first = &command->segments[0];
+	last = &command->segments[command->count - 1];
+	return first->len >= 2 && last->len >= 1 &&
+		   memcmp(first->data, "AT", 2) == 0 && ((const char *)last->data)[last->len - 1] == '\r';
+}
+
+/**
+ * Joins the chainable commands at the head of the queue into one "AT<cmd1>;<cmd2>...\r" line.
+ * Stops at the first command that cannot be chained or would make the line too long.
+ * @param length Where to store the number of bytes of the line.
+ * @return The number of commands on the line, 1 when the head command is sent alone.
+ */
+static size_t saraR5ChainBuild(size_t *length)
+{
+	static const char separator = ';';
+	size_t segmentCount = 1;
+	size_t members = 0;
+
+	*length = 2;
+	saraR5ChainSegments[0].data = "AT";
+	saraR5ChainSegments[0].len = 2;
+
+	while (members < saraR5QueueCount)
+	{
+		const SARA_R5_command *command = &saraR5Queue[(saraR5QueueHead + members) % SARA_R5_COMMAND_QUEUE_SIZE];
+		size_t needed = 0;
+
+		if (!saraR5ChainFits(command) || segmentCount + command->count + 1 > SARA_R5_CHAIN_MAX_SEGMENTS)
+		{
+			break;
+		}
+		for (size_t i = 0; i < command->count; i++)
+		{
+			needed += command->segments[i].len;
+		}
+		needed -= 2; // Without its "AT", its '\r' becomes the ';' or '\r' closing it
+		if (*length + needed > SARA_R5_CHAIN_LINE_SIZE)
+		{
+			break;
+		}
+
+		if (members > 0)
+		{
+			saraR5ChainSegments[segmentCount - 1].data = &separator; // Replaces the '\r' closing the previous one
+		}
+		for (size_t i = 0; i < command->count; i++)
+		{
+			SARA_R5_segment piece = command->segments[i];
+
+			if (i == 0)
+			{
+				piece.data = (const char *)piece.data + 2;
+				piece.len -= 2;
+			}
+			if (i == command->count - 1)
+			{
+				piece.len--;
+			}
+			saraR5ChainSegments[segmentCount++] = piece;
+		}
+		saraR5ChainSegments[segmentCount].data = "\r";
+		saraR5ChainSegments[segmentCount].len = 1;
+		segmentCount++;
+		*length += needed;
+		members++;
+	}
+
+	if (members < 2)
+	{
+		return 1;
+	}
+	return members;
+}
+
+/**
+ * Sends the command at the head of the queue, chained with the next ones when they allow it.
+ * @return true if the line was sent, false otherwise.
+ */
+static bool saraR5QueueSend(void)
+{
+	SARA_R5_command *command = &saraR5Queue[saraR5QueueHead];
+	size_t length;
+
+	saraR5QueueChained = saraR5ChainBuild(&length);
+	if (saraR5QueueChained == 1)
+	{
+		saraR5QueueTimeout = command->timeout;
+		return saraR5SendSegments(command->segments, command->count);
+	}
+
+	// The members answer one after the other, allow each its own time
+	saraR5QueueTimeout = 0;
+	for (size_t i = 0; i < saraR5QueueChained; i++)
+	{
+		saraR5QueueTimeout += saraR5Queue[(saraR5QueueHead + i) % SARA_R5_COMMAND_QUEUE_SIZE].timeout;
+	}
+
+	size_t segmentCount = 1;
+	for (size_t i = 0; i < saraR5QueueChained; i++)
+	{
+		segmentCount += saraR5Queue[(saraR5QueueHead + i) % SARA_R5_COMMAND_QUEUE_SIZE].count + 1;
+	}
+	return saraR5SendSegments(saraR5ChainSegments, segmentCount);
+}
+
+/**
+ * Handles an ERROR to a chained line: the module stopped at the failing command without saying which one,
+ * so every member is sent again on its own line.
+ * @return true if the members will be sent again, false if the failure must be reported.
+ */
+static bool saraR5QueueReplayChain(void)
+{
+	if (saraR5QueueChained < 2 || saraR5Tokenizer.result == SARA_R5_AT_RESULT_OK || saraR5Tokenizer.result == SARA_R5_AT_RESULT_NONE)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < saraR5QueueChained; i++)
+	{
+		saraR5Queue[(saraR5QueueHead + i) % SARA_R5_COMMAND_QUEUE_SIZE].chainable = false;
+	}
+	saraR5QueueActive = false;
+	saraR5QueueChained = 0;
+	return true;
+}
+
+/**
+ * Queues a command to be sent by saraR5Poll. Returns at once: 'callback' reports the result.
+ * The segments are copied, so they may point to local variables.
+ * @param segments The pieces of the command, in order.
+ * @param count The number of segments.
+ * @param buffer Where to store the raw answer (may be NULL). It must live until the callback.
+ * @param size The size of the buffer in bytes.
+ * @param timeout The time allowed for the final result code in milliseconds, counted from the moment the command is sent.
+ * @param chainable true if the command may be sent on one ';' chained line with the chainable commands queued next to it.
+ *                  Only for settings that can safely be sent twice: when the line fails, every member is sent again alone.
+ * @param callback Function called once the command is over (may be NULL).
+ * @param context Pointer passed back to the callback.
+ * @return SARA_R5_ERROR_SUCCESS if the command is queued, SARA_R5_ERROR_OUT_OF_MEMORY if the queue is full,
+ *         or SARA_R5_ERROR_UNEXPECTED_PARAM if the command is longer than SARA_R5_COMMAND_LINE_SIZE with SARA_R5_NO_HEAP
+ *         (longer commands are otherwise copied to the heap).
+ */
+uint8_t saraR5SubmitCommand(const SARA_R5_segment *segments, size_t count, const char *buffer, size_t size, unsigned long timeout, bool chainable, SARA_R5_command_callback callback, void *context)
+{
+	return saraR5QueuePush(segments, count, true, buffer, size, timeout, chainable, callback, context);
+}
+
+/**
+ * Gives a response handler to the command just queued.
+ */
+static void saraR5QueueSetHandler(SARA_R5_response_handler handler, void *handlerContext)
+{
+	SARA_R5_command *command = &saraR5Queue[(saraR5QueueHead + saraR5QueueCount - 1) % SARA_R5_COMMAND_QUEUE_SIZE];
+
+	command->handler = handler;
+	command->handlerContext = handlerContext;
+}
+
+/**
+ * Gives the command just queued the data to send after its '@' prompt. It is not copied.
+ */
+static void saraR5QueueSetPayload(const uint8_t *data, size_t len)
+{
+	SARA_R5_command *command = &saraR5Queue[(saraR5QueueHead + saraR5QueueCount - 1) % SARA_R5_COMMAND_QUEUE_SIZE];
+
+	command->payload.data = (const char *)data;
+	command->payload.len = len;
+}
+
+/**
+ * Queues a command whose answer is handed to 'handler' line by line as it arrives, instead of being stored.
+ * Meant for answers of any length (e.g. AT+COPS=?): a line longer than the tokenizer line buffer comes in
+ * several pieces, so no buffer needs to hold the whole answer. The command is never chained.
+ * @param segments The pieces of the command, in order. They are copied.
+ * @param count The number of segments.
+ * @param timeout The time allowed for the final result code in milliseconds, counted from the moment the command is sent.
+ * @param handler Function receiving the answer (URCs and the final result code excluded).
+ * @param handlerContext Pointer passed back to the handler.
+ * @param callback Function called once the command is over (may be NULL). Its response is NULL.
+ * @param context Pointer passed back to the callback.
+ * @return SARA_R5_ERROR_SUCCESS if the command is queued, SARA_R5_ERROR_OUT_OF_MEMORY if the queue is full,
+ *         or SARA_R5_ERROR_UNEXPECTED_PARAM if the command is longer than SARA_R5_COMMAND_LINE_SIZE with SARA_R5_NO_HEAP
+ *         (longer commands are otherwise copied to the heap).
+ */
+uint8_t saraR5SubmitCommandStreamed(const SARA_R5_segment *segments, size_t count, unsigned long timeout, SARA_R5_response_handler handler, void *handlerContext, SARA_R5_command_callback callback, void *context)
+{
+	uint8_t error = saraR5QueuePush(segments, count, true, NULL, 0, timeout, false, callback, context);
+
+	if (error == SARA_R5_ERROR_SUCCESS)
+	{
+		saraR5QueueSetHandler(handler, handlerContext);
+	}
+	return error;
+}
+
+/**
+ * Queues a command the module answers with the '@' prompt (e.g. AT+USOWR=<socket>,<length>): saraR5Poll sends
+ * 'data' as it is, SARA_R5_PROMPT_DELAY after the prompt, then waits for the final result code.
+ * The data may hold any byte. The command is never chained.
+ * @param segments The pieces of the command, in order. They are copied.
+ * @param count The number of segments.
+ * @param data The bytes sent after the prompt. They are not copied: they must live until the callback.
+ * @param len The number of bytes, as announced in the command.
+ * @param buffer Where to store the raw answer (may be NULL). It must live until the callback.
+ * @param size The size of the buffer in bytes.
+ * @param timeout The time allowed for the final result code in milliseconds, counted from the moment the command is sent.
+ * @param callback Function called once the command is over (may be NULL).
+ * @param context Pointer passed back to the callback.
+ * @return SARA_R5_ERROR_SUCCESS if the command is queued, SARA_R5_ERROR_OUT_OF_MEMORY if the queue is full,
+ *         or SARA_R5_ERROR_UNEXPECTED_PARAM if 'data' is empty or the command is longer than SARA_R5_COMMAND_LINE_SIZE with
+ *         SARA_R5_NO_HEAP (longer commands are otherwise copied to the heap).
+ */
+uint8_t saraR5SubmitCommandWithData(const SARA_R5_segment *segments, size_t count, const uint8_t *data, size_t len, const char *buffer, size_t size, unsigned long timeout, SARA_R5_command_callback callback, void *context)
+{
+	uint8_t error;
+
+	if (data == NULL || len == 0)
+	{
+		return SARA_R5_ERROR_UNEXPECTED_PARAM; // The module would wait for the data forever
+	}
+	error = saraR5QueuePush(segments, count, true, buffer, size, timeout, false, callback, context);
+	if (error == SARA_R5_ERROR_SUCCESS)
+	{
+		saraR5QueueSetPayload(data, len);
+	}
+	return error;
+}
+
+/**
+ * Handles the '@' prompt of the command in progress: sends its data once SARA_R5_PROMPT_DELAY has passed,
+ * then lets the tokenizer follow the rest of the answer.
+ * @return true once the data is sent, false while the delay runs or if the data could not be sent.
+ */
+static bool saraR5QueuePromptStep(SARA_R5_command *command)
+{
+	if (!saraR5QueuePrompted)
+	{
+		saraR5QueuePrompted = true;
+		saraR5QueuePromptTime = saraR5NowMs();
+	}
+	if ((saraR5NowMs() - saraR5QueuePromptTime) < SARA_R5_PROMPT_DELAY)
+	{
+		return false; // The module drops the data sent too early
+	}
+
+	saraR5QueuePrompted = false;
+	saraR5AtTokenizerReset(&saraR5Tokenizer);
+	saraR5QueueStart = saraR5NowMs(); // The final result code comes once the data is in
+	return saraR5SendSegments(&command->payload, 1);
+}
+
+/**
+ * Completion of the AT+USOST of a queued datagram: counts it and frees its slot.
+ */
+static void saraR5UdpQueueSent(uint8_t error, SARA_R5_at_result_t result, int errorCode, const char *response, void *context)
+{
+	SARA_R5_udp_datagram *datagram = (SARA_R5_udp_datagram *)context;
+
+	(void)result;
+	(void)errorCode;
+	(void)response;
+	if (error == SARA_R5_ERROR_SUCCESS)
+	{
+		saraR5UdpQueueStats.datagrams++;
+		saraR5UdpQueueStats.recordsSent += datagram->records;
+		saraR5UdpQueueStats.bytes += datagram->length;
+	}
+	else
+	{
+		saraR5UdpQueueStats.failures++;
+	}
+	datagram->used = false;
+	datagram->sending = false;
+}
+
+/**
+ * Queues the AT+USOST of every datagram of the UDP send queue that is due, oldest first: closed (full, or not
+ * coalescing), or waiting for more records for longer than the latency budget. They go back to back through
+ * the command queue, without waiting for the application. Called by saraR5Poll.
+ */
+static void saraR5UdpQueueService(void)
+{
+	uint32_t now = saraR5NowMs();
+
+	for (;;)
+	{
+		SARA_R5_udp_datagram *oldest = NULL;
+
+		for (size_t i = 0; i < SARA_R5_UDP_QUEUE_DATAGRAMS; i++)
+		{
+			SARA_R5_udp_datagram *datagram = &saraR5UdpQueue[i];
+
+			if (!datagram->used || datagram->sending || (!datagram->closed && (now - datagram->firstTime) < saraR5UdpQueueLatency))
+			{
+				continue;
+			}
+			if (oldest == NULL || (now - datagram->firstTime) > (now - oldest->firstTime))
+			{
+				oldest = datagram;
+			}
+		}
+		if (oldest == NULL)
+		{
+			return;
+		}
+
+		char socketDigits[SARA_R5_SEGMENT_INT_SIZE];
+		char *addressQuoted;
+		size_t addressQuotedSize;
+		char portDigits[SARA_R5_SEGMENT_INT_SIZE];
+		char lengthDigits[SARA_R5_SEGMENT_INT_SIZE];
+		SARA_R5_segment address = saraR5SegmentQuotedAlloc(&addressQuoted, &addressQuotedSize, oldest->address, strlen(oldest->address));
+
+		if (address.data == NULL)
+		{
+			return; // No memory for the escaped address, the datagram goes at a next saraR5Poll
+		}
+		SARA_R5_segment command[] = {
+			SARA_R5_SEGMENT_LITERAL(SARA_R5_WRITE_UDP_SOCKET "="),
+			saraR5SegmentInt(socketDigits, oldest->socket),
+			SARA_R5_SEGMENT_LITERAL(",\""),
+			address,
+			SARA_R5_SEGMENT_LITERAL("\","),
+			saraR5SegmentUint(portDigits, oldest->port),
+			SARA_R5_SEGMENT_LITERAL(","),
+			saraR5SegmentUint(lengthDigits, (unsigned long)oldest->length),
+			SARA_R5_SEGMENT_LITERAL("\r"),
+		};
+		uint8_t error = saraR5SubmitCommandWithData(command, SARA_R5_SEGMENT_COUNT(command), oldest->data, oldest->length, NULL, 0,
+													SARA_R5_SOCKET_WRITE_TIMEOUT, saraR5UdpQueueSent, oldest);
+
+		saraR5FreeChar(addressQuoted, addressQuotedSize); // The queue holds a copy of the command
+		if (error == SARA_R5_ERROR_OUT_OF_MEMORY)
+		{
+			return; // The command queue is full, the datagram goes at a next saraR5Poll
+		}
+		if (error != SARA_R5_ERROR_SUCCESS)
+		{
+			saraR5UdpQueueSent(error, SARA_R5_AT_RESULT_NONE, -1, NULL, oldest);
+			continue;
+		}
+		oldest->closed = true;
+		oldest->sending = true;
+	}
+}
+
+/**
+ * Advances the command queue without blocking: sends the next command, collects the bytes of its answer
+ * and calls the completion callbacks. Chainable commands queued one after the other share a single line.
+ * Between commands, the URCs received are handed to their handler (see saraR5SetUrcHandler).
+ * Call it from the main loop (or after a UART reception event).
+ * @return true while commands are waiting or in progress, false once the queue is empty.
+ */
+bool saraR5Poll(void)
+{
+	if (saraR5DirectLinkActive)
+	{
+		return saraR5QueueCount > 0; // Everything received is socket data
+	}
+	if (!saraR5QueueActive)
+	{
+		saraR5UrcProcess();
+	}
+	saraR5SocketRxService();
+	saraR5UdpQueueService();
+
+	while (saraR5QueueCount > 0 && !saraR5DirectLinkActive)
+	{
+		SARA_R5_command *command = &saraR5Queue[saraR5QueueHead];
+
+		if (!saraR5QueueActive)
+		{
+			if (saraR5QueueHold)
+			{
+				break; // The batch is still being built
+			}
+
+			// Read what came before, so only the answer to this command is matched.
+			// A URC still arriving is finished by the command tokenizer.
+			saraR5UrcProcess();
+			saraR5AtTokenizerReset(&saraR5Tokenizer);
+			memcpy(saraR5Tokenizer.line, saraR5UrcTokenizer.line, saraR5UrcTokenizer.lineLength + 1);
+			saraR5Tokenizer.lineLength = saraR5UrcTokenizer.lineLength;
+			saraR5AtTokenizerReset(&saraR5UrcTokenizer);
+			saraR5ResponsePrefixSet(command->segments, command->count);
+			saraR5QueueStored = 0;
+			for (size_t i = 0; i < saraR5QueueCount; i++)
+			{
+				SARA_R5_command *queued = &saraR5Queue[(saraR5QueueHead + i) % SARA_R5_COMMAND_QUEUE_SIZE];
+
+				if (queued->response != NULL && queued->responseSize > 0)
+				{
+					queued->response[0] = '\0';
+				}
+			}
+			saraR5QueueActive = true;
+			saraR5QueueAborted = false;
+			saraR5QueuePrompted = false;
+			saraR5QueueStart = saraR5NowMs();
+			if (command->payload.len > 0)
+			{
+				saraR5AtTokenizerExpectPrompt(&saraR5Tokenizer);
+			}
+			if (!saraR5QueueSend())
+			{
+				saraR5QueueFinish(); // Nothing will answer
+				continue;
+			}
+		}
+
+		while (!saraR5AtTokenizerDone(&saraR5Tokenizer) && saraR5ResponseStep(command->response, command->responseSize, &saraR5QueueStored, command->handler, command->handlerContext))
+		{
+		}
+
+		if (saraR5Tokenizer.result == SARA_R5_AT_RESULT_PROMPT)
+		{
+			if (saraR5QueuePromptStep(command))
+			{
+				continue; // Wait for the final result code
+			}
+			if (saraR5QueuePrompted)
+			{
+				break; // The prompt delay still runs
+			}
+			saraR5Tokenizer.result = SARA_R5_AT_RESULT_NONE; // The data could not be sent
+			saraR5QueueFinish();
+			continue;
+		}
+
+		if (!saraR5AtTokenizerDone(&saraR5Tokenizer) && (saraR5NowMs() - saraR5QueueStart) < saraR5QueueTimeout)
+		{
+			break; // Still waiting for the answer
+		}
+		if (!saraR5QueueReplayChain())
+		{
+			saraR5QueueFinish();
+		}
+	}
+	return saraR5QueueCount > 0;
+}
+
+/**
+ * Gets the number of commands waiting in the queue or in progress.
+ * @return The number of commands not finished yet.
+ */
+size_t saraR5PendingCommands(void)
+{
+	return saraR5QueueCount;
+}
+
+/**
+ * Aborts the command in progress by sending it one character, e.g. to end an AT+COPS=? scan early.
+ * Only abortable commands stop, they end with the ABORTED result code (SARA_R5_ERROR_ERROR); the others ignore it.
+ * May be called from a response handler or a URC handler.
+ * @return true if the abort was sent, false if no command is waiting for its answer or it was already aborted.
+ */
+bool saraR5AbortCommand(void)
+{
+	if (!saraR5QueueActive || saraR5QueueAborted || saraR5AtTokenizerDone(&saraR5Tokenizer))
+	{
+		return false;
+	}
+	saraR5QueueAborted = true;
+	return saraR5SendDataUART((const uint8_t *)SARA_R5_COMMAND_ABORT, strlen(SARA_R5_COMMAND_ABORT));
+}
+
+/**
+ * Sets the function called for every unsolicited result code with a given prefix, e.g. "+UUSORD".
+ * URCs are taken out of the command answers and handed over by saraR5Poll or while a command runs.
+ * The handler must not call blocking functions, it may queue commands with the ...Async functions.
+ * @param prefix The URC name, without the ':'.
+ * @param handler Function receiving the URC split into fields, or NULL to drop these URCs.
+ * @param context Pointer passed back to the handler.
+ * @return true if the handler is set, false if the prefix is longer than SARA_R5_URC_PREFIX_SIZE - 1 or the table is full.
+ */
+bool saraR5SetUrcHandler(const char *prefix, SARA_R5_urc_handler handler, void *context)
+{
+	saraR5UrcSetup();
+	return saraR5UrcRegister(&saraR5Urcs, prefix, handler, context);
+}
+
+/**
+ * Completion callback that copies the outcome of a command into a SARA_R5_command_result.
+ * Used by the blocking functions, and handy to collect the per command results of a batch.
+ * @param error The error of the command.
+ * @param result Its final result code.
+ * @param errorCode Its +CME/+CMS ERROR value.
+ * @param response Its raw answer (unused).
+ * @param context The SARA_R5_command_result to fill.
+ */
+void saraR5StoreResult(uint8_t error, SARA_R5_at_result_t result, int errorCode, const char *response, void *context)
+{
+	SARA_R5_command_result *store = (SARA_R5_command_result *)context;
+
+	(void)response;
+	store->error = error;
+	store->result = result;
+	store->errorCode = errorCode;
+	store->done = true;
+}
+
+/**
+ * Holds the queue: the commands submitted from now on wait until saraR5BatchEnd or saraR5BatchRun,
+ * so the chainable ones can be sent on the same line. A blocking call also ends the batch.
+ */
+void saraR5BatchBegin(void)
+{
+	saraR5QueueHold = true;
+}
+
+/**
+ * Releases the commands held since saraR5BatchBegin. They are sent by the next saraR5Poll calls.
+ */
+void saraR5BatchEnd(void)
+{
+	saraR5QueueHold = false;
+}
+
+/**
+ * Sleeps until new bytes arrive or the command in progress times out.
+ */
+static void saraR5QueueSleep(void)
+{
+	uint32_t elapsed = saraR5NowMs() - saraR5QueueStart;
+
+	if (saraR5QueuePrompted)
+	{
+		// The answer only comes once the data is sent, but a URC may: keep it in the ring so the wait really sleeps
+		saraR5RxPump();
+		elapsed = saraR5NowMs() - saraR5QueuePromptTime;
+		saraR5RxWait((elapsed < SARA_R5_PROMPT_DELAY) ? (uint32_t)(SARA_R5_PROMPT_DELAY - elapsed) : 0);
+		return;
+	}
+
+	saraR5RxWait((elapsed < saraR5QueueTimeout) ? (uint32_t)(saraR5QueueTimeout - elapsed) : 0);
+}
+
+/**
+ * Releases the commands held since saraR5BatchBegin and runs the queue until every command is over.
+ * The results reach the callbacks given at submission (e.g. saraR5StoreResult).
+ */
+void saraR5BatchRun(void)
+{
+	saraR5QueueHold = false;
+	while (saraR5Poll())
+	{
+		saraR5QueueSleep();
+	}
+}
+
+/**
+ * Runs the queue until there is room for one more command.
+ */
+static void saraR5QueueMakeRoom(void)
+{
+	saraR5QueueHold = false;
+	while (saraR5QueueCount == SARA_R5_COMMAND_QUEUE_SIZE && !saraR5DirectLinkActive)
+	{
+		if (saraR5Poll())
+		{
+			saraR5QueueSleep();
+		}
+	}
+}
+
+/**
+ * Runs the queue until the command tracked by 'wait' is over. Commands queued before it are completed first.
+ * @return The error reported to the command callback.
+ */
+static uint8_t saraR5CommandWait(SARA_R5_command_result *wait)
+{
+	saraR5QueueHold = false;
+	while (!wait->done)
+	{
+		if (saraR5Poll() && !wait->done)
+		{
+			saraR5QueueSleep();
+		}
+	}
+	return wait->error;
+}
+
+/**
+ * Runs an asynchronous command function to completion. 'submitted' is what the function returned.
+ * @return The error reported to the command callback, or the submission error.
+ */
+static uint8_t saraR5CommandWaitSubmitted(uint8_t submitted, SARA_R5_command_result *wait)
+{
+	if (submitted != SARA_R5_ERROR_SUCCESS)
+	{
+		return submitted;
+	}
+	return saraR5CommandWait(wait);
+}
+
+/**
+ * Queues a command without copying it, then runs the queue until it is over.
+ * 'payload' (may be NULL) is sent after the '@' prompt of the command.
+ * @return The error reported to the command callback.
+ */
+static uint8_t saraR5RunCommand(const SARA_R5_segment *segments, size_t count, const SARA_R5_segment *payload, const char *buffer, size_t size, unsigned long timeout, SARA_R5_response_handler handler, void *handlerContext)
+{
+	SARA_R5_command_result wait = {false, SARA_R5_ERROR_NO_RESPONSE, SARA_R5_AT_RESULT_NONE, -1};
+	uint8_t error;
+
+	// The segments may live on the caller's stack, the call does not return before the command is over
+	saraR5QueueMakeRoom();
+	error = saraR5QueuePush(segments, count, false, buffer, size, timeout, false, saraR5StoreResult, &wait);
+	if (error == SARA_R5_ERROR_SUCCESS)
+	{
+		saraR5QueueSetHandler(handler, handlerContext);
+		if (payload != NULL)
+		{
+			saraR5QueueSetPayload((const uint8_t *)payload->data, payload->len);
+		}
+	}
+	return saraR5CommandWaitSubmitted(error, &wait);
+}
+
+/**
+ * Sends a command and hands its answer to 'handler' line by line as it arrives, so an answer of any length
+ * can be parsed without a buffer holding all of it. See saraR5SubmitCommandStreamed.
+ * @param segments The pieces of the command, in order.
+ * @param count The number of segments.
+ * @param timeout The timeout in milliseconds for the final result code.
+ * @param handler Function receiving the answer (URCs and the final result code excluded).
+ * @param handlerContext Pointer passed back to the handler.
+ * @return SARA_R5_ERROR_SUCCESS on OK, SARA_R5_ERROR_ERROR on an error result code (see saraR5GetLastResult),
+ *         SARA_R5_ERROR_NO_RESPONSE on timeout.
+ */
+uint8_t saraR5SendSegmentsStreamed(const SARA_R5_segment *segments, size_t count, unsigned long timeout, SARA_R5_response_handler handler, void *handlerContext)
+{
+	return saraR5RunCommand(segments, count, NULL, NULL, 0, timeout, handler, handlerContext);
+}
+
+/**
+ * Gets the final result code of the last command.
+ * @param errorCode Where to store the +CME/+CMS ERROR value (-1 if none). May be NULL.
+ * @return The final result code, or SARA_R5_AT_RESULT_NONE if the last command timed out.
+ */
+SARA_R5_at_result_t saraR5GetLastResult(int *errorCode)
+{
+	if (errorCode != NULL)
+	{
+		*errorCode = saraR5Tokenizer.errorCode;
+	}
+	return saraR5Tokenizer.result;
+}
+
+/**
+ * Sends a command and waits for a specific response using the saraR5SendCommand and saraR5ReceiveResponse functions.
+ * @param command Pointer to a string containing the command to be sent.
+ * @param expectedResponse Pointer to a string containing the expected response to check for in the received data.
+ * @param buffer Pointer to a buffer where the received data will be stored.
+ * @param size The size of the buffer in bytes.
+ * @param timeout The timeout in milliseconds for receiving the response.
+ * @return true if the function gets the right response in time, false if it does not.
+ */
+bool saraR5SendCommandWithResponse(const char *command, const char *expectedResponse, const char *buffer, size_t size, unsigned long timeout)
+{
+	SARA_R5_segment segment = saraR5SegmentString(command);
+
+	return saraR5SendSegmentsWithResponse(&segment, 1, expectedResponse, buffer, size, timeout);
+}
+
+/**
+ * Sends a command given as a list of segments and waits for a specific response.
+ * @param segments The pieces of the command, in order.
+ * @param count The number of segments.
+ * @param expectedResponse Pointer to a string containing the expected response to check for in the received data.
+ * @param buffer Pointer to a buffer where the received data will be stored.
+ * @param size The size of the buffer in bytes.
+ * @param timeout The timeout in milliseconds for receiving the response.
+ * @return true if the function gets the right response in time, false if it does not.
+ */
+bool saraR5SendSegmentsWithResponse(const SARA_R5_segment *segments, size_t count, const char *expectedResponse, const char *buffer, size_t size, unsigned long timeout)
+{
+	// Run the command through the queue and wait for its final result code
+	uint8_t error = saraR5RunCommand(segments, count, NULL, buffer, size, timeout, NULL, NULL);
+
+	// "OK" is judged on the result code, the buffer may be too small to hold the whole answer
+	if (strcmp(expectedResponse, SARA_RESPONSE_OK) == 0)
+	{
+		return error == SARA_R5_ERROR_SUCCESS;
+	}
+
+	// See if the expected response is in the buffer
+	if (buffer != NULL && strstr(buffer, expectedResponse) != NULL)
+	{
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
+
+/**
+ * Waits for 'ms' milliseconds on the clock of the transport, dropping what is received meanwhile.
+ */
+static void saraR5Delay(uint32_t ms)
+{
+	uint32_t start = saraR5NowMs();
+	uint32_t elapsed = 0;
+
+	while (elapsed < ms)
+	{
+		saraR5RxFlush();
+		saraR5RxWait(ms - elapsed);
+		elapsed = saraR5NowMs() - start;
+	}
+}
+
+/**
+ * Checks that the module answers OK to AT at the current rate.
+ */
+static bool saraR5ProbeAT(void)
+{
+	for (uint8_t attempt = 0; attempt < SARA_R5_BAUD_PROBE_ATTEMPTS; attempt++)
+	{
+		saraR5RxFlush();
+		if (saraR5SendCommand((const uint8_t *)SARA_R5_COMMAND_AT) &&
+			saraR5ReceiveResponse(NULL, 0, SARA_R5_BAUD_PROBE_TIMEOUT) &&
+			saraR5Tokenizer.result == SARA_R5_AT_RESULT_OK)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Reconfigures the local side of the link and drops what was received at the old rate.
+ */
+static bool saraR5SetLocalBaudRate(uint32_t baud, bool rtsCts)
+{
+	SARA_R5_transport *transport = saraR5GetTransport();
+
+	if (transport == NULL || transport->setBaudRate == NULL)
+	{
+		return false;
+	}
+	if (!transport->setBaudRate(transport->context, baud, rtsCts))
+	{
+		return false;
+	}
+	saraR5RxFlush();
+	return true;
+}
+
+/**
+ * Sends AT+IPR. When 'checkAnswer' is set, waits for the OK that the module sends at the old rate.
+ */
+static bool saraR5SendBaudRate(uint32_t baud, bool checkAnswer)
+{
+	char digits[SARA_R5_SEGMENT_INT_SIZE];
+	// e.g. "AT+IPR=921600"
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_BAUD_RATE "="),
+		saraR5SegmentInt(digits, (long)baud),
+		SARA_R5_SEGMENT_LITERAL("\r"),
+	};
+
+	if (checkAnswer)
+	{
+		return saraR5SendSegmentsWithResponse(command, SARA_R5_SEGMENT_COUNT(command), SARA_RESPONSE_OK, NULL, 0, SARA_R5_STANDARD_RESPONSE_TIMEOUT);
+	}
+	return saraR5SendSegments(command, SARA_R5_SEGMENT_COUNT(command));
+}
+
+/**
+ * Moves the link to the fastest rate both sides can use, with RTS/CTS hardware flow control.
+ * A rate kept in 'store' is tried first, so a module already configured skips the ladder. Otherwise the
+ * module is reached at SARA_R5_DEFAULT_BAUD_RATE, switched to RTS/CTS with AT+IFC, then moved up with AT+IPR
+ * through 'rates'. Each rate is checked with AT probes; when they fail the module is sent back to the
+ * previous rate. The rate in use is stored in the module profile (AT&W) and handed to 'store'.
+ * The RTS/CTS pins of the UART must be wired and configured (e.g. in CubeMX).
+ * @param rates The rates to try, fastest first (e.g. SARA_R5_BAUD_LADDER).
+ * @param count The number of rates.
+ * @param store Where the selected rate is kept across reboots. May be NULL.
+ * @param selected Where to store the rate in use. May be NULL.
+ * @return SARA_R5_ERROR_SUCCESS if the module answers at the selected rate, or an error code otherwise.
+ */
+uint8_t saraR5NegotiateBaudRate(const uint32_t *rates, size_t count, const SARA_R5_baud_store *store, uint32_t *selected)
+{
+	SARA_R5_transport *transport = saraR5GetTransport();
+	uint32_t current = SARA_R5_DEFAULT_BAUD_RATE;
+	uint32_t stored;
+
+	if (transport == NULL)
+	{
+		return SARA_R5_ERROR_NO_RESPONSE;
+	}
+
+	// Links without a speed (e.g. loopback) only need to answer
+	if (transport->setBaudRate == NULL)
+	{
+		if (!saraR5ProbeAT())
+		{
+			return SARA_R5_ERROR_NO_RESPONSE;
+		}
+		if (selected != NULL)
+		{
+			*selected = current;
+		}
+		return SARA_R5_ERROR_SUCCESS;
+	}
+
+	// The module keeps the rate of the last negotiation in its profile
+	if (store != NULL && store->load != NULL && store->load(&stored, store->context))
+	{
+		if (saraR5SetLocalBaudRate(stored, true) && saraR5ProbeAT())
+		{
+			if (selected != NULL)
+			{
+				*selected = stored;
+			}
+			return SARA_R5_ERROR_SUCCESS;
+		}
+	}
+
+	// Reach the module at its power on settings
+	if (!saraR5SetLocalBaudRate(current, false) || !saraR5ProbeAT())
+	{
+		return SARA_R5_ERROR_NO_RESPONSE;
+	}
+
+	// Without flow control on both sides the higher rates overrun, stay at the default one
+	if (saraR5SendCommandWithResponse(SARA_R5_FLOW_CONTROL, SARA_RESPONSE_OK, NULL, 0, SARA_R5_STANDARD_RESPONSE_TIMEOUT) &&
+		saraR5SetLocalBaudRate(current, true))
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			if (rates[i] <= current || !saraR5SendBaudRate(rates[i], true))
+			{
+				continue; // Not faster, or refused by the module
+			}
+
+			// The module answers at the old rate, then switches
+			saraR5Delay(SARA_R5_BAUD_SWITCH_DELAY);
+			if (saraR5SetLocalBaudRate(rates[i], true) && saraR5ProbeAT())
+			{
+				current = rates[i];
+				break;
+			}
+
+			// The new rate does not get through: send the module back, the request may still be understood
+			saraR5SendBaudRate(current, false);
+			saraR5Delay(SARA_R5_BAUD_SWITCH_DELAY);
+			if (!saraR5SetLocalBaudRate(current, true) || !saraR5ProbeAT())
+			{
+				return SARA_R5_ERROR_NO_RESPONSE;
+			}
+		}
+	}
+	else
+	{
+		saraR5SetLocalBaudRate(current, false);
+	}
+
+	// Keep the rate for the next boot
+	saraR5SendCommandWithResponse(SARA_R5_STORE_PROFILE, SARA_RESPONSE_OK, NULL, 0, SARA_R5_STANDARD_RESPONSE_TIMEOUT);
+	if (store != NULL && store->save != NULL)
+	{
+		store->save(current, store->context);
+	}
+	if (selected != NULL)
+	{
+		*selected = current;
+	}
+	return SARA_R5_ERROR_SUCCESS;
+}
+
+/**
+ * Switches the link to CMUX (3GPP TS 27.010) so several channels share the serial line. The library
+ * keeps running its commands on DLCI 1 and receives the URCs there; DLCI 2 to SARA_R5_CMUX_CHANNELS are
+ * free for other traffic (e.g. a second AT session or socket data) through saraR5CmuxChannel.
+ * Nothing else may use the serial link while the multiplexer runs.
+ * @param mux Storage for the multiplexer state. Must live until saraR5StopCmux.
+ * @return SARA_R5_ERROR_SUCCESS if every channel is open, or an error code otherwise.
+ */
+uint8_t saraR5StartCmux(SARA_R5_cmux *mux)
+{
+	SARA_R5_transport *physical = saraR5GetTransport();
+	char digits[SARA_R5_SEGMENT_INT_SIZE];
+	// Basic option, UIH frames, default rate, N1 frame size: "AT+CMUX=0,0,,127"
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_CMUX "=0,0,,"),
+		saraR5SegmentInt(digits, SARA_R5_CMUX_FRAME_SIZE),
+		SARA_R5_SEGMENT_LITERAL("\r"),
+	};
+
+	if (physical == NULL)
+	{
+		return SARA_R5_ERROR_NO_RESPONSE;
+	}
+	if (!saraR5SendSegmentsWithResponse(command, SARA_R5_SEGMENT_COUNT(command), SARA_RESPONSE_OK, NULL, 0, SARA_R5_STANDARD_RESPONSE_TIMEOUT))
+	{
+		return SARA_R5_ERROR_ERROR;
+	}
+
+	saraR5CmuxInit(mux, physical);
+	for (uint8_t dlci = 0; dlci <= SARA_R5_CMUX_CHANNELS; dlci++)
+	{
+		if (!saraR5CmuxOpen(mux, dlci))
+		{
+			saraR5CmuxClose(mux);
+			return SARA_R5_ERROR_NO_RESPONSE;
+		}
+	}
+	saraR5SetTransport(saraR5CmuxChannel(mux, 1));
+	return SARA_R5_ERROR_SUCCESS;
+}
+
+/**
+ * Closes every CMUX channel and brings the module back to plain AT commands on the serial link.
+ * @param mux The multiplexer started by saraR5StartCmux.
+ * @return SARA_R5_ERROR_SUCCESS if the module confirmed the close down, SARA_R5_ERROR_NO_RESPONSE otherwise.
+ */
+uint8_t saraR5StopCmux(SARA_R5_cmux *mux)
+{
+	bool closed = saraR5CmuxClose(mux);
+
+	// Whatever the answer, the library talks to the serial link again
+	saraR5SetTransport(mux->physical);
+	return closed ? SARA_R5_ERROR_SUCCESS : SARA_R5_ERROR_NO_RESPONSE;
+}
+
+/**
+ * Performs an action on a PDP (Packet Data Protocol) profile.
+ * @param profile The PDP profile number.
+ * @param action The action to perform on the PDP profile.
+ * @param buffer A place to store data received from the action.
+ * @param size How big the buffer is in bytes.
+ * @return A number indicating if the action was successful, ran out of memory,
+ *         encountered an error, or got no response.
+ */
+uint8_t saraR5PerformPDPaction(int profile, SARA_R5_pdp_actions_t action, const char *buffer, size_t size)
+{
+	SARA_R5_command_result wait = {false, SARA_R5_ERROR_NO_RESPONSE, SARA_R5_AT_RESULT_NONE, -1};
+
+	// Queue the command and wait for it
+	saraR5QueueMakeRoom();
+	return saraR5CommandWaitSubmitted(saraR5PerformPDPactionAsync(profile, action, buffer, size, saraR5StoreResult, &wait), &wait);
+}
+
+/**
+ * Queues an action on a PDP (Packet Data Protocol) profile and returns at once.
+ * @param profile The PDP profile number.
+ * @param action The action to perform on the PDP profile.
+ * @param buffer A place to store data received from the action (may be NULL). It must live until the callback.
+ * @param size How big the buffer is in bytes.
+ * @param callback Function called with the result once the module has answered (may be NULL).
+ * @param context Pointer passed back to the callback.
+ * @return SARA_R5_ERROR_SUCCESS if the command is queued, or SARA_R5_ERROR_OUT_OF_MEMORY if the queue is full.
+ */
+uint8_t saraR5PerformPDPactionAsync(int profile, SARA_R5_pdp_actions_t action, const char *buffer, size_t size, SARA_R5_command_callback callback, void *context)
+{
+	char profileDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char actionDigits[SARA_R5_SEGMENT_INT_SIZE];
+
+	// Send the command as e.g "AT+UPSDA = 2,2"
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_MESSAGE_PDP_ACTION "="),
+		saraR5SegmentInt(profileDigits, profile),
+		SARA_R5_SEGMENT_LITERAL(","),
+		saraR5SegmentInt(actionDigits, action),
+		SARA_R5_SEGMENT_LITERAL("\r"),
+	};
+
+	return saraR5SubmitCommand(command, SARA_R5_SEGMENT_COUNT(command), buffer, size, SARA_R5_10_SEC_TIMEOUT, false, callback, context);
+}
+
+/**
+ * Prepares an operator parser for a new AT+COPS=? answer.
+ * @param parser The parser to initialize.
+ * @param callback Function called for every operator, as soon as its closing ')' is received.
+ * @param context Pointer passed back to the callback.
+ */
+void saraR5OperatorParserInit(SARA_R5_operator_parser *parser, SARA_R5_operator_callback callback, void *context)
+{
+	memset(parser, 0, sizeof(*parser));
+	parser->callback = callback;
+	parser->context = context;
+}
+
+/**
+ * Stores one character of a quoted field of the operator being parsed.
+ */
+static void saraR5OperatorParserQuoted(SARA_R5_operator_parser *parser, char c)
+{
+	SARA_R5_operator_stats *op = &parser->op;
+
+	switch (parser->field)
+	{
+	case SARA_R5_OPERATOR_FIELD_LONG:
+		if (parser->fieldLength < sizeof(op->longOp) - 1)
+		{
+			op->longOp[parser->fieldLength++] = c; // Longer names are cut, the buffer is zeroed
+		}
+		break;
+	case SARA_R5_OPERATOR_FIELD_SHORT:
+		if (parser->fieldLength < sizeof(op->shortOp) - 1)
+		{
+			op->shortOp[parser->fieldLength++] = c;
+		}
+		break;
+	case SARA_R5_OPERATOR_FIELD_NUMERIC:
+		if (c < '0' || c > '9')
+		{
+			parser->valid = false;
+		}
+		op->numOp = op->numOp * 10 + (unsigned long)(c - '0');
+		parser->fieldLength++;
+		break;
+	default:
+		parser->valid = false; // Status and access technology are never quoted
+		break;
+	}
+}
+
+/**
+ * Stores one character of an unquoted field (status or access technology) of the operator being parsed.
+ */
+static void saraR5OperatorParserNumber(SARA_R5_operator_parser *parser, char c)
+{
+	uint8_t *value = (parser->field == SARA_R5_OPERATOR_FIELD_STAT) ? &parser->op.stat : &parser->op.act;
+
+	if (c < '0' || c > '9' || (parser->field != SARA_R5_OPERATOR_FIELD_STAT && parser->field != SARA_R5_OPERATOR_FIELD_ACT) ||
+		*value >= 25)
+	{
+		parser->valid = false;
+		return;
+	}
+	*value = (uint8_t)(*value * 10 + (c - '0'));
+	parser->fieldLength++;
+}
+
+/**
+ * Closes a field: the numeric ones must not be empty.
+ */
+static void saraR5OperatorParserEndField(SARA_R5_operator_parser *parser)
+{
+	if (parser->fieldLength == 0 && parser->field != SARA_R5_OPERATOR_FIELD_LONG && parser->field != SARA_R5_OPERATOR_FIELD_SHORT)
+	{
+		parser->valid = false;
+	}
+	parser->fieldLength = 0;
+}
+
+/**
+ * Hands the operator just closed to the callback, and aborts the scan if the callback is done.
+ */
+static void saraR5OperatorParserEmit(SARA_R5_operator_parser *parser)
+{
+	saraR5OperatorParserEndField(parser);
+	if (!parser->valid || parser->field != SARA_R5_OPERATOR_FIELD_ACT || parser->quoted != SARA_R5_OPERATOR_QUOTED_FIELDS)
+	{
+		return; // Not an operator, e.g. the list of supported modes "(0,1,2,3,4)"
+	}
+	parser->count++;
+	if (parser->callback != NULL && !parser->callback(&parser->op, parser->context))
+	{
+		parser->stopped = true;
+		saraR5AbortCommand();
+	}
+}
+
+/**
+ * Feeds a piece of an AT+COPS=? answer to the parser, e.g.
+ * +COPS: (1,"313 100","313 100","313100",8),(2,"AT&T","AT&T","310410",8),,(0,1,2,3,4),(0,1,2)
+ * Each (stat,"long","short","numeric",act) operator goes to the callback as soon as it is complete, nothing is copied
+ * besides the operator being parsed. Malformed tuples are skipped, and parsing ends at the ",," closing the list.
+ * The signature is that of SARA_R5_response_handler, so the parser can take the answer of a streamed command.
+ * @param data The received characters.
+ * @param len The number of characters.
+ * @param lineEnd true if the line ends after them.
+ * @param context The SARA_R5_operator_parser.
+ */
+void saraR5OperatorParserFeed(const char *data, size_t len, bool lineEnd, void *context)
+{
+	SARA_R5_operator_parser *parser = (SARA_R5_operator_parser *)context;
+
+	for (size_t i = 0; i < len && !parser->stopped && !parser->listEnd; i++)
+	{
+		char c = data[i];
+
+		if (!parser->inTuple)
+		{
+			if (c == '(')
+			{
+				memset(&parser->op, 0, sizeof(parser->op));
+				parser->inTuple = true;
+				parser->inQuotes = false;
+				parser->valid = true;
+				parser->field = SARA_R5_OPERATOR_FIELD_STAT;
+				parser->fieldLength = 0;
+				parser->quoted = 0;
+			}
+			else if (c == ',')
+			{
+				parser->listEnd = parser->comma; // An empty entry separates the operators from the supported values
+				parser->comma = true;
+			}
+			else if (c != ' ')
+			{
+				parser->comma = false;
+			}
+		}
+		else if (parser->inQuotes)
+		{
+			if (c == '"')
+			{
+				parser->inQuotes = false;
+			}
+			else
+			{
+				saraR5OperatorParserQuoted(parser, c);
+			}
+		}
+		else if (c == '"')
+		{
+			parser->inQuotes = true;
+			parser->quoted |= (uint8_t)(1u << parser->field);
+		}
+		else if (c == ',')
+		{
+			saraR5OperatorParserEndField(parser);
+			if (parser->field == SARA_R5_OPERATOR_FIELD_ACT)
+			{
+				parser->valid = false; // More fields than an operator has
+			}
+			else
+			{
+				parser->field++;
+			}
+		}
+		else if (c == ')')
+		{
+			parser->inTuple = false;
+			parser->comma = false;
+			saraR5OperatorParserEmit(parser);
+		}
+		else if (c != ' ')
+		{
+			saraR5OperatorParserNumber(parser, c);
+		}
+	}
+
+	if (lineEnd)
+	{
+		parser->inTuple = false; // A tuple never spans two lines
+		parser->comma = false;
+	}
+}
+
+/**
+ * Queues an AT+COPS=? network scan whose operators go to 'onOperator' as they are received.
+ * The scan may take minutes: returning false from 'onOperator' (e.g. once an acceptable PLMN is seen) aborts it,
+ * and so does saraR5AbortCommand() at any time.
+ * @param parser Storage for the parser state. Must live until the callback.
+ * @param onOperator Function called for every operator found.
+ * @param operatorContext Pointer passed back to onOperator.
+ * @param callback Function called once the scan is over (may be NULL). When the scan was aborted by 'onOperator',
+ *                 parser->stopped is set and the error is SARA_R5_ERROR_ERROR (ABORTED) or SARA_R5_ERROR_SUCCESS.
+ * @param context Pointer passed back to the callback.
+ * @return SARA_R5_ERROR_SUCCESS if the scan is queued, SARA_R5_ERROR_OUT_OF_MEMORY if the queue is full.
+ */
+uint8_t saraR5ScanOperatorsAsync(SARA_R5_operator_parser *parser, SARA_R5_operator_callback onOperator, void *operatorContext, SARA_R5_command_callback callback, void *context)
+{
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_OPERATOR_SELECTION "=?\r"),
+	};
+
+	saraR5OperatorParserInit(parser, onOperator, operatorContext);
+	return saraR5SubmitCommandStreamed(command, SARA_R5_SEGMENT_COUNT(command), SARA_R5_3_MIN_TIMEOUT, saraR5OperatorParserFeed, parser, callback, context);
+}
+
+/**
+ * Runs an AT+COPS=? network scan, handing the operators to 'onOperator' as they are received.
+ * Returning false from 'onOperator' ends the scan early.
+ * @param onOperator Function called for every operator found.
+ * @param context Pointer passed back to onOperator.
+ * @return SARA_R5_ERROR_SUCCESS if the scan completed or was ended by 'onOperator', SARA_R5_ERROR_ERROR on an error
+ *         result code, SARA_R5_ERROR_NO_RESPONSE on timeout.
+ */
+uint8_t saraR5ScanOperators(SARA_R5_operator_callback onOperator, void *context)
+{
+	SARA_R5_operator_parser parser;
+	SARA_R5_command_result wait = {false, SARA_R5_ERROR_NO_RESPONSE, SARA_R5_AT_RESULT_NONE, -1};
+	uint8_t error;
+
+	saraR5QueueMakeRoom();
+	error = saraR5CommandWaitSubmitted(saraR5ScanOperatorsAsync(&parser, onOperator, context, saraR5StoreResult, &wait), &wait);
+	return parser.stopped ? SARA_R5_ERROR_SUCCESS : error;
+}
+
+// Operators collected by saraR5GetOperators
+typedef struct
+{
+	SARA_R5_operator_stats *ops;
+	int maxOps;
+	int count;
+} SARA_R5_operator_list;
+
+/**
+ * Operator callback of saraR5GetOperators: stores the operator, and ends the scan once the list is full.
+ */
+static bool saraR5OperatorCollect(const SARA_R5_operator_stats *op, void *context)
+{
+	SARA_R5_operator_list *list = (SARA_R5_operator_list *)context;
+
+	if (list->count < list->maxOps)
+	{
+		list->ops[list->count++] = *op;
+	}
+	return list->count < list->maxOps;
+}
+
+/**
+ * Gets a list of mobile network operators available.
+ * The operators are parsed as the answer arrives, and the scan is aborted as soon as 'maxOps' of them are found.
+ * @param opRet Where to store the list of operators.
+ * @param maxOps The maximum number of operators to find.
+ * @param buffer A place to store data received from the action.
+ * @param size How big the buffer is in bytes.
+ * @return The number of operators found, or an error code if something goes wrong.
+ */
+uint8_t saraR5GetOperators(SARA_R5_operator_stats *opRet, int maxOps, const char *buffer, size_t size)
+{
+	SARA_R5_operator_list list = {opRet, maxOps, 0};
+	uint8_t error;
+
+	if (opRet == NULL || maxOps <= 0)
+	{
+		return 0;
+	}
+
+	// Send AT+COPS = 0,0 to set to automatic
+	saraR5AutomaticOperatorSelection(buffer, size);
+	// Send the AT+COPS = ?, to see the available networks
+	error = saraR5ScanOperators(saraR5OperatorCollect, &list);
+	if (error != SARA_R5_ERROR_SUCCESS)
+	{
+		return error;
+	}
+	return (uint8_t)list.count;
+}
+
+/**
+ * Prepares a PDP context parser for a new AT+CGDCONT? answer.
+ * @param parser The parser to initialize.
+ * @param contexts Where to store the contexts.
+ * @param maxContexts The number of entries of 'contexts'.
+ * @param cid Only keep this context, or 0 to keep them all in the order the module reports them.
+ */
+void saraR5PdpParserInit(SARA_R5_pdp_parser *parser, SARA_R5_pdp_context *contexts, size_t maxContexts, uint8_t cid)
+{
+	memset(parser, 0, sizeof(*parser));
+	parser->contexts = contexts;
+	parser->maxContexts = maxContexts;
+	parser->cid = cid;
+}
+
+/**
+ * Gets the entry the line being parsed is stored in, or NULL when the line is skipped or the array is full.
+ */
+static SARA_R5_pdp_context *saraR5PdpParserContext(SARA_R5_pdp_parser *parser)
+{
+	if (!parser->valid || parser->count >= parser->maxContexts)
+	{
+		return NULL;
+	}
+	return &parser->contexts[parser->count];
+}
+
+/**
+ * Starts a token of the address field: an IPv4 or IPv6 address, in dotted decimal or colon notation.
+ */
+static void saraR5PdpAddressStart(SARA_R5_pdp_parser *parser)
+{
+	memset(parser->address, 0, sizeof(parser->address));
+	parser->addressParts = 0;
+	parser->addressGap = -1;
+	parser->addressColon = false;
+	parser->addressPrevColon = false;
+	parser->addressValid = true;
+	parser->digits = 0;
+	parser->value = 0;
+	parser->hexValue = 0;
+	parser->hexOnly = false;
+}
+
+/**
+ * Ends a part of the address token: a decimal byte before '.', or a hex group before ':'.
+ */
+static void saraR5PdpAddressPart(SARA_R5_pdp_parser *parser, bool colon)
+{
+	if (parser->digits == 0)
+	{
+		return;
+	}
+	if (colon)
+	{
+		if (parser->addressParts >= 8 || parser->digits > 4)
+		{
+			parser->addressValid = false;
+			return;
+		}
+		parser->address[parser->addressParts * 2] = (uint8_t)(parser->hexValue >> 8);
+		parser->address[parser->addressParts * 2 + 1] = (uint8_t)parser->hexValue;
+	}
+	else
+	{
+		if (parser->addressParts >= sizeof(parser->address) || parser->hexOnly || parser->value > 255)
+		{
+			parser->addressValid = false;
+			return;
+		}
+		parser->address[parser->addressParts] = (uint8_t)parser->value;
+	}
+	parser->addressParts++;
+	parser->digits = 0;
+	parser->value = 0;
+	parser->hexValue = 0;
+	parser->hexOnly = false;
+}
+
+/**
+ * Ends an address token and stores it as the IPv4 or the IPv6 address of the context.
+ * Dotted tokens have 4 (IPv4) or 16 (IPv6) bytes, colon tokens 8 groups or fewer around a "::".
+ */
+static void saraR5PdpAddressEnd(SARA_R5_pdp_parser *parser)
+{
+	SARA_R5_pdp_context *context = saraR5PdpParserContext(parser);
+
+	saraR5PdpAddressPart(parser, parser->addressColon);
+	if (context == NULL || !parser->addressValid || parser->addressParts == 0)
+	{
+		return;
+	}
+
+	if (parser->addressColon)
+	{
+		size_t tail;
+
+		if (parser->addressGap < 0 ? parser->addressParts != 8 : parser->addressParts >= 8)
+		{
+			return;
+		}
+		if (parser->addressGap >= 0)
+		{
+			// Move the groups after the "::" to the end, zeros in between
+			tail = (size_t)(parser->addressParts - parser->addressGap) * 2;
+			memmove(&parser->address[16 - tail], &parser->address[parser->addressGap * 2], tail);
+			memset(&parser->address[parser->addressGap * 2], 0, 16 - tail - (size_t)parser->addressGap * 2);
+		}
+		memcpy(context->ipv6, parser->address, sizeof(context->ipv6));
+		context->hasIpv6 = true;
+	}
+	else if (parser->addressParts == sizeof(context->ipv4))
+	{
+		memcpy(context->ipv4, parser->address, sizeof(context->ipv4));
+		context->hasIpv4 = true;
+	}
+	else if (parser->addressParts == sizeof(context->ipv6))
+	{
+		memcpy(context->ipv6, parser->address, sizeof(context->ipv6));
+		context->hasIpv6 = true;
+	}
+}
+
+/**
+ * Handles one character of the address field: "10.64.12.8", "32.1.13.184.0.0.0.0.0.0.0.0.0.0.0.1",
+ * "2001:db8::1", or an IPv4 and an IPv6 address separated by a space.
+ */
+static void saraR5PdpAddressChar(SARA_R5_pdp_parser *parser, char c)
+{
+	if (c == ' ')
+	{
+		saraR5PdpAddressEnd(parser);
+		saraR5PdpAddressStart(parser);
+	}
+	else if (c == '.')
+	{
+		if (parser->digits == 0 || parser->addressColon)
+		{
+			parser->addressValid = false;
+		}
+		saraR5PdpAddressPart(parser, false);
+	}
+	else if (c == ':')
+	{
+		if (parser->addressParts > 0 && !parser->addressColon && parser->digits == 0)
+		{
+			parser->addressValid = false; // Dotted bytes before the ':'
+		}
+		parser->addressColon = true;
+		if (parser->digits > 0)
+		{
+			saraR5PdpAddressPart(parser, true);
+			parser->addressPrevColon = true;
+		}
+		else if (parser->addressPrevColon && parser->addressGap < 0)
+		{
+			parser->addressGap = (int8_t)parser->addressParts;
+			parser->addressPrevColon = false;
+		}
+		else if (parser->addressPrevColon || parser->addressGap >= 0)
+		{
+			parser->addressValid = false; // ":::" or a second "::"
+		}
+		else
+		{
+			parser->addressPrevColon = true; // First ':' of a leading "::"
+		}
+	}
+	else
+	{
+		uint8_t nibble;
+
+		if (c >= '0' && c <= '9')
+		{
+			nibble = (uint8_t)(c - '0');
+			if (parser->value < 100000)
+			{
+				parser->value = parser->value * 10 + nibble;
+			}
+		}
+		else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+		{
+			nibble = (uint8_t)((c | 0x20) - 'a' + 10);
+			parser->hexOnly = true;
+		}
+		else
+		{
+			parser->addressValid = false;
+			return;
+		}
+		if (parser->digits < 5)
+		{
+			parser->digits++;
+		}
+		parser->hexValue = (uint16_t)((parser->hexValue << 4) | nibble);
+		parser->addressPrevColon = false;
+	}
+}
+
+/**
+ * Ends a field of a +CGDCONT line.
+ */
+static void saraR5PdpEndField(SARA_R5_pdp_parser *parser)
+{
+	SARA_R5_pdp_context *context = saraR5PdpParserContext(parser);
+
+	if (context == NULL)
+	{
+		return;
+	}
+
+	if (parser->field == SARA_R5_PDP_FIELD_CID)
+	{
+		if (parser->digits == 0 || parser->value == 0 || parser->value > 255)
+		{
+			parser->valid = false;
+			return;
+		}
+		context->cid = (uint8_t)parser->value;
+		if (parser->cid != 0 && parser->cid != context->cid)
+		{
+			parser->valid = false; // Another context
+		}
+	}
+	else if (parser->field == SARA_R5_PDP_FIELD_TYPE)
+	{
+		parser->type[parser->fieldLength] = '\0';
+		context->pdpType = (strcmp(parser->type, "IPV4V6") == 0)   ? PDP_TYPE_IPV4V6
+						   : (strcmp(parser->type, "IPV6") == 0)  ? PDP_TYPE_IPV6
+						   : (strcmp(parser->type, "IP") == 0)    ? PDP_TYPE_IP
+						   : (strcmp(parser->type, "NONIP") == 0) ? PDP_TYPE_NONIP
+																  : PDP_TYPE_INVALID;
+	}
+	else if (parser->field == SARA_R5_PDP_FIELD_APN)
+	{
+		context->apn[parser->fieldLength] = '\0';
+	}
+	else if (parser->field == SARA_R5_PDP_FIELD_ADDRESS)
+	{
+		saraR5PdpAddressEnd(parser);
+	}
+	else if (context->paramCount < SARA_R5_PDP_PARAMS)
+	{
+		context->params[context->paramCount++] = (parser->value > 255) ? 255 : (uint8_t)parser->value;
+	}
+	parser->fieldLength = 0;
+	parser->digits = 0;
+	parser->value = 0;
+}
+
+/**
+ * Starts a +CGDCONT line: the context is parsed in place in the next free entry.
+ */
+static void saraR5PdpStartLine(SARA_R5_pdp_parser *parser)
+{
+	SARA_R5_pdp_context *context;
+
+	parser->valid = true;
+	parser->field = SARA_R5_PDP_FIELD_CID;
+	parser->fieldLength = 0;
+	parser->inQuotes = false;
+	saraR5PdpAddressStart(parser);
+	parser->found++;
+	context = saraR5PdpParserContext(parser);
+	if (context != NULL)
+	{
+		memset(context, 0, sizeof(*context));
+		context->pdpType = PDP_TYPE_INVALID;
+	}
+}
+
+/**
+ * Handles one character of a field of a +CGDCONT line, after the prefix.
+ */
+static void saraR5PdpFieldChar(SARA_R5_pdp_parser *parser, char c)
+{
+	SARA_R5_pdp_context *context = saraR5PdpParserContext(parser);
+
+	if (c == '"')
+	{
+		parser->inQuotes = !parser->inQuotes;
+		if (parser->field == SARA_R5_PDP_FIELD_ADDRESS && parser->inQuotes)
+		{
+			saraR5PdpAddressStart(parser);
+		}
+	}
+	else if (c == ',' && !parser->inQuotes)
+	{
+		saraR5PdpEndField(parser);
+		if (parser->field < SARA_R5_PDP_FIELD_PARAMS)
+		{
+			parser->field++;
+		}
+	}
+	else if (context == NULL)
+	{
+		return; // Line skipped
+	}
+	else if (parser->field == SARA_R5_PDP_FIELD_APN)
+	{
+		if (parser->fieldLength < sizeof(context->apn) - 1)
+		{
+			context->apn[parser->fieldLength++] = c; // Written in place, longer APNs are cut
+		}
+	}
+	else if (parser->field == SARA_R5_PDP_FIELD_TYPE)
+	{
+		if (parser->fieldLength < sizeof(parser->type) - 1)
+		{
+			parser->type[parser->fieldLength++] = (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c; // "IPv4v6" is "IPV4V6"
+		}
+	}
+	else if (parser->field == SARA_R5_PDP_FIELD_ADDRESS)
+	{
+		if (parser->inQuotes)
+		{
+			saraR5PdpAddressChar(parser, c);
+		}
+	}
+	else if (c >= '0' && c <= '9')
+	{
+		if (parser->value < 100000)
+		{
+			parser->value = parser->value * 10 + (uint32_t)(c - '0');
+		}
+		parser->digits++;
+	}
+	else if (c != ' ')
+	{
+		parser->valid = false;
+	}
+}
+
+/**
+ * Feeds a piece of an AT+CGDCONT? answer to the parser, e.g.
+ * +CGDCONT: 1,"IP","payandgo.o2.co.uk.mnc010.mcc234.gprs","10.160.182.234",0,0,0,2,0,0,0,0,0,0
+ * Every context goes, in one pass and without any copy of the line, to the next entry of the array. IPv4, IPv6
+ * (dotted or colon notation) and dual-stack addresses are decoded, and the numeric parameters that follow the
+ * address are kept. Lines that do not start with "+CGDCONT:" and malformed contexts are skipped.
+ * The signature is that of SARA_R5_response_handler, so the parser can take the answer of a streamed command.
+ * @param data The received characters.
+ * @param len The number of characters.
+ * @param lineEnd true if the line ends after them.
+ * @param context The SARA_R5_pdp_parser.
+ */
+void saraR5PdpParserFeed(const char *data, size_t len, bool lineEnd, void *context)
+{
+	static const char prefix[] = SARA_R5_PDP_PREFIX;
+	SARA_R5_pdp_parser *parser = (SARA_R5_pdp_parser *)context;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		char c = data[i];
+
+		if (parser->prefixLength < sizeof(prefix) - 1)
+		{
+			// Still matching the start of the line
+			if (parser->prefixLength == SARA_R5_PDP_LINE_SKIPPED || c != prefix[parser->prefixLength])
+			{
+				parser->prefixLength = SARA_R5_PDP_LINE_SKIPPED;
+				continue;
+			}
+			if (++parser->prefixLength == sizeof(prefix) - 1)
+			{
+				saraR5PdpStartLine(parser);
+			}
+			continue;
+		}
+		if (parser->field == SARA_R5_PDP_FIELD_APN && parser->inQuotes && c != '"')
+		{
+			// The APN up to its closing quote in one copy, the longest field of the line
+			SARA_R5_pdp_context *entry = saraR5PdpParserContext(parser);
+			const char *quote = memchr(&data[i], '"', len - i);
+			size_t run = (quote != NULL) ? (size_t)(quote - &data[i]) : len - i;
+
+			if (entry != NULL)
+			{
+				size_t room = sizeof(entry->apn) - 1 - parser->fieldLength;
+				size_t copied = (run < room) ? run : room; // Longer APNs are cut
+
+				memcpy(&entry->apn[parser->fieldLength], &data[i], copied);
+				parser->fieldLength += copied;
+			}
+			i += run - 1;
+			continue;
+		}
+		saraR5PdpFieldChar(parser, c);
+	}
+
+	if (!lineEnd)
+	{
+		return;
+	}
+	if (parser->prefixLength == sizeof(prefix) - 1)
+	{
+		if (parser->inQuotes)
+		{
+			parser->valid = false; // Cut in the middle of a quoted field
+		}
+		saraR5PdpEndField(parser);
+		if (saraR5PdpParserContext(parser) != NULL && parser->field >= SARA_R5_PDP_FIELD_APN)
+		{
+			parser->count++; // The entry is kept
+		}
+	}
+	parser->prefixLength = 0;
+}
+
+/**
+ * Reads the PDP contexts defined in the module (AT+CGDCONT?), parsed as the answer arrives.
+ * @param contexts Where to store the contexts, in the order the module reports them.
+ * @param maxContexts The number of entries of 'contexts'.
+ * @param count Where to store the number of contexts stored. May be NULL.
+ * @return SARA_R5_ERROR_SUCCESS, SARA_R5_ERROR_ERROR on an error result code or SARA_R5_ERROR_NO_RESPONSE on timeout.
+ */
+uint8_t saraR5GetPdpContexts(SARA_R5_pdp_context *contexts, size_t maxContexts, size_t *count)
+{
+	SARA_R5_pdp_parser parser;
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_MESSAGE_PDP_DEF2),
+	};
+	uint8_t error;
+
+	saraR5PdpParserInit(&parser, contexts, maxContexts, 0);
+	error = saraR5SendSegmentsStreamed(command, SARA_R5_SEGMENT_COUNT(command), SARA_R5_STANDARD_RESPONSE_TIMEOUT, saraR5PdpParserFeed, &parser);
+	if (count != NULL)
+	{
+		*count = parser.count;
+	}
+	return error;
+}
+
+/**
+ * Gets the Access Point Name (APN) and IP address information for a mobile network.
+ * @param cid The context ID for which the APN information is requested, stored in apn[0] and ip[0].
+ *            0 gets the first MAX_APN contexts the module reports, in apn[i] and ip[i].
+ * @param apn Where to store the APN information.
+ * @param ip Where to store the IP address information (0.0.0.0 for a context without an IPv4 address).
+ * @param pdpType Where to store the type of Packet Data Protocol (PDP) of the first context stored. May be NULL.
+ * @return A number indicating if the function was successful, or an error code if something went wrong.
+ */
+uint8_t saraR5GetAPN(int cid, myApn *apn, Ip_adress *ip, SARA_R5_pdp_type *pdpType)
+{
+	SARA_R5_pdp_context contexts[MAX_APN];
+	SARA_R5_pdp_parser parser;
+	size_t slots = (cid > 0) ? 1 : MAX_APN;
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_MESSAGE_PDP_DEF2),
+	};
+
+	if (apn == NULL || ip == NULL || cid < 0 || cid > 255)
+	{
+		return SARA_R5_ERROR_UNEXPECTED_PARAM;
+	}
+
+	// Ask for the PDP contexts, parsed as they arrive
+	saraR5PdpParserInit(&parser, contexts, slots, (uint8_t)cid);
+	uint8_t error = saraR5SendSegmentsStreamed(command, SARA_R5_SEGMENT_COUNT(command), SARA_R5_STANDARD_RESPONSE_TIMEOUT, saraR5PdpParserFeed, &parser);
+	if (error == SARA_R5_ERROR_ERROR)
+	{
+		return SARA_R5_ERROR_ERROR;
+	}
+
+	// Entries without a context are cleared
+	for (size_t i = 0; i < slots; i++)
+	{
+		if (i >= parser.count)
+		{
+			apn[i].apn[0] = '\0';
+			memset(&ip[i], 0, sizeof(ip[i]));
+			continue;
+		}
+		memcpy(apn[i].apn, contexts[i].apn, sizeof(apn[i].apn));
+		ip[i].first_ip = contexts[i].ipv4[0];
+		ip[i].second_ip = contexts[i].ipv4[1];
+		ip[i].third_ip = contexts[i].ipv4[2];
+		ip[i].fourth_ip = contexts[i].ipv4[3];
+	}
+	if (pdpType)
+	{
+		*pdpType = (parser.count > 0) ? contexts[0].pdpType : PDP_TYPE_INVALID;
+	}
+	return (parser.count > 0) ? SARA_R5_ERROR_SUCCESS : SARA_R5_ERROR_NO_RESPONSE; // Returns SUCCESS if at least one context was processed, otherwise returns NO_RESPONSE
+}
+
+uint8_t saraR5SetAPN(uint8_t cid, SARA_R5_pdp_type pdpType, char *apn, const char *buffer, size_t size)
+{
+
+	char cidDigits[SARA_R5_SEGMENT_INT_SIZE];
+	const char *pdpStr = "";
+	char *apnQuoted;
+	size_t apnQuotedSize;
+	bool sent;
+
+	// Convert PDP type to string representation
+	switch (pdpType)
+	{
+	case PDP_TYPE_INVALID:
+		return SARA_R5_ERROR_UNEXPECTED_PARAM;
+	case PDP_TYPE_IP:
+		pdpStr = "IP";
+		break;
+	case PDP_TYPE_NONIP:
+		pdpStr = "NONIP";
+		break;
+	case PDP_TYPE_IPV4V6:
+		pdpStr = "IPV4V6";
+		break;
+	case PDP_TYPE_IPV6:
+		pdpStr = "IPV6";
+		break;
+	}
+
+	SARA_R5_segment apnSegment = saraR5SegmentQuotedAlloc(&apnQuoted, &apnQuotedSize, apn, strlen(apn));
+
+	if (apnSegment.data == NULL)
+	{
+		return SARA_R5_ERROR_OUT_OF_MEMORY;
+	}
+
+	// Send the command AT+CGDCONT = CID, TYPE, APN
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_MESSAGE_PDP_DEF "="),
+		saraR5SegmentInt(cidDigits, cid),
+		SARA_R5_SEGMENT_LITERAL(",\""),
+		saraR5SegmentString(pdpStr),
+		SARA_R5_SEGMENT_LITERAL("\",\""),
+		apnSegment,
+		SARA_R5_SEGMENT_LITERAL("\"\r"),
+	};
+
+	sent = saraR5SendSegmentsWithResponse(command, SARA_R5_SEGMENT_COUNT(command), SARA_RESPONSE_OK, buffer, size, SARA_R5_10_SEC_TIMEOUT);
+	saraR5FreeChar(apnQuoted, apnQuotedSize);
+	if (!sent)
+	{
+		if (buffer != NULL && strstr(buffer, SARA_RESPONSE_ERROR) != NULL)
+		{
+			return SARA_R5_ERROR_ERROR;
+		}
+		else
+		{
+			return SARA_R5_ERROR_NO_RESPONSE;
+		}
+	}
+	return SARA_R5_ERROR_SUCCESS;
+}
+
+/**
+ * Sets the Access Point Name (APN) for a mobile network connection.
+ * @param cid The context ID where the APN is to be set.
+ * @param pdpType The type of Packet Data Protocol (PDP) to use.
+ * @param apn The APN name to be set for the connection.
+ * @param buffer A place to store data received from the action.
+ * @param size How big the buffer is in bytes.
+ * @return A number indicating if the APN was successfully set, or an error code if something went wrong.
+ */
+uint8_t saraR5NetworkMode(SARA_R5_mode_action mode, const char *buffer, size_t size)
+{
+	SARA_R5_command_result wait = {false, SARA_R5_ERROR_NO_RESPONSE, SARA_R5_AT_RESULT_NONE, -1};
+
+	// Queue the command and wait for it
+	saraR5QueueMakeRoom();
+	return saraR5CommandWaitSubmitted(saraR5NetworkModeAsync(mode, buffer, size, saraR5StoreResult, &wait), &wait);
+}
+
+/**
+ * Queues the selection of the network mode and returns at once.
+ * @param mode The network selection mode.
+ * @param buffer A place to store data received after sending the command (may be NULL). It must live until the callback.
+ * @param size The size of the buffer in bytes.
+ * @param callback Function called with the result once the module has answered (may be NULL).
+ * @param context Pointer passed back to the callback.
+ * @return SARA_R5_ERROR_SUCCESS if the command is queued, or SARA_R5_ERROR_OUT_OF_MEMORY if the queue is full.
+ */
+uint8_t saraR5NetworkModeAsync(SARA_R5_mode_action mode, const char *buffer, size_t size, SARA_R5_command_callback callback, void *context)
+{
+	char modeDigits[SARA_R5_SEGMENT_INT_SIZE];
+
+	// Construct the network mode command
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_OPERATOR_SELECTION "="),
+		saraR5SegmentInt(modeDigits, mode),
+		SARA_R5_SEGMENT_LITERAL("\r"),
+	};
+
+	return saraR5SubmitCommand(command, SARA_R5_SEGMENT_COUNT(command), buffer, size, SARA_R5_10_SEC_TIMEOUT, false, callback, context);
+}
+
+/**
+ * Sets the device to choose a mobile network operator automatically.
+ * @param buffer A place to store data received after sending the command.
+ * @param size The size of the buffer in bytes.
+ * @return A number indicating if the operation was successful, or an error code if something went wrong.
+ */
+uint8_t saraR5AutomaticOperatorSelection(const char *buffer, size_t size)
+{
+	SARA_R5_command_result wait = {false, SARA_R5_ERROR_NO_RESPONSE, SARA_R5_AT_RESULT_NONE, -1};
+
+	// Queue the command and wait for it
+	saraR5QueueMakeRoom();
+	return saraR5CommandWaitSubmitted(saraR5AutomaticOperatorSelectionAsync(buffer, size, saraR5StoreResult, &wait), &wait);
+}
+
+/**
+ * Queues the automatic operator selection and returns at once. The module may take up to 3 minutes to answer.
+ * @param buffer A place to store data received after sending the command (may be NULL). It must live until the callback.
+ * @param size The size of the buffer in bytes.
+ * @param callback Function called with the result once the module has answered (may be NULL).
+ * @param context Pointer passed back to the callback.
+ * @return SARA_R5_ERROR_SUCCESS if the command is queued, or SARA_R5_ERROR_OUT_OF_MEMORY if the queue is full.
+ */
+uint8_t saraR5AutomaticOperatorSelectionAsync(const char *buffer, size_t size, SARA_R5_command_callback callback, void *context)
+{
+	SARA_R5_segment command = SARA_R5_SEGMENT_LITERAL(SARA_R5_OPERATOR_SELECTION "=0,0\r");
+
+	return saraR5SubmitCommand(&command, 1, buffer, size, SARA_R5_3_MIN_TIMEOUT, false, callback, context);
+}
+
+/**
+ * Creates a network socket using a specified protocol and local port.
+ * @param protocol The type of protocol (TCP, UDP, etc.) for the socket connection.
+ * @param localPort The local port number to be used for the socket. If set to 0, the port is assigned automatically.
+ * @return Returns the socket ID if the socket is successfully opened, or an error code in case of a failure.
+ */
+int saraR5SocketOpen(SARA_R5_socket_protocol_t protocol, unsigned long localPort)
+{
+
+	char protocolDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char portDigits[SARA_R5_SEGMENT_INT_SIZE];
+	SARA_R5_socket_created created;
+	SARA_R5_schema_parser parser;
+
+	// Construct the socket open command, the local port is only sent when one is requested
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_CREATE_SOCKET "="),
+		saraR5SegmentInt(protocolDigits, (int)protocol),
+		SARA_R5_SEGMENT_LITERAL(","),
+		saraR5SegmentInt(portDigits, (long)localPort),
+		SARA_R5_SEGMENT_LITERAL("\r"),
+	};
+	if (localPort == 0)
+	{
+		command[2].len = 0;
+		command[3].len = 0;
+	}
+
+	// Send the command, the socket ID is parsed as the answer arrives
+	saraR5SchemaParserInit(&parser, &saraR5SocketCreatedSchema, &created, 1);
+	if (saraR5SendSegmentsStreamed(command, SARA_R5_SEGMENT_COUNT(command), SARA_R5_STANDARD_RESPONSE_TIMEOUT, saraR5SchemaParserFeed, &parser) != SARA_R5_ERROR_SUCCESS)
+	{
+		return SARA_R5_ERROR_ERROR;
+	}
+
+	if (parser.count != 1 || created.socket < 0)
+	{
+		return SARA_R5_ERROR_INVALID_SOCKET;
+	}
+
+	// Nothing received on a previous socket with the same ID is handed to this one
+	saraR5UrcSetup();
+	saraR5SocketRxReset(created.socket);
+	memset(&saraR5SocketSlots[created.socket], 0, sizeof(saraR5SocketSlots[created.socket]));
+	saraR5SocketSlots[created.socket].state = SARA_R5_SOCKET_OPEN;
+	saraR5SocketSlots[created.socket].protocol = protocol;
+	saraR5SocketSlots[created.socket].inUse = true;
+	saraR5SocketSlots[created.socket].lastUse = saraR5NowMs();
+	return created.socket;
+}
+
+/**
+ * Closes a specified network socket.
+ * @param socket The ID of the socket to be closed.
+ * @param timeout The time in milliseconds to wait for the socket to close.
+ *                Use the standard timeout for immediate closure.
+ * @param buffer A memory area to store the response from the close command.
+ * @param size The size of the buffer in bytes.
+ * @return Returns a success code if the socket is closed properly, or an error code if the closure fails.
+ */
+uint8_t saraR5socketClose(int socket, unsigned long timeout, const char *buffer, size_t size)
+{
+
+	char socketDigits[SARA_R5_SEGMENT_INT_SIZE];
+
+	// Construct the socket close command
+	// If the standard response is 'timeout', then close asynchronously (",1"); otherwise, wait for the closure.
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_CLOSE_SOCKET "="),
+		saraR5SegmentInt(socketDigits, socket),
+		SARA_R5_SEGMENT_LITERAL(",1"),
+		SARA_R5_SEGMENT_LITERAL("\r"),
+	};
+	if (SARA_R5_STANDARD_RESPONSE_TIMEOUT != timeout)
+	{
+		command[2].len = 0;
+	}
+
+	// Send the command and check for the response
+	if (!saraR5SendSegmentsWithResponse(command, SARA_R5_SEGMENT_COUNT(command), SARA_RESPONSE_OK, buffer, size, SARA_R5_10_SEC_TIMEOUT))
+	{
+		if (buffer != NULL && strstr(buffer, SARA_RESPONSE_ERROR) != NULL)
+		{
+			return SARA_R5_ERROR_ERROR;
+		}
+	}
+	saraR5SocketRxReset(socket);
+	if (saraR5SocketRxGet(socket) != NULL)
+	{
+		memset(&saraR5SocketSlots[socket], 0, sizeof(saraR5SocketSlots[socket]));
+	}
+	return SARA_R5_ERROR_SUCCESS;
+}
+
+/**
+ * Reads the bytes received on a socket. saraR5Poll reads them out of the module as soon as +UUSORD / +UUSORF
+ * announces them (AT+USORD / AT+USORF, at most SARA_R5_SOCKET_MAX_READ bytes per command), so this call never
+ * waits for the module: it only empties the reception ring of the socket, which lets the next read go.
+ * @param socket The socket ID.
+ * @param data Where to copy the bytes.
+ * @param len The size of 'data'.
+ * @return The number of bytes copied, 0 if nothing was received or the socket ID is invalid.
+ */
+size_t saraR5SocketRead(int socket, uint8_t *data, size_t len)
+{
+	SARA_R5_socket_rx *rx = saraR5SocketRxGet(socket);
+
+	if (rx == NULL || rx->ring.buffer == NULL)
+	{
+		return 0;
+	}
+	return saraR5RingBufferRead(&rx->ring, data, len);
+}
+
+/**
+ * Gets the number of bytes received on a socket and not read yet with saraR5SocketRead.
+ * @param socket The socket ID.
+ * @return The number of bytes waiting, 0 if the socket ID is invalid.
+ */
+size_t saraR5SocketAvailable(int socket)
+{
+	SARA_R5_socket_rx *rx = saraR5SocketRxGet(socket);
+
+	if (rx == NULL || rx->ring.buffer == NULL)
+	{
+		return 0;
+	}
+	return saraR5RingBufferAvailable(&rx->ring);
+}
+
+/**
+ * Selects how the module exchanges socket data (AT+UDCONF=1): as it is, or as hex digits.
+ * Hex mode doubles the bytes on the line but carries any binary data; in text mode the received data must not
+ * hold line breaks, as the answer of AT+USORD is read line by line.
+ * @param hex true for hex mode, false for text mode (module default).
+ * @return SARA_R5_ERROR_SUCCESS, SARA_R5_ERROR_ERROR on an error result code or SARA_R5_ERROR_NO_RESPONSE on timeout.
+ */
+uint8_t saraR5SocketSetHexMode(bool hex)
+{
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_DATA_CONFIG "=1,0\r"),
+	};
+	uint8_t error;
+
+	if (hex)
+	{
+		command[0] = (SARA_R5_segment)SARA_R5_SEGMENT_LITERAL(SARA_R5_DATA_CONFIG "=1,1\r");
+	}
+	error = saraR5SendSegmentsStreamed(command, SARA_R5_SEGMENT_COUNT(command), SARA_R5_STANDARD_RESPONSE_TIMEOUT, NULL, NULL);
+	if (error == SARA_R5_ERROR_SUCCESS)
+	{
+		saraR5SocketHex = hex;
+	}
+	return error;
+}
+
+/**
+ * Makes a TCP socket use TLS with a security profile (AT+USOSEC), or plain TCP again. Call it before
+ * saraR5SocketConnect2, which then times the handshake in the statistics of the profile (saraR5SecurityGetStats).
+ * @param socket The ID of the TCP socket, not connected yet.
+ * @param profile The security profile (see saraR5SecurityProfileSet), or SARA_R5_SECURITY_NONE.
+ * @return SARA_R5_ERROR_SUCCESS, SARA_R5_ERROR_INVALID_SOCKET if the socket ID is invalid,
+ *         SARA_R5_ERROR_UNEXPECTED_PARAM if the profile is out of range, or the error of the command.
+ */
+uint8_t saraR5SocketSetSecurity(int socket, int profile)
+{
+	char socketDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char profileDigits[SARA_R5_SEGMENT_INT_SIZE];
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_SOCKET_SECURITY "="),
+		saraR5SegmentInt(socketDigits, socket),
+		SARA_R5_SEGMENT_LITERAL(",1,"),
+		saraR5SegmentInt(profileDigits, profile),
+		SARA_R5_SEGMENT_LITERAL("\r"),
+	};
+	size_t count = SARA_R5_SEGMENT_COUNT(command);
+	uint8_t error;
+
+	if (saraR5SocketRxGet(socket) == NULL)
+	{
+		return SARA_R5_ERROR_INVALID_SOCKET;
+	}
+	if (profile == SARA_R5_SECURITY_NONE)
+	{
+		command[2] = (SARA_R5_segment)SARA_R5_SEGMENT_LITERAL(",0\r");
+		count = 3;
+	}
+	else if (profile < 0 || profile >= SARA_R5_SECURITY_PROFILES)
+	{
+		return SARA_R5_ERROR_UNEXPECTED_PARAM;
+	}
+
+	error = saraR5SendSegmentsStreamed(command, count, SARA_R5_STANDARD_RESPONSE_TIMEOUT, NULL, NULL);
+	if (error == SARA_R5_ERROR_SUCCESS)
+	{
+		saraR5SocketSlots[socket].secure = (profile != SARA_R5_SECURITY_NONE);
+		saraR5SocketSlots[socket].securityProfile = saraR5SocketSlots[socket].secure ? (uint8_t)profile : 0;
+	}
+	return error;
+}
+
+/**
+ * Writes an address in dotted decimal, e.g. "35.180.39.173". 'address' holds at least SARA_R5_SIZE_IP bytes.
+ */
+static void saraR5FormatIp(char *address, const Ip_adress *ip)
+{
+	const int octets[SIZE_OCT_IP] = {ip->first_ip, ip->second_ip, ip->third_ip, ip->fourth_ip};
+	char digits[SARA_R5_SEGMENT_INT_SIZE];
+	size_t len = 0;
+
+	for (size_t i = 0; i < SIZE_OCT_IP; i++)
+	{
+		SARA_R5_segment octet = saraR5SegmentUint(digits, (unsigned long)(octets[i] & 0xFF));
+
+		memcpy(&address[len], octet.data, octet.len);
+		len += octet.len;
+		address[len++] = (i < SIZE_OCT_IP - 1) ? '.' : '\0';
+	}
+}
+
+/**
+ * Reads a dotted decimal IPv4 address, e.g. "35.180.39.173".
+ * @return false if 'text' is anything else, such as a host name.
+ */
+static bool saraR5ParseIp(const char *text, Ip_adress *ip)
+{
+	int octets[SIZE_OCT_IP] = {0};
+	size_t octet = 0;
+	size_t digits = 0;
+
+	for (;;)
+	{
+		char c = *text++;
+
+		if (c >= '0' && c <= '9' && digits < 3)
+		{
+			octets[octet] = octets[octet] * 10 + (c - '0');
+			digits++;
+		}
+		else if (digits == 0 || octets[octet] > 255)
+		{
+			return false;
+		}
+		else if (c == '.' && octet < SIZE_OCT_IP - 1)
+		{
+			octet++;
+			digits = 0;
+		}
+		else if (c == '\0' && octet == SIZE_OCT_IP - 1)
+		{
+			*ip = (Ip_adress){octets[0], octets[1], octets[2], octets[3]};
+			return true;
+		}
+		else
+		{
+			return false;
+		}
+	}
+}
+
+/**
+ * Gets the cache entry of a host name, or NULL.
+ */
+static SARA_R5_dns_entry *saraR5DnsCacheFind(const char *host)
+{
+	for (size_t i = 0; i < saraR5DnsCapacity; i++)
+	{
+		if (saraR5DnsCache[i].host[0] != '\0' && strcmp(saraR5DnsCache[i].host, host) == 0)
+		{
+			return &saraR5DnsCache[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Remembers the outcome of a resolution, in a free entry or in place of the least recently used one.
+ */
+static void saraR5DnsCacheStore(const char *host, const Ip_adress *ip, bool resolved)
+{
+	SARA_R5_dns_entry *entry = saraR5DnsCacheFind(host);
+	uint32_t now = saraR5NowMs();
+
+	if (saraR5DnsCapacity == 0)
+	{
+		return;
+	}
+	if (entry == NULL)
+	{
+		entry = &saraR5DnsCache[0];
+		for (size_t i = 1; i < saraR5DnsCapacity; i++)
+		{
+			SARA_R5_dns_entry *other = &saraR5DnsCache[i];
+
+			if (entry->host[0] != '\0' && (other->host[0] == '\0' || (uint32_t)(now - other->lastUse) > (uint32_t)(now - entry->lastUse)))
+			{
+				entry = other;
+			}
+		}
+	}
+	memset(entry, 0, sizeof(*entry));
+	strcpy(entry->host, host);
+	if (resolved)
+	{
+		entry->ip = *ip;
+	}
+	entry->resolved = resolved;
+	entry->time = now;
+	entry->lastUse = now;
+}
+
+/**
+ * Resolves a host name to an IPv4 address (AT+UDNSRN=0) through a cache keyed by the name: an address is reused
+ * for the TTL of the cache, and a name the module could not resolve fails at once for the negative TTL, both
+ * without airtime. A dotted decimal address is read as it is.
+ * @param host The host name, e.g. "broker.example.com", shorter than SARA_R5_SOCKET_ADDRESS_SIZE.
+ * @param ip Where to store the address.
+ * @return SARA_R5_ERROR_SUCCESS, SARA_R5_ERROR_ERROR if the name does not resolve (now or recently),
+ *         SARA_R5_ERROR_UNEXPECTED_PARAM if the name is empty or too long, SARA_R5_ERROR_UNEXPECTED_RESPONSE if the
+ *         answer holds no IPv4 address, or SARA_R5_ERROR_NO_RESPONSE on timeout (not cached).
+ */
+uint8_t saraR5ResolveHost(const char *host, Ip_adress *ip)
+{
+	char *hostQuoted;
+	size_t hostQuotedSize;
+	SARA_R5_dns_answer answer;
+	SARA_R5_schema_parser parser;
+	SARA_R5_dns_entry *entry;
+	uint8_t error;
+
+	if (host == NULL || ip == NULL || host[0] == '\0' || strlen(host) >= SARA_R5_SOCKET_ADDRESS_SIZE)
+	{
+		return SARA_R5_ERROR_UNEXPECTED_PARAM;
+	}
+	if (saraR5ParseIp(host, ip))
+	{
+		return SARA_R5_ERROR_SUCCESS;
+	}
+
+	saraR5DnsStats.lookups++;
+	entry = saraR5DnsCacheFind(host);
+	if (entry != NULL)
+	{
+		uint32_t age = saraR5NowMs() - entry->time;
+
+		if (entry->resolved && age < saraR5DnsTtl)
+		{
+			saraR5DnsStats.hits++;
+			entry->lastUse = saraR5NowMs();
+			*ip = entry->ip;
+			return SARA_R5_ERROR_SUCCESS;
+		}
+		if (!entry->resolved && age < saraR5DnsNegativeTtl)
+		{
+			saraR5DnsStats.negativeHits++;
+			entry->lastUse = saraR5NowMs();
+			return SARA_R5_ERROR_ERROR;
+		}
+	}
+
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_RESOLVE_NAME "=0,\""),
+		saraR5SegmentQuotedAlloc(&hostQuoted, &hostQuotedSize, host, strlen(host)),
+		SARA_R5_SEGMENT_LITERAL("\"\r"),
+	};
+
+	if (command[1].data == NULL)
+	{
+		return SARA_R5_ERROR_OUT_OF_MEMORY;
+	}
+	saraR5DnsStats.queries++;
+	saraR5SchemaParserInit(&parser, &saraR5DnsAnswerSchema, &answer, 1);
+	error = saraR5SendSegmentsStreamed(command, SARA_R5_SEGMENT_COUNT(command), SARA_R5_DNS_TIMEOUT, saraR5SchemaParserFeed, &parser);
+	saraR5FreeChar(hostQuoted, hostQuotedSize);
+	if (error == SARA_R5_ERROR_SUCCESS && parser.count != 1)
+	{
+		error = SARA_R5_ERROR_UNEXPECTED_RESPONSE;
+	}
+	if (error != SARA_R5_ERROR_SUCCESS)
+	{
+		saraR5DnsStats.failures++;
+		if (error == SARA_R5_ERROR_ERROR)
+		{
+			saraR5DnsCacheStore(host, NULL, false); // Only a refused name is remembered, a timeout may not happen again
+		}
+		return error;
+	}
+
+	*ip = (Ip_adress){answer.ip[0], answer.ip[1], answer.ip[2], answer.ip[3]};
+	saraR5DnsCacheStore(host, ip, true);
+	return SARA_R5_ERROR_SUCCESS;
+}
+
+/**
+ * Sets the capacity and the lifetimes of the resolution cache, and empties it.
+ * @param capacity Host names remembered, at most SARA_R5_DNS_CACHE_SIZE. 0 turns the cache off: saraR5ResolveHost
+ *        always asks the module, and saraR5SocketConnect2 and saraR5SocketSend hand host names to AT+USOCO and
+ *        AT+USOST as they are.
+ * @param ttlMs Time a resolved address is reused (ms).
+ * @param negativeTtlMs Time a name that did not resolve fails without asking the module (ms), 0 to always ask again.
+ * @return SARA_R5_ERROR_SUCCESS, or SARA_R5_ERROR_UNEXPECTED_PARAM if the capacity is too large.
+ */
+uint8_t saraR5DnsCacheConfigure(size_t capacity, uint32_t ttlMs, uint32_t negativeTtlMs)
+{
+	if (capacity > SARA_R5_DNS_CACHE_SIZE)
+	{
+		return SARA_R5_ERROR_UNEXPECTED_PARAM;
+	}
+	saraR5DnsCacheForget(NULL);
+	saraR5DnsCapacity = capacity;
+	saraR5DnsTtl = ttlMs;
+	saraR5DnsNegativeTtl = negativeTtlMs;
+	return SARA_R5_ERROR_SUCCESS;
+}
+
+/**
+ * Drops a host name from the resolution cache, so the next lookup asks the module again
+ * (e.g. after a connection to its cached address failed).
+ * @param host The host name, or NULL to empty the whole cache.
+ */
+void saraR5DnsCacheForget(const char *host)
+{
+	for (size_t i = 0; i < SARA_R5_DNS_CACHE_SIZE; i++)
+	{
+		if (host == NULL || strcmp(saraR5DnsCache[i].host, host) == 0)
+		{
+			memset(&saraR5DnsCache[i], 0, sizeof(saraR5DnsCache[i]));
+		}
+	}
+}
+
+/**
+ * Gets the statistics of the resolution cache since boot.
+ * @param stats Where to store them.
+ */
+void saraR5DnsGetStats(SARA_R5_dns_stats *stats)
+{
+	*stats = saraR5DnsStats;
+}
+
+/**
+ * Picks the address a command hands to the module for a remote end: for a host name the address of the
+ * resolution cache, so the module sends without a DNS query of its own, otherwise 'address' as it is (an IPv4 or
+ * IPv6 address, the cache turned off, or a name whose answer holds no IPv4 address, left to the module).
+ * @param resolved Storage for the resolved address, at least SARA_R5_SIZE_IP bytes.
+ * @param target Where to store the address to send, 'address' or 'resolved'.
+ * @return SARA_R5_ERROR_SUCCESS, or the error of saraR5ResolveHost.
+ */
+static uint8_t saraR5ResolveTarget(const char *address, char *resolved, const char **target)
+{
+	Ip_adress ip;
+	uint8_t error;
+
+	*target = address;
+	if (saraR5DnsCapacity == 0 || strchr(address, ':') != NULL || saraR5ParseIp(address, &ip))
+	{
+		return SARA_R5_ERROR_SUCCESS;
+	}
+	error = saraR5ResolveHost(address, &ip);
+	if (error == SARA_R5_ERROR_SUCCESS)
+	{
+		saraR5FormatIp(resolved, &ip);
+		*target = resolved;
+	}
+	return (error == SARA_R5_ERROR_UNEXPECTED_RESPONSE) ? SARA_R5_ERROR_SUCCESS : error;
+}
+
+/**
+ * Connects an existing network socket to a specific IP address and port.
+ * @param socket The ID of the socket to be connected.
+ * @param ip The IP address to connect the socket to, provided as a structured format.
+ * @param port The port number to connect the socket to.
+ * @param buffer A memory area to store the response from the connect command.
+ * @param size The size of the buffer in bytes.
+ * @return Returns a success code if the connection is established, or an error code if the connection fails.
+ */
+uint8_t saraR5SocketConnect(int socket, Ip_adress ip, unsigned int port, const char *buffer, size_t size)
+{
+
+	char charAddress[SARA_R5_SIZE_IP];
+
+	// Convert the IP address structure to a string representation
+	saraR5FormatIp(charAddress, &ip);
+
+	// Call the function to send the command to connect
+	return saraR5SocketConnect2(socket, (const char *)charAddress, port, buffer, size);
+}
+
+/**
+ * Establishes a network connection for a given socket to a specified IP address and port.
+ * A host name is resolved with saraR5ResolveHost, so a reconnection reuses the cached address.
+ * @param socket The ID of the socket to be connected.
+ * @param address The IP address in string format, or the host name, to connect the socket to.
+ * @param port The port number to connect the socket to.
+ * @param buffer A memory area to store the response from the connection attempt.
+ * @param size The size of the buffer in bytes.
+ * @return Returns a success code if the connection is successfully made, or an error code if the connection attempt fails.
+ */
+uint8_t saraR5SocketConnect2(int socket, const char *address, unsigned int port, const char *buffer, size_t size)
+{
+	SARA_R5_command_result wait = {false, SARA_R5_ERROR_NO_RESPONSE, SARA_R5_AT_RESULT_NONE, -1};
+	char resolved[SARA_R5_SIZE_IP];
+	const char *target;
+	bool secure = saraR5SocketRxGet(socket) != NULL && saraR5SocketSlots[socket].secure;
+	uint32_t start;
+	uint8_t error;
+
+	// A host name goes through the resolution cache, so the module connects to the address without a DNS query
+	error = saraR5ResolveTarget(address, resolved, &target);
+	if (error != SARA_R5_ERROR_SUCCESS)
+	{
+		return error;
+	}
+
+	// Queue the command and wait for it, on a secure socket AT+USOCO answers once the TLS session is up
+	saraR5QueueMakeRoom();
+	start = saraR5NowMs();
+	error = saraR5CommandWaitSubmitted(saraR5SocketConnect2Async(socket, target, port, buffer, size, saraR5StoreResult, &wait), &wait);
+	if (secure)
+	{
+		saraR5SecurityHandshake(saraR5SocketSlots[socket].securityProfile, error == SARA_R5_ERROR_SUCCESS, saraR5NowMs() - start);
+	}
+	if (error != SARA_R5_ERROR_SUCCESS && target != address)
+	{
+		saraR5DnsCacheForget(address); // The host may have moved, it is resolved again next time
+	}
+
+	// The pool remembers the endpoint, so the socket can be reused for it
+	if (error == SARA_R5_ERROR_SUCCESS && saraR5SocketRxGet(socket) != NULL && strlen(address) < SARA_R5_SOCKET_ADDRESS_SIZE)
+	{
+		SARA_R5_socket_slot *slot = &saraR5SocketSlots[socket];
+
+		slot->state = SARA_R5_SOCKET_CONNECTED;
+		strcpy(slot->address, address);
+		slot->port = port;
+		slot->lastUse = saraR5NowMs();
+	}
+	return error;
+}
+
+/**
+ * Queues the connection of a socket and returns at once. The module may take up to SARA_R5_IP_CONNECT_TIMEOUT to answer.
+ * @param socket The ID of the socket to be connected.
+ * @param address The IP address in string format to connect the socket to. It is copied.
+ * @param port The port number to connect the socket to.
+ * @param buffer A memory area to store the response (may be NULL). It must live until the callback.
+ * @param size The size of the buffer in bytes.
+ * @param callback Function called with the result once the module has answered (may be NULL).
+ * @param context Pointer passed back to the callback.
+ * @return SARA_R5_ERROR_SUCCESS if the command is queued, SARA_R5_ERROR_OUT_OF_MEMORY if the queue is full
+ *         or the command gets no memory, or SARA_R5_ERROR_UNEXPECTED_PARAM if it is too long for a SARA_R5_NO_HEAP build.
+ */
+uint8_t saraR5SocketConnect2Async(int socket, const char *address, unsigned int port, const char *buffer, size_t size, SARA_R5_command_callback callback, void *context)
+{
+	char socketDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char *addressQuoted;
+	size_t addressQuotedSize;
+	char portDigits[SARA_R5_SEGMENT_INT_SIZE];
+	uint8_t error;
+
+	// Construct the command to connect the socket
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_CONNECT_SOCKET "="),
+		saraR5SegmentInt(socketDigits, socket),
+		SARA_R5_SEGMENT_LITERAL(",\""),
+		saraR5SegmentQuotedAlloc(&addressQuoted, &addressQuotedSize, address, strlen(address)),
+		SARA_R5_SEGMENT_LITERAL("\","),
+		saraR5SegmentInt(portDigits, (long)port),
+		SARA_R5_SEGMENT_LITERAL("\r"),
+	};
+
+	if (command[3].data == NULL)
+	{
+		return SARA_R5_ERROR_OUT_OF_MEMORY;
+	}
+	error = saraR5SubmitCommand(command, SARA_R5_SEGMENT_COUNT(command), buffer, size, SARA_R5_IP_CONNECT_TIMEOUT, false, callback, context);
+	saraR5FreeChar(addressQuoted, addressQuotedSize); // The queue holds a copy of the command
+	return error;
+}
+
+/**
+ * Sends a datagram through a UDP socket (AT+USOST), binary safe: the bytes may hold NUL, CR or any other value.
+ * In text mode (module default) the command announces the length and the bytes go as they are after the '@' prompt.
+ * In hex mode (saraR5SocketSetHexMode) they are sent in the command itself as hex digits.
+ * @param socket The ID of the UDP socket.
+ * @param address The destination IP address in string format.
+ * @param port The destination port number.
+ * @param data The bytes to send.
+ * @param len The number of bytes, 1 to SARA_R5_SOCKET_MAX_WRITE (SARA_R5_SOCKET_MAX_WRITE_HEX in hex mode).
+ * @return SARA_R5_ERROR_SUCCESS once the module has taken the whole datagram, SARA_R5_ERROR_UNEXPECTED_PARAM if the
+ *         length or the address does not fit, SARA_R5_ERROR_OUT_OF_MEMORY if the hex digits get no buffer,
+ *         SARA_R5_ERROR_UNEXPECTED_RESPONSE if +USOST reports another length, or the error of the command.
+ */
+uint8_t saraR5SocketWriteDatagram(int socket, const char *address, unsigned int port, const uint8_t *data, size_t len)
+{
+	char socketDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char *addressQuoted;
+	size_t addressQuotedSize;
+	char portDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char lengthDigits[SARA_R5_SEGMENT_INT_SIZE];
+	SARA_R5_socket_written written;
+	SARA_R5_schema_parser parser;
+	SARA_R5_segment payload = {(const char *)data, len};
+	char *hex = NULL;
+	uint8_t error;
+
+	if (saraR5SocketRxGet(socket) == NULL)
+	{
+		return SARA_R5_ERROR_INVALID_SOCKET;
+	}
+	if (data == NULL || len == 0 || len > (saraR5SocketHex ? SARA_R5_SOCKET_MAX_WRITE_HEX : SARA_R5_SOCKET_MAX_WRITE))
+	{
+		return SARA_R5_ERROR_UNEXPECTED_PARAM;
+	}
+
+	// Construct the command, the hex digits are only in it in hex mode
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_WRITE_UDP_SOCKET "="),
+		saraR5SegmentInt(socketDigits, socket),
+		SARA_R5_SEGMENT_LITERAL(",\""),
+		saraR5SegmentQuotedAlloc(&addressQuoted, &addressQuotedSize, address, strlen(address)),
+		SARA_R5_SEGMENT_LITERAL("\","),
+		saraR5SegmentUint(portDigits, port),
+		SARA_R5_SEGMENT_LITERAL(","),
+		saraR5SegmentUint(lengthDigits, (unsigned long)len),
+		SARA_R5_SEGMENT_LITERAL(",\""),
+		{NULL, 0},
+		SARA_R5_SEGMENT_LITERAL("\"\r"),
+	};
+	if (command[3].data == NULL)
+	{
+		return SARA_R5_ERROR_OUT_OF_MEMORY;
+	}
+	if (saraR5SocketHex)
+	{
+		hex = saraR5CallocChar(2 * len);
+		if (hex == NULL)
+		{
+			saraR5FreeChar(addressQuoted, addressQuotedSize);
+			return SARA_R5_ERROR_OUT_OF_MEMORY;
+		}
+		command[9] = saraR5SegmentHex(hex, 2 * len, data, len);
+	}
+	else
+	{
+		command[8].len = 0;
+		command[9].data = "";
+		command[10] = (SARA_R5_segment)SARA_R5_SEGMENT_LITERAL("\r");
+	}
+
+	// Send the command, the datagram follows the prompt in text mode
+	saraR5SchemaParserInit(&parser, &saraR5SocketSentSchema, &written, 1);
+	saraR5QueueMakeRoom();
+	error = saraR5RunCommand(command, SARA_R5_SEGMENT_COUNT(command), saraR5SocketHex ? NULL : &payload, NULL, 0, SARA_R5_SOCKET_WRITE_TIMEOUT, saraR5SchemaParserFeed, &parser);
+	if (hex != NULL)
+	{
+		saraR5FreeChar(hex, 2 * len);
+	}
+	saraR5FreeChar(addressQuoted, addressQuotedSize);
+	if (error != SARA_R5_ERROR_SUCCESS)
+	{
+		return error;
+	}
+	if (parser.count != 1 || written.socket != socket || written.length != len)
+	{
+		return SARA_R5_ERROR_UNEXPECTED_RESPONSE;
+	}
+	return SARA_R5_ERROR_SUCCESS;
+}
+
+/**
+ * Sends data through a UDP socket to a specified IP address and port. See saraR5SocketWriteDatagram.
+ * @param socket The ID of the UDP socket to use for sending data.
+ * @param address The destination IP address in string format.
+ * @param port The destination port number.
+ * @param str The data to be sent, any bytes when 'len' is given.
+ * @param len The length of the data to send. If set to -1, 'str' is taken as a null terminated string.
+ * @return Returns a success code if the data is sent successfully, or an error code if the sending fails.
+ */
+uint8_t saraR5SocketWriteUDP(int socket, const char *address, int port, const char *str, int len)
+{
+	size_t dataLen;
+
+	if (str == NULL || port < 0 || len < -1)
+	{
+		return SARA_R5_ERROR_UNEXPECTED_PARAM;
+	}
+	dataLen = (len == -1) ? strlen(str) : (size_t)len;
+	return saraR5SocketWriteDatagram(socket, address, (unsigned int)port, (const uint8_t *)str, dataLen);
+}
+
+/**
+ * Gets the number of bytes sent on a TCP socket that the remote end has not acknowledged yet (AT+USOCTL=<socket>,11).
+ * @param socket The socket ID.
+ * @param bytes Where to store the number of bytes.
+ * @return SARA_R5_ERROR_SUCCESS, SARA_R5_ERROR_INVALID_SOCKET if the socket ID is invalid,
+ *         SARA_R5_ERROR_UNEXPECTED_RESPONSE if the answer holds no count, or the error of the command.
+ */
+uint8_t saraR5SocketUnacked(int socket, size_t *bytes)
+{
+	char socketDigits[SARA_R5_SEGMENT_INT_SIZE];
+	SARA_R5_socket_control control;
+	SARA_R5_schema_parser parser;
+	uint8_t error;
+
+	if (saraR5SocketRxGet(socket) == NULL || bytes == NULL)
+	{
+		return SARA_R5_ERROR_INVALID_SOCKET;
+	}
+
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_SOCKET_CONTROL "="),
+		saraR5SegmentInt(socketDigits, socket),
+		SARA_R5_SEGMENT_LITERAL(",11\r"),
+	};
+
+	saraR5SchemaParserInit(&parser, &saraR5SocketControlSchema, &control, 1);
+	error = saraR5SendSegmentsStreamed(command, SARA_R5_SEGMENT_COUNT(command), SARA_R5_STANDARD_RESPONSE_TIMEOUT, saraR5SchemaParserFeed, &parser);
+	if (error != SARA_R5_ERROR_SUCCESS)
+	{
+		return error;
+	}
+	if (parser.count != 1 || control.socket != socket || control.param != 11)
+	{
+		return SARA_R5_ERROR_UNEXPECTED_RESPONSE;
+	}
+	*bytes = (size_t)control.value;
+	return SARA_R5_ERROR_SUCCESS;
+}
+
+/**
+ * Runs the queue and hands over the URCs for 'ms' milliseconds, unlike saraR5Delay which drops what arrives.
+ */
+static void saraR5PollFor(uint32_t ms)
+{
+	uint32_t start = saraR5NowMs();
+	uint32_t elapsed = 0;
+
+	while (elapsed < ms)
+	{
+		saraR5Poll();
+		saraR5RxWait(ms - elapsed);
+		elapsed = saraR5NowMs() - start;
+	}
+}
+
+/**
+ * Writes one chunk of at most SARA_R5_SOCKET_MAX_WRITE bytes on a TCP socket: AT+USOWR=<socket>,<length>,
+ * then the bytes as they are after the '@' prompt.
+ * @param accepted Where to store the number of bytes the module took (+USOWR: <socket>,<length>).
+ */
+static uint8_t saraR5SocketWriteChunk(int socket, const uint8_t *data, size_t len, size_t *accepted)
+{
+	char socketDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char lengthDigits[SARA_R5_SEGMENT_INT_SIZE];
+	SARA_R5_socket_written written;
+	SARA_R5_schema_parser parser;
+	uint8_t error;
+
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_WRITE_SOCKET "="),
+		saraR5SegmentInt(socketDigits, socket),
+		SARA_R5_SEGMENT_LITERAL(","),
+		saraR5SegmentUint(lengthDigits, (unsigned long)len),
+		SARA_R5_SEGMENT_LITERAL("\r"),
+	};
+	SARA_R5_segment payload = {(const char *)data, len};
+
+	saraR5SchemaParserInit(&parser, &saraR5SocketWrittenSchema, &written, 1);
+	saraR5QueueMakeRoom();
+	error = saraR5RunCommand(command, SARA_R5_SEGMENT_COUNT(command), &payload, NULL, 0, SARA_R5_SOCKET_WRITE_TIMEOUT, saraR5SchemaParserFeed, &parser);
+	if (error != SARA_R5_ERROR_SUCCESS)
+	{
+		return error;
+	}
+	if (parser.count != 1 || written.socket != socket || written.length > len)
+	{
+		return SARA_R5_ERROR_UNEXPECTED_RESPONSE;
+	}
+	*accepted = written.length;
+	return SARA_R5_ERROR_SUCCESS;
+}
+
+/**
+ * Sends data of any length on a connected TCP socket. The data is split into chunks of SARA_R5_SOCKET_MAX_WRITE bytes,
+ * each written with AT+USOWR in binary mode: after the '@' prompt the bytes go as they are, so any byte is allowed
+ * and hex mode is not needed. Once SARA_R5_SOCKET_MAX_UNACKED bytes may be waiting for their acknowledgement,
+ * the module is asked for the real count (AT+USOCTL) and the call waits, handling the URCs, until the remote end
+ * catches up, so a long upload does not overrun the buffers of the module.
+ * @param socket The ID of the connected TCP socket.
+ * @param data The bytes to send.
+ * @param len The number of bytes.
+ * @param written Where to store the number of bytes the module accepted (may be NULL). Less than 'len' on an error.
+ * @return SARA_R5_ERROR_SUCCESS once every byte is accepted, SARA_R5_ERROR_INVALID_SOCKET if the socket ID is invalid,
+ *         SARA_R5_ERROR_TIMEOUT if the acknowledgements did not come within SARA_R5_SOCKET_FLOW_TIMEOUT,
+ *         SARA_R5_ERROR_ERROR on an error result code or if the module accepted no byte of a chunk,
+ *         or another error of the commands.
+ */
+uint8_t saraR5SocketWrite(int socket, const uint8_t *data, size_t len, size_t *written)
+{
+	size_t sent = 0;
+	size_t unacked = 0; // Bytes sent by this call since the module was last asked, plus its count
+	uint8_t error = SARA_R5_ERROR_SUCCESS;
+
+	if (written != NULL)
+	{
+		*written = 0;
+	}
+	if (saraR5SocketRxGet(socket) == NULL || (data == NULL && len > 0))
+	{
+		return SARA_R5_ERROR_INVALID_SOCKET;
+	}
+
+	while (sent < len && error == SARA_R5_ERROR_SUCCESS)
+	{
+		size_t chunk = (len - sent < SARA_R5_SOCKET_MAX_WRITE) ? len - sent : SARA_R5_SOCKET_MAX_WRITE;
+		size_t accepted = 0;
+		uint32_t start = saraR5NowMs();
+
+		// Only ask the module once the bytes in flight may reach the limit
+		while (unacked + chunk > SARA_R5_SOCKET_MAX_UNACKED && error == SARA_R5_ERROR_SUCCESS)
+		{
+			error = saraR5SocketUnacked(socket, &unacked);
+			if (error != SARA_R5_ERROR_SUCCESS || unacked + chunk <= SARA_R5_SOCKET_MAX_UNACKED || unacked == 0)
+			{
+				break;
+			}
+			if ((saraR5NowMs() - start) >= SARA_R5_SOCKET_FLOW_TIMEOUT)
+			{
+				error = SARA_R5_ERROR_TIMEOUT;
+				break;
+			}
+			saraR5PollFor(SARA_R5_SOCKET_FLOW_POLL);
+		}
+		if (error != SARA_R5_ERROR_SUCCESS)
+		{
+			break;
+		}
+
+		error = saraR5SocketWriteChunk(socket, &data[sent], chunk, &accepted);
+		if (error == SARA_R5_ERROR_SUCCESS && accepted == 0)
+		{
+			error = SARA_R5_ERROR_ERROR; // The module takes nothing, trying again would loop forever
+		}
+		sent += accepted;
+		unacked += accepted;
+	}
+
+	if (written != NULL)
+	{
+		*written = sent;
+	}
+	return error;
+}
+
+/**
+ * Connects again, with its own ID, a socket of the pool the module closed (+UUSOCL). If the module freed the ID,
+ * AT+USOCO fails and the slot is given up, for the caller to open a new socket.
+ * @return SARA_R5_ERROR_SUCCESS, or the error of AT+USOCO.
+ */
+static uint8_t saraR5SocketReconnect(int socket, uint32_t now)
+{
+	SARA_R5_socket_slot *slot = &saraR5SocketSlots[socket];
+	char address[SARA_R5_SOCKET_ADDRESS_SIZE];
+	uint8_t error;
+
+	strcpy(address, slot->address); // saraR5socketClose clears the slot
+	error = saraR5SocketConnect2(socket, address, slot->port, NULL, 0);
+	if (error != SARA_R5_ERROR_SUCCESS)
+	{
+		saraR5socketClose(socket, SARA_R5_STANDARD_RESPONSE_TIMEOUT, NULL, 0);
+		return error;
+	}
+	slot->inUse = true;
+	slot->lastUse = now;
+	return SARA_R5_ERROR_SUCCESS;
+}
+
+/**
+ * Gets a socket connected to an endpoint, for the caller alone until saraR5SocketRelease. An idle socket already
+ * connected to the same endpoint is reused, which saves AT+USOCR and AT+USOCO. A socket of the endpoint the module
+ * closed (+UUSOCL) is connected again with the same ID, which saves AT+USOCR and keeps its security profile, as long
+ * as the module kept the ID. Otherwise a new socket is opened and connected; when every socket ID is taken, the
+ * idle one unused for the longest time is closed first.
+ * Sockets opened with saraR5SocketOpen join the pool once released.
+ * @param protocol SARA_R5_TCP or SARA_R5_UDP (a UDP socket is connected to its default remote end).
+ * @param address The remote IP address or host name, shorter than SARA_R5_SOCKET_ADDRESS_SIZE.
+ * @param port The remote port.
+ * @param socket Where to store the socket ID.
+ * @return SARA_R5_ERROR_SUCCESS, SARA_R5_ERROR_UNEXPECTED_PARAM if the address is too long,
+ *         SARA_R5_ERROR_OUT_OF_MEMORY if every socket is in use, SARA_R5_ERROR_INVALID_SOCKET if no socket
+ *         could be created, or the error of AT+USOCO.
+ */
+uint8_t saraR5SocketAcquire(SARA_R5_socket_protocol_t protocol, const char *address, unsigned int port, int *socket)
+{
+	uint32_t now = saraR5NowMs();
+	size_t open = 0;
+	int oldest = -1;
+	int closed = -1;
+	int id;
+	uint8_t error;
+
+	if (address == NULL || socket == NULL || strlen(address) >= SARA_R5_SOCKET_ADDRESS_SIZE)
+	{
+		return SARA_R5_ERROR_UNEXPECTED_PARAM;
+	}
+	*socket = -1;
+
+	// Take the +UUSOCL already received into account
+	saraR5UrcSetup();
+	saraR5Poll();
+
+	for (id = 0; id < SARA_R5_NUM_SOCKETS; id++)
+	{
+		SARA_R5_socket_slot *slot = &saraR5SocketSlots[id];
+		bool endpoint = !slot->inUse && slot->protocol == protocol && slot->port == port && strcmp(slot->address, address) == 0;
+
+		if (endpoint && slot->state == SARA_R5_SOCKET_CONNECTED)
+		{
+			slot->inUse = true;
+			slot->lastUse = now;
+			*socket = id;
+			return SARA_R5_ERROR_SUCCESS;
+		}
+		if (endpoint && slot->state == SARA_R5_SOCKET_CLOSED && closed < 0)
+		{
+			closed = id;
+		}
+		if (slot->state == SARA_R5_SOCKET_OPEN || slot->state == SARA_R5_SOCKET_CONNECTED)
+		{
+			open++;
+			if (!slot->inUse && (oldest < 0 || (now - slot->lastUse) > (now - saraR5SocketSlots[oldest].lastUse)))
+			{
+				oldest = id;
+			}
+		}
+	}
+
+	// Connect the socket the module closed again, a new one only if its ID is gone
+	if (closed >= 0 && saraR5SocketReconnect(closed, now) == SARA_R5_ERROR_SUCCESS)
+	{
+		*socket = closed;
+		return SARA_R5_ERROR_SUCCESS;
+	}
+
+	// Make room for a new socket
+	if (open >= SARA_R5_NUM_SOCKETS)
+	{
+		if (oldest < 0)
+		{
+			return SARA_R5_ERROR_OUT_OF_MEMORY;
+		}
+		error = saraR5socketClose(oldest, SARA_R5_STANDARD_RESPONSE_TIMEOUT, NULL, 0);
+		if (error != SARA_R5_ERROR_SUCCESS)
+		{
+			return error;
+		}
+	}
+
+	id = saraR5SocketOpen(protocol, 0);
+	if (saraR5SocketRxGet(id) == NULL)
+	{
+		return SARA_R5_ERROR_INVALID_SOCKET; // saraR5SocketOpen returned an error code
+	}
+	error = saraR5SocketConnect2(id, address, port, NULL, 0);
+	if (error != SARA_R5_ERROR_SUCCESS)
+	{
+		saraR5socketClose(id, SARA_R5_STANDARD_RESPONSE_TIMEOUT, NULL, 0);
+		return error;
+	}
+	*socket = id;
+	return SARA_R5_ERROR_SUCCESS;
+}
+
+/**
+ * Gives a socket back to the pool. It stays open and connected, to be reused by saraR5SocketAcquire,
+ * until the pool needs its ID for another endpoint.
+ * @param socket The socket ID.
+ */
+void saraR5SocketRelease(int socket)
+{
+	if (saraR5SocketRxGet(socket) == NULL)
+	{
+		return;
+	}
+	saraR5SocketSlots[socket].inUse = false;
+	saraR5SocketSlots[socket].lastUse = saraR5NowMs();
+}
+
+/**
+ * Sends a message to an endpoint through the socket pool: only the first message to an endpoint opens and
+ * connects a socket, the next ones go straight to AT+USOWR (TCP, see saraR5SocketWrite) or AT+USOST (UDP).
+ * A socket whose write fails is closed, so the next message starts on a new one.
+ * @param protocol SARA_R5_TCP or SARA_R5_UDP.
+ * @param address The remote IP address or host name.
+ * @param port The remote port.
+ * @param data The bytes to send.
+ * @param len The number of bytes.
+ * @return SARA_R5_ERROR_SUCCESS, or the error of saraR5SocketAcquire or of the write.
+ */
+uint8_t saraR5SocketSend(SARA_R5_socket_protocol_t protocol, const char *address, unsigned int port, const uint8_t *data, size_t len)
+{
+	char resolved[SARA_R5_SIZE_IP];
+	const char *target;
+	int socket;
+	uint8_t error = saraR5SocketAcquire(protocol, address, port, &socket);
+
+	if (error != SARA_R5_ERROR_SUCCESS)
+	{
+		return error;
+	}
+	if (protocol == SARA_R5_TCP)
+	{
+		error = saraR5SocketWrite(socket, data, len, NULL);
+	}
+	else
+	{
+		// Every AT+USOST names its destination: a host name is sent resolved, from the cache filled by the connection
+		error = saraR5ResolveTarget(address, resolved, &target);
+		if (error == SARA_R5_ERROR_SUCCESS)
+		{
+			error = saraR5SocketWriteDatagram(socket, target, port, data, len);
+		}
+	}
+
+	if (error != SARA_R5_ERROR_SUCCESS)
+	{
+		saraR5socketClose(socket, SARA_R5_STANDARD_RESPONSE_TIMEOUT, NULL, 0);
+		return error;
+	}
+	saraR5SocketRelease(socket);
+	return SARA_R5_ERROR_SUCCESS;
+}
+
+/**
+ * Gets the state the pool keeps for a socket ID: open, connected and to which endpoint, in use, last use.
+ * @param socket The socket ID.
+ * @return The state, or NULL if the socket ID is invalid.
+ */
+const SARA_R5_socket_slot *saraR5SocketGetSlot(int socket)
+{
+	if (saraR5SocketRxGet(socket) == NULL)
+	{
+		return NULL;
+	}
+	return &saraR5SocketSlots[socket];
+}
+
+/**
+ * Configures the UDP send queue.
+ * @param coalesce true to put the records to the same socket and destination in one datagram, up to 'mtu' bytes
+ *                 and 'latencyMs' of waiting; false to send every record as its own datagram at the next saraR5Poll.
+ * @param mtu The largest datagram built, 1 to SARA_R5_UDP_QUEUE_MTU.
+ * @param latencyMs The longest time the first record of a datagram waits for the next ones.
+ * @return SARA_R5_ERROR_SUCCESS, or SARA_R5_ERROR_UNEXPECTED_PARAM if 'mtu' is out of range.
+ */
+uint8_t saraR5UdpQueueConfigure(bool coalesce, size_t mtu, uint32_t latencyMs)
+{
+	if (mtu == 0 || mtu > SARA_R5_UDP_QUEUE_MTU || mtu > SARA_R5_SOCKET_MAX_WRITE)
+	{
+		return SARA_R5_ERROR_UNEXPECTED_PARAM;
+	}
+	saraR5UdpQueueCoalesce = coalesce;
+	saraR5UdpQueueMtu = mtu;
+	saraR5UdpQueueLatency = latencyMs;
+	return SARA_R5_ERROR_SUCCESS;
+}
+
+/**
+ * Queues a record for a UDP destination and returns at once. saraR5Poll sends the datagrams with AT+USOST (after
+ * the '@' prompt, so the record may hold any byte) and pipelines them through the command queue. With coalescing
+ * (saraR5UdpQueueConfigure) the record is appended to the datagram waiting for the same socket and destination
+ * when it fits, so the records must carry their own framing.
+ * @param socket The ID of the UDP socket.
+ * @param address The destination IP address, shorter than SARA_R5_SOCKET_ADDRESS_SIZE.
+ * @param port The destination port.
+ * @param data The record. It is copied.
+ * @param len The number of bytes, 1 to the MTU of the queue.
+ * @return SARA_R5_ERROR_SUCCESS if the record is queued, SARA_R5_ERROR_OUT_OF_MEMORY if every datagram slot is taken,
+ *         SARA_R5_ERROR_INVALID_SOCKET or SARA_R5_ERROR_UNEXPECTED_PARAM for invalid parameters.
+ */
+uint8_t saraR5UdpQueueSend(int socket, const char *address, unsigned int port, const uint8_t *data, size_t len)
+{
+	SARA_R5_udp_datagram *datagram = NULL;
+
+	if (saraR5SocketRxGet(socket) == NULL)
+	{
+		return SARA_R5_ERROR_INVALID_SOCKET;
+	}
+	if (address == NULL || strlen(address) >= SARA_R5_SOCKET_ADDRESS_SIZE || data == NULL || len == 0 || len > saraR5UdpQueueMtu)
+	{
+		return SARA_R5_ERROR_UNEXPECTED_PARAM;
+	}
+
+	for (size_t i = 0; i < SARA_R5_UDP_QUEUE_DATAGRAMS; i++)
+	{
+		SARA_R5_udp_datagram *waiting = &saraR5UdpQueue[i];
+
+		if (!waiting->used || waiting->closed || waiting->socket != socket || waiting->port != port || strcmp(waiting->address, address) != 0)
+		{
+			continue;
+		}
+		if (waiting->length + len <= saraR5UdpQueueMtu)
+		{
+			datagram = waiting;
+			break;
+		}
+		waiting->closed = true; // Full: it leaves, the record starts the next one
+	}
+
+	if (datagram == NULL)
+	{
+		for (size_t i = 0; i < SARA_R5_UDP_QUEUE_DATAGRAMS && datagram == NULL; i++)
+		{
+			if (!saraR5UdpQueue[i].used)
+			{
+				datagram = &saraR5UdpQueue[i];
+			}
+		}
+		if (datagram == NULL)
+		{
+			return SARA_R5_ERROR_OUT_OF_MEMORY;
+		}
+		memset(datagram, 0, offsetof(SARA_R5_udp_datagram, data));
+		datagram->used = true;
+		datagram->socket = socket;
+		strcpy(datagram->address, address);
+		datagram->port = port;
+		datagram->firstTime = saraR5NowMs();
+	}
+
+	memcpy(&datagram->data[datagram->length], data, len);
+	datagram->length += len;
+	datagram->records++;
+	datagram->closed = !saraR5UdpQueueCoalesce || datagram->length == saraR5UdpQueueMtu;
+	saraR5UdpQueueStats.records++;
+	return SARA_R5_ERROR_SUCCESS;
+}
+
+/**
+ * Sends every datagram of the UDP send queue at once, without waiting for the latency budget, and runs the
+ * command queue until they are all answered.
+ */
+void saraR5UdpQueueFlush(void)
+{
+	bool waiting = true;
+
+	for (size_t i = 0; i < SARA_R5_UDP_QUEUE_DATAGRAMS; i++)
+	{
+		saraR5UdpQueue[i].closed = true;
+	}
+	saraR5QueueHold = false;
+	while (waiting && !saraR5DirectLinkActive)
+	{
+		if (saraR5Poll())
+		{
+			saraR5QueueSleep();
+		}
+		waiting = false;
+		for (size_t i = 0; i < SARA_R5_UDP_QUEUE_DATAGRAMS; i++)
+		{
+			waiting = waiting || saraR5UdpQueue[i].used;
+		}
+	}
+}
+
+/**
+ * Gets the statistics of the UDP send queue since the last reset, with the records sent per second and the
+ * coalescing ratio (records per datagram).
+ * @param stats The statistics to fill.
+ */
+void saraR5UdpQueueGetStats(SARA_R5_udp_queue_stats *stats)
+{
+	*stats = saraR5UdpQueueStats;
+	stats->elapsedMs = saraR5NowMs() - saraR5UdpQueueStatsStart;
+	stats->recordsPerSecond = (stats->elapsedMs > 0) ? (unsigned long)((uint64_t)stats->recordsSent * 1000u / stats->elapsedMs) : 0;
+	stats->coalescing = (stats->datagrams > 0) ? stats->recordsSent * 100u / stats->datagrams : 0;
+}
+
+/**
+ * Resets the statistics of the UDP send queue, e.g. at the start of a measurement.
+ */
+void saraR5UdpQueueResetStats(void)
+{
+	memset(&saraR5UdpQueueStats, 0, sizeof(saraR5UdpQueueStats));
+	saraR5UdpQueueStatsStart = saraR5NowMs();
+}
+
+/**
+ * Completion of AT+USODL: the direct link starts as soon as CONNECT is received, before anything
+ * else is sent, since the bytes that follow are socket data.
+ */
+static void saraR5DirectLinkStarted(uint8_t error, SARA_R5_at_result_t result, int errorCode, const char *response, void *context)
+{
+	saraR5StoreResult(error, result, errorCode, response, context);
+	if (result == SARA_R5_AT_RESULT_CONNECT)
+	{
+		memset(&saraR5DirectLinkStats, 0, sizeof(saraR5DirectLinkStats));
+		saraR5DirectLinkLastSend = saraR5NowMs();
+		saraR5DirectLinkActive = true;
+	}
+}
+
+/**
+ * Switches a connected socket to direct link (transparent) mode: until saraR5DirectLinkExit, the bytes written
+ * with saraR5DirectLinkWrite go to the socket as they are, without AT+USOWR / AT+USOST, and the bytes received
+ * on the socket are read with saraR5DirectLinkRead. Commands cannot be sent meanwhile: the queue is held and
+ * blocking command functions fail with SARA_R5_ERROR_ERROR. URCs are not reported either.
+ * @param socket The ID of the socket, already connected (saraR5SocketConnect2 for TCP).
+ * @return SARA_R5_ERROR_SUCCESS once the module has answered CONNECT, or an error code otherwise.
+ */
+uint8_t saraR5SocketDirectLink(int socket)
+{
+	SARA_R5_command_result wait = {false, SARA_R5_ERROR_NO_RESPONSE, SARA_R5_AT_RESULT_NONE, -1};
+	char socketDigits[SARA_R5_SEGMENT_INT_SIZE];
+	uint8_t error;
+	// e.g. "AT+USODL=0"
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_DIRECT_LINK "="),
+		saraR5SegmentInt(socketDigits, socket),
+		SARA_R5_SEGMENT_LITERAL("\r"),
+	};
+
+	saraR5QueueMakeRoom();
+	error = saraR5QueuePush(command, SARA_R5_SEGMENT_COUNT(command), false, NULL, 0, SARA_R5_10_SEC_TIMEOUT, false, saraR5DirectLinkStarted, &wait);
+	error = saraR5CommandWaitSubmitted(error, &wait);
+	if (error != SARA_R5_ERROR_SUCCESS)
+	{
+		return error;
+	}
+	return saraR5DirectLinkActive ? SARA_R5_ERROR_SUCCESS : SARA_R5_ERROR_UNEXPECTED_RESPONSE;
+}
+
+/**
+ * Writes raw bytes to the socket in direct link mode, at the rate of the line.
+ * @param data The bytes to send.
+ * @param len The number of bytes.
+ * @return true if the bytes are handed to the transport, false otherwise (e.g. no direct link).
+ */
+bool saraR5DirectLinkWrite(const uint8_t *data, size_t len)
+{
+	if (!saraR5DirectLinkActive || !saraR5SendDataUART(data, len))
+	{
+		return false;
+	}
+	saraR5DirectLinkLastSend = saraR5NowMs();
+	saraR5DirectLinkStats.sent += len;
+	return true;
+}
+
+/**
+ * Reads the bytes received on the socket in direct link mode.
+ * @param data Where to store the bytes.
+ * @param len The size of 'data'.
+ * @param timeout The longest time to wait for the first byte, in milliseconds.
+ * @return The number of bytes read, 0 if nothing came in time or there is no direct link.
+ */
+size_t saraR5DirectLinkRead(uint8_t *data, size_t len, unsigned long timeout)
+{
+	uint32_t start = saraR5NowMs();
+	uint32_t elapsed = 0;
+	size_t count;
+
+	if (!saraR5DirectLinkActive)
+	{
+		return 0;
+	}
+
+	do
+	{
+		saraR5RxPump();
+		count = saraR5RingBufferRead(&saraR5RxRing, data, len);
+		if (count > 0)
 		{
-			free(command);
-			return SARA_R5_ERROR_NO_RESPONSE;
+			saraR5DirectLinkStats.received += count;
+			return count;
 		}
-	}
-	free(command);
-	return SARA_R5_ERROR_SUCCESS;
+		saraR5RxWait(timeout - elapsed);
+		elapsed = saraR5NowMs() - start;
+	} while (elapsed < timeout);
+	return 0;
 }
 
 /**
- * Sets the Access Point Name (APN) for a mobile network connection.
- * @param cid The context ID where the APN is to be set.
- * @param pdpType The type of Packet Data Protocol (PDP) to use.
- * @param apn The APN name to be set for the connection.
- * @param buffer A place to store data received from the action.
- * @param size How big the buffer is in bytes.
- * @return A number indicating if the APN was successfully set, or an error code if something went wrong.
+ * Lets SARA_R5_DIRECT_LINK_GUARD_TIME pass from 'since' without sending, keeping what is received.
  */
-uint8_t saraR5NetworkMode(SARA_R5_mode_action mode, const char *buffer, uint8_t size)
+static void saraR5DirectLinkGuard(uint32_t since)
 {
+	uint32_t elapsed;
 
-	// Function to select the mode of network
-	char *command;
-
-	// Allocate memory for the command string
-	// This extra buffer space accommodates additional command parameters and ensures security against buffer overflow.
-	command = saraR5CallocChar(strlen(SARA_R5_OPERATOR_SELECTION) + OPERATOR_SELECTION_MEMORY);
-	if (command == NULL)
+	while ((elapsed = saraR5NowMs() - since) < SARA_R5_DIRECT_LINK_GUARD_TIME)
 	{
-		return SARA_R5_ERROR_OUT_OF_MEMORY;
+		saraR5RxPump();
+		saraR5RxWait(SARA_R5_DIRECT_LINK_GUARD_TIME - elapsed);
 	}
+}
 
-	// Construct the network mode command
-	sprintf(command, "%s=%d\r", SARA_R5_OPERATOR_SELECTION, mode);
+/**
+ * Tells if the module takes commands, by sending AT and waiting for its OK.
+ */
+static bool saraR5DirectLinkProbe(void)
+{
+	char response[STANDARD_RESPONSE_BUFFER_SIZE];
 
-	// Send the command and check for the response
-	if (!saraR5SendCommandWithResponse((const char *)command, (const char *)SARA_RESPONSE_OK, buffer, size, SARA_R5_10_SEC_TIMEOUT))
+	saraR5RxFlush();
+	if (!saraR5SendCommand((const uint8_t *)SARA_R5_COMMAND_AT))
 	{
-		if (strstr(buffer, SARA_RESPONSE_ERROR))
-		{
-			free(command);
-			return SARA_R5_ERROR_ERROR;
-		}
+		return false;
 	}
-
-	free(command); // Free memory after use
-	return SARA_R5_ERROR_SUCCESS;
+	return saraR5ReceiveResponse(response, sizeof(response), SARA_R5_STANDARD_RESPONSE_TIMEOUT) && saraR5Tokenizer.result == SARA_R5_AT_RESULT_OK;
 }
 
 /**
- * Sets the device to choose a mobile network operator automatically.
- * @param buffer A place to store data received after sending the command.
- * @param size The size of the buffer in bytes.
- * @return A number indicating if the operation was successful, or an error code if something went wrong.
+ * Leaves direct link mode with the escape sequence: SARA_R5_DIRECT_LINK_GUARD_TIME of silence, "+++", then the
+ * same silence again, after which the module answers DISCONNECT and takes commands again. The socket stays open.
+ * Socket data received and not read yet is dropped and counted in 'stats->flushed'.
+ * When DISCONNECT does not come, an AT probe tells if the module left the link anyway (the DISCONNECT was lost).
+ * If it did not answer OK the link is kept, the command queue stays held and the escape may be tried again.
+ * @param stats Where to store the byte counts of the session. May be NULL.
+ * @return SARA_R5_ERROR_SUCCESS if the module takes commands again, SARA_R5_ERROR_NO_RESPONSE if it is still in
+ *         the link (call again to retry), or SARA_R5_ERROR_ERROR if there is no direct link.
  */
-uint8_t saraR5AutomaticOperatorSelection(const char *buffer, uint8_t size)
+uint8_t saraR5DirectLinkExit(SARA_R5_direct_link_stats *stats)
 {
+	static const char end[] = SARA_R5_DIRECT_LINK_END;
+	size_t matched = 0;
+	uint32_t start;
+	uint8_t byte;
 
-	// Function to set the device to automatic operator selection mode
-	char *command;
-
-	// Allocate memory for the command string
-	// This extra buffer space accommodates additional command parameters and ensures security against buffer overflow.
-	command = saraR5CallocChar(strlen(SARA_R5_OPERATOR_SELECTION) + AUTO_OPERATOR_SELECTION_MEMORY);
-	if (command == NULL)
+	if (!saraR5DirectLinkActive)
 	{
-		return SARA_R5_ERROR_OUT_OF_MEMORY;
+		return SARA_R5_ERROR_ERROR;
 	}
 
-	// Construct the command for automatic operator selection
-	sprintf(command, "%s=0,0\r", SARA_R5_OPERATOR_SELECTION);
+	// The escape sequence is only recognized between two silences, otherwise it is data
+	saraR5DirectLinkGuard(saraR5DirectLinkLastSend);
+	saraR5SendDataUART((const uint8_t *)SARA_R5_DIRECT_LINK_ESCAPE, strlen(SARA_R5_DIRECT_LINK_ESCAPE));
+	saraR5DirectLinkGuard(saraR5NowMs());
 
-	// Send the command and check for the response
-	if (!saraR5SendCommandWithResponse(command, SARA_RESPONSE_OK, buffer, size, SARA_R5_3_MIN_TIMEOUT))
+	// Drop the data still coming until DISCONNECT
+	start = saraR5NowMs();
+	while (matched < sizeof(end) - 1 && (saraR5NowMs() - start) < SARA_R5_STANDARD_RESPONSE_TIMEOUT)
 	{
-		if (strstr(buffer, SARA_RESPONSE_ERROR))
+		saraR5RxPump();
+		if (saraR5RingBufferRead(&saraR5RxRing, &byte, 1) == 0)
 		{
-			free(command);
-			return SARA_R5_ERROR_ERROR;
+			saraR5RxWait(SARA_R5_STANDARD_RESPONSE_TIMEOUT - (saraR5NowMs() - start));
+			continue;
 		}
+		if ((char)byte == end[matched])
+		{
+			matched++;
+			continue;
+		}
+
+		// What looked like the start of DISCONNECT was data
+		saraR5DirectLinkStats.flushed += matched;
+		matched = ((char)byte == end[0]) ? 1 : 0;
+		saraR5DirectLinkStats.flushed += 1 - matched;
 	}
 
-	free(command);
+	if (stats != NULL)
+	{
+		*stats = saraR5DirectLinkStats;
+	}
+	if (matched < sizeof(end) - 1 && !saraR5DirectLinkProbe())
+	{
+		return SARA_R5_ERROR_NO_RESPONSE; // Still in the link, the queue must not send commands as data
+	}
+	saraR5DirectLinkActive = false;
 	return SARA_R5_ERROR_SUCCESS;
 }
 
 /**
- * Creates a network socket using a specified protocol and local port.
- * @param protocol The type of protocol (TCP, UDP, etc.) for the socket connection.
- * @param localPort The local port number to be used for the socket. If set to 0, the port is assigned automatically.
- * @return Returns the socket ID if the socket is successfully opened, or an error code in case of a failure.
+ * Sets one parameter of a security profile, AT+USECPRF=<profile>[,<op>][,<value>][,"<text>"].
+ * 'op' and 'value' are left out when negative, 'text' when NULL; the profile alone resets it.
  */
-int saraR5SocketOpen(SARA_R5_socket_protocol_t protocol, unsigned long localPort)
+static uint8_t saraR5SecurityParam(int profile, int op, long value, const char *text)
 {
+	char profileDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char opDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char valueDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char *textQuoted = NULL;
+	size_t textQuotedSize = 0;
+	uint8_t error;
+	SARA_R5_segment command[10] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_SECURITY_PROFILE "="),
+	};
+	size_t count = 1;
 
-	char *command;
-	char *response;
-	int sockId = -1;
-	char *responseStart;
-
-	// Allocate memory for the command string
-	// This extra buffer space accommodates additional command parameters and ensures security against buffer overflow.
-	command = saraR5CallocChar(strlen(SARA_R5_CREATE_SOCKET) + CREATE_SOCKET_EXTRA_MEMORY);
-	if (command == NULL)
+	command[count++] = saraR5SegmentInt(profileDigits, profile);
+	if (op >= 0)
 	{
-		return SARA_R5_ERROR_OUT_OF_MEMORY;
+		command[count++] = (SARA_R5_segment)SARA_R5_SEGMENT_LITERAL(",");
+		command[count++] = saraR5SegmentInt(opDigits, op);
 	}
-
-	// Construct the socket open command
-	if (localPort == 0)
-		sprintf(command, "%s=%d\r", SARA_R5_CREATE_SOCKET, (int)protocol);
-	else
-		sprintf(command, "%s=%d,%lu\r", SARA_R5_CREATE_SOCKET, (int)protocol, localPort);
-
-	// Allocate memory for the response
-	response = saraR5CallocChar(STANDARD_RESPONSE_BUFFER_SIZE);
-	if (response == NULL)
+	if (value >= 0)
 	{
-		free(command);
-		return SARA_R5_ERROR_OUT_OF_MEMORY;
+		command[count++] = (SARA_R5_segment)SARA_R5_SEGMENT_LITERAL(",");
+		command[count++] = saraR5SegmentInt(valueDigits, value);
 	}
-	// Send the command and check for the response
-	if (!saraR5SendCommandWithResponse(command, SARA_RESPONSE_OK, response, STANDARD_RESPONSE_BUFFER_SIZE, SARA_R5_STANDARD_RESPONSE_TIMEOUT))
+	if (text != NULL)
 	{
-		free(command);
-		free(response);
-		return SARA_R5_ERROR_ERROR;
+		command[count++] = (SARA_R5_segment)SARA_R5_SEGMENT_LITERAL(",\"");
+		command[count] = saraR5SegmentQuotedAlloc(&textQuoted, &textQuotedSize, text, strlen(text));
+		if (command[count++].data == NULL)
+		{
+			return SARA_R5_ERROR_OUT_OF_MEMORY;
+		}
+		command[count++] = (SARA_R5_segment)SARA_R5_SEGMENT_LITERAL("\"");
 	}
+	command[count++] = (SARA_R5_segment)SARA_R5_SEGMENT_LITERAL("\r");
 
-	// Parse the response to extract socket ID
-	responseStart = strstr(response, "+USOCR:");
-	responseStart += strlen("+USOCR:"); //  Move searchPtr to first char
-	while (*responseStart == ' ')
-		responseStart++;				  // skip spaces
-	sscanf(responseStart, "%d", &sockId); // It extracts an integer from responseStart and stores it in sockId.
-
-	free(command);
-	free(response);
-
-	// Return the socket ID or an error code
-	return (sockId != -1) ? sockId : SARA_R5_ERROR_INVALID_SOCKET;
+	error = saraR5SendSegmentsStreamed(command, count, SARA_R5_STANDARD_RESPONSE_TIMEOUT, NULL, NULL);
+	saraR5FreeChar(textQuoted, textQuotedSize);
+	return error;
 }
 
 /**
- * Closes a specified network socket.
- * @param socket The ID of the socket to be closed.
- * @param timeout The time in milliseconds to wait for the socket to close.
- *                Use the standard timeout for immediate closure.
- * @param buffer A memory area to store the response from the close command.
- * @param size The size of the buffer in bytes.
- * @return Returns a success code if the socket is closed properly, or an error code if the closure fails.
+ * Configures a TLS security profile (AT+USECPRF): resets it to the factory settings, then sets the parameters given.
+ * Certificates and keys are referred to by the names they were imported with (AT+USECMNG).
+ * Sockets use the profile through saraR5SocketSetSecurity, the MQTT client through saraR5SetMQTTsecurity.
+ * With session resumption, every handshake after the first successful one offers the session of the previous one:
+ * the server skips the certificate exchange, which saves kilobytes and round trips on each reconnection.
+ * @param profile The profile, 0 to SARA_R5_SECURITY_PROFILES - 1.
+ * @param settings The parameters.
+ * @return SARA_R5_ERROR_SUCCESS, SARA_R5_ERROR_UNEXPECTED_PARAM if the profile is out of range or a name too long,
+ *         or the error of the first command that failed.
  */
-uint8_t saraR5socketClose(int socket, unsigned long timeout, const char *buffer, uint8_t size)
+uint8_t saraR5SecurityProfileSet(int profile, const SARA_R5_security_profile *settings)
 {
+	uint8_t error;
 
-	char *command;
-	char *response;
-
-	// Allocate memory for the command string
-	// This extra buffer space accommodates additional command parameters and ensures security against buffer overflow.
-	command = saraR5CallocChar(strlen(SARA_R5_CLOSE_SOCKET) + CLOSE_SOCKET_EXTRA_MEMORY);
-	if (command == NULL)
+	if (profile < 0 || profile >= SARA_R5_SECURITY_PROFILES || settings == NULL)
 	{
-		return SARA_R5_ERROR_OUT_OF_MEMORY;
+		return SARA_R5_ERROR_UNEXPECTED_PARAM;
 	}
 
-	// Allocate memory for the response
-	response = saraR5CallocChar(STANDARD_RESPONSE_BUFFER_SIZE);
-	if (response == NULL)
+	// Back to the factory settings first, so nothing is left of an earlier configuration
+	saraR5SecurityResumption[profile] = false;
+	saraR5SecuritySession[profile] = false;
+	error = saraR5SecurityParam(profile, -1, -1, NULL);
+	if (error == SARA_R5_ERROR_SUCCESS && settings->validation != 0)
 	{
-		return SARA_R5_ERROR_OUT_OF_MEMORY;
+		error = saraR5SecurityParam(profile, SARA_R5_SECURITY_VALIDATION, settings->validation, NULL);
+	}
+	if (error == SARA_R5_ERROR_SUCCESS && settings->tlsVersion != 0)
+	{
+		error = saraR5SecurityParam(profile, SARA_R5_SECURITY_TLS_VERSION, settings->tlsVersion, NULL);
 	}
-	// If the standard response is 'timeout', then use the first option; otherwise, use the second option.
-	const char *format = (SARA_R5_STANDARD_RESPONSE_TIMEOUT == timeout) ? "%s=%d,1\r" : "%s=%d\r";
+	if (error == SARA_R5_ERROR_SUCCESS && settings->cipherSuite != 0)
+	{
+		// IANA number as "<high byte>;<low byte>" in hex, e.g. "C0;2F"
+		const char *high = saraR5HexPairs[settings->cipherSuite >> 8];
+		const char *low = saraR5HexPairs[settings->cipherSuite & 0xFF];
+		const char cipher[] = {high[0], high[1], ';', low[0], low[1], '\0'};
 
-	// Construct the socket close command
-	sprintf(command, format, SARA_R5_CLOSE_SOCKET, socket);
+		error = saraR5SecurityParam(profile, SARA_R5_SECURITY_CIPHER_SUITE, 99, cipher);
+	}
+	if (error == SARA_R5_ERROR_SUCCESS && settings->rootCa != NULL)
+	{
+		error = saraR5SecurityParam(profile, SARA_R5_SECURITY_ROOT_CA, -1, settings->rootCa);
+	}
+	if (error == SARA_R5_ERROR_SUCCESS && settings->hostname != NULL)
+	{
+		error = saraR5SecurityParam(profile, SARA_R5_SECURITY_HOSTNAME, -1, settings->hostname);
+	}
+	if (error == SARA_R5_ERROR_SUCCESS && settings->clientCert != NULL)
+	{
+		error = saraR5SecurityParam(profile, SARA_R5_SECURITY_CLIENT_CERT, -1, settings->clientCert);
+	}
+	if (error == SARA_R5_ERROR_SUCCESS && settings->clientKey != NULL)
+	{
+		error = saraR5SecurityParam(profile, SARA_R5_SECURITY_CLIENT_KEY, -1, settings->clientKey);
+	}
+	if (error == SARA_R5_ERROR_SUCCESS && settings->sni != NULL)
+	{
+		error = saraR5SecurityParam(profile, SARA_R5_SECURITY_SNI, -1, settings->sni);
+	}
+	if (error == SARA_R5_ERROR_SUCCESS && settings->sessionResumption)
+	{
+		error = saraR5SecurityParam(profile, SARA_R5_SECURITY_RESUMPTION, 1, NULL);
+		saraR5SecurityResumption[profile] = (error == SARA_R5_ERROR_SUCCESS);
+	}
+	return error;
+}
 
-	// Send the command and check for the response
-	if (!saraR5SendCommandWithResponse(command, SARA_RESPONSE_OK, buffer, size, SARA_R5_10_SEC_TIMEOUT))
+/**
+ * Gets the handshake statistics of a security profile since boot: how many secure connections ran a full
+ * handshake or offered the previous session, and how long they took. A handshake is timed from the command that
+ * starts it (AT+USOCO, AT+UMQTTC=1) to the connection being up (its answer, the +UUMQTTC URC).
+ * @param profile The profile, 0 to SARA_R5_SECURITY_PROFILES - 1.
+ * @param stats Where to store the statistics.
+ * @return SARA_R5_ERROR_SUCCESS, or SARA_R5_ERROR_UNEXPECTED_PARAM if the profile is out of range.
+ */
+uint8_t saraR5SecurityGetStats(int profile, SARA_R5_security_stats *stats)
+{
+	if (profile < 0 || profile >= SARA_R5_SECURITY_PROFILES || stats == NULL)
 	{
-		if (strstr(buffer, SARA_RESPONSE_ERROR))
-		{
-			free(command);
-			free(response);
-			return SARA_R5_ERROR_ERROR;
-		}
+		return SARA_R5_ERROR_UNEXPECTED_PARAM;
 	}
-	free(command);
-	free(response);
+	*stats = saraR5SecurityStats[profile];
+	stats->fullAverageMs = (stats->fullHandshakes > 0) ? stats->fullMs / stats->fullHandshakes : 0;
+	stats->resumedAverageMs = (stats->resumedHandshakes > 0) ? stats->resumedMs / stats->resumedHandshakes : 0;
 	return SARA_R5_ERROR_SUCCESS;
 }
 
 /**
- * Connects an existing network socket to a specific IP address and port.
- * @param socket The ID of the socket to be connected.
- * @param ip The IP address to connect the socket to, provided as a structured format.
- * @param port The port number to connect the socket to.
- * @param buffer A memory area to store the response from the connect command.
+ * Sets the MQTT client ID for a MQTT profile.
+ * @param clientId The MQTT client ID to be set.
+ * @param buffer A memory area to store the response from the setting attempt.
  * @param size The size of the buffer in bytes.
- * @return Returns a success code if the connection is established, or an error code if the connection fails.
+ * @return Returns a success code if the client ID is successfully set, or an error code if the attempt fails.
  */
-uint8_t saraR5SocketConnect(int socket, Ip_adress ip, unsigned int port, const char *buffer, uint8_t size)
+uint8_t saraR5SetMQTTclientId(const char *clientId, const char *buffer, size_t size)
 {
+	SARA_R5_command_result wait = {false, SARA_R5_ERROR_NO_RESPONSE, SARA_R5_AT_RESULT_NONE, -1};
 
-	char *charAddress = saraR5CallocChar(SARA_R5_SIZE_IP);
-
-	if (charAddress == NULL)
+	// Queue the command and wait for it
+	// If the response is not OK, return an error code.
+	saraR5QueueMakeRoom();
+	if (saraR5CommandWaitSubmitted(saraR5SetMQTTclientIdAsync(clientId, buffer, size, saraR5StoreResult, &wait), &wait) != SARA_R5_ERROR_SUCCESS)
 	{
-		return false;
+		return SARA_R5_ERROR_ERROR;
 	}
-
-	memset(charAddress, 0, SARA_R5_SIZE_IP);
-
-	// Convert the IP address structure to a string representation
-	sprintf(charAddress, "%d.%d.%d.%d", ip.first_ip, ip.second_ip, ip.third_ip, ip.fourth_ip);
-
-	// Call the function to send the command to connect
-	uint8_t connectResult = saraR5SocketConnect2(socket, (const char *)charAddress, port, buffer, size);
-
-	free(charAddress);
-	return connectResult;
+	return SARA_R5_ERROR_SUCCESS;
 }
 
 /**
- * Establishes a network connection for a given socket to a specified IP address and port.
- * @param socket The ID of the socket to be connected.
- * @param address The IP address in string format to connect the socket to.
- * @param port The port number to connect the socket to.
- * @param buffer A memory area to store the response from the connection attempt.
+ * Queues the MQTT client ID setting and returns at once. It may be chained with the other MQTT settings.
+ * @param clientId The MQTT client ID to be set.
+ * @param buffer A memory area to store the response (may be NULL). It must live until the callback.
  * @param size The size of the buffer in bytes.
- * @return Returns a success code if the connection is successfully made, or an error code if the connection attempt fails.
+ * @param callback Function called with the result once the module has answered (may be NULL).
+ * @param context Pointer passed back to the callback.
+ * @return SARA_R5_ERROR_SUCCESS if the command is queued, SARA_R5_ERROR_OUT_OF_MEMORY if the queue is full
+ *         or the command gets no memory, or SARA_R5_ERROR_UNEXPECTED_PARAM if it is too long for a SARA_R5_NO_HEAP build.
  */
-uint8_t saraR5SocketConnect2(int socket, const char *address, unsigned int port, const char *buffer, uint8_t size)
+uint8_t saraR5SetMQTTclientIdAsync(const char *clientId, const char *buffer, size_t size, SARA_R5_command_callback callback, void *context)
 {
+	char opDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char *clientIdQuoted;
+	size_t clientIdQuotedSize;
+	uint8_t error;
 
-	char *command;
+	// Construct the command to set the MQTT client ID
+	// The command is formatted with the MQTT profile and client ID, which is sent from the caller's string.
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_MQTT_PROFILE "="),
+		saraR5SegmentInt(opDigits, SARA_R5_MQTT_PROFILE_CLIENT_ID),
+		SARA_R5_SEGMENT_LITERAL(",\""),
+		saraR5SegmentQuotedAlloc(&clientIdQuoted, &clientIdQuotedSize, clientId, strlen(clientId)),
+		SARA_R5_SEGMENT_LITERAL("\"\r"),
+	};
 
-	// Allocate memory for the command string
-	// This extra buffer space accommodates additional command parameters and ensures security against buffer overflow.
-	command = saraR5CallocChar(strlen(SARA_R5_CONNECT_SOCKET) + strlen(address) + CONNECT_SOCKET_EXTRA_MEMORY);
-	if (command == NULL)
+	if (command[3].data == NULL)
 	{
 		return SARA_R5_ERROR_OUT_OF_MEMORY;
 	}
+	error = saraR5SubmitCommand(command, SARA_R5_SEGMENT_COUNT(command), buffer, size, SARA_R5_STANDARD_RESPONSE_TIMEOUT, true, callback, context);
+	saraR5FreeChar(clientIdQuoted, clientIdQuotedSize); // The queue holds a copy of the command
+	return error;
+}
 
-	// Construct the command to connect the socket
-	sprintf(command, "%s=%d,\"%s\",%d\r", SARA_R5_CONNECT_SOCKET, socket, address, port);
+/**
+ * Sets the MQTT server details for a MQTT profile.
+ * @param serverName The name of the server to be set in the MQTT profile.
+ * @param port The port number for the MQTT server.
+ * @param buffer A memory area to store the response from the setting attempt.
+ * @param size The size of the buffer in bytes.
+ * @return Returns a success code if the server details are successfully set, or an error code if the attempt fails.
+ */
+uint8_t saraR5SetMQTTserver(const char *serverName, int port, const char *buffer, size_t size)
+{
+	SARA_R5_command_result wait = {false, SARA_R5_ERROR_NO_RESPONSE, SARA_R5_AT_RESULT_NONE, -1};
 
-	// Send the command and check for the response
-	if (!saraR5SendCommandWithResponse(command, SARA_RESPONSE_OK, buffer, size, SARA_R5_IP_CONNECT_TIMEOUT))
+	// Queue the command and wait for it
+	// If the response is not OK, return an error code.
+	saraR5QueueMakeRoom();
+	if (saraR5CommandWaitSubmitted(saraR5SetMQTTserverAsync(serverName, port, buffer, size, saraR5StoreResult, &wait), &wait) != SARA_R5_ERROR_SUCCESS)
 	{
-		if (strstr(buffer, SARA_RESPONSE_ERROR))
-		{
-			free(command);
-			return SARA_R5_ERROR_ERROR;
-		}
+		return SARA_R5_ERROR_ERROR;
 	}
-
-	free(command);
 	return SARA_R5_ERROR_SUCCESS;
 }
 
 /**
- * Sends data through a UDP socket to a specified IP address and port.
- * @param socket The ID of the UDP socket to use for sending data.
- * @param address The destination IP address in string format.
- * @param port The destination port number.
- * @param str The string data to be sent.
- * @param len The length of the data to send. If set to -1, the function calculates the length automatically.
- * @return Returns a success code if the data is sent successfully, or an error code if the sending fails.
+ * Queues the MQTT server setting and returns at once. It may be chained with the other MQTT settings.
+ * @param serverName The name of the server to be set in the MQTT profile.
+ * @param port The port number for the MQTT server.
+ * @param buffer A memory area to store the response (may be NULL). It must live until the callback.
+ * @param size The size of the buffer in bytes.
+ * @param callback Function called with the result once the module has answered (may be NULL).
+ * @param context Pointer passed back to the callback.
+ * @return SARA_R5_ERROR_SUCCESS if the command is queued, SARA_R5_ERROR_OUT_OF_MEMORY if the queue is full
+ *         or the command gets no memory, or SARA_R5_ERROR_UNEXPECTED_PARAM if it is too long for a SARA_R5_NO_HEAP build.
  */
-uint8_t saraR5SocketWriteUDP(int socket, const char *address, int port, const char *str, int len)
+uint8_t saraR5SetMQTTserverAsync(const char *serverName, int port, const char *buffer, size_t size, SARA_R5_command_callback callback, void *context)
 {
+	char opDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char *serverQuoted;
+	size_t serverQuotedSize;
+	uint8_t error;
+	char portDigits[SARA_R5_SEGMENT_INT_SIZE];
 
-	char *command;
-	char *response;
-	char *responseData;
-
-	// Determine the data length
-	int dataLen = len == -1 ? strlen(str) : len;
-
-	// Allocate memory for the command string
-	// This extra buffer space accommodates additional command parameters and ensures security against buffer overflow.
-	command = saraR5CallocChar(SMALL_RESPONSE_BUFFER_SIZE);
-	if (command == NULL)
-	{
-		return SARA_R5_ERROR_OUT_OF_MEMORY;
-	}
-
-	// Allocate memory for the command response
-	response = saraR5CallocChar(STANDARD_RESPONSE_BUFFER_SIZE);
-	if (response == NULL)
-	{
-		free(command);
-		return SARA_R5_ERROR_OUT_OF_MEMORY;
-	}
+	// Construct the command to set the MQTT server details
+	// The command is formatted with the MQTT profile, server name, and port.
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_MQTT_PROFILE "="),
+		saraR5SegmentInt(opDigits, SARA_R5_MQTT_PROFILE_SERVERNAME),
+		SARA_R5_SEGMENT_LITERAL(",\""),
+		saraR5SegmentQuotedAlloc(&serverQuoted, &serverQuotedSize, serverName, strlen(serverName)),
+		SARA_R5_SEGMENT_LITERAL("\","),
+		saraR5SegmentInt(portDigits, port),
+		SARA_R5_SEGMENT_LITERAL("\r"),
+	};
 
-	// Allocate memory for the data response
-	responseData = saraR5CallocChar(len);
-	if (response == NULL)
+	if (command[3].data == NULL)
 	{
-		free(command);
-		free(response);
 		return SARA_R5_ERROR_OUT_OF_MEMORY;
 	}
-
-	// Construct the command to write data to the UDP socket
-	sprintf(command, "%s=%d,\"%s\",%d,%d\r", SARA_R5_WRITE_UDP_SOCKET, socket, address, port, dataLen);
-
-	// Send the command and check for the response
-	if (!saraR5SendCommandWithResponse(command, SARA_RESPONSE_OK, response, STANDARD_RESPONSE_BUFFER_SIZE, SARA_R5_STANDARD_RESPONSE_TIMEOUT * 5))
-	{
-		free(command);
-		free(response);
-		free(responseData);
-		return SARA_R5_ERROR_ERROR;
-	}
-
-	if (!saraR5SendCommandWithResponse(str, SARA_RESPONSE_OK, responseData, len, SARA_R5_STANDARD_RESPONSE_TIMEOUT))
-	{
-		free(command);
-		free(response);
-		free(responseData);
-		return SARA_R5_ERROR_ERROR;
-	}
-
-	free(command);
-	free(response);
-	free(responseData);
-	return SARA_R5_ERROR_SUCCESS;
+	error = saraR5SubmitCommand(command, SARA_R5_SEGMENT_COUNT(command), buffer, size, SARA_R5_STANDARD_RESPONSE_TIMEOUT, true, callback, context);
+	saraR5FreeChar(serverQuoted, serverQuotedSize); // The queue holds a copy of the command
+	return error;
 }
 
 /**
- * Sets the MQTT client ID for a MQTT profile.
- * @param clientId The MQTT client ID to be set.
+ * Makes the MQTT client connect over TLS with a security profile (AT+UMQTT=11), or in plain TCP again.
+ * saraR5MQTTconect then times the handshake in the statistics of the profile (saraR5SecurityGetStats).
+ * @param profile The security profile (see saraR5SecurityProfileSet), or SARA_R5_SECURITY_NONE.
  * @param buffer A memory area to store the response from the setting attempt.
  * @param size The size of the buffer in bytes.
- * @return Returns a success code if the client ID is successfully set, or an error code if the attempt fails.
+ * @return Returns a success code if the setting is made, or an error code if the attempt fails.
  */
-uint8_t saraR5SetMQTTclientId(const char *clientId, const char *buffer, int size)
+uint8_t saraR5SetMQTTsecurity(int profile, const char *buffer, size_t size)
 {
-	char *command;
-	
-	// Allocate memory for the command string
-	// This extra memory ensures there is sufficient space for the MQTT profile and client ID, preventing buffer overflow.
-	command = saraR5CallocChar(strlen(SARA_R5_MQTT_PROFILE) + strlen(clientId) + SARA_R5_MQTT_CLIENT_EXTRA_MEMMORY);
-	if (command == NULL)
-	{
-		// Return an error code if memory allocation fails
-		return SARA_R5_ERROR_OUT_OF_MEMORY;
-	}
-	
-	// Construct the command to set the MQTT client ID
-	// The command is formatted with the MQTT profile and client ID.
-	sprintf(command, "%s=%d,\"%s\"\r", SARA_R5_MQTT_PROFILE, SARA_R5_MQTT_PROFILE_CLIENT_ID, clientId);
-	
-	// Send the command and check for the response
-	// If the response is not OK, free the memory and return an error code.
-	if(!saraR5SendCommandWithResponse(command, SARA_RESPONSE_OK, buffer, size,SARA_R5_STANDARD_RESPONSE_TIMEOUT))
+	SARA_R5_command_result wait = {false, SARA_R5_ERROR_NO_RESPONSE, SARA_R5_AT_RESULT_NONE, -1};
+
+	// Queue the command and wait for it
+	saraR5QueueMakeRoom();
+	if (saraR5CommandWaitSubmitted(saraR5SetMQTTsecurityAsync(profile, buffer, size, saraR5StoreResult, &wait), &wait) != SARA_R5_ERROR_SUCCESS)
 	{
-		// Free the allocated memory and return an error code if the response is not as expected
-		free (command);
 		return SARA_R5_ERROR_ERROR;
 	}
-	// Free the allocated memory for the command string and return a success code
-	free (command);
 	return SARA_R5_ERROR_SUCCESS;
 }
 
 /**
- * Sets the MQTT server details for a MQTT profile.
- * @param serverName The name of the server to be set in the MQTT profile.
- * @param port The port number for the MQTT server.
- * @param buffer A memory area to store the response from the setting attempt.
+ * Queues the MQTT security setting and returns at once. It may be chained with the other MQTT settings.
+ * @param profile The security profile (see saraR5SecurityProfileSet), or SARA_R5_SECURITY_NONE.
+ * @param buffer A memory area to store the response (may be NULL). It must live until the callback.
  * @param size The size of the buffer in bytes.
- * @return Returns a success code if the server details are successfully set, or an error code if the attempt fails.
+ * @param callback Function called with the result once the module has answered (may be NULL).
+ * @param context Pointer passed back to the callback.
+ * @return SARA_R5_ERROR_SUCCESS if the command is queued, SARA_R5_ERROR_OUT_OF_MEMORY if the queue is full,
+ *         or SARA_R5_ERROR_UNEXPECTED_PARAM if the profile is out of range.
  */
-uint8_t saraR5SetMQTTserver(const char *serverName, int port, const char *buffer, int size)
+uint8_t saraR5SetMQTTsecurityAsync(int profile, const char *buffer, size_t size, SARA_R5_command_callback callback, void *context)
 {
-	char *command;
-	
-	// Allocate memory for the command string
-	// This extra memory is to ensure there's enough space for the MQTT profile, server name, and port to prevent buffer overflow.
-	command = saraR5CallocChar(strlen(SARA_R5_MQTT_PROFILE) + strlen(serverName) + SARA_R5_MQTT_SERVER_EXTRA_MEMMORY);
-	if (command == NULL)
+	char opDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char profileDigits[SARA_R5_SEGMENT_INT_SIZE];
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_MQTT_PROFILE "="),
+		saraR5SegmentInt(opDigits, SARA_R5_MQTT_PROFILE_SECURE),
+		SARA_R5_SEGMENT_LITERAL(",1,"),
+		saraR5SegmentInt(profileDigits, profile),
+		SARA_R5_SEGMENT_LITERAL("\r"),
+	};
+	size_t count = SARA_R5_SEGMENT_COUNT(command);
+	uint8_t error;
+
+	if (profile == SARA_R5_SECURITY_NONE)
 	{
-		// Return an error code if memory allocation fails
-		return SARA_R5_ERROR_OUT_OF_MEMORY;
+		command[2] = (SARA_R5_segment)SARA_R5_SEGMENT_LITERAL(",0\r");
+		count = 3;
 	}
-	
-	// Construct the command to set the MQTT server details
-	// The command is formatted with the MQTT profile, server name, and port.
-	sprintf(command, "%s=%d,\"%s\",%d\r", SARA_R5_MQTT_PROFILE, SARA_R5_MQTT_PROFILE_SERVERNAME, serverName, port);
-	
-	// Send the command and check for the response
-	// If the response is not OK, free the memory and return an error code.
-	if(!saraR5SendCommandWithResponse(command, SARA_RESPONSE_OK, buffer,size,SARA_R5_STANDARD_RESPONSE_TIMEOUT))
+	else if (profile < 0 || profile >= SARA_R5_SECURITY_PROFILES)
 	{
-		// Free the allocated memory and return an error code if the response is not as expected
-		free (command);
-		return SARA_R5_ERROR_ERROR;
+		return SARA_R5_ERROR_UNEXPECTED_PARAM;
 	}
-	// Free the allocated memory for the command string and return a success code
-	free (command);
-	return SARA_R5_ERROR_SUCCESS;
+
+	error = saraR5SubmitCommand(command, count, buffer, size, SARA_R5_STANDARD_RESPONSE_TIMEOUT, true, callback, context);
+	if (error == SARA_R5_ERROR_SUCCESS)
+	{
+		saraR5MqttSecurity = profile;
+	}
+	return error;
 }
 
 /**
@@ -834,35 +4910,50 @@ uint8_t saraR5SetMQTTserver(const char *serverName, int port, const char *buffer
  * @param size The size of the buffer in bytes.
  * @return Returns a success code if the MQTT connection is successfully initiated, or an error code if the attempt fails.
  */
-uint8_t saraR5MQTTconect(const char *buffer, int size)
+uint8_t saraR5MQTTconect(const char *buffer, size_t size)
 {
-	char *command;
-	
-	// Allocate memory for the command string
-	// This extra memory ensures there's enough space for the MQTT command plus additional space to prevent buffer overflow.
-	command = saraR5CallocChar(strlen(SARA_R5_MQTT_COMMAND) + SARA_R5_MQTT_CONNECTION_EXTRA_MEMMORY);
-	if (command == NULL)
+	SARA_R5_command_result wait = {false, SARA_R5_ERROR_NO_RESPONSE, SARA_R5_AT_RESULT_NONE, -1};
+
+	// Queue the command and wait for it
+	// If the response is not OK, return an error code.
+	saraR5QueueMakeRoom();
+	if (saraR5CommandWaitSubmitted(saraR5MQTTconectAsync(buffer, size, saraR5StoreResult, &wait), &wait) != SARA_R5_ERROR_SUCCESS)
 	{
-		// Return an error code if memory allocation fails
-		return SARA_R5_ERROR_OUT_OF_MEMORY;
+		return SARA_R5_ERROR_ERROR;
 	}
-	
+	return SARA_R5_ERROR_SUCCESS;
+}
+
+/**
+ * Queues the connection to the MQTT server and returns at once.
+ * The OK only means the login was sent, the +UUMQTTC URC tells when the broker accepted it.
+ * @param buffer A memory area to store the response (may be NULL). It must live until the callback.
+ * @param size The size of the buffer in bytes.
+ * @param callback Function called with the result once the module has answered (may be NULL).
+ * @param context Pointer passed back to the callback.
+ * @return SARA_R5_ERROR_SUCCESS if the command is queued, or SARA_R5_ERROR_OUT_OF_MEMORY if the queue is full.
+ */
+uint8_t saraR5MQTTconectAsync(const char *buffer, size_t size, SARA_R5_command_callback callback, void *context)
+{
+	char opDigits[SARA_R5_SEGMENT_INT_SIZE];
+
 	// Construct the command to initiate the MQTT connection
 	// The command is formatted with the MQTT connection command.
-	sprintf(command, "%s=%d\r", SARA_R5_MQTT_COMMAND, SARA_R5_MQTT_COMMAND_LOGIN);
-	
-	// Send the command and check for the response
-	// If the response is not OK, free the memory and return an error code.
-	if(!saraR5SendCommandWithResponse(command, SARA_RESPONSE_OK, buffer,size,SARA_R5_STANDARD_RESPONSE_TIMEOUT))
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_MQTT_COMMAND "="),
+		saraR5SegmentInt(opDigits, SARA_R5_MQTT_COMMAND_LOGIN),
+		SARA_R5_SEGMENT_LITERAL("\r"),
+	};
+	uint8_t error;
+
+	error = saraR5SubmitCommand(command, SARA_R5_SEGMENT_COUNT(command), buffer, size, SARA_R5_STANDARD_RESPONSE_TIMEOUT, false, callback, context);
+	if (error == SARA_R5_ERROR_SUCCESS && saraR5MqttSecurity != SARA_R5_SECURITY_NONE)
 	{
-		// Free the allocated memory and return an error code if the response is not as expected
-		free (command);
-		return SARA_R5_ERROR_ERROR;
+		// The handshake is over when +UUMQTTC reports the login
+		saraR5MqttLoginPending = true;
+		saraR5MqttLoginTime = saraR5NowMs();
 	}
-	
-	// Free the allocated memory for the command string and return a success code
-	free (command);
-	return SARA_R5_ERROR_SUCCESS;
+	return error;
 }
 
 /**
@@ -871,35 +4962,25 @@ uint8_t saraR5MQTTconect(const char *buffer, int size)
  * @param size The size of the buffer in bytes.
  * @return Returns a success code if the MQTT disconnection is successfully completed, or an error code if the attempt fails.
  */
-uint8_t saraR5MQTTdisconnect(const char* buffer, int size)
-{
-    char *command;
-    
-    // Allocate memory for the command string
-    // This extra memory is to ensure there's enough space for the MQTT command and to prevent buffer overflow.
-    command = saraR5CallocChar(strlen(SARA_R5_MQTT_COMMAND) + SARA_R5_MQTT_CONNECTION_EXTRA_MEMMORY);
-    if (command == NULL)
-    {
-    	// Return an error code if memory allocation fails
-    	return SARA_R5_ERROR_OUT_OF_MEMORY;
-    }
-    
-    // Construct the command to disconnect from the MQTT server
-    // The command is formatted with the MQTT disconnection command.
-    sprintf(command, "%s=%d\r", SARA_R5_MQTT_COMMAND, SARA_R5_MQTT_COMMAND_LOGOUT);
-
-    // Send the command and check for the response
-    // If the response is not OK, free the memory and return an error code.	
-    if(!saraR5SendCommandWithResponse(command, SARA_RESPONSE_OK, buffer,size,SARA_R5_STANDARD_RESPONSE_TIMEOUT)) // NULL i 0 per no posar un buffer
-    {
-    	// Free the allocated memory and return an error code if the response is not as expected
-    	free (command);
-    	return SARA_R5_ERROR_ERROR;
-    }
-    
-    // Free the allocated memory for the command string and return a success code
-    free (command);
-    return SARA_R5_ERROR_SUCCESS;
+uint8_t saraR5MQTTdisconnect(const char *buffer, size_t size)
+{
+	char opDigits[SARA_R5_SEGMENT_INT_SIZE];
+
+	// Construct the command to disconnect from the MQTT server
+	// The command is formatted with the MQTT disconnection command.
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_MQTT_COMMAND "="),
+		saraR5SegmentInt(opDigits, SARA_R5_MQTT_COMMAND_LOGOUT),
+		SARA_R5_SEGMENT_LITERAL("\r"),
+	};
+
+	// Send the command and check for the response
+	// If the response is not OK, return an error code.
+	if(!saraR5SendSegmentsWithResponse(command, SARA_R5_SEGMENT_COUNT(command), SARA_RESPONSE_OK, buffer,size,SARA_R5_STANDARD_RESPONSE_TIMEOUT))
+	{
+		return SARA_R5_ERROR_ERROR;
+	}
+	return SARA_R5_ERROR_SUCCESS;
 }
 
 /**
@@ -910,34 +4991,39 @@ uint8_t saraR5MQTTdisconnect(const char* buffer, int size)
  */
 uint8_t saraR5SubscribeMQTTtopic(int max_Qos, const char *topic)
 {
-  char *command;
-  
-  // Allocate memory for the command string
-  // This extra memory accounts for the MQTT command, topic, and additional space to prevent buffer overflow.
-  command = saraR5CallocChar(strlen(SARA_R5_MQTT_COMMAND) + strlen(topic) + SARA_R5_MQTT_TOPIC_EXTRA_MEMMORY + strlen(topic));
-  if (command == NULL)
-  {
-	  // Return an error code if memory allocation fails
-	  return SARA_R5_ERROR_OUT_OF_MEMORY;
-  }
-  
-  // Construct the command to subscribe to the MQTT topic
-  // The command is formatted with the MQTT subscribe command, maximum QoS, and topic.
-  sprintf(command, "%s=%d,%d,\"%s\"\r", SARA_R5_MQTT_COMMAND, SARA_R5_MQTT_COMMAND_SUBSCRIBE, max_Qos, topic);
-  
-  // Send the command and check for the response
-  // If the response is not OK, free the memory and return an error code.
-  // Note: NULL and 0 are passed to avoid using a buffer for the response.
-  if(!saraR5SendCommandWithResponse(command, SARA_RESPONSE_OK, NULL,0,SARA_R5_STANDARD_RESPONSE_TIMEOUT)) // NULL i 0 per no posar un buffer
-  {
-	  // Free the allocated memory and return an error code if the response is not as expected
-	  free (command);
-	  return SARA_R5_ERROR_ERROR;
-  }
-
-  // Free the allocated memory for the command string and return a success code
-  free (command);
-  return SARA_R5_ERROR_SUCCESS;
+	char opDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char *topicQuoted;
+	size_t topicQuotedSize;
+	bool sent;
+	char qosDigits[SARA_R5_SEGMENT_INT_SIZE];
+
+	// Construct the command to subscribe to the MQTT topic
+	// The command is formatted with the MQTT subscribe command, maximum QoS, and topic.
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_MQTT_COMMAND "="),
+		saraR5SegmentInt(opDigits, SARA_R5_MQTT_COMMAND_SUBSCRIBE),
+		SARA_R5_SEGMENT_LITERAL(","),
+		saraR5SegmentInt(qosDigits, max_Qos),
+		SARA_R5_SEGMENT_LITERAL(",\""),
+		saraR5SegmentQuotedAlloc(&topicQuoted, &topicQuotedSize, topic, strlen(topic)),
+		SARA_R5_SEGMENT_LITERAL("\"\r"),
+	};
+
+	if (command[5].data == NULL)
+	{
+		return SARA_R5_ERROR_OUT_OF_MEMORY;
+	}
+
+	// Send the command and check for the response
+	// If the response is not OK, return an error code.
+	// Note: NULL and 0 are passed to avoid using a buffer for the response.
+	sent = saraR5SendSegmentsWithResponse(command, SARA_R5_SEGMENT_COUNT(command), SARA_RESPONSE_OK, NULL, 0, SARA_R5_STANDARD_RESPONSE_TIMEOUT);
+	saraR5FreeChar(topicQuoted, topicQuotedSize);
+	if (!sent)
+	{
+		return SARA_R5_ERROR_ERROR;
+	}
+	return SARA_R5_ERROR_SUCCESS;
 }
 
 /**
@@ -947,34 +5033,36 @@ uint8_t saraR5SubscribeMQTTtopic(int max_Qos, const char *topic)
  */
 uint8_t saraR5UnsubscribeMQTTtopic(const char *topic)
 {
-  char *command;
-
-  // Allocate memory for the command string
-  // This extra memory is to ensure there's enough space for the MQTT command and topic, and to prevent buffer overflow.
-  command = saraR5CallocChar(strlen(SARA_R5_MQTT_COMMAND) + strlen(topic) + SARA_R5_MQTT_TOPIC_EXTRA_MEMMORY + strlen(topic));
-  if (command == NULL)
-  {
-	  // Return an error code if memory allocation fails
-	  return SARA_R5_ERROR_OUT_OF_MEMORY;
-  }
-  
-  // Construct the command to unsubscribe from the MQTT topic
-  // The command is formatted with the MQTT unsubscribe command and the topic.
-  sprintf(command, "%s=%d,\"%s\"\r", SARA_R5_MQTT_COMMAND, SARA_R5_MQTT_COMMAND_UNSUBSCRIBE, topic);
-  
-  // Send the command and check for the response
-  // If the response is not OK, free the memory and return an error code.
-  // Note: NULL and 0 are passed to avoid using a buffer for the response.
-  if(!saraR5SendCommandWithResponse(command, SARA_RESPONSE_OK, NULL,0,SARA_R5_STANDARD_RESPONSE_TIMEOUT)) // NULL i 0 per no posar un buffer
-  {
-	// Free the allocated memory and return an error code if the response is not as expected
-	free (command);
-	return SARA_R5_ERROR_ERROR;
-  }
-
-  // Free the allocated memory for the command string and return a success code
-  free (command);
-  return SARA_R5_ERROR_SUCCESS;
+	char opDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char *topicQuoted;
+	size_t topicQuotedSize;
+	bool sent;
+
+	// Construct the command to unsubscribe from the MQTT topic
+	// The command is formatted with the MQTT unsubscribe command and the topic.
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_MQTT_COMMAND "="),
+		saraR5SegmentInt(opDigits, SARA_R5_MQTT_COMMAND_UNSUBSCRIBE),
+		SARA_R5_SEGMENT_LITERAL(",\""),
+		saraR5SegmentQuotedAlloc(&topicQuoted, &topicQuotedSize, topic, strlen(topic)),
+		SARA_R5_SEGMENT_LITERAL("\"\r"),
+	};
+
+	if (command[3].data == NULL)
+	{
+		return SARA_R5_ERROR_OUT_OF_MEMORY;
+	}
+
+	// Send the command and check for the response
+	// If the response is not OK, return an error code.
+	// Note: NULL and 0 are passed to avoid using a buffer for the response.
+	sent = saraR5SendSegmentsWithResponse(command, SARA_R5_SEGMENT_COUNT(command), SARA_RESPONSE_OK, NULL, 0, SARA_R5_STANDARD_RESPONSE_TIMEOUT);
+	saraR5FreeChar(topicQuoted, topicQuotedSize);
+	if (!sent)
+	{
+		return SARA_R5_ERROR_ERROR;
+	}
+	return SARA_R5_ERROR_SUCCESS;
 }
 
 /**
@@ -990,41 +5078,63 @@ uint8_t saraR5UnsubscribeMQTTtopic(const char *topic)
  * @param messageLength The length of the message.
  * @return Returns a success code if the message is successfully published, or an error code if the attempt fails.
  */
-uint8_t saraR5PublishMQTT(const char *topic, uint8_t topicLength ,const char *buffer, int size, int QoS, int retain, uint8_t hex_mode, const uint8_t *message, uint8_t messageLength)
+uint8_t saraR5PublishMQTT(const char *topic, size_t topicLength,const char *buffer, size_t size, int QoS, int retain, uint8_t hex_mode, const uint8_t *message, size_t messageLength)
 {
-	char *command;
-	int commandLength;
+	char opDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char *topicQuoted;
+	size_t topicQuotedSize;
+	char *messageQuoted = NULL;
+	size_t messageQuotedSize = 0;
+	bool sent;
+	char qosDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char retainDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char hexDigits[SARA_R5_SEGMENT_INT_SIZE];
 
 	// Validate input parameters
-	if (topic == NULL || message == NULL || messageLength <= 0)
+	if (topic == NULL || message == NULL || messageLength == 0)
 	{
 		return SARA_R5_ERROR_UNEXPECTED_PARAM;
 	}
 
-	// Calculate the command length considering the MQTT publish command format
-	// Additional characters are for commas and other command syntax elements.
-	commandLength = strlen("AT+UMQTTC=2,") + QoS + retain + hex_mode + topicLength + messageLength + 3;
-	command = saraR5CallocChar(commandLength);
-	if (command == NULL)
+	// Construct the command to publish the message
+	// The command is formatted with the MQTT publish command, QoS, retain flag, hex mode, topic, and message.
+	// The topic and the message are sent from the caller's buffers, unless they hold characters that must be escaped.
+	// In hex mode the message is already made of hex digits.
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_MQTT_COMMAND "="),
+		saraR5SegmentInt(opDigits, SARA_R5_MQTT_COMMAND_PUBLISH),
+		SARA_R5_SEGMENT_LITERAL(","),
+		saraR5SegmentInt(qosDigits, QoS),
+		SARA_R5_SEGMENT_LITERAL(","),
+		saraR5SegmentInt(retainDigits, retain),
+		SARA_R5_SEGMENT_LITERAL(","),
+		saraR5SegmentInt(hexDigits, hex_mode),
+		SARA_R5_SEGMENT_LITERAL(",\""),
+		saraR5SegmentQuotedAlloc(&topicQuoted, &topicQuotedSize, topic, topicLength),
+		SARA_R5_SEGMENT_LITERAL("\",\""),
+		{message, messageLength},
+		SARA_R5_SEGMENT_LITERAL("\"\r"),
+	};
+
+	if (!hex_mode)
+	{
+		command[11] = saraR5SegmentQuotedAlloc(&messageQuoted, &messageQuotedSize, message, messageLength);
+	}
+	if (command[9].data == NULL || command[11].data == NULL)
 	{
-		// Return an error code if memory allocation fails
+		saraR5FreeChar(messageQuoted, messageQuotedSize);
+		saraR5FreeChar(topicQuoted, topicQuotedSize);
 		return SARA_R5_ERROR_OUT_OF_MEMORY;
 	}
 
-	// Construct the command to publish the message
-	// The command is formatted with the MQTT publish command, QoS, retain flag, hex mode, topic, and message.
-	sprintf(command,"%s=%d,%d,%d,%d,\"%s\",\"%s\"\r", SARA_R5_MQTT_COMMAND, SARA_R5_MQTT_COMMAND_PUBLISH, QoS, retain, hex_mode , topic, message);
-
 	// Send the command and check for the response
 	// The response timeout is extended for publish operations.
-	if(!saraR5SendCommandWithResponse(command, SARA_RESPONSE_OK, buffer, size,5 * SARA_R5_STANDARD_RESPONSE_TIMEOUT)) // NULL i 0 per no posar un buffer
+	sent = saraR5SendSegmentsWithResponse(command, SARA_R5_SEGMENT_COUNT(command), SARA_RESPONSE_OK, buffer, size, 5 * SARA_R5_STANDARD_RESPONSE_TIMEOUT);
+	saraR5FreeChar(messageQuoted, messageQuotedSize);
+	saraR5FreeChar(topicQuoted, topicQuotedSize);
+	if (!sent)
 	{
-		// Free the allocated memory and return an error code if the response is not as expected
-		free (command);
 		return SARA_R5_ERROR_ERROR;
 	}
-
-	// Free the allocated memory for the command string and return a success code
-	free (command);
 	return SARA_R5_ERROR_SUCCESS;
-}
\ No newline at end of file
+}
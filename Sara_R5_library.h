@@ -1,10 +1,23 @@
+#ifndef SARA_R5_LIBRARY_H
+#define SARA_R5_LIBRARY_H
+
 // INCLUDES
 #include "stdio.h"
 #include "string.h"
 #include "stdlib.h"
 #include "stdbool.h"
-#include "stm32u5xx_hal.h"
-#include "stm32u5xx_hal_uart.h"
+#include "Sara_R5_ring_buffer.h"
+#include "Sara_R5_at_tokenizer.h"
+#include "Sara_R5_urc.h"
+#include "Sara_R5_schema.h"
+#include "Sara_R5_cmux.h"
+#include "Sara_R5_transport.h"
+#include "Sara_R5_transport_loopback.h"
+#ifdef SARA_R5_HOST
+#include "Sara_R5_transport_posix.h" // Linux / CI build
+#else
+#include "Sara_R5_transport_stm32.h" // STM32 HAL build
+#endif
 
 // General
 #define SMALL_RESPONSE_BUFFER_SIZE 64
@@ -15,28 +28,96 @@
 #define SIZE_PDP_TYPE 10
 #define SIZE_APN 128
 #define SIZE_OCT_IP 4
+#define SARA_R5_PDP_PARAMS 10 // Numeric parameters kept after the address of a PDP context
 #define MAX_OPS 3             // MAX OPERATORS
 #define MAX_APN 3             // MAX APN
 #define SARA_R5_NUM_SOCKETS 6 // MAX NUM SOCKETS
 
+// Reception
+#define SARA_R5_RX_RING_BUFFER_SIZE 1024 // Ring buffer drained by the receive functions
+#define SARA_R5_RX_CHUNK_SIZE 64         // Bytes handed to the AT tokenizer at a time
+#define SARA_R5_RX_IDLE_TIME 5           // Silence (ms) that ends a raw reception
+
 // Timing
 #define SARA_R5_STANDARD_RESPONSE_TIMEOUT 1000 // 1 SEC TIMEOUT
 #define SARA_R5_3_MIN_TIMEOUT 180000           // 3 MIN TIMEOUT
 #define SARA_R5_10_SEC_TIMEOUT 10000           // 10 SEC TIMEOUT
 #define SARA_R5_IP_CONNECT_TIMEOUT 130000
+#define SARA_R5_BAUD_SWITCH_DELAY 100          // Time the module needs to apply AT+IPR
+#define SARA_R5_BAUD_PROBE_TIMEOUT 200         // Wait for the OK to one AT probe
+#define SARA_R5_BAUD_PROBE_ATTEMPTS 3          // AT probes before a rate is given up
+#define SARA_R5_DIRECT_LINK_GUARD_TIME 1100    // Silence around the escape sequence (ATS12 default 1 s, plus margin)
+#define SARA_R5_PROMPT_DELAY 50                // Wait after the '@' prompt before sending the data
+
+// Baud rate
+#define SARA_R5_DEFAULT_BAUD_RATE 115200     // Rate of a module that was never configured
+#define SARA_R5_BAUD_LADDER {921600, 460800} // Rates tried by saraR5NegotiateBaudRate, fastest first
 
 //Memory
-#define MESSAGE_PDP_ACTION_EXTRA_MEMORY 32 //Additional memory allocation  to extra characters
-#define OPERATOR_SELECTION_EXTRA_MEMORY 3
-#define OPERATOR_SELECTION_MEMORY 10
-#define AUTO_OPERATOR_SELECTION_MEMORY 6
-#define MESSAGE_PDP_DEF_EXTRA_MEMORY 3
 #define RESPONSE_MEMORY 1024
 #define RESPONSE_EXTRA_MEMORY 48
-#define APN_EXTRA_MEMORY 16
-#define CREATE_SOCKET_EXTRA_MEMORY 10
-#define CLOSE_SOCKET_EXTRA_MEMORY 10
-#define CONNECT_SOCKET_EXTRA_MEMORY 11
+#ifndef SARA_R5_SCRATCH_SIZE
+#define SARA_R5_SCRATCH_SIZE 2048 // Static response pool of a SARA_R5_NO_HEAP build, see saraR5GetFootprint
+#endif
+
+// Socket reception
+#ifndef SARA_R5_SOCKET_RX_BUFFER_SIZE
+#define SARA_R5_SOCKET_RX_BUFFER_SIZE 512 // Bytes received on one socket and not read by the application yet
+#endif
+#define SARA_R5_SOCKET_MAX_READ 1024    // Most bytes one AT+USORD / AT+USORF returns
+#define SARA_R5_SOCKET_MAX_READ_HEX 512 // Same in hex mode, where every byte takes two characters
+#define SARA_R5_SOCKET_READ_TIMEOUT 10000
+
+// Socket transmission
+#define SARA_R5_SOCKET_MAX_WRITE 1024     // Most bytes one AT+USOWR / AT+USOST takes, largest UDP datagram
+#define SARA_R5_SOCKET_MAX_WRITE_HEX 512  // Same for AT+USOST in hex mode, where every byte takes two characters
+#ifndef SARA_R5_SOCKET_MAX_UNACKED
+#define SARA_R5_SOCKET_MAX_UNACKED 4096 // Bytes sent on a TCP socket and not acknowledged yet before saraR5SocketWrite waits
+#endif
+#define SARA_R5_SOCKET_WRITE_TIMEOUT 10000
+#define SARA_R5_SOCKET_FLOW_POLL 100      // Interval of the AT+USOCTL queries while the unacknowledged bytes are too many
+#define SARA_R5_SOCKET_FLOW_TIMEOUT 30000 // Wait for the acknowledgements before saraR5SocketWrite gives up
+
+// UDP send queue
+#ifndef SARA_R5_UDP_QUEUE_DATAGRAMS
+#define SARA_R5_UDP_QUEUE_DATAGRAMS 4 // Datagrams waiting in the UDP send queue, all sockets together
+#endif
+#ifndef SARA_R5_UDP_QUEUE_MTU
+#define SARA_R5_UDP_QUEUE_MTU 512 // Largest datagram of the queue (at most SARA_R5_SOCKET_MAX_WRITE)
+#endif
+#define SARA_R5_UDP_QUEUE_LATENCY 200 // Default time a datagram waits for more records before it leaves (ms)
+
+// Socket pool
+#define SARA_R5_SOCKET_ADDRESS_SIZE 64 // Longest remote address (IP or host name) remembered per socket, with its terminator
+
+// Host name resolution
+#ifndef SARA_R5_DNS_CACHE_SIZE
+#define SARA_R5_DNS_CACHE_SIZE 4 // Host names remembered by saraR5ResolveHost (the capacity can be lowered at run time)
+#endif
+#define SARA_R5_DNS_TTL 300000         // Default time a resolved address is reused (ms), AT+UDNSRN does not give the record TTL
+#define SARA_R5_DNS_NEGATIVE_TTL 30000 // Default time a name that did not resolve is failed without asking the module (ms)
+#define SARA_R5_DNS_TIMEOUT 70000      // Longest AT+UDNSRN answer
+
+// TLS security profiles
+#define SARA_R5_SECURITY_PROFILES 5 // Security profiles of the module, AT+USECPRF 0 to 4
+#define SARA_R5_SECURITY_NONE -1    // No TLS, see saraR5SocketSetSecurity and saraR5SetMQTTsecurity
+
+// Command queue
+#ifndef SARA_R5_COMMAND_QUEUE_SIZE
+#define SARA_R5_COMMAND_QUEUE_SIZE 8 // Commands waiting for saraR5Poll
+#endif
+#ifndef SARA_R5_COMMAND_LINE_SIZE
+#define SARA_R5_COMMAND_LINE_SIZE 128 // Longest command copied by saraR5SubmitCommand
+#endif
+#ifndef SARA_R5_CHAIN_LINE_SIZE
+#define SARA_R5_CHAIN_LINE_SIZE 256 // Longest line of ';' chained commands
+#endif
+#define SARA_R5_CHAIN_MAX_SEGMENTS 32 // Pieces of one chained line
+
+// Command segments
+#define SARA_R5_SEGMENT_INT_SIZE 24 // Digits of any long, with its sign
+#define SARA_R5_SEGMENT_LITERAL(str) {(str), sizeof(str) - 1}
+#define SARA_R5_SEGMENT_COUNT(segments) (sizeof(segments) / sizeof((segments)[0]))
 
 // IP
 #define SARA_R5_SIZE_IP 16
@@ -44,11 +125,16 @@
 // Supported AT Commands
 // General
 #define SARA_R5_COMMAND_AT "AT\r" // AT test
+#define SARA_R5_COMMAND_ABORT "\r"   // Any character aborts an abortable command (e.g. AT+COPS=?)
 // #define SARA_R5_INFORMATION "AT+CGDCONT=2\r"		// SARA R5 INFORMATION
 // #define SARA_R5_INFORMATION2 "AT+USOCL=0\r"		// SARA R5 INFORMATION
 #define SARA_RESPONSE_OK "\r\nOK\r\n"             // OK response
 #define SARA_RESPONSE_ERROR "\r\nERROR\r\n"       // ERROR response
 #define SARA_R5_COMMAND_ECHO_DESACTIVATE "ATE0\r" // Desactivate local echo
+#define SARA_R5_BAUD_RATE "AT+IPR"                // UART data rate
+#define SARA_R5_FLOW_CONTROL "AT+IFC=2,2\r"       // RTS/CTS hardware flow control
+#define SARA_R5_STORE_PROFILE "AT&W\r"            // Store the current configuration
+#define SARA_R5_CMUX "AT+CMUX"                    // Multiplexing mode (3GPP TS 27.010)
 // Network service
 #define SARA_R5_OPERATOR_SELECTION "AT+COPS" // search operators
 
@@ -59,6 +145,7 @@
 #define SARA_R5_NETWORK_ASSIGNED_DATA "AT+UPSND" // Packet switched network-assigned data
 #define SARA_R5_MESSAGE_PDP_DEF "AT+CGDCONT"     // Packet switched Data Profile context definition
 #define SARA_R5_MESSAGE_PDP_DEF2 "AT+CGDCONT?\r"
+#define SARA_R5_PDP_PREFIX "+CGDCONT:" // Start of every line of the AT+CGDCONT? answer
 // IP
 #define SARA_R5_CREATE_SOCKET "AT+USOCR"      // Create a new socket
 #define SARA_R5_CREATE_SOCKET2 "AT+USOCL=3\r" // Create a new socket
@@ -66,6 +153,42 @@
 #define SARA_R5_CONNECT_SOCKET "AT+USOCO"     // Socket Connect
 #define SARA_R5_WRITE_SOCKET "AT+USOWR"       // Write data to a socket
 #define SARA_R5_WRITE_UDP_SOCKET "AT+USOST"   // Write data to a UDP socket
+#define SARA_R5_READ_SOCKET "AT+USORD"        // Read data from a socket
+#define SARA_R5_READ_UDP_SOCKET "AT+USORF"    // Read a datagram from a UDP socket
+#define SARA_R5_SOCKET_CONTROL "AT+USOCTL"    // Query a socket parameter
+#define SARA_R5_RESOLVE_NAME "AT+UDNSRN"      // Resolve a host name (DNS)
+#define SARA_R5_SOCKET_SECURITY "AT+USOSEC"   // Bind a security profile to a socket
+#define SARA_R5_SECURITY_PROFILE "AT+USECPRF" // Security (TLS) profile configuration
+#define SARA_R5_DATA_CONFIG "AT+UDCONF"       // Data configuration, AT+UDCONF=1,<0|1> sets the socket hex mode
+#define SARA_R5_DIRECT_LINK "AT+USODL"        // Socket direct link (transparent mode)
+#define SARA_R5_DIRECT_LINK_ESCAPE "+++"      // Leaves the direct link, between two guard times
+#define SARA_R5_DIRECT_LINK_END "\r\nDISCONNECT\r\n" // Sent by the module once back in command mode
+// MQTT
+#define SARA_R5_MQTT_PROFILE "AT+UMQTT"  // MQTT profile configuration
+#define SARA_R5_MQTT_COMMAND "AT+UMQTTC" // MQTT command
+
+// AT+UMQTT operation codes
+#define SARA_R5_MQTT_PROFILE_CLIENT_ID 0
+#define SARA_R5_MQTT_PROFILE_SERVERNAME 2
+#define SARA_R5_MQTT_PROFILE_SECURE 11
+
+// AT+USECPRF operation codes
+#define SARA_R5_SECURITY_VALIDATION 0   // Server certificate validation level
+#define SARA_R5_SECURITY_TLS_VERSION 1  // Minimum TLS version
+#define SARA_R5_SECURITY_CIPHER_SUITE 2 // Cipher suite, 99 for an IANA number given as "<high>;<low>"
+#define SARA_R5_SECURITY_ROOT_CA 3      // Trusted root certificate, by its AT+USECMNG name
+#define SARA_R5_SECURITY_HOSTNAME 4     // Host name expected in the server certificate
+#define SARA_R5_SECURITY_CLIENT_CERT 5  // Client certificate, by its AT+USECMNG name
+#define SARA_R5_SECURITY_CLIENT_KEY 6   // Client private key, by its AT+USECMNG name
+#define SARA_R5_SECURITY_SNI 10         // Server name indication
+#define SARA_R5_SECURITY_RESUMPTION 13  // TLS session resumption
+
+// AT+UMQTTC operation codes
+#define SARA_R5_MQTT_COMMAND_LOGOUT 0
+#define SARA_R5_MQTT_COMMAND_LOGIN 1
+#define SARA_R5_MQTT_COMMAND_PUBLISH 2
+#define SARA_R5_MQTT_COMMAND_SUBSCRIBE 4
+#define SARA_R5_MQTT_COMMAND_UNSUBSCRIBE 5
 
 typedef enum
 {
@@ -85,12 +208,131 @@ typedef struct
   uint8_t act;                 // Access technology used by the operator. E.g., 0 for GSM, 1 for UMTS, etc.
 } SARA_R5_operator_stats;
 
+// Called for every operator of an AT+COPS=? answer as soon as it is received. Returns false to end the scan.
+typedef bool (*SARA_R5_operator_callback)(const SARA_R5_operator_stats *op, void *context);
+
+// Fields of an operator in the AT+COPS=? answer: (stat,"long","short","numeric",act)
+#define SARA_R5_OPERATOR_FIELD_STAT 0
+#define SARA_R5_OPERATOR_FIELD_LONG 1
+#define SARA_R5_OPERATOR_FIELD_SHORT 2
+#define SARA_R5_OPERATOR_FIELD_NUMERIC 3
+#define SARA_R5_OPERATOR_FIELD_ACT 4
+#define SARA_R5_OPERATOR_QUOTED_FIELDS 0x0E // Bit per field, the names and the numeric format are quoted
+
+// Incremental parser of the AT+COPS=? answer, fed as the bytes arrive
+typedef struct
+{
+  SARA_R5_operator_stats op;          // Operator being parsed
+  uint8_t field;                      // Field being parsed, SARA_R5_OPERATOR_FIELD_...
+  size_t fieldLength;                 // Characters of the field stored so far
+  uint8_t quoted;                     // Bit per field that was quoted
+  bool inTuple;                       // Between '(' and ')'
+  bool inQuotes;                      // Inside a quoted field
+  bool valid;                         // Nothing unexpected in the tuple so far
+  bool comma;                         // Last character outside a tuple was a ','
+  bool listEnd;                       // ",," seen, the rest of the answer lists the supported values
+  bool stopped;                       // The callback ended the scan
+  size_t count;                       // Operators handed to the callback
+  SARA_R5_operator_callback callback; // Called for every operator (may be NULL)
+  void *context;                      // Passed back to 'callback'
+} SARA_R5_operator_parser;
+
 typedef enum
 {
   SARA_R5_TCP = 6,
   SARA_R5_UDP = 17
 } SARA_R5_socket_protocol_t;
 
+// Bytes received on one socket: announced by +UUSORD / +UUSORF, read with AT+USORD / AT+USORF by saraR5Poll,
+// kept in 'ring' until saraR5SocketRead
+typedef struct
+{
+  uint8_t storage[SARA_R5_SOCKET_RX_BUFFER_SIZE]; // Storage of 'ring'
+  SARA_R5_ring_buffer ring;                       // Bytes not read by the application yet
+  size_t pending;                                 // Bytes the module still holds, as last announced
+  bool udp;                                       // Announced by +UUSORF, read with AT+USORF
+  bool reading;                                   // A read command is queued or running
+  bool announced;                                 // A URC came while reading, 'pending' is already up to date
+  uint8_t prefixLength;                           // Characters of "+USORD:" / "+USORF:" matched
+  bool skipLine;                                  // The line is not the answer
+  uint8_t field;                                  // Field of the answer being parsed
+  size_t length;                                  // Its <length> field
+  size_t dataLeft;                                // Characters of the data field still expected
+  bool inData;                                    // Inside the quoted data
+  uint8_t hexHigh;                                // First digit of a hex byte, 0xFF if none
+} SARA_R5_socket_rx;
+
+// State of a socket ID, as tracked by the socket pool
+typedef enum
+{
+  SARA_R5_SOCKET_FREE = 0,  // No socket with this ID
+  SARA_R5_SOCKET_OPEN,      // Created with AT+USOCR, not connected
+  SARA_R5_SOCKET_CONNECTED, // Connected to 'address':'port' with AT+USOCO
+  SARA_R5_SOCKET_CLOSED     // Closed by the module (+UUSOCL), the endpoint is kept to connect again on demand
+} SARA_R5_socket_state_t;
+
+// One socket ID of the pool
+typedef struct
+{
+  SARA_R5_socket_state_t state;
+  SARA_R5_socket_protocol_t protocol;
+  char address[SARA_R5_SOCKET_ADDRESS_SIZE]; // Remote end given to AT+USOCO ("" if none)
+  unsigned int port;                         // Its port
+  bool inUse;                                // Held by the code that opened or acquired it, until saraR5SocketRelease
+  bool secure;                               // Bound to a security profile with saraR5SocketSetSecurity
+  uint8_t securityProfile;                   // That profile
+  uint32_t lastUse;                          // Time of the last acquire or release (ms), the oldest idle socket is closed first
+} SARA_R5_socket_slot;
+
+// Datagram of the UDP send queue: records to one destination, sent with one AT+USOST
+typedef struct
+{
+  bool used;                                 // The slot holds a datagram
+  int socket;                                // Socket it leaves from
+  char address[SARA_R5_SOCKET_ADDRESS_SIZE]; // Destination address
+  unsigned int port;                         // Destination port
+  size_t length;                             // Bytes in 'data'
+  size_t records;                            // Records coalesced in it
+  uint32_t firstTime;                        // Time of its first record (ms), it leaves within the latency budget
+  bool closed;                               // No more records go in, it leaves at the next saraR5Poll
+  bool sending;                              // Its AT+USOST is queued or running
+  uint8_t data[SARA_R5_UDP_QUEUE_MTU];       // The records, one after the other
+} SARA_R5_udp_datagram;
+
+// Statistics of the UDP send queue, see saraR5UdpQueueGetStats
+typedef struct
+{
+  unsigned long records;          // Records queued with saraR5UdpQueueSend
+  unsigned long recordsSent;      // Records in the datagrams the module took
+  unsigned long datagrams;        // Datagrams the module took
+  unsigned long failures;         // Datagrams refused or not answered, their records are lost
+  unsigned long bytes;            // Bytes of the datagrams the module took
+  uint32_t elapsedMs;             // Time since the statistics were reset
+  unsigned long recordsPerSecond; // 'recordsSent' per second over 'elapsedMs'
+  unsigned long coalescing;       // Records per datagram in hundredths, e.g. 250 for 2.5
+} SARA_R5_udp_queue_stats;
+
+// Answer to AT+USOCR, "+USOCR: <socket>"
+typedef struct
+{
+  int socket; // ID of the created socket
+} SARA_R5_socket_created;
+
+// Answer to AT+USOWR / AT+USOST, "+USOWR: <socket>,<length>"
+typedef struct
+{
+  int socket;    // ID of the socket written
+  size_t length; // Bytes the module accepted
+} SARA_R5_socket_written;
+
+// Answer to AT+USOCTL, "+USOCTL: <socket>,<param_id>,<param_val>"
+typedef struct
+{
+  int socket;          // ID of the socket queried
+  int param;           // Parameter queried (11: TCP bytes sent and not acknowledged yet)
+  unsigned long value; // Its value
+} SARA_R5_socket_control;
+
 typedef enum
 {
   AUTOMATIC = 0,       // Automatic network selection mode
@@ -107,6 +349,59 @@ typedef struct
   int fourth_ip; // Fourth octet of the IP address
 } Ip_adress;
 
+// Host name of the resolution cache, see saraR5ResolveHost
+typedef struct
+{
+  char host[SARA_R5_SOCKET_ADDRESS_SIZE]; // Host name ("" if the entry is free)
+  Ip_adress ip;                           // Its address, if 'resolved'
+  bool resolved;                          // false for a negative entry: the name did not resolve
+  uint32_t time;                          // Time of the resolution (ms), the entry expires after its TTL
+  uint32_t lastUse;                       // Time of the last lookup (ms), the least recently used entry is replaced first
+} SARA_R5_dns_entry;
+
+// Statistics of the resolution cache, see saraR5DnsGetStats
+typedef struct
+{
+  unsigned long lookups;      // Host names looked up with saraR5ResolveHost
+  unsigned long hits;         // Lookups answered with a cached address
+  unsigned long negativeHits; // Lookups failed at once from a negative entry
+  unsigned long queries;      // AT+UDNSRN sent to the module
+  unsigned long failures;     // AT+UDNSRN that gave no address
+} SARA_R5_dns_stats;
+
+// TLS security profile, see saraR5SecurityProfileSet
+typedef struct
+{
+  uint8_t validation;     // Server certificate check: 0 none, 1 root CA, 2 root CA and host name, 3 same and validity date
+  uint8_t tlsVersion;     // Minimum TLS version: 0 any, 1 TLS 1.0, 2 TLS 1.1, 3 TLS 1.2, 4 TLS 1.3
+  uint16_t cipherSuite;   // IANA number of the only cipher suite offered (e.g. 0xC02F), 0 for the module's list
+  const char *rootCa;     // AT+USECMNG name of the trusted root certificate, NULL for none
+  const char *clientCert; // AT+USECMNG name of the client certificate, NULL for none
+  const char *clientKey;  // AT+USECMNG name of the client private key, NULL for none
+  const char *hostname;   // Host name expected in the server certificate (validation 2 and 3), NULL for none
+  const char *sni;        // Server name sent in the TLS ClientHello, NULL for none
+  bool sessionResumption; // Resume the last session of the profile instead of running a full handshake
+} SARA_R5_security_profile;
+
+// Handshake times of a security profile, see saraR5SecurityGetStats
+typedef struct
+{
+  unsigned long fullHandshakes;    // Secure connections that ran a full handshake
+  unsigned long resumedHandshakes; // Secure connections that offered the session of the previous one
+  unsigned long failures;          // Secure connections that failed
+  uint32_t fullMs;                 // Time of the full handshakes, all together (ms)
+  uint32_t resumedMs;              // Time of the resumed ones, all together (ms)
+  uint32_t fullAverageMs;          // 'fullMs' per full handshake
+  uint32_t resumedAverageMs;       // 'resumedMs' per resumed handshake
+  uint32_t lastMs;                 // Time of the last handshake (ms)
+} SARA_R5_security_stats;
+
+// Answer to AT+UDNSRN=0, "+UDNSRN: "<ip>""
+typedef struct
+{
+  uint8_t ip[SIZE_OCT_IP]; // Resolved IPv4 address
+} SARA_R5_dns_answer;
+
 // Represents an Access Point Name (APN) configuration
 typedef struct
 {
@@ -123,6 +418,54 @@ typedef enum
   PDP_TYPE_IPV6 = 3      // IPv6 based PDP context
 } SARA_R5_pdp_type;
 
+// PDP context reported by AT+CGDCONT?
+typedef struct
+{
+  uint8_t cid;                        // Context identifier
+  SARA_R5_pdp_type pdpType;           // PDP type, PDP_TYPE_INVALID if unknown
+  bool hasIpv4;                       // 'ipv4' holds an address
+  bool hasIpv6;                       // 'ipv6' holds an address
+  uint8_t ipv4[4];                    // IPv4 address
+  uint8_t ipv6[16];                   // IPv6 address
+  uint8_t paramCount;                 // Values stored in 'params'
+  uint8_t params[SARA_R5_PDP_PARAMS]; // <d_comp>,<h_comp>,<IPv4AddrAlloc>,<request_type>,... after the address
+  char apn[SIZE_APN];                 // APN, empty if not set
+} SARA_R5_pdp_context;
+
+// Fields of a +CGDCONT line, the numeric parameters follow the address
+#define SARA_R5_PDP_FIELD_CID 0
+#define SARA_R5_PDP_FIELD_TYPE 1
+#define SARA_R5_PDP_FIELD_APN 2
+#define SARA_R5_PDP_FIELD_ADDRESS 3
+#define SARA_R5_PDP_FIELD_PARAMS 4
+#define SARA_R5_PDP_LINE_SKIPPED 0xFF // 'prefixLength' of a line that is not a +CGDCONT line
+
+// Single pass parser of the AT+CGDCONT? answer, fed as the bytes arrive
+typedef struct
+{
+  SARA_R5_pdp_context *contexts; // Where the contexts go
+  size_t maxContexts;            // Entries of 'contexts'
+  size_t count;                  // Contexts stored
+  size_t found;                  // +CGDCONT lines received, stored or not
+  uint8_t cid;                   // Only context kept, 0 for all
+  uint8_t prefixLength;          // Characters of "+CGDCONT:" matched at the start of the line
+  uint8_t field;                 // Field being parsed, SARA_R5_PDP_FIELD_...
+  size_t fieldLength;            // Characters of the field stored so far
+  bool inQuotes;                 // Inside a quoted field
+  bool valid;                    // The line is kept
+  char type[SIZE_PDP_TYPE];      // PDP type being read
+  uint32_t value;                // Decimal number being read
+  uint16_t hexValue;             // Same digits read as an IPv6 group
+  uint8_t digits;                // Digits of the number being read
+  bool hexOnly;                  // The number has hex digits
+  uint8_t address[16];           // Bytes of the address being read
+  uint8_t addressParts;          // Dotted bytes or colon groups read
+  int8_t addressGap;             // Group index of the "::", -1 if none
+  bool addressColon;             // The address uses the colon notation
+  bool addressPrevColon;         // Last character was a ':' ending no group
+  bool addressValid;             // Nothing unexpected in the address so far
+} SARA_R5_pdp_parser;
+
 typedef enum
 {
   SARA_R5_ERROR_INVALID = -1,        // Invalid value or unknown error
@@ -138,34 +481,206 @@ typedef enum
   SARA_R5_ERROR_INVALID_SOCKET       // Invalid Socket
 } SARA_R5_error_t;
 
+// Piece of a command, sent as is without assembling the whole command in memory
+typedef struct
+{
+  const void *data; // First byte of the piece
+  size_t len;       // Bytes in the piece
+} SARA_R5_segment;
+
+// Called once a queued command is over.
+// 'error' is SARA_R5_ERROR_SUCCESS on OK (or CONNECT), SARA_R5_ERROR_ERROR on ERROR / +CME ERROR / +CMS ERROR (code in
+// 'errorCode', -1 if none) and SARA_R5_ERROR_NO_RESPONSE on timeout. 'response' is the raw answer, or NULL.
+typedef void (*SARA_R5_command_callback)(uint8_t error, SARA_R5_at_result_t result, int errorCode, const char *response, void *context);
+
+// Called with the answer of a streamed command as it arrives, one line at a time, without the line terminator.
+// A line longer than SARA_R5_AT_LINE_BUFFER_SIZE - 1 comes in several pieces, 'lineEnd' is only set on its last one.
+typedef void (*SARA_R5_response_handler)(const char *data, size_t len, bool lineEnd, void *context);
+
+// Command waiting in the queue or in progress
+typedef struct
+{
+  const SARA_R5_segment *segments;         // Pieces of the command
+  size_t count;                            // Number of pieces
+  SARA_R5_segment copy;                    // Single piece pointing to 'storage' when the command was copied
+  char storage[SARA_R5_COMMAND_LINE_SIZE]; // Command bytes copied at submission
+  char *overflow;                          // Heap copy of a longer command (NULL if none), freed once it is over
+  char *response;                          // Where to store the raw answer (may be NULL)
+  size_t responseSize;                     // Size of 'response'
+  unsigned long timeout;                   // Time allowed for the final result code (ms)
+  bool chainable;                          // May share a ';' chained line with its neighbours
+  SARA_R5_command_callback callback;       // Called once the command is over (may be NULL)
+  void *context;                           // Passed back to 'callback'
+  SARA_R5_response_handler handler;        // Gets the answer as it arrives (may be NULL)
+  void *handlerContext;                    // Passed back to 'handler'
+  SARA_R5_segment payload;                 // Data sent after the '@' prompt (empty if none)
+} SARA_R5_command;
+
+// Outcome of a command, filled by saraR5StoreResult
+typedef struct
+{
+  bool done;                  // The command is over
+  uint8_t error;              // SARA_R5_ERROR_SUCCESS, SARA_R5_ERROR_ERROR or SARA_R5_ERROR_NO_RESPONSE
+  SARA_R5_at_result_t result; // Final result code
+  int errorCode;              // +CME/+CMS ERROR value, -1 if none
+} SARA_R5_command_result;
+
+// Byte counts of a socket direct link session
+typedef struct
+{
+  size_t sent;     // Bytes written with saraR5DirectLinkWrite
+  size_t received; // Bytes read with saraR5DirectLinkRead
+  size_t flushed;  // Bytes received but never read, dropped when leaving the direct link
+} SARA_R5_direct_link_stats;
+
+// RAM used by the library, to size the SARA_R5_NO_HEAP pool and the queues
+typedef struct
+{
+  size_t receive;             // Reception ring and AT tokenizers
+  size_t commandQueue;        // Queued commands with their copies, chained line
+  size_t urcTable;            // URC prefix table
+  size_t sockets;             // Socket reception rings and pool
+  size_t udpQueue;            // Datagrams of the UDP send queue
+  size_t dnsCache;            // Host names of the resolution cache
+  size_t scratch;             // Static response pool (0 when the heap is used)
+  size_t total;               // Static RAM of Sara_R5_library.c
+  size_t scratchInUse;        // Response bytes held right now
+  size_t scratchPeak;         // Most response bytes held at once since boot
+  unsigned long allocations;  // Response buffers taken since boot
+  unsigned long failures;     // Requests that did not fit
+} SARA_R5_footprint;
+
+// Keeps the negotiated baud rate across reboots (e.g. in flash or a backup register)
+typedef struct
+{
+  bool (*load)(uint32_t *baud, void *context); // Reads the stored rate, false if there is none
+  void (*save)(uint32_t baud, void *context);  // Stores the rate in use
+  void *context;                               // Passed back to both functions
+} SARA_R5_baud_store;
+
 // FUNCTION TO ALLOCATE MEMORY
 char *saraR5CallocChar(size_t num);
+void saraR5FreeChar(char *memory, size_t num);
+void saraR5GetFootprint(SARA_R5_footprint *footprint);
 
 // FUNCTION TO INITIALIZE THE MODULE WITHOUT ECHO.
 bool saraR5Init(const char *expectedResponse, const char *buffer);
+uint8_t saraR5NegotiateBaudRate(const uint32_t *rates, size_t count, const SARA_R5_baud_store *store, uint32_t *selected);
 
 // FUNCTIONS TO SEND & RECEIVE COMMANDS
 bool saraR5SendDataUART(const uint8_t *data, uint32_t size);
-bool saraR5ReceiveDataUART(const uint8_t *buffer, uint8_t size, unsigned long timeout);
-bool saraR5ReceiveCommand(const char *buffer, uint8_t size, unsigned long timeout);
+bool saraR5ReceiveDataUART(const uint8_t *buffer, size_t size, unsigned long timeout);
+bool saraR5ReceiveCommand(const char *buffer, size_t size, unsigned long timeout);
 bool saraR5SendCommand(const uint8_t *command);
-bool saraR5SendCommandWithResponse(const char *command, const char *expectedResponse, const char *buffer, uint8_t size, unsigned long timeout);
+bool saraR5SendCommandWithResponse(const char *command, const char *expectedResponse, const char *buffer, size_t size, unsigned long timeout);
+bool saraR5ReceiveResponse(const char *buffer, size_t size, unsigned long timeout);
+bool saraR5SendSegments(const SARA_R5_segment *segments, size_t count);
+bool saraR5SendSegmentsWithResponse(const SARA_R5_segment *segments, size_t count, const char *expectedResponse, const char *buffer, size_t size, unsigned long timeout);
+SARA_R5_segment saraR5SegmentInt(char *digits, long value);
+SARA_R5_segment saraR5SegmentUint(char *digits, unsigned long value);
+SARA_R5_segment saraR5SegmentString(const char *str);
+SARA_R5_segment saraR5SegmentQuoted(char *storage, size_t size, const void *str, size_t len);
+SARA_R5_segment saraR5SegmentHex(char *storage, size_t size, const uint8_t *data, size_t len);
+SARA_R5_at_result_t saraR5GetLastResult(int *errorCode);
+
+// FUNCTIONS FOR THE COMMAND QUEUE
+uint8_t saraR5SubmitCommand(const SARA_R5_segment *segments, size_t count, const char *buffer, size_t size, unsigned long timeout, bool chainable, SARA_R5_command_callback callback, void *context);
+uint8_t saraR5SubmitCommandStreamed(const SARA_R5_segment *segments, size_t count, unsigned long timeout, SARA_R5_response_handler handler, void *handlerContext, SARA_R5_command_callback callback, void *context);
+uint8_t saraR5SendSegmentsStreamed(const SARA_R5_segment *segments, size_t count, unsigned long timeout, SARA_R5_response_handler handler, void *handlerContext);
+uint8_t saraR5SubmitCommandWithData(const SARA_R5_segment *segments, size_t count, const uint8_t *data, size_t len, const char *buffer, size_t size, unsigned long timeout, SARA_R5_command_callback callback, void *context);
+bool saraR5Poll(void);
+size_t saraR5PendingCommands(void);
+bool saraR5AbortCommand(void);
+void saraR5StoreResult(uint8_t error, SARA_R5_at_result_t result, int errorCode, const char *response, void *context);
+void saraR5BatchBegin(void);
+void saraR5BatchEnd(void);
+void saraR5BatchRun(void);
+
+// FUNCTIONS FOR UNSOLICITED RESULT CODES
+bool saraR5SetUrcHandler(const char *prefix, SARA_R5_urc_handler handler, void *context);
+
+// FUNCTIONS FOR CMUX
+uint8_t saraR5StartCmux(SARA_R5_cmux *mux);
+uint8_t saraR5StopCmux(SARA_R5_cmux *mux);
+
+// FUNCTIONS FOR THE TRANSPORT AND THE RECEIVE RING
+void saraR5SetTransport(SARA_R5_transport *transport);
+SARA_R5_transport *saraR5GetTransport(void);
+uint32_t saraR5NowMs(void);
+void saraR5RxFeed(const uint8_t *data, size_t len);
+size_t saraR5RxAvailable(void);
+void saraR5RxFlush(void);
 
 // PACKET SWITCHED DATA
-uint8_t saraR5PerformPDPaction(int profile, SARA_R5_pdp_actions_t action, const char *buffer, uint8_t size);
+uint8_t saraR5PerformPDPaction(int profile, SARA_R5_pdp_actions_t action, const char *buffer, size_t size);
+uint8_t saraR5PerformPDPactionAsync(int profile, SARA_R5_pdp_actions_t action, const char *buffer, size_t size, SARA_R5_command_callback callback, void *context);
 
 // NETWORK SERVICE
-uint8_t saraR5GetOperators(SARA_R5_operator_stats *opRet, int maxOps, const char *buffer, uint8_t size);
-uint8_t saraR5NetworkMode(SARA_R5_mode_action mode, const char *buffer, uint8_t size);
-uint8_t saraR5AutomaticOperatorSelection(const char *buffer, uint8_t size);
+uint8_t saraR5GetOperators(SARA_R5_operator_stats *opRet, int maxOps, const char *buffer, size_t size);
+uint8_t saraR5ScanOperators(SARA_R5_operator_callback onOperator, void *context);
+uint8_t saraR5ScanOperatorsAsync(SARA_R5_operator_parser *parser, SARA_R5_operator_callback onOperator, void *operatorContext, SARA_R5_command_callback callback, void *context);
+void saraR5OperatorParserInit(SARA_R5_operator_parser *parser, SARA_R5_operator_callback callback, void *context);
+void saraR5OperatorParserFeed(const char *data, size_t len, bool lineEnd, void *context);
+uint8_t saraR5NetworkMode(SARA_R5_mode_action mode, const char *buffer, size_t size);
+uint8_t saraR5NetworkModeAsync(SARA_R5_mode_action mode, const char *buffer, size_t size, SARA_R5_command_callback callback, void *context);
+uint8_t saraR5AutomaticOperatorSelection(const char *buffer, size_t size);
+uint8_t saraR5AutomaticOperatorSelectionAsync(const char *buffer, size_t size, SARA_R5_command_callback callback, void *context);
 
 // FUNCTIONS FOR APN
 uint8_t saraR5GetAPN(int cid, myApn *apn, Ip_adress *ip, SARA_R5_pdp_type *pdpType);
-uint8_t saraR5SetAPN(uint8_t cid, SARA_R5_pdp_type pdpType, char *apn, const char *buffer, uint8_t size);
+uint8_t saraR5GetPdpContexts(SARA_R5_pdp_context *contexts, size_t maxContexts, size_t *count);
+void saraR5PdpParserInit(SARA_R5_pdp_parser *parser, SARA_R5_pdp_context *contexts, size_t maxContexts, uint8_t cid);
+void saraR5PdpParserFeed(const char *data, size_t len, bool lineEnd, void *context);
+uint8_t saraR5SetAPN(uint8_t cid, SARA_R5_pdp_type pdpType, char *apn, const char *buffer, size_t size);
 
 // FUNCTIONS FOR SOCKETS
 int saraR5SocketOpen(SARA_R5_socket_protocol_t protocol, unsigned long localPort);
-uint8_t saraR5socketClose(int socket, unsigned long timeout, const char *buffer, uint8_t size);
-uint8_t saraR5SocketConnect(int socket, Ip_adress ip, unsigned int port, const char *buffer, uint8_t size);
-uint8_t saraR5SocketConnect2(int socket, const char *address, unsigned int port, const char *buffer, uint8_t size);
-uint8_t saraR5SocketWriteUDP(int socket, const char *address, int port, const char *str, int len);
\ No newline at end of file
+uint8_t saraR5socketClose(int socket, unsigned long timeout, const char *buffer, size_t size);
+uint8_t saraR5SocketConnect(int socket, Ip_adress ip, unsigned int port, const char *buffer, size_t size);
+uint8_t saraR5SocketConnect2(int socket, const char *address, unsigned int port, const char *buffer, size_t size);
+uint8_t saraR5SocketConnect2Async(int socket, const char *address, unsigned int port, const char *buffer, size_t size, SARA_R5_command_callback callback, void *context);
+uint8_t saraR5SocketWriteUDP(int socket, const char *address, int port, const char *str, int len);
+uint8_t saraR5SocketWriteDatagram(int socket, const char *address, unsigned int port, const uint8_t *data, size_t len);
+uint8_t saraR5SocketWrite(int socket, const uint8_t *data, size_t len, size_t *written);
+uint8_t saraR5SocketUnacked(int socket, size_t *bytes);
+uint8_t saraR5SocketAcquire(SARA_R5_socket_protocol_t protocol, const char *address, unsigned int port, int *socket);
+void saraR5SocketRelease(int socket);
+uint8_t saraR5SocketSend(SARA_R5_socket_protocol_t protocol, const char *address, unsigned int port, const uint8_t *data, size_t len);
+const SARA_R5_socket_slot *saraR5SocketGetSlot(int socket);
+uint8_t saraR5UdpQueueConfigure(bool coalesce, size_t mtu, uint32_t latencyMs);
+uint8_t saraR5UdpQueueSend(int socket, const char *address, unsigned int port, const uint8_t *data, size_t len);
+void saraR5UdpQueueFlush(void);
+void saraR5UdpQueueGetStats(SARA_R5_udp_queue_stats *stats);
+void saraR5UdpQueueResetStats(void);
+uint8_t saraR5ResolveHost(const char *host, Ip_adress *ip);
+uint8_t saraR5DnsCacheConfigure(size_t capacity, uint32_t ttlMs, uint32_t negativeTtlMs);
+void saraR5DnsCacheForget(const char *host);
+void saraR5DnsGetStats(SARA_R5_dns_stats *stats);
+uint8_t saraR5SocketSetSecurity(int socket, int profile);
+uint8_t saraR5SocketDirectLink(int socket);
+size_t saraR5SocketRead(int socket, uint8_t *data, size_t len);
+size_t saraR5SocketAvailable(int socket);
+uint8_t saraR5SocketSetHexMode(bool hex);
+bool saraR5DirectLinkWrite(const uint8_t *data, size_t len);
+size_t saraR5DirectLinkRead(uint8_t *data, size_t len, unsigned long timeout);
+uint8_t saraR5DirectLinkExit(SARA_R5_direct_link_stats *stats);
+
+// FUNCTIONS FOR TLS
+uint8_t saraR5SecurityProfileSet(int profile, const SARA_R5_security_profile *settings);
+uint8_t saraR5SecurityGetStats(int profile, SARA_R5_security_stats *stats);
+
+// FUNCTIONS FOR MQTT
+uint8_t saraR5SetMQTTclientId(const char *clientId, const char *buffer, size_t size);
+uint8_t saraR5SetMQTTclientIdAsync(const char *clientId, const char *buffer, size_t size, SARA_R5_command_callback callback, void *context);
+uint8_t saraR5SetMQTTserver(const char *serverName, int port, const char *buffer, size_t size);
+uint8_t saraR5SetMQTTserverAsync(const char *serverName, int port, const char *buffer, size_t size, SARA_R5_command_callback callback, void *context);
+uint8_t saraR5SetMQTTsecurity(int profile, const char *buffer, size_t size);
+uint8_t saraR5SetMQTTsecurityAsync(int profile, const char *buffer, size_t size, SARA_R5_command_callback callback, void *context);
+uint8_t saraR5MQTTconect(const char *buffer, size_t size);
+uint8_t saraR5MQTTconectAsync(const char *buffer, size_t size, SARA_R5_command_callback callback, void *context);
+uint8_t saraR5MQTTdisconnect(const char *buffer, size_t size);
+uint8_t saraR5SubscribeMQTTtopic(int max_Qos, const char *topic);
+uint8_t saraR5UnsubscribeMQTTtopic(const char *topic);
+uint8_t saraR5PublishMQTT(const char *topic, size_t topicLength, const char *buffer, size_t size, int QoS, int retain, uint8_t hex_mode, const uint8_t *message, size_t messageLength);
+
+#endif // SARA_R5_LIBRARY_H
@@ -0,0 +1,147 @@
+#include "Sara_R5_ring_buffer.h"
+#include "string.h"
+
+/**
+ * Initializes a ring buffer on top of caller provided storage.
+ * @param ring The ring buffer to initialize.
+ * @param storage Memory used to hold the bytes.
+ * @param size The size of the storage in bytes. The ring can hold size - 1 bytes.
+ */
+void saraR5RingBufferInit(SARA_R5_ring_buffer *ring, uint8_t *storage, size_t size)
+{
+	ring->buffer = storage;
+	ring->size = size;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->dropped = 0;
+}
+
+/**
+ * Discards every byte stored in the ring buffer.
+ * Must only be called from the consumer side.
+ * @param ring The ring buffer to clear.
+ */
+void saraR5RingBufferClear(SARA_R5_ring_buffer *ring)
+{
+	ring->tail = ring->head;
+}
+
+/**
+ * Gets the number of bytes waiting to be read.
+ * @param ring The ring buffer to inspect.
+ * @return The number of bytes that can be read.
+ */
+size_t saraR5RingBufferAvailable(const SARA_R5_ring_buffer *ring)
+{
+	size_t head = ring->head;
+	size_t tail = ring->tail;
+
+	return (head >= tail) ? (head - tail) : (ring->size - tail + head);
+}
+
+/**
+ * Gets the number of bytes that can still be written.
+ * @param ring The ring buffer to inspect.
+ * @return The number of free bytes.
+ */
+size_t saraR5RingBufferFree(const SARA_R5_ring_buffer *ring)
+{
+	if (ring->size == 0)
+	{
+		return 0;
+	}
+	return ring->size - 1 - saraR5RingBufferAvailable(ring);
+}
+
+/**
+ * Writes bytes into the ring buffer. Bytes that do not fit are dropped and counted.
+ * Must only be called from the producer side.
+ * @param ring The ring buffer to write to.
+ * @param data The bytes to write.
+ * @param len The number of bytes to write.
+ * @return The number of bytes actually stored.
+ */
+size_t saraR5RingBufferWrite(SARA_R5_ring_buffer *ring, const uint8_t *data, size_t len)
+{
+	size_t space = saraR5RingBufferFree(ring);
+	size_t head = ring->head;
+	size_t count = (len < space) ? len : space;
+	size_t first;
+
+	// Copy in at most two pieces: up to the end of the storage, then from the start
+	first = ring->size - head;
+	if (first > count)
+	{
+		first = count;
+	}
+	memcpy(&ring->buffer[head], data, first);
+	memcpy(ring->buffer, data + first, count - first);
+
+	head += count;
+	if (head >= ring->size)
+	{
+		head -= ring->size;
+	}
+	ring->head = head;
+	ring->dropped += len - count;
+	return count;
+}
+
+/**
+ * Copies bytes out of the ring buffer without consuming them.
+ * @param ring The ring buffer to read from.
+ * @param data Where to store the bytes.
+ * @param len The maximum number of bytes to copy.
+ * @return The number of bytes copied.
+ */
+size_t saraR5RingBufferPeek(const SARA_R5_ring_buffer *ring, uint8_t *data, size_t len)
+{
+	size_t available = saraR5RingBufferAvailable(ring);
+	size_t tail = ring->tail;
+	size_t count = (len < available) ? len : available;
+	size_t first;
+
+	first = ring->size - tail;
+	if (first > count)
+	{
+		first = count;
+	}
+	memcpy(data, &ring->buffer[tail], first);
+	memcpy(data + first, ring->buffer, count - first);
+	return count;
+}
+
+/**
+ * Reads bytes out of the ring buffer.
+ * Must only be called from the consumer side.
+ * @param ring The ring buffer to read from.
+ * @param data Where to store the bytes. If NULL the bytes are discarded.
+ * @param len The maximum number of bytes to read.
+ * @return The number of bytes read.
+ */
+size_t saraR5RingBufferRead(SARA_R5_ring_buffer *ring, uint8_t *data, size_t len)
+{
+	size_t available = saraR5RingBufferAvailable(ring);
+	size_t tail = ring->tail;
+	size_t count = (len < available) ? len : available;
+	size_t first;
+
+	first = ring->size - tail;
+	if (first > count)
+	{
+		first = count;
+	}
+	if (data != NULL)
+	{
+		memcpy(data, &ring->buffer[tail], first);
+		memcpy(data + first, ring->buffer, count - first);
+	}
+
+	tail += count;
+	if (tail >= ring->size)
+	{
+		tail -= ring->size;
+	}
+	ring->tail = tail;
+	return count;
+}
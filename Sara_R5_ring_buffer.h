@@ -0,0 +1,30 @@
+#ifndef SARA_R5_RING_BUFFER_H
+#define SARA_R5_RING_BUFFER_H
+
+// INCLUDES
+#include "stdint.h"
+#include "stddef.h"
+#include "stdbool.h"
+
+// Single producer / single consumer byte ring.
+// The producer (UART ISR or a host byte source) only moves 'head',
+// the consumer (library code) only moves 'tail', so no locking is needed.
+typedef struct
+{
+  uint8_t *buffer;         // Storage provided by the caller
+  size_t size;             // Size of the storage in bytes (one slot is kept free)
+  volatile size_t head;    // Next position to write
+  volatile size_t tail;    // Next position to read
+  volatile size_t dropped; // Bytes lost because the ring was full
+} SARA_R5_ring_buffer;
+
+// FUNCTIONS FOR RING BUFFERS
+void saraR5RingBufferInit(SARA_R5_ring_buffer *ring, uint8_t *storage, size_t size);
+void saraR5RingBufferClear(SARA_R5_ring_buffer *ring);
+size_t saraR5RingBufferWrite(SARA_R5_ring_buffer *ring, const uint8_t *data, size_t len);
+size_t saraR5RingBufferRead(SARA_R5_ring_buffer *ring, uint8_t *data, size_t len);
+size_t saraR5RingBufferPeek(const SARA_R5_ring_buffer *ring, uint8_t *data, size_t len);
+size_t saraR5RingBufferAvailable(const SARA_R5_ring_buffer *ring);
+size_t saraR5RingBufferFree(const SARA_R5_ring_buffer *ring);
+
+#endif // SARA_R5_RING_BUFFER_H
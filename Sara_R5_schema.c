@@ -0,0 +1,355 @@
+#include "Sara_R5_schema.h"
+#include "string.h"
+
+/**
+ * Gets the output struct of the record being parsed.
+ */
+static uint8_t *saraR5SchemaRecord(SARA_R5_schema_parser *parser)
+{
+	return &parser->records[parser->count * parser->schema->recordSize];
+}
+
+/**
+ * Gets the field being parsed, or NULL past the last field of the schema.
+ */
+static const SARA_R5_field *saraR5SchemaField(SARA_R5_schema_parser *parser)
+{
+	return (parser->field < parser->schema->count) ? &parser->schema->fields[parser->field] : NULL;
+}
+
+/**
+ * Clears the number being read at the start of a field, and after every address byte or hex pair.
+ */
+static void saraR5SchemaValueStart(SARA_R5_schema_parser *parser)
+{
+	parser->value = 0;
+	parser->digits = 0;
+	parser->negative = false;
+}
+
+/**
+ * Gets the value of a hex digit, or -1.
+ */
+static int saraR5SchemaHexDigit(char c)
+{
+	if (c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+	if (c >= 'A' && c <= 'F')
+	{
+		return c - 'A' + 10;
+	}
+	if (c >= 'a' && c <= 'f')
+	{
+		return c - 'a' + 10;
+	}
+	return -1;
+}
+
+/**
+ * Stores a number in an integer member of 1, 2, 4 or 8 bytes, which takes the range of both its signed and its
+ * unsigned type (-128 to 255 for a byte).
+ * @return false if the member has another size or the number does not fit.
+ */
+static bool saraR5SchemaStoreInt(uint8_t *member, size_t size, uint64_t value, bool negative)
+{
+	uint64_t bits = negative ? 0u - value : value; // Two's complement, cut to the member
+	uint64_t max;
+
+	switch (size)
+	{
+	case sizeof(uint8_t):
+		max = UINT8_MAX;
+		break;
+	case sizeof(uint16_t):
+		max = UINT16_MAX;
+		break;
+	case sizeof(uint32_t):
+		max = UINT32_MAX;
+		break;
+	case sizeof(uint64_t):
+		max = UINT64_MAX;
+		break;
+	default:
+		return false;
+	}
+	if (negative ? value > max / 2 + 1 : value > max)
+	{
+		return false;
+	}
+
+	switch (size)
+	{
+	case sizeof(uint8_t):
+		*(uint8_t *)member = (uint8_t)bits;
+		break;
+	case sizeof(uint16_t):
+		*(uint16_t *)member = (uint16_t)bits;
+		break;
+	case sizeof(uint32_t):
+		*(uint32_t *)member = (uint32_t)bits;
+		break;
+	default:
+		*(uint64_t *)member = bits;
+		break;
+	}
+	return true;
+}
+
+/**
+ * Takes one character of the current field, outside the quotes and separators.
+ */
+static void saraR5SchemaFieldChar(SARA_R5_schema_parser *parser, char c)
+{
+	const SARA_R5_field *field = saraR5SchemaField(parser);
+	uint8_t *member;
+	int digit;
+
+	if (field == NULL || !parser->valid)
+	{
+		return; // Extra field, or the record is already dropped
+	}
+	member = saraR5SchemaRecord(parser) + field->offset;
+
+	switch (field->type)
+	{
+	case SARA_R5_FIELD_INT:
+		if (c == '-' && parser->digits == 0 && !parser->negative)
+		{
+			parser->negative = true;
+		}
+		else if (c >= '0' && c <= '9' && parser->value <= (UINT64_MAX - (uint64_t)(c - '0')) / 10)
+		{
+			parser->value = parser->value * 10 + (uint64_t)(c - '0');
+			parser->digits++;
+		}
+		else
+		{
+			parser->valid = false;
+		}
+		break;
+
+	case SARA_R5_FIELD_STRING:
+		if (parser->fieldLength + 1 < field->size)
+		{
+			member[parser->fieldLength++] = (uint8_t)c; // The rest stays 0, so the string is terminated
+		}
+		break;
+
+	case SARA_R5_FIELD_IP:
+		if (c >= '0' && c <= '9' && parser->digits < 3)
+		{
+			parser->value = parser->value * 10 + (uint64_t)(c - '0');
+			parser->digits++;
+			parser->valid = parser->value <= 255;
+		}
+		else if (c == '.' && parser->digits > 0 && parser->fieldLength + 1 < field->size)
+		{
+			member[parser->fieldLength++] = (uint8_t)parser->value;
+			saraR5SchemaValueStart(parser);
+		}
+		else
+		{
+			parser->valid = false;
+		}
+		break;
+
+	case SARA_R5_FIELD_HEX:
+		digit = saraR5SchemaHexDigit(c);
+		if (digit < 0 || parser->fieldLength >= field->size)
+		{
+			parser->valid = false;
+			break;
+		}
+		parser->value = (parser->value << 4) | (uint64_t)digit;
+		if (++parser->digits == 2)
+		{
+			member[parser->fieldLength++] = (uint8_t)parser->value;
+			saraR5SchemaValueStart(parser);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+/**
+ * Finishes the current field: stores its number, its last address byte or its length.
+ */
+static void saraR5SchemaFieldEnd(SARA_R5_schema_parser *parser)
+{
+	const SARA_R5_field *field = saraR5SchemaField(parser);
+	uint8_t *member;
+
+	if (field == NULL || !parser->valid)
+	{
+		return;
+	}
+	member = saraR5SchemaRecord(parser) + field->offset;
+
+	switch (field->type)
+	{
+	case SARA_R5_FIELD_INT:
+		parser->valid = parser->digits > 0 && saraR5SchemaStoreInt(member, field->size, parser->value, parser->negative);
+		break;
+
+	case SARA_R5_FIELD_IP:
+		// Every byte of the member must be given, "10.64.12" is not an IPv4 address
+		parser->valid = parser->digits > 0 && parser->fieldLength + 1 == field->size;
+		if (parser->valid)
+		{
+			member[parser->fieldLength] = (uint8_t)parser->value;
+		}
+		break;
+
+	case SARA_R5_FIELD_HEX:
+		parser->valid = parser->digits == 0; // An odd number of digits is a cut byte
+		if (parser->valid && field->lengthOffset != SARA_R5_FIELD_NO_LENGTH)
+		{
+			memcpy(saraR5SchemaRecord(parser) + field->lengthOffset, &parser->fieldLength, sizeof(parser->fieldLength));
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+/**
+ * Starts the next field of the line.
+ */
+static void saraR5SchemaFieldStart(SARA_R5_schema_parser *parser)
+{
+	parser->fieldLength = 0;
+	parser->inQuotes = false;
+	saraR5SchemaValueStart(parser);
+}
+
+/**
+ * Starts a record once the prefix of the line is matched, or skips the line when the records are full.
+ */
+static void saraR5SchemaStartLine(SARA_R5_schema_parser *parser)
+{
+	if (parser->count >= parser->maxRecords)
+	{
+		parser->skipLine = true;
+		return;
+	}
+	memset(saraR5SchemaRecord(parser), 0, parser->schema->recordSize);
+	parser->field = 0;
+	parser->valid = true;
+	saraR5SchemaFieldStart(parser);
+}
+
+/**
+ * Initializes a schema parser.
+ * @param parser The parser to initialize.
+ * @param schema The layout of the lines to parse.
+ * @param records Where to store one output struct per matching line (array of schema->recordSize structs).
+ * @param maxRecords The number of entries of 'records'.
+ */
+void saraR5SchemaParserInit(SARA_R5_schema_parser *parser, const SARA_R5_response_schema *schema, void *records, size_t maxRecords)
+{
+	memset(parser, 0, sizeof(*parser));
+	parser->schema = schema;
+	parser->records = (uint8_t *)records;
+	parser->maxRecords = maxRecords;
+}
+
+/**
+ * Parses an answer as it arrives (SARA_R5_response_handler), in a single pass and without copying the lines.
+ * Lines starting with the prefix of the schema fill one record each; the other lines are skipped.
+ * A record is kept only if every field of the schema is there and well formed.
+ * @param data The next bytes of the current line.
+ * @param len The number of bytes.
+ * @param lineEnd true if 'data' ends the line.
+ * @param context The parser (SARA_R5_schema_parser).
+ */
+void saraR5SchemaParserFeed(const char *data, size_t len, bool lineEnd, void *context)
+{
+	SARA_R5_schema_parser *parser = (SARA_R5_schema_parser *)context;
+	const char *prefix = parser->schema->prefix;
+	size_t prefixSize = strlen(prefix);
+
+	for (size_t i = 0; i < len && !parser->skipLine; i++)
+	{
+		char c = data[i];
+
+		if (parser->prefixLength < prefixSize)
+		{
+			// Still matching the start of the line
+			if (c != prefix[parser->prefixLength])
+			{
+				parser->skipLine = true;
+			}
+			else if (++parser->prefixLength == prefixSize)
+			{
+				saraR5SchemaStartLine(parser);
+			}
+		}
+		else if (c == '"')
+		{
+			parser->inQuotes = !parser->inQuotes;
+		}
+		else if (c == ',' && !parser->inQuotes)
+		{
+			saraR5SchemaFieldEnd(parser);
+			parser->field++;
+			saraR5SchemaFieldStart(parser);
+		}
+		else if (c != ' ' || parser->inQuotes)
+		{
+			saraR5SchemaFieldChar(parser, c);
+		}
+	}
+
+	if (!lineEnd)
+	{
+		return;
+	}
+	if (!parser->skipLine && prefixSize > 0 && parser->prefixLength == prefixSize)
+	{
+		if (parser->inQuotes)
+		{
+			parser->valid = false; // Cut in the middle of a quoted field
+		}
+		saraR5SchemaFieldEnd(parser);
+		if (parser->valid && parser->field + 1 >= parser->schema->count)
+		{
+			parser->count++; // The record is kept
+		}
+	}
+	parser->prefixLength = 0;
+	parser->skipLine = false;
+}
+
+/**
+ * Parses a whole answer, or a single line such as a URC, with a schema.
+ * @param schema The layout of the lines to parse.
+ * @param text The answer, lines separated by CR and / or LF.
+ * @param len The length of the answer.
+ * @param records Where to store one output struct per matching line.
+ * @param maxRecords The number of entries of 'records'.
+ * @return The number of records stored.
+ */
+size_t saraR5SchemaParse(const SARA_R5_response_schema *schema, const char *text, size_t len, void *records, size_t maxRecords)
+{
+	SARA_R5_schema_parser parser;
+	size_t start = 0;
+
+	saraR5SchemaParserInit(&parser, schema, records, maxRecords);
+	for (size_t i = 0; i <= len; i++)
+	{
+		if (i == len || text[i] == '\r' || text[i] == '\n')
+		{
+			if (i > start)
+			{
+				saraR5SchemaParserFeed(&text[start], i - start, true, &parser);
+			}
+			start = i + 1;
+		}
+	}
+	return parser.count;
+}
@@ -0,0 +1,68 @@
+#ifndef SARA_R5_SCHEMA_H
+#define SARA_R5_SCHEMA_H
+
+// INCLUDES
+#include "stdint.h"
+#include "stddef.h"
+#include "stdbool.h"
+
+#define SARA_R5_FIELD_NO_LENGTH ((size_t)-1) // 'lengthOffset' of the fields that do not store a length
+
+// Types of the fields of a response line
+typedef enum
+{
+  SARA_R5_FIELD_INT = 0, // Decimal number, optionally signed, stored in an integer member of 1, 2, 4 or 8 bytes
+  SARA_R5_FIELD_STRING,  // Quoted or bare string, stored null terminated in a char array (cut if too long)
+  SARA_R5_FIELD_IP,      // Dotted address ("10.64.12.7"), stored in a uint8_t[4] (or uint8_t[16] for IPv6)
+  SARA_R5_FIELD_HEX,     // Hex digits, stored as bytes in a uint8_t array, their number in a size_t member
+  SARA_R5_FIELD_SKIP     // Read and dropped
+} SARA_R5_field_type;
+
+// One field of a response line and the member of the output struct it goes to
+typedef struct
+{
+  SARA_R5_field_type type;
+  size_t offset;       // Offset of the member in the output struct
+  size_t size;         // Size of the member
+  size_t lengthOffset; // SARA_R5_FIELD_HEX: offset of the size_t receiving the number of bytes
+} SARA_R5_field;
+
+#define SARA_R5_FIELD(type, record, member) {(type), offsetof(record, member), sizeof(((record *)0)->member), SARA_R5_FIELD_NO_LENGTH}
+#define SARA_R5_FIELD_BYTES(record, member, length) {SARA_R5_FIELD_HEX, offsetof(record, member), sizeof(((record *)0)->member), offsetof(record, length)}
+#define SARA_R5_FIELD_SKIPPED {SARA_R5_FIELD_SKIP, 0, 0, SARA_R5_FIELD_NO_LENGTH}
+
+// Layout of the lines of an answer, e.g. "+USOCR: <socket>"
+typedef struct
+{
+  const char *prefix;          // Start of the line, with its ':' (e.g. "+USOCR:")
+  const SARA_R5_field *fields; // Fields after the prefix, in order
+  size_t count;                // Number of fields, all of them must be present (more are ignored)
+  size_t recordSize;           // Size of the output struct, one per matching line
+} SARA_R5_response_schema;
+
+#define SARA_R5_SCHEMA(prefix, record, fields) {(prefix), (fields), sizeof(fields) / sizeof((fields)[0]), sizeof(record)}
+
+// Single pass parser filling the output structs of a schema, fed as the bytes arrive
+typedef struct
+{
+  const SARA_R5_response_schema *schema; // Layout of the lines
+  uint8_t *records;                      // Output structs
+  size_t maxRecords;                     // Entries of 'records'
+  size_t count;                          // Records filled
+  size_t prefixLength;                   // Characters of the prefix matched at the start of the line
+  bool skipLine;                         // The line does not match, or no record is left
+  size_t field;                          // Field being parsed
+  size_t fieldLength;                    // Characters (or bytes) of the field stored so far
+  bool inQuotes;                         // Inside a quoted field
+  bool valid;                            // Nothing unexpected in the line so far
+  bool negative;                         // The number being read has a '-'
+  uint64_t value;                        // Number, address byte or hex digit being read (64 bits on every target)
+  uint8_t digits;                        // Digits of 'value'
+} SARA_R5_schema_parser;
+
+// FUNCTIONS FOR RESPONSE SCHEMAS
+void saraR5SchemaParserInit(SARA_R5_schema_parser *parser, const SARA_R5_response_schema *schema, void *records, size_t maxRecords);
+void saraR5SchemaParserFeed(const char *data, size_t len, bool lineEnd, void *context);
+size_t saraR5SchemaParse(const SARA_R5_response_schema *schema, const char *text, size_t len, void *records, size_t maxRecords);
+
+#endif // SARA_R5_SCHEMA_H
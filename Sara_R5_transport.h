@@ -0,0 +1,21 @@
+#ifndef SARA_R5_TRANSPORT_H
+#define SARA_R5_TRANSPORT_H
+
+// INCLUDES
+#include "stdint.h"
+#include "stddef.h"
+#include "stdbool.h"
+
+// Byte link between the library and the module.
+// Every backend (STM32 HAL UART, POSIX serial/pty, in-memory loopback) fills one of these.
+typedef struct
+{
+  bool (*send)(void *context, const uint8_t *data, size_t len);   // Blocking write of 'len' bytes
+  size_t (*receive)(void *context, uint8_t *data, size_t len);    // Non blocking read of the bytes already received
+  void (*wait)(void *context, uint32_t ms);                       // Sleep until bytes arrive or 'ms' elapse
+  uint32_t (*nowMs)(void *context);                               // Monotonic time in milliseconds
+  bool (*setBaudRate)(void *context, uint32_t baud, bool rtsCts); // Reconfigure the local side (may be NULL)
+  void *context;                                                  // Backend state passed to every call
+} SARA_R5_transport;
+
+#endif // SARA_R5_TRANSPORT_H
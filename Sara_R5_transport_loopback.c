@@ -0,0 +1,97 @@
+#include "Sara_R5_transport_loopback.h"
+#include "string.h"
+
+/**
+ * Stores the bytes sent by the library and lets the peer answer them.
+ */
+static bool saraR5LoopbackSend(void *context, const uint8_t *data, size_t len)
+{
+	SARA_R5_loopback_transport *port = (SARA_R5_loopback_transport *)context;
+
+	if (port->onSend != NULL)
+	{
+		port->onSend(port->peer, data, len);
+		return true;
+	}
+	return saraR5RingBufferWrite(&port->sent, data, len) == len;
+}
+
+/**
+ * Hands out the bytes injected for the library.
+ */
+static size_t saraR5LoopbackReceive(void *context, uint8_t *data, size_t len)
+{
+	SARA_R5_loopback_transport *port = (SARA_R5_loopback_transport *)context;
+
+	return saraR5RingBufferRead(&port->pending, data, len);
+}
+
+/**
+ * Moves the virtual clock forward when there is nothing to read.
+ */
+static void saraR5LoopbackWait(void *context, uint32_t ms)
+{
+	SARA_R5_loopback_transport *port = (SARA_R5_loopback_transport *)context;
+
+	if (saraR5RingBufferAvailable(&port->pending) == 0)
+	{
+		port->now += ms;
+	}
+}
+
+/**
+ * Reads the virtual clock.
+ */
+static uint32_t saraR5LoopbackNowMs(void *context)
+{
+	SARA_R5_loopback_transport *port = (SARA_R5_loopback_transport *)context;
+
+	return port->now;
+}
+
+/**
+ * Builds an in-memory transport. Without a peer, sent bytes are kept and can be read with saraR5LoopbackDrain.
+ * @param transport The transport to fill.
+ * @param port Storage for the backend state. Must live as long as the transport.
+ * @param onSend Function receiving the bytes sent by the library, or NULL.
+ * @param peer Pointer passed back to onSend.
+ */
+void saraR5TransportLoopbackInit(SARA_R5_transport *transport, SARA_R5_loopback_transport *port, SARA_R5_loopback_peer onSend, void *peer)
+{
+	memset(port, 0, sizeof(*port));
+	saraR5RingBufferInit(&port->sent, port->sentStorage, sizeof(port->sentStorage));
+	saraR5RingBufferInit(&port->pending, port->pendingStorage, sizeof(port->pendingStorage));
+	port->onSend = onSend;
+	port->peer = peer;
+
+	transport->send = saraR5LoopbackSend;
+	transport->receive = saraR5LoopbackReceive;
+	transport->wait = saraR5LoopbackWait;
+	transport->nowMs = saraR5LoopbackNowMs;
+	transport->setBaudRate = NULL;
+	transport->context = port;
+}
+
+/**
+ * Queues bytes for the library to receive, as if the module had sent them.
+ * @param port The backend state.
+ * @param data The bytes to queue.
+ * @param len The number of bytes.
+ * @return The number of bytes queued.
+ */
+size_t saraR5LoopbackInject(SARA_R5_loopback_transport *port, const uint8_t *data, size_t len)
+{
+	return saraR5RingBufferWrite(&port->pending, data, len);
+}
+
+/**
+ * Reads the bytes the library sent (only when no peer is attached).
+ * @param port The backend state.
+ * @param data Where to store the bytes.
+ * @param len The maximum number of bytes to read.
+ * @return The number of bytes read.
+ */
+size_t saraR5LoopbackDrain(SARA_R5_loopback_transport *port, uint8_t *data, size_t len)
+{
+	return saraR5RingBufferRead(&port->sent, data, len);
+}
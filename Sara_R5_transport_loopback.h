@@ -0,0 +1,31 @@
+#ifndef SARA_R5_TRANSPORT_LOOPBACK_H
+#define SARA_R5_TRANSPORT_LOOPBACK_H
+
+// INCLUDES
+#include "Sara_R5_transport.h"
+#include "Sara_R5_ring_buffer.h"
+
+#define SARA_R5_LOOPBACK_BUFFER_SIZE 2048
+
+// Called with every byte block the library sends, so a peer can answer synchronously
+typedef void (*SARA_R5_loopback_peer)(void *peer, const uint8_t *data, size_t len);
+
+// State of the in-memory loopback backend.
+// Time is virtual: it only moves when the library waits, which keeps runs deterministic.
+typedef struct
+{
+  uint8_t sentStorage[SARA_R5_LOOPBACK_BUFFER_SIZE];    // Storage of 'sent'
+  uint8_t pendingStorage[SARA_R5_LOOPBACK_BUFFER_SIZE]; // Storage of 'pending'
+  SARA_R5_ring_buffer sent;                             // Bytes written by the library
+  SARA_R5_ring_buffer pending;                          // Bytes waiting to be read by the library
+  uint32_t now;                                         // Virtual clock in milliseconds
+  SARA_R5_loopback_peer onSend;                         // Peer answering the library (may be NULL)
+  void *peer;                                           // Passed back to onSend
+} SARA_R5_loopback_transport;
+
+// FUNCTIONS FOR THE LOOPBACK TRANSPORT
+void saraR5TransportLoopbackInit(SARA_R5_transport *transport, SARA_R5_loopback_transport *port, SARA_R5_loopback_peer onSend, void *peer);
+size_t saraR5LoopbackInject(SARA_R5_loopback_transport *port, const uint8_t *data, size_t len);
+size_t saraR5LoopbackDrain(SARA_R5_loopback_transport *port, uint8_t *data, size_t len);
+
+#endif // SARA_R5_TRANSPORT_LOOPBACK_H
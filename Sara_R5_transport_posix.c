@@ -0,0 +1,233 @@
+#ifdef SARA_R5_HOST
+
+#include "Sara_R5_transport_posix.h"
+#include "errno.h"
+#include "fcntl.h"
+#include "poll.h"
+#include "termios.h"
+#include "time.h"
+#include "unistd.h"
+
+/**
+ * Converts a numeric baud rate to its termios constant.
+ * @param baud The baud rate.
+ * @return The termios speed, or B0 if the rate is not supported.
+ */
+static speed_t saraR5PosixSpeed(uint32_t baud)
+{
+	switch (baud)
+	{
+	case 9600:
+		return B9600;
+	case 19200:
+		return B19200;
+	case 38400:
+		return B38400;
+	case 57600:
+		return B57600;
+	case 115200:
+		return B115200;
+	case 230400:
+		return B230400;
+#ifdef B460800
+	case 460800:
+		return B460800;
+#endif
+#ifdef B921600
+	case 921600:
+		return B921600;
+#endif
+	default:
+		return B0;
+	}
+}
+
+/**
+ * Writes every byte, waiting for the descriptor when the kernel buffer is full.
+ */
+static bool saraR5PosixSend(void *context, const uint8_t *data, size_t len)
+{
+	SARA_R5_posix_transport *port = (SARA_R5_posix_transport *)context;
+
+	while (len > 0)
+	{
+		ssize_t written = write(port->fd, data, len);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				struct pollfd pfd = {port->fd, POLLOUT, 0};
+				poll(&pfd, 1, -1);
+				continue;
+			}
+			return false; // Write error
+		}
+		data += written;
+		len -= (size_t)written;
+	}
+	return true;
+}
+
+/**
+ * Reads the bytes already queued by the kernel without blocking.
+ */
+static size_t saraR5PosixReceive(void *context, uint8_t *data, size_t len)
+{
+	SARA_R5_posix_transport *port = (SARA_R5_posix_transport *)context;
+	ssize_t count = read(port->fd, data, len);
+
+	return (count > 0) ? (size_t)count : 0;
+}
+
+/**
+ * Waits until the descriptor is readable or 'ms' elapse.
+ */
+static void saraR5PosixWait(void *context, uint32_t ms)
+{
+	SARA_R5_posix_transport *port = (SARA_R5_posix_transport *)context;
+	struct pollfd pfd = {port->fd, POLLIN, 0};
+
+	poll(&pfd, 1, (int)ms);
+}
+
+/**
+ * Reads the monotonic clock in milliseconds.
+ */
+static uint32_t saraR5PosixNowMs(void *context)
+{
+	struct timespec now;
+
+	(void)context;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)(now.tv_sec * 1000u + now.tv_nsec / 1000000);
+}
+
+/**
+ * Changes the line speed and RTS/CTS flow control. Ptys accept it and ignore the speed.
+ */
+static bool saraR5PosixSetBaudRate(void *context, uint32_t baud, bool rtsCts)
+{
+	SARA_R5_posix_transport *port = (SARA_R5_posix_transport *)context;
+	speed_t speed = saraR5PosixSpeed(baud);
+	struct termios tio;
+
+	if (speed == B0 || tcgetattr(port->fd, &tio) != 0)
+	{
+		return false;
+	}
+
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+#ifdef CRTSCTS
+	if (rtsCts)
+	{
+		tio.c_cflag |= CRTSCTS;
+	}
+	else
+	{
+		tio.c_cflag &= ~CRTSCTS;
+	}
+#else
+	if (rtsCts)
+	{
+		return false; // No hardware flow control on this system
+	}
+#endif
+	// Let the pending bytes leave at the old speed first
+	return tcsetattr(port->fd, TCSADRAIN, &tio) == 0;
+}
+
+/**
+ * Builds a transport on top of an already open descriptor (e.g. the master side of openpty()).
+ * The descriptor is switched to non blocking mode and is not closed by saraR5TransportPosixClose.
+ * @param transport The transport to fill.
+ * @param port Storage for the backend state. Must live as long as the transport.
+ * @param fd The open descriptor.
+ * @return true if the descriptor could be used, false otherwise.
+ */
+bool saraR5TransportPosixAttach(SARA_R5_transport *transport, SARA_R5_posix_transport *port, int fd)
+{
+	int flags = fcntl(fd, F_GETFL);
+
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+	{
+		return false;
+	}
+
+	port->fd = fd;
+	port->ownsFd = false;
+
+	transport->send = saraR5PosixSend;
+	transport->receive = saraR5PosixReceive;
+	transport->wait = saraR5PosixWait;
+	transport->nowMs = saraR5PosixNowMs;
+	transport->setBaudRate = saraR5PosixSetBaudRate;
+	transport->context = port;
+	return true;
+}
+
+/**
+ * Opens a serial device or pty in raw 8N1 mode and builds a transport on top of it.
+ * @param transport The transport to fill.
+ * @param port Storage for the backend state. Must live as long as the transport.
+ * @param device Path of the device, e.g. "/dev/ttyUSB0" or "/dev/pts/3".
+ * @param baud The baud rate. Ignored by ptys.
+ * @return true if the device is open and configured, false otherwise.
+ */
+bool saraR5TransportPosixOpen(SARA_R5_transport *transport, SARA_R5_posix_transport *port, const char *device, uint32_t baud)
+{
+	struct termios tio;
+	speed_t speed = saraR5PosixSpeed(baud);
+	int fd;
+
+	if (speed == B0)
+	{
+		return false; // Unsupported baud rate
+	}
+
+	fd = open(device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	if (tcgetattr(fd, &tio) == 0)
+	{
+		cfmakeraw(&tio);
+		tio.c_cflag |= CLOCAL | CREAD;
+		tio.c_cc[VMIN] = 0;
+		tio.c_cc[VTIME] = 0;
+		cfsetispeed(&tio, speed);
+		cfsetospeed(&tio, speed);
+		tcsetattr(fd, TCSANOW, &tio);
+		tcflush(fd, TCIOFLUSH);
+	}
+
+	if (!saraR5TransportPosixAttach(transport, port, fd))
+	{
+		close(fd);
+		return false;
+	}
+	port->ownsFd = true;
+	return true;
+}
+
+/**
+ * Closes the descriptor if it was opened by saraR5TransportPosixOpen.
+ * @param port The backend state.
+ */
+void saraR5TransportPosixClose(SARA_R5_posix_transport *port)
+{
+	if (port->ownsFd && port->fd >= 0)
+	{
+		close(port->fd);
+	}
+	port->fd = -1;
+	port->ownsFd = false;
+}
+
+#endif // SARA_R5_HOST
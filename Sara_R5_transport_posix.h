@@ -0,0 +1,19 @@
+#ifndef SARA_R5_TRANSPORT_POSIX_H
+#define SARA_R5_TRANSPORT_POSIX_H
+
+// INCLUDES
+#include "Sara_R5_transport.h"
+
+// State of the POSIX termios / pty backend
+typedef struct
+{
+  int fd;      // Serial device or pty file descriptor
+  bool ownsFd; // The descriptor was opened by the backend and is closed by it
+} SARA_R5_posix_transport;
+
+// FUNCTIONS FOR THE POSIX TRANSPORT
+bool saraR5TransportPosixOpen(SARA_R5_transport *transport, SARA_R5_posix_transport *port, const char *device, uint32_t baud);
+bool saraR5TransportPosixAttach(SARA_R5_transport *transport, SARA_R5_posix_transport *port, int fd);
+void saraR5TransportPosixClose(SARA_R5_posix_transport *port);
+
+#endif // SARA_R5_TRANSPORT_POSIX_H
@@ -0,0 +1,197 @@
+#ifndef SARA_R5_HOST
+
+#include "Sara_R5_transport_stm32.h"
+#include "string.h"
+
+// Backend fed by the HAL UART callbacks
+static SARA_R5_stm32_transport *saraR5Stm32Port = NULL;
+
+/**
+ * Starts the circular DMA reception with idle line detection.
+ * The UART DMA channel must be configured in circular mode. Calling it again once started does nothing.
+ * @param port The STM32 backend state.
+ * @return true if the reception is running, false otherwise.
+ */
+bool saraR5StartReceiveDMA(SARA_R5_stm32_transport *port)
+{
+	if (port->started)
+	{
+		return true;
+	}
+
+	port->dmaPosition = 0;
+	if (HAL_UARTEx_ReceiveToIdle_DMA(port->huart, port->dmaBuffer, SARA_R5_RX_DMA_BUFFER_SIZE) != HAL_OK)
+	{
+		return false; // DMA could not be started
+	}
+	port->started = true;
+	return true;
+}
+
+/**
+ * Handles a reception event from the UART (DMA half transfer, transfer complete or idle line).
+ * Copies the bytes written by the DMA since the last event into the reception ring buffer.
+ * @param huart The UART that raised the event.
+ * @param size The current write position of the DMA inside its buffer.
+ */
+void saraR5UartRxEventHandler(UART_HandleTypeDef *huart, uint16_t size)
+{
+	SARA_R5_stm32_transport *port = saraR5Stm32Port;
+
+	if (port == NULL || huart != port->huart)
+	{
+		return;
+	}
+
+	uint16_t position = port->dmaPosition;
+
+	if (size > position)
+	{
+		saraR5RingBufferWrite(&port->ring, &port->dmaBuffer[position], size - position);
+	}
+	else if (size < position)
+	{
+		// The DMA wrapped around: copy the tail of the buffer, then the beginning
+		saraR5RingBufferWrite(&port->ring, &port->dmaBuffer[position], SARA_R5_RX_DMA_BUFFER_SIZE - position);
+		saraR5RingBufferWrite(&port->ring, port->dmaBuffer, size);
+	}
+
+	port->dmaPosition = (size == SARA_R5_RX_DMA_BUFFER_SIZE) ? 0 : size;
+}
+
+/**
+ * Handles a UART error (overrun, noise, framing) by restarting the DMA reception.
+ * @param huart The UART that raised the error.
+ */
+void saraR5UartErrorHandler(UART_HandleTypeDef *huart)
+{
+	SARA_R5_stm32_transport *port = saraR5Stm32Port;
+
+	if (port == NULL || huart != port->huart)
+	{
+		return;
+	}
+
+	port->started = false;
+	saraR5StartReceiveDMA(port);
+}
+
+#ifndef SARA_R5_USER_UART_CALLBACKS
+// Overrides of the weak HAL callbacks. Define SARA_R5_USER_UART_CALLBACKS when the application
+// provides its own and call saraR5UartRxEventHandler / saraR5UartErrorHandler from them.
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size)
+{
+	saraR5UartRxEventHandler(huart, Size);
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	saraR5UartErrorHandler(huart);
+}
+#endif
+
+/**
+ * Sends bytes through the HAL UART, in pieces the HAL can handle.
+ */
+static bool saraR5Stm32Send(void *context, const uint8_t *data, size_t len)
+{
+	SARA_R5_stm32_transport *port = (SARA_R5_stm32_transport *)context;
+
+	// Reception must be running before the module starts answering
+	if (!saraR5StartReceiveDMA(port))
+	{
+		return false;
+	}
+
+	while (len > 0)
+	{
+		uint16_t piece = (len > 0xFFFF) ? 0xFFFF : (uint16_t)len;
+		if (HAL_UART_Transmit(port->huart, data, piece, HAL_MAX_DELAY) != HAL_OK)
+		{
+			return false; // Transmission error
+		}
+		data += piece;
+		len -= piece;
+	}
+	return true;
+}
+
+/**
+ * Hands out the bytes already moved out of the DMA buffer.
+ */
+static size_t saraR5Stm32Receive(void *context, uint8_t *data, size_t len)
+{
+	SARA_R5_stm32_transport *port = (SARA_R5_stm32_transport *)context;
+
+	if (!saraR5StartReceiveDMA(port))
+	{
+		return 0;
+	}
+	return saraR5RingBufferRead(&port->ring, data, len);
+}
+
+/**
+ * Waits until the interrupt stores new bytes or 'ms' elapse.
+ */
+static void saraR5Stm32Wait(void *context, uint32_t ms)
+{
+	SARA_R5_stm32_transport *port = (SARA_R5_stm32_transport *)context;
+	uint32_t start = HAL_GetTick();
+
+	while (saraR5RingBufferAvailable(&port->ring) == 0 && (HAL_GetTick() - start) < ms)
+	{
+	}
+}
+
+/**
+ * Reads the HAL millisecond tick.
+ */
+static uint32_t saraR5Stm32NowMs(void *context)
+{
+	(void)context;
+	return HAL_GetTick();
+}
+
+/**
+ * Reconfigures the UART speed and RTS/CTS flow control, then restarts the reception.
+ */
+static bool saraR5Stm32SetBaudRate(void *context, uint32_t baud, bool rtsCts)
+{
+	SARA_R5_stm32_transport *port = (SARA_R5_stm32_transport *)context;
+
+	HAL_UART_AbortReceive(port->huart);
+	port->started = false;
+
+	port->huart->Init.BaudRate = baud;
+	port->huart->Init.HwFlowCtl = rtsCts ? UART_HWCONTROL_RTS_CTS : UART_HWCONTROL_NONE;
+	if (HAL_UART_Init(port->huart) != HAL_OK)
+	{
+		return false;
+	}
+
+	saraR5RingBufferClear(&port->ring);
+	return saraR5StartReceiveDMA(port);
+}
+
+/**
+ * Builds a transport on top of a HAL UART. Reception starts on first use.
+ * @param transport The transport to fill.
+ * @param port Storage for the backend state. Must live as long as the transport.
+ * @param huart The UART wired to the module.
+ */
+void saraR5TransportStm32Init(SARA_R5_transport *transport, SARA_R5_stm32_transport *port, UART_HandleTypeDef *huart)
+{
+	memset(port, 0, sizeof(*port));
+	port->huart = huart;
+	saraR5RingBufferInit(&port->ring, port->storage, sizeof(port->storage));
+	saraR5Stm32Port = port;
+
+	transport->send = saraR5Stm32Send;
+	transport->receive = saraR5Stm32Receive;
+	transport->wait = saraR5Stm32Wait;
+	transport->nowMs = saraR5Stm32NowMs;
+	transport->setBaudRate = saraR5Stm32SetBaudRate;
+	transport->context = port;
+}
+
+#endif // SARA_R5_HOST
@@ -0,0 +1,32 @@
+#ifndef SARA_R5_TRANSPORT_STM32_H
+#define SARA_R5_TRANSPORT_STM32_H
+
+// INCLUDES
+#include "stm32u5xx_hal.h"
+#include "stm32u5xx_hal_uart.h"
+#include "Sara_R5_transport.h"
+#include "Sara_R5_ring_buffer.h"
+
+#define SARA_R5_RX_DMA_BUFFER_SIZE 256       // Circular DMA buffer written by the UART
+#define SARA_R5_STM32_RX_RING_BUFFER_SIZE 512 // Ring buffer filled from the UART interrupt
+
+// State of the STM32 HAL UART backend.
+// The DMA writes circularly into dmaBuffer; every half/full/idle event moves the
+// new bytes into 'ring', which is what the transport hands to the library.
+typedef struct
+{
+  UART_HandleTypeDef *huart;                         // UART wired to the module
+  uint8_t dmaBuffer[SARA_R5_RX_DMA_BUFFER_SIZE];     // Circular DMA target
+  uint8_t storage[SARA_R5_STM32_RX_RING_BUFFER_SIZE]; // Storage of 'ring'
+  SARA_R5_ring_buffer ring;                          // Received bytes not handed out yet
+  volatile uint16_t dmaPosition;                     // Last DMA position copied into the ring
+  bool started;                                      // DMA reception running
+} SARA_R5_stm32_transport;
+
+// FUNCTIONS FOR THE STM32 HAL UART TRANSPORT
+void saraR5TransportStm32Init(SARA_R5_transport *transport, SARA_R5_stm32_transport *port, UART_HandleTypeDef *huart);
+bool saraR5StartReceiveDMA(SARA_R5_stm32_transport *port);
+void saraR5UartRxEventHandler(UART_HandleTypeDef *huart, uint16_t size);
+void saraR5UartErrorHandler(UART_HandleTypeDef *huart);
+
+#endif // SARA_R5_TRANSPORT_STM32_H
@@ -0,0 +1,213 @@
+#include "Sara_R5_urc.h"
+#include "string.h"
+#include "stdlib.h"
+
+/**
+ * Gets the length of the prefix of a line: everything before the ':', or the whole line.
+ */
+static size_t saraR5UrcPrefixLength(const char *line, size_t len)
+{
+	const char *colon = memchr(line, ':', len);
+
+	return (colon != NULL) ? (size_t)(colon - line) : len;
+}
+
+/**
+ * Hashes a prefix (FNV-1a). Prefixes are short, so a lookup costs the same whatever the number of handlers.
+ */
+static uint32_t saraR5UrcHash(const char *prefix, size_t len)
+{
+	uint32_t hash = 2166136261u;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		hash ^= (uint8_t)prefix[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * Finds the slot holding a prefix, or the free slot where it would go.
+ * @return The slot, or NULL if the prefix is not there and the table is full.
+ */
+static SARA_R5_urc_entry *saraR5UrcSlot(const SARA_R5_urc_table *table, const char *prefix, size_t len)
+{
+	size_t index = saraR5UrcHash(prefix, len) & (SARA_R5_URC_TABLE_SIZE - 1);
+
+	if (len == 0 || len >= SARA_R5_URC_PREFIX_SIZE)
+	{
+		return NULL;
+	}
+
+	for (size_t probe = 0; probe < SARA_R5_URC_TABLE_SIZE; probe++)
+	{
+		const SARA_R5_urc_entry *entry = &table->entries[(index + probe) & (SARA_R5_URC_TABLE_SIZE - 1)];
+
+		if (entry->prefix[0] == '\0' || (strncmp(entry->prefix, prefix, len) == 0 && entry->prefix[len] == '\0'))
+		{
+			return (SARA_R5_urc_entry *)entry;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Initializes a URC table with the prefixes of SARA_R5_URC_KNOWN_PREFIXES and no handler.
+ * @param table The table to initialize.
+ */
+void saraR5UrcTableInit(SARA_R5_urc_table *table)
+{
+	static const char *const known[] = SARA_R5_URC_KNOWN_PREFIXES;
+
+	memset(table, 0, sizeof(*table));
+	for (size_t i = 0; i < sizeof(known) / sizeof(known[0]); i++)
+	{
+		saraR5UrcRegister(table, known[i], NULL, NULL);
+	}
+}
+
+/**
+ * Sets the handler of a URC prefix, replacing the previous one.
+ * @param table The URC table.
+ * @param prefix The prefix, without the ':' (e.g. "+UUSORD").
+ * @param handler Function called for every URC with this prefix, or NULL to drop them.
+ * @param context Pointer passed back to the handler.
+ * @return true if the handler is set, false if the prefix is too long or the table is full.
+ */
+bool saraR5UrcRegister(SARA_R5_urc_table *table, const char *prefix, SARA_R5_urc_handler handler, void *context)
+{
+	size_t len = strlen(prefix);
+	SARA_R5_urc_entry *entry = saraR5UrcSlot(table, prefix, len);
+
+	if (entry == NULL)
+	{
+		return false;
+	}
+	if (entry->prefix[0] == '\0')
+	{
+		// Keep one slot free so a failed lookup always ends on an empty slot
+		if (table->count == SARA_R5_URC_TABLE_SIZE - 1)
+		{
+			return false;
+		}
+		memcpy(entry->prefix, prefix, len + 1);
+		table->count++;
+	}
+	entry->handler = handler;
+	entry->context = context;
+	return true;
+}
+
+/**
+ * Tells if a line is an unsolicited result code, i.e. if its prefix is in the table.
+ * @param table The URC table.
+ * @param line The line, without the line terminator.
+ * @param len The length of the line.
+ * @return true if the line is a URC, false otherwise.
+ */
+bool saraR5UrcIsKnown(const SARA_R5_urc_table *table, const char *line, size_t len)
+{
+	const SARA_R5_urc_entry *entry = saraR5UrcSlot(table, line, saraR5UrcPrefixLength(line, len));
+
+	return entry != NULL && entry->prefix[0] != '\0';
+}
+
+/**
+ * Splits the fields of a URC. Fields are separated by ',' outside quotes, spaces and quotes are removed.
+ */
+static void saraR5UrcSplit(SARA_R5_urc_table *table, SARA_R5_urc *urc, const char *line, size_t len, size_t prefixLength)
+{
+	char *storage = table->fieldStorage;
+	char *out;
+	bool quoted = false;
+
+	memcpy(storage, line, prefixLength);
+	storage[prefixLength] = '\0';
+	urc->name = storage;
+	urc->line = line;
+	urc->fieldCount = 0;
+	if (prefixLength == len)
+	{
+		return; // No fields
+	}
+
+	out = &storage[prefixLength + 1];
+	urc->fields[urc->fieldCount++] = out;
+	for (size_t i = prefixLength + 1; i < len; i++)
+	{
+		char c = line[i];
+
+		if (c == '"')
+		{
+			quoted = !quoted;
+		}
+		else if (c == ',' && !quoted)
+		{
+			*out++ = '\0';
+			if (urc->fieldCount == SARA_R5_URC_MAX_FIELDS)
+			{
+				return;
+			}
+			urc->fields[urc->fieldCount++] = out;
+		}
+		else if (c != ' ' || quoted)
+		{
+			*out++ = c;
+		}
+	}
+	*out = '\0';
+}
+
+/**
+ * Hands a line to the handler registered for its prefix, with its fields parsed.
+ * @param table The URC table.
+ * @param line The line, without the line terminator.
+ * @param len The length of the line (at most SARA_R5_AT_LINE_BUFFER_SIZE - 1).
+ * @return true if the line is a URC (handled or dropped), false if it is not in the table.
+ */
+bool saraR5UrcDispatch(SARA_R5_urc_table *table, const char *line, size_t len)
+{
+	size_t prefixLength = saraR5UrcPrefixLength(line, len);
+	const SARA_R5_urc_entry *entry = saraR5UrcSlot(table, line, prefixLength);
+	SARA_R5_urc urc;
+
+	if (entry == NULL || entry->prefix[0] == '\0')
+	{
+		return false;
+	}
+	if (entry->handler == NULL)
+	{
+		table->dropped++;
+		return true;
+	}
+
+	if (len >= sizeof(table->fieldStorage))
+	{
+		len = sizeof(table->fieldStorage) - 1;
+	}
+	saraR5UrcSplit(table, &urc, line, len, prefixLength);
+	table->dispatched++;
+	entry->handler(&urc, entry->context);
+	return true;
+}
+
+/**
+ * Reads a field of a URC as a decimal number.
+ * @param urc The URC.
+ * @param index The index of the field, 0 for the first one after the ':'.
+ * @param fallback The value returned when the field is missing or not a number.
+ * @return The value of the field, or 'fallback'.
+ */
+long saraR5UrcFieldInt(const SARA_R5_urc *urc, size_t index, long fallback)
+{
+	char *end;
+	long value;
+
+	if (index >= urc->fieldCount || urc->fields[index][0] == '\0')
+	{
+		return fallback;
+	}
+	value = strtol(urc->fields[index], &end, 10);
+	return (*end == '\0') ? value : fallback;
+}
@@ -0,0 +1,54 @@
+#ifndef SARA_R5_URC_H
+#define SARA_R5_URC_H
+
+// INCLUDES
+#include "stdint.h"
+#include "stddef.h"
+#include "stdbool.h"
+#include "Sara_R5_at_tokenizer.h"
+
+#define SARA_R5_URC_TABLE_SIZE 32  // Prefixes known at the same time, power of two
+#define SARA_R5_URC_PREFIX_SIZE 16 // Longest prefix, with its null terminator
+#define SARA_R5_URC_MAX_FIELDS 8   // Fields parsed after the ':'
+
+// Unsolicited lines recognized even when nobody handles them, so they never end up in a command answer
+#define SARA_R5_URC_KNOWN_PREFIXES {"+UUSORD", "+UUSORF", "+UUSOCL", "+UUSOLI", "+UUMQTTC", "+UUMQTTCM", "+UUPSDA", "+UUPSDD", "+CEREG", "+CREG", "+CGREG"}
+
+// Unsolicited result code split into fields, e.g. "+UUSORD: 0,12" gives name "+UUSORD" and fields "0", "12"
+typedef struct
+{
+  const char *name;                           // Prefix before the ':'
+  const char *line;                           // Whole line, without the line terminator
+  size_t fieldCount;                          // Fields found after the ':'
+  const char *fields[SARA_R5_URC_MAX_FIELDS]; // Fields without spaces and quotes
+} SARA_R5_urc;
+
+// Called for every URC with a registered prefix
+typedef void (*SARA_R5_urc_handler)(const SARA_R5_urc *urc, void *context);
+
+// Slot of the prefix table
+typedef struct
+{
+  char prefix[SARA_R5_URC_PREFIX_SIZE]; // Empty when the slot is free
+  SARA_R5_urc_handler handler;          // NULL: known URC, dropped
+  void *context;                        // Passed back to 'handler'
+} SARA_R5_urc_entry;
+
+// Prefix table, open addressing on a hash of the prefix
+typedef struct
+{
+  SARA_R5_urc_entry entries[SARA_R5_URC_TABLE_SIZE];
+  size_t count;                                   // Slots in use
+  char fieldStorage[SARA_R5_AT_LINE_BUFFER_SIZE]; // Copy of the line being split
+  unsigned long dispatched;                       // URCs handed to a handler
+  unsigned long dropped;                          // Known URCs without a handler
+} SARA_R5_urc_table;
+
+// FUNCTIONS FOR THE URC DISPATCHER
+void saraR5UrcTableInit(SARA_R5_urc_table *table);
+bool saraR5UrcRegister(SARA_R5_urc_table *table, const char *prefix, SARA_R5_urc_handler handler, void *context);
+bool saraR5UrcIsKnown(const SARA_R5_urc_table *table, const char *line, size_t len);
+bool saraR5UrcDispatch(SARA_R5_urc_table *table, const char *line, size_t len);
+long saraR5UrcFieldInt(const SARA_R5_urc *urc, size_t index, long fallback);
+
+#endif // SARA_R5_URC_H
@@ -0,0 +1,39 @@
+#ifndef SARA_R5_BENCH_H
+#define SARA_R5_BENCH_H
+
+// INCLUDES
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * Reads the monotonic clock of the host.
+ * @return The time in nanoseconds.
+ */
+static inline uint64_t saraR5BenchNowNs(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Reads the cycle counter of the CPU (TSC on x86), or the monotonic clock in nanoseconds elsewhere.
+ */
+static inline uint64_t saraR5BenchCycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return saraR5BenchNowNs();
+#endif
+}
+
+// Keeps the compiler from dropping a result the benchmark does not use
+static volatile uintptr_t saraR5BenchSink;
+
+#endif // SARA_R5_BENCH_H
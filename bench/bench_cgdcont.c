@@ -0,0 +1,152 @@
+/*
+ * bench_cgdcont.c
+ *
+ * Parsing of the AT+CGDCONT? answer, in CPU cycles: the single pass parser of the library, fed line by line as
+ * the tokenizer hands them, against the strstr / sscanf loop of the original saraR5GetAPN, kept below as it was
+ * (the answer is already in memory, so only the parsing is measured).
+ */
+
+// INCLUDES
+#include <string.h>
+#include "Sara_R5_library.h"
+#include "Sara_R5_bench.h"
+
+#define SARA_R5_BENCH_RUNS 100000
+#define SARA_R5_BENCH_ROUNDS 5
+
+// Answer of a module with three contexts: IPv4, dual-stack and IPv6
+static const char saraR5BenchAnswer[] =
+	"\r\n+CGDCONT: 1,\"IP\",\"payandgo.o2.co.uk.mnc010.mcc234.gprs\",\"10.160.182.234\",0,0,0,2,0,0,0,0,0,0\r\n"
+	"+CGDCONT: 2,\"IPV4V6\",\"ims\",\"10.64.12.8 32.1.13.184.0.0.0.0.0.0.0.0.0.0.0.1\",0,0,0,2,0,0,0,0,0,0\r\n"
+	"+CGDCONT: 3,\"IPV6\",\"v6.example\",\"32.1.13.184.0.0.0.0.0.0.0.0.0.0.0.2\",0,0,0,0\r\n"
+	"\r\nOK\r\n";
+
+/**
+ * Parsing loop of the original saraR5GetAPN, on an answer already received.
+ */
+static bool saraR5BenchSscanf(char *response, myApn *apn, Ip_adress *ip, SARA_R5_pdp_type *pdpType)
+{
+	int op = 0;
+	bool success = false;
+
+	// Parse the response to extract APN information
+	int rcid = -1;
+	char *searchPtr = response;
+	// Sample responses:
+	//  +CGDCONT: 1,"IP","payandgo.o2.co.uk.mnc010.mcc234.gprs","10.160.182.234",0,0,0,2,0,0,0,0,0,0
+	for (; op < MAX_OPS; op++)
+	{
+		int scanned = 0;
+		// Find the first/next occurrence of +CGDCONT:
+		searchPtr = strstr(searchPtr, "+CGDCONT:");
+		if (searchPtr != NULL)
+		{
+
+			char strPdpType[SIZE_PDP_TYPE] = "";
+			char strApn[SIZE_APN];
+			int ipOct[SIZE_OCT_IP] = {0};
+
+			searchPtr += strlen("+CGDCONT:");
+			while (*searchPtr == ' ')
+				searchPtr++; // Skip spaces
+
+			scanned = sscanf(searchPtr, "%d,\"%[^\"]\",\"%[^\"]\",\"%d.%d.%d.%d", &rcid, strPdpType, strApn, &ipOct[0], &ipOct[1], &ipOct[2], &ipOct[3]);
+			if (scanned == 7)
+			{
+				success = true;
+				// If scanned == 7 we can save the result
+				strcpy(apn[op].apn, strApn);
+				ip[op].first_ip = ipOct[0];
+				ip[op].second_ip = ipOct[1];
+				ip[op].third_ip = ipOct[2];
+				ip[op].fourth_ip = ipOct[3];
+
+				if (pdpType)
+				{
+					*pdpType = (0 == strcmp(strPdpType, "IPV4V6")) ? PDP_TYPE_IPV4V6 : (0 == strcmp(strPdpType, "IPV6")) ? PDP_TYPE_IPV6
+																				   : (0 == strcmp(strPdpType, "IP"))	 ? PDP_TYPE_IP
+																														 : PDP_TYPE_INVALID;
+				}
+			}
+		}
+		else // We don't have a match so let's clear the APN and IP address
+		{
+			if (apn)
+				apn->apn[0] = '\0';
+			if (pdpType)
+				*pdpType = PDP_TYPE_INVALID;
+			if (ip)
+				memset(ip, 0, sizeof(*ip));
+		}
+	}
+	return success;
+}
+
+/**
+ * The library parser, fed the lines of the answer without their "\r\n".
+ */
+static size_t saraR5BenchParser(const char *answer, SARA_R5_pdp_context *contexts)
+{
+	SARA_R5_pdp_parser parser;
+	const char *line = answer;
+	const char *end;
+
+	saraR5PdpParserInit(&parser, contexts, MAX_OPS, 0);
+	while ((end = strstr(line, "\r\n")) != NULL)
+	{
+		saraR5PdpParserFeed(line, (size_t)(end - line), true, &parser);
+		line = end + 2;
+	}
+	return parser.count;
+}
+
+int main(void)
+{
+	static char response[sizeof(saraR5BenchAnswer)];
+	SARA_R5_pdp_context contexts[MAX_OPS];
+	myApn apn[MAX_OPS];
+	Ip_adress ip[MAX_OPS];
+	SARA_R5_pdp_type pdpType;
+	size_t len = sizeof(saraR5BenchAnswer) - 1;
+	uint64_t start;
+	uint64_t sscanfCycles;
+	uint64_t parserCycles;
+	size_t stored = 0;
+
+	memcpy(response, saraR5BenchAnswer, sizeof(response));
+
+	// Best of a few rounds, the host is shared
+	sscanfCycles = UINT64_MAX;
+	parserCycles = UINT64_MAX;
+	for (unsigned round = 0; round < SARA_R5_BENCH_ROUNDS; round++)
+	{
+		uint64_t cycles;
+
+		start = saraR5BenchCycles();
+		for (unsigned run = 0; run < SARA_R5_BENCH_RUNS; run++)
+		{
+			saraR5BenchSink += saraR5BenchSscanf(response, apn, ip, &pdpType);
+		}
+		cycles = saraR5BenchCycles() - start;
+		sscanfCycles = (cycles < sscanfCycles) ? cycles : sscanfCycles;
+
+		start = saraR5BenchCycles();
+		for (unsigned run = 0; run < SARA_R5_BENCH_RUNS; run++)
+		{
+			stored = saraR5BenchParser(saraR5BenchAnswer, contexts);
+			saraR5BenchSink += stored;
+		}
+		cycles = saraR5BenchCycles() - start;
+		parserCycles = (cycles < parserCycles) ? cycles : parserCycles;
+	}
+
+	// The original loop only reads IPv4 addresses: the IPv6 context is missed, the dual-stack one keeps its IPv4
+	printf("AT+CGDCONT? answer of %u bytes, 3 contexts (IPv4, dual-stack, IPv6)\n", (unsigned)len);
+	printf("parser          | cycles/answer | cycles/byte | IPv6 addresses\n");
+	printf("sscanf          | %13llu | %6llu.%02llu | %14s\n", (unsigned long long)(sscanfCycles / SARA_R5_BENCH_RUNS),
+		   (unsigned long long)(sscanfCycles / SARA_R5_BENCH_RUNS / len), (unsigned long long)(sscanfCycles * 100u / SARA_R5_BENCH_RUNS / len % 100u), "no");
+	printf("single pass     | %13llu | %6llu.%02llu | %14s\n", (unsigned long long)(parserCycles / SARA_R5_BENCH_RUNS),
+		   (unsigned long long)(parserCycles / SARA_R5_BENCH_RUNS / len), (unsigned long long)(parserCycles * 100u / SARA_R5_BENCH_RUNS / len % 100u),
+		   (stored == 3 && contexts[2].hasIpv6) ? "yes" : "no");
+	return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * bench_emulator.c
+ *
+ * Throughput and latency of the flows of the examples 01 to 05 against the module emulator (default configuration).
+ * Each flow runs again and again on the same emulator: the host time says how fast the library gets through it,
+ * the virtual time how long it keeps the modem line (answers, URCs and the 115200 bps line included).
+ */
+
+// INCLUDES
+#include <string.h>
+#include "Sara_R5_library.h"
+#include "Sara_R5_emulator.h"
+#include "Sara_R5_example_flows.h"
+#include "Sara_R5_bench.h"
+
+#define SARA_R5_BENCH_RUNS 200
+
+int main(void)
+{
+	static SARA_R5_emulator emulator;
+	SARA_R5_transport transport;
+
+	saraR5EmulatorInit(&emulator, &transport, NULL);
+	saraR5SetTransport(&transport);
+
+	printf("flow | runs | failed | host us/run | runs/s | commands/s | line ms min/avg/max | bytes/run\n");
+	for (size_t f = 0; f < SARA_R5_EXAMPLE_FLOWS; f++)
+	{
+		SARA_R5_emulator_stats before = emulator.stats;
+		uint32_t minMs = UINT32_MAX;
+		uint32_t maxMs = 0;
+		uint64_t totalMs = 0;
+		uint64_t hostNs = 0;
+		unsigned failed = 0;
+		unsigned long commands;
+		unsigned long bytes;
+
+		for (unsigned run = 0; run < SARA_R5_BENCH_RUNS; run++)
+		{
+			uint32_t startMs = saraR5NowMs();
+			uint64_t startNs = saraR5BenchNowNs();
+			uint32_t elapsedMs;
+
+			failed += (saraR5ExampleFlows[f](&transport) != 0);
+			hostNs += saraR5BenchNowNs() - startNs;
+			elapsedMs = saraR5NowMs() - startMs;
+			minMs = (elapsedMs < minMs) ? elapsedMs : minMs;
+			maxMs = (elapsedMs > maxMs) ? elapsedMs : maxMs;
+			totalMs += elapsedMs;
+		}
+
+		commands = emulator.stats.commands - before.commands;
+		bytes = (emulator.stats.bytesToModule - before.bytesToModule) + (emulator.stats.bytesFromModule - before.bytesFromModule);
+		printf("  %02u | %4u | %6u | %11llu | %6llu | %10llu | %5lu / %5llu / %5lu | %9lu\n", (unsigned)(f + 1), SARA_R5_BENCH_RUNS, failed,
+			   (unsigned long long)(hostNs / SARA_R5_BENCH_RUNS / 1000u),
+			   (unsigned long long)(SARA_R5_BENCH_RUNS * 1000000000ull / (hostNs + 1)),
+			   (unsigned long long)(commands * 1000000000ull / (hostNs + 1)),
+			   (unsigned long)minMs, (unsigned long long)(totalMs / SARA_R5_BENCH_RUNS), (unsigned long)maxMs,
+			   bytes / SARA_R5_BENCH_RUNS);
+	}
+	return 0;
+}
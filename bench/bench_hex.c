@@ -0,0 +1,92 @@
+/*
+ * bench_hex.c
+ *
+ * Hex encoding of socket and MQTT payloads, in nanoseconds per byte for 16 B to 1024 B: saraR5SegmentHex, which
+ * copies digit pairs from a table four bytes at a time, against the per-nibble loop it replaced, kept below.
+ */
+
+// INCLUDES
+#include <string.h>
+#include "Sara_R5_library.h"
+#include "Sara_R5_bench.h"
+
+#define SARA_R5_BENCH_MAX_LEN 1024
+#define SARA_R5_BENCH_BYTES (64u * 1024u * 1024u) // Bytes encoded per size and encoder
+#define SARA_R5_BENCH_ROUNDS 3
+
+/**
+ * The per-nibble loop saraR5SegmentHex used before its table.
+ */
+static SARA_R5_segment saraR5BenchHexNibbles(char *storage, size_t size, const uint8_t *data, size_t len)
+{
+	static const char hex[] = "0123456789ABCDEF";
+
+	if (len > size / 2)
+	{
+		return (SARA_R5_segment){NULL, 0};
+	}
+	for (size_t i = 0; i < len; i++)
+	{
+		storage[2 * i] = hex[data[i] >> 4];
+		storage[2 * i + 1] = hex[data[i] & 0x0F];
+	}
+	return (SARA_R5_segment){storage, 2 * len};
+}
+
+/**
+ * Encodes 'len' bytes again and again, best of a few rounds.
+ * @return The time per byte, in hundredths of a nanosecond.
+ */
+static uint64_t saraR5BenchEncode(SARA_R5_segment (*encode)(char *, size_t, const uint8_t *, size_t), char *digits,
+								  const uint8_t *data, size_t len)
+{
+	uint64_t best = UINT64_MAX;
+	unsigned runs = SARA_R5_BENCH_BYTES / len;
+
+	for (unsigned round = 0; round < SARA_R5_BENCH_ROUNDS; round++)
+	{
+		uint64_t start = saraR5BenchNowNs();
+		uint64_t elapsed;
+
+		for (unsigned run = 0; run < runs; run++)
+		{
+			SARA_R5_segment segment = encode(digits, 2 * SARA_R5_BENCH_MAX_LEN, data, len);
+
+			saraR5BenchSink += (uint8_t)((const char *)segment.data)[run % segment.len];
+		}
+		elapsed = saraR5BenchNowNs() - start;
+		best = (elapsed < best) ? elapsed : best;
+	}
+	return best * 100u / ((uint64_t)runs * len);
+}
+
+int main(void)
+{
+	static uint8_t data[SARA_R5_BENCH_MAX_LEN];
+	static char tableDigits[2 * SARA_R5_BENCH_MAX_LEN];
+	static char nibbleDigits[2 * SARA_R5_BENCH_MAX_LEN];
+	uint32_t random = 0x2545F491;
+
+	for (size_t i = 0; i < sizeof(data); i++)
+	{
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+		data[i] = (uint8_t)random;
+	}
+
+	printf("bytes | nibbles ns/B | table ns/B | speedup | same digits\n");
+	for (size_t len = 16; len <= SARA_R5_BENCH_MAX_LEN; len *= 2)
+	{
+		uint64_t nibbles = saraR5BenchEncode(saraR5BenchHexNibbles, nibbleDigits, data, len);
+		uint64_t table = saraR5BenchEncode(saraR5SegmentHex, tableDigits, data, len);
+		uint64_t speedup = nibbles * 100u / (table + 1);
+
+		printf("%5u | %9llu.%02llu | %7llu.%02llu | %4llu.%02llu | %11s\n", (unsigned)len,
+			   (unsigned long long)(nibbles / 100u), (unsigned long long)(nibbles % 100u),
+			   (unsigned long long)(table / 100u), (unsigned long long)(table % 100u),
+			   (unsigned long long)(speedup / 100u), (unsigned long long)(speedup % 100u),
+			   memcmp(tableDigits, nibbleDigits, 2 * len) == 0 ? "yes" : "no");
+	}
+	return 0;
+}
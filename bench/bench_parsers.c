@@ -0,0 +1,180 @@
+/*
+ * bench_parsers.c
+ *
+ * Throughput of the response parsers on answers of the module emulator, the same ones the fuzz targets start from
+ * (fuzz/corpus): parses per second and bytes per CPU cycle, best of a few rounds, to spot a parser getting slower.
+ */
+
+// INCLUDES
+#include <string.h>
+#include "Sara_R5_library.h"
+#include "Sara_R5_bench.h"
+
+#define SARA_R5_BENCH_RUNS 200000
+#define SARA_R5_BENCH_ROUNDS 5
+
+static const char saraR5BenchCops[] =
+	"+COPS: (2,\"Emu Telecom\",\"EMU\",\"99901\",7),(1,\"Other Net\",\"OTH\",\"99902\",7),(3,\"Blocked Net\",\"BLK\",\"99903\",9),"
+	"(1,\"Roaming Partner One\",\"RP1\",\"99904\",7),(1,\"Roaming Partner Two\",\"RP2\",\"99905\",9),"
+	"(1,\"Emu Telecom NB-IoT\",\"EMU NB\",\"99906\",9),(3,\"Border Network\",\"BRD\",\"99907\",7),,(0,1,2,3,4),(0,1,2)";
+static const char saraR5BenchCgdcont[] =
+	"+CGDCONT: 1,\"IP\",\"payandgo.o2.co.uk.mnc010.mcc234.gprs\",\"10.160.182.234\",0,0,0,2,0,0,0,0,0,0";
+static const char saraR5BenchUsoctl[] = "+USOCTL: 0,11,1460";
+static const char saraR5BenchAnswer[] = "\r\n+USOCTL: 0,11,1460\r\n\r\nOK\r\n";
+static const char saraR5BenchUrc[] = "+UUSORF: 3,1024";
+
+// Layout of the AT+USOCTL answer, as the library declares it
+static const SARA_R5_field saraR5BenchUsoctlFields[] = {
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_socket_control, socket),
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_socket_control, param),
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_socket_control, value),
+};
+static const SARA_R5_response_schema saraR5BenchUsoctlSchema = SARA_R5_SCHEMA("+USOCTL:", SARA_R5_socket_control, saraR5BenchUsoctlFields);
+
+static SARA_R5_urc_table saraR5BenchUrcs;
+static uint8_t saraR5BenchFrame[SARA_R5_CMUX_FRAME_SIZE + 6]; // UIH frame on DLCI 1 with a full information field
+static size_t saraR5BenchFrameLength;
+
+static bool saraR5BenchOperator(const SARA_R5_operator_stats *op, void *context)
+{
+	(void)context;
+	saraR5BenchSink += op->numOp;
+	return true;
+}
+
+static void saraR5BenchUrcHandler(const SARA_R5_urc *urc, void *context)
+{
+	(void)context;
+	saraR5BenchSink += (uintptr_t)saraR5UrcFieldInt(urc, 1, 0);
+}
+
+static void saraR5BenchLine(const char *line, size_t len, void *context)
+{
+	(void)line;
+	(void)context;
+	saraR5BenchSink += len;
+}
+
+static void saraR5BenchOperators(void)
+{
+	SARA_R5_operator_parser parser;
+
+	saraR5OperatorParserInit(&parser, saraR5BenchOperator, NULL);
+	saraR5OperatorParserFeed(saraR5BenchCops, sizeof(saraR5BenchCops) - 1, true, &parser);
+}
+
+static void saraR5BenchPdp(void)
+{
+	SARA_R5_pdp_context contexts[1];
+	SARA_R5_pdp_parser parser;
+
+	saraR5PdpParserInit(&parser, contexts, 1, 0);
+	saraR5PdpParserFeed(saraR5BenchCgdcont, sizeof(saraR5BenchCgdcont) - 1, true, &parser);
+	saraR5BenchSink += contexts[0].ipv4[3];
+}
+
+static void saraR5BenchSchema(void)
+{
+	SARA_R5_socket_control control;
+	SARA_R5_schema_parser parser;
+
+	saraR5SchemaParserInit(&parser, &saraR5BenchUsoctlSchema, &control, 1);
+	saraR5SchemaParserFeed(saraR5BenchUsoctl, sizeof(saraR5BenchUsoctl) - 1, true, &parser);
+	saraR5BenchSink += control.value;
+}
+
+static void saraR5BenchTokenizer(void)
+{
+	SARA_R5_at_tokenizer tokenizer;
+
+	saraR5AtTokenizerInit(&tokenizer, saraR5BenchLine, NULL);
+	saraR5AtTokenizerFeed(&tokenizer, (const uint8_t *)saraR5BenchAnswer, sizeof(saraR5BenchAnswer) - 1);
+	saraR5BenchSink += tokenizer.result;
+}
+
+static void saraR5BenchUrcDispatch(void)
+{
+	saraR5UrcDispatch(&saraR5BenchUrcs, saraR5BenchUrc, sizeof(saraR5BenchUrc) - 1);
+}
+
+static void saraR5BenchCmux(void)
+{
+	SARA_R5_cmux_parser parser;
+
+	saraR5CmuxParserReset(&parser);
+	for (size_t i = 0; i < saraR5BenchFrameLength; i++)
+	{
+		saraR5BenchSink += saraR5CmuxParse(&parser, saraR5BenchFrame[i]);
+	}
+}
+
+// Parser and the answer it takes
+typedef struct
+{
+  const char *name;
+  void (*parse)(void);
+  size_t bytes;
+} SARA_R5_bench_parser;
+
+int main(void)
+{
+	SARA_R5_bench_parser parsers[] = {
+		{"operators (+COPS=?)", saraR5BenchOperators, sizeof(saraR5BenchCops) - 1},
+		{"contexts (+CGDCONT)", saraR5BenchPdp, sizeof(saraR5BenchCgdcont) - 1},
+		{"schema (+USOCTL)", saraR5BenchSchema, sizeof(saraR5BenchUsoctl) - 1},
+		{"AT tokenizer", saraR5BenchTokenizer, sizeof(saraR5BenchAnswer) - 1},
+		{"URC dispatch", saraR5BenchUrcDispatch, sizeof(saraR5BenchUrc) - 1},
+		{"CMUX frame", saraR5BenchCmux, 0},
+	};
+	uint8_t info[SARA_R5_CMUX_FRAME_SIZE];
+	size_t headerLength;
+
+	saraR5UrcTableInit(&saraR5BenchUrcs);
+	saraR5UrcRegister(&saraR5BenchUrcs, "+UUSORD", saraR5BenchUrcHandler, NULL);
+	saraR5UrcRegister(&saraR5BenchUrcs, "+UUSORF", saraR5BenchUrcHandler, NULL);
+	saraR5UrcRegister(&saraR5BenchUrcs, "+UUSOCL", saraR5BenchUrcHandler, NULL);
+
+	// Flag, header, information field, FCS of the header, flag
+	memset(info, 'x', sizeof(info));
+	saraR5BenchFrame[0] = SARA_R5_CMUX_FLAG;
+	headerLength = saraR5CmuxHeader(&saraR5BenchFrame[1], 1, SARA_R5_CMUX_UIH, true, sizeof(info));
+	memcpy(&saraR5BenchFrame[1 + headerLength], info, sizeof(info));
+	saraR5BenchFrameLength = 1 + headerLength + sizeof(info);
+	saraR5BenchFrame[saraR5BenchFrameLength++] = saraR5CmuxFcs(&saraR5BenchFrame[1], headerLength);
+	saraR5BenchFrame[saraR5BenchFrameLength++] = SARA_R5_CMUX_FLAG;
+	parsers[5].bytes = saraR5BenchFrameLength;
+	saraR5BenchSink = 0;
+	saraR5BenchCmux();
+	if (saraR5BenchSink != 1)
+	{
+		printf("CMUX frame not decoded\n");
+		return 1;
+	}
+
+	printf("parser              | bytes | parses/s  | bytes/cycle\n");
+	for (size_t p = 0; p < sizeof(parsers) / sizeof(parsers[0]); p++)
+	{
+		uint64_t bestCycles = UINT64_MAX;
+		uint64_t bestNs = UINT64_MAX;
+
+		for (unsigned round = 0; round < SARA_R5_BENCH_ROUNDS; round++)
+		{
+			uint64_t ns = saraR5BenchNowNs();
+			uint64_t cycles = saraR5BenchCycles();
+
+			for (unsigned run = 0; run < SARA_R5_BENCH_RUNS; run++)
+			{
+				parsers[p].parse();
+			}
+			cycles = saraR5BenchCycles() - cycles;
+			ns = saraR5BenchNowNs() - ns;
+			bestCycles = (cycles < bestCycles) ? cycles : bestCycles;
+			bestNs = (ns < bestNs) ? ns : bestNs;
+		}
+		printf("%-19s | %5u | %9llu | %7llu.%02llu\n", parsers[p].name, (unsigned)parsers[p].bytes,
+			   (unsigned long long)((uint64_t)SARA_R5_BENCH_RUNS * 1000000000u / (bestNs + 1)),
+			   (unsigned long long)((uint64_t)parsers[p].bytes * SARA_R5_BENCH_RUNS / (bestCycles + 1)),
+			   (unsigned long long)((uint64_t)parsers[p].bytes * SARA_R5_BENCH_RUNS * 100u / (bestCycles + 1) % 100u));
+	}
+	return 0;
+}
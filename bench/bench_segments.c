@@ -0,0 +1,193 @@
+/*
+ * bench_segments.c
+ *
+ * Cost of building and sending a command, in CPU cycles: the segments the library sends now (the strings sent
+ * from where they are, escaped copies only when needed) against the heap buffer and sprintf of the original
+ * library, kept below as it was. The transport only counts the bytes, so only the formatting is measured.
+ */
+
+// INCLUDES
+#include <stdlib.h>
+#include <string.h>
+#include "Sara_R5_library.h"
+#include "Sara_R5_bench.h"
+
+#define SARA_R5_BENCH_RUNS 200000
+
+// What reaches the transport
+static unsigned long saraR5BenchSends;
+static unsigned long saraR5BenchBytes;
+
+static bool saraR5BenchSend(void *context, const uint8_t *data, size_t len)
+{
+	(void)context;
+	saraR5BenchSends++;
+	saraR5BenchBytes += len;
+	saraR5BenchSink += data[len - 1];
+	return true;
+}
+
+static size_t saraR5BenchReceive(void *context, uint8_t *data, size_t len)
+{
+	(void)context;
+	(void)data;
+	(void)len;
+	return 0;
+}
+
+static void saraR5BenchWait(void *context, uint32_t ms)
+{
+	(void)context;
+	(void)ms;
+}
+
+static uint32_t saraR5BenchMs(void *context)
+{
+	(void)context;
+	return 0;
+}
+
+static const char saraR5BenchTopic[] = "sensors/room1";
+static const char saraR5BenchJson[] = "{\"device\":\"sara-r5\",\"temp\":21,\"hum\":480,\"status\":\"running\"}";
+static const char saraR5BenchApn[] = "internet.operator.example.mnc001.mcc999.gprs";
+static const char saraR5BenchClientId[] = "sara-r5-0123456789";
+
+/**
+ * AT+UMQTTC=2 as the original library built it (with room for the quotes, which its size left out).
+ */
+static void saraR5BenchPublishSprintf(void)
+{
+	char *command;
+	int commandLength;
+
+	commandLength = strlen("AT+UMQTTC=2,") + 0 + 0 + 0 + strlen(saraR5BenchTopic) + strlen(saraR5BenchJson) + 3 + 16;
+	command = calloc(commandLength, sizeof(char));
+	sprintf(command, "%s=%d,%d,%d,%d,\"%s\",\"%s\"\r", SARA_R5_MQTT_COMMAND, SARA_R5_MQTT_COMMAND_PUBLISH, 0, 0, 0, saraR5BenchTopic, saraR5BenchJson);
+	saraR5SendCommand((const uint8_t *)command);
+	free(command);
+}
+
+/**
+ * AT+UMQTTC=2 as segments, with the escaped copy of the message the library makes.
+ */
+static void saraR5BenchPublishSegments(void)
+{
+	char opDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char qosDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char retainDigits[SARA_R5_SEGMENT_INT_SIZE];
+	char hexDigits[SARA_R5_SEGMENT_INT_SIZE];
+	size_t messageQuotedSize = 3 * (sizeof(saraR5BenchJson) - 1);
+	char *messageQuoted = saraR5CallocChar(messageQuotedSize);
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_MQTT_COMMAND "="),
+		saraR5SegmentInt(opDigits, SARA_R5_MQTT_COMMAND_PUBLISH),
+		SARA_R5_SEGMENT_LITERAL(","),
+		saraR5SegmentInt(qosDigits, 0),
+		SARA_R5_SEGMENT_LITERAL(","),
+		saraR5SegmentInt(retainDigits, 0),
+		SARA_R5_SEGMENT_LITERAL(","),
+		saraR5SegmentInt(hexDigits, 0),
+		SARA_R5_SEGMENT_LITERAL(",\""),
+		saraR5SegmentQuoted(NULL, 0, saraR5BenchTopic, sizeof(saraR5BenchTopic) - 1),
+		SARA_R5_SEGMENT_LITERAL("\",\""),
+		saraR5SegmentQuoted(messageQuoted, messageQuotedSize, saraR5BenchJson, sizeof(saraR5BenchJson) - 1),
+		SARA_R5_SEGMENT_LITERAL("\"\r"),
+	};
+
+	saraR5SendSegments(command, SARA_R5_SEGMENT_COUNT(command));
+	saraR5FreeChar(messageQuoted, messageQuotedSize);
+}
+
+/**
+ * AT+CGDCONT as the original library built it.
+ */
+static void saraR5BenchApnSprintf(void)
+{
+	char *command = calloc(strlen(saraR5BenchApn) + 32, sizeof(char));
+
+	sprintf(command, "%s=%d,\"%s\",\"%s\"\r", SARA_R5_MESSAGE_PDP_DEF, 1, "IP", saraR5BenchApn);
+	saraR5SendCommand((const uint8_t *)command);
+	free(command);
+}
+
+/**
+ * AT+CGDCONT as segments.
+ */
+static void saraR5BenchApnSegments(void)
+{
+	char cidDigits[SARA_R5_SEGMENT_INT_SIZE];
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_MESSAGE_PDP_DEF "="),
+		saraR5SegmentUint(cidDigits, 1),
+		SARA_R5_SEGMENT_LITERAL(",\"IP\",\""),
+		saraR5SegmentQuoted(NULL, 0, saraR5BenchApn, sizeof(saraR5BenchApn) - 1),
+		SARA_R5_SEGMENT_LITERAL("\"\r"),
+	};
+
+	saraR5SendSegments(command, SARA_R5_SEGMENT_COUNT(command));
+}
+
+/**
+ * AT+UMQTT=0 as the original library built it.
+ */
+static void saraR5BenchClientIdSprintf(void)
+{
+	char *command = calloc(strlen(saraR5BenchClientId) + 32, sizeof(char));
+
+	sprintf(command, "%s=%d,\"%s\"\r", SARA_R5_MQTT_PROFILE, SARA_R5_MQTT_PROFILE_CLIENT_ID, saraR5BenchClientId);
+	saraR5SendCommand((const uint8_t *)command);
+	free(command);
+}
+
+/**
+ * AT+UMQTT=0 as segments.
+ */
+static void saraR5BenchClientIdSegments(void)
+{
+	char opDigits[SARA_R5_SEGMENT_INT_SIZE];
+	SARA_R5_segment command[] = {
+		SARA_R5_SEGMENT_LITERAL(SARA_R5_MQTT_PROFILE "="),
+		saraR5SegmentInt(opDigits, SARA_R5_MQTT_PROFILE_CLIENT_ID),
+		SARA_R5_SEGMENT_LITERAL(",\""),
+		saraR5SegmentQuoted(NULL, 0, saraR5BenchClientId, sizeof(saraR5BenchClientId) - 1),
+		SARA_R5_SEGMENT_LITERAL("\"\r"),
+	};
+
+	saraR5SendSegments(command, SARA_R5_SEGMENT_COUNT(command));
+}
+
+/**
+ * Builds and sends a command again and again, and prints its cost.
+ */
+static void saraR5BenchRun(const char *name, void (*build)(void))
+{
+	uint64_t start;
+	uint64_t cycles;
+
+	saraR5BenchSends = 0;
+	saraR5BenchBytes = 0;
+	start = saraR5BenchCycles();
+	for (unsigned run = 0; run < SARA_R5_BENCH_RUNS; run++)
+	{
+		build();
+	}
+	cycles = saraR5BenchCycles() - start;
+	printf("%-24s | %12llu | %11lu | %11lu\n", name, (unsigned long long)(cycles / SARA_R5_BENCH_RUNS),
+		   saraR5BenchSends / SARA_R5_BENCH_RUNS, saraR5BenchBytes / SARA_R5_BENCH_RUNS);
+}
+
+int main(void)
+{
+	SARA_R5_transport transport = {saraR5BenchSend, saraR5BenchReceive, saraR5BenchWait, saraR5BenchMs, NULL, NULL};
+
+	saraR5SetTransport(&transport);
+
+	printf("command                  | cycles/cmd   | sends/cmd   | bytes/cmd\n");
+	saraR5BenchRun("publish, sprintf", saraR5BenchPublishSprintf);
+	saraR5BenchRun("publish, segments", saraR5BenchPublishSegments);
+	saraR5BenchRun("APN, sprintf", saraR5BenchApnSprintf);
+	saraR5BenchRun("APN, segments", saraR5BenchApnSegments);
+	saraR5BenchRun("client ID, sprintf", saraR5BenchClientIdSprintf);
+	saraR5BenchRun("client ID, segments", saraR5BenchClientIdSegments);
+	return 0;
+}
@@ -0,0 +1,62 @@
+#ifndef SARA_R5_FUZZ_H
+#define SARA_R5_FUZZ_H
+
+// INCLUDES
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Sara_R5_library.h"
+
+// Entry point of every fuzz target, called by libFuzzer or by the standalone driver (Sara_R5_fuzz_main.c)
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+// Stops the run on a broken invariant, so libFuzzer keeps the input as a crash
+#define SARA_R5_FUZZ_ASSERT(condition) \
+	do                                 \
+	{                                  \
+		if (!(condition))              \
+		{                              \
+			abort();                   \
+		}                              \
+	} while (0)
+
+/**
+ * Hands an input to a response handler the way the tokenizer does: line by line without the line terminators,
+ * each line in pieces. The first byte gives the size of the pieces (0: whole lines), the rest is the answer.
+ * @param data The input of the fuzzer.
+ * @param size Its length.
+ * @param feed The response handler.
+ * @param context Passed to 'feed'.
+ */
+static inline void saraR5FuzzFeedLines(const uint8_t *data, size_t size, SARA_R5_response_handler feed, void *context)
+{
+	const char *text = (const char *)data + 1;
+	size_t piece;
+	size_t start = 0;
+
+	if (size == 0)
+	{
+		return;
+	}
+	piece = data[0] % 17;
+	size--;
+	for (size_t end = 0; end <= size; end++)
+	{
+		size_t at = start;
+
+		if (end < size && text[end] != '\r' && text[end] != '\n')
+		{
+			continue;
+		}
+		do
+		{
+			size_t n = (piece == 0 || end - at < piece) ? end - at : piece;
+
+			feed(&text[at], n, at + n == end, context);
+			at += n;
+		} while (at < end);
+		start = end + 1;
+	}
+}
+
+#endif // SARA_R5_FUZZ_H
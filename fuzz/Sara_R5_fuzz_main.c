@@ -0,0 +1,174 @@
+/*
+ * Sara_R5_fuzz_main.c
+ *
+ * Driver of the fuzz targets for compilers without libFuzzer (e.g. gcc): runs LLVMFuzzerTestOneInput on every
+ * corpus file given, then on random mutations of them (bytes flipped, inserted, dropped, lines cut), under the
+ * sanitizers the target is built with. The generator is seeded, so a failing run is repeated by running it again.
+ * Usage: fuzz_<target> [-runs=N] <file or directory>...
+ */
+
+// INCLUDES
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Sara_R5_fuzz.h"
+
+#define SARA_R5_FUZZ_MAX_INPUTS 256
+#define SARA_R5_FUZZ_MAX_SIZE 4096
+#define SARA_R5_FUZZ_RUNS 10000 // Mutations run after the corpus, by default
+
+// Corpus loaded in memory
+static uint8_t *saraR5FuzzInputs[SARA_R5_FUZZ_MAX_INPUTS];
+static size_t saraR5FuzzSizes[SARA_R5_FUZZ_MAX_INPUTS];
+static size_t saraR5FuzzCount;
+static uint32_t saraR5FuzzRandom = 0x2545F491;
+
+/**
+ * Draws the next number of the xorshift32 generator.
+ */
+static uint32_t saraR5FuzzNext(void)
+{
+	saraR5FuzzRandom ^= saraR5FuzzRandom << 13;
+	saraR5FuzzRandom ^= saraR5FuzzRandom >> 17;
+	saraR5FuzzRandom ^= saraR5FuzzRandom << 5;
+	return saraR5FuzzRandom;
+}
+
+/**
+ * Loads a corpus file and runs the target on it.
+ */
+static void saraR5FuzzLoad(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	uint8_t *data;
+	size_t size;
+
+	if (file == NULL || saraR5FuzzCount == SARA_R5_FUZZ_MAX_INPUTS)
+	{
+		if (file != NULL)
+		{
+			fclose(file);
+		}
+		return;
+	}
+	data = malloc(SARA_R5_FUZZ_MAX_SIZE);
+	size = (data != NULL) ? fread(data, 1, SARA_R5_FUZZ_MAX_SIZE, file) : 0;
+	fclose(file);
+	if (data == NULL)
+	{
+		return;
+	}
+	data = realloc(data, (size > 0) ? size : 1); // Exact size, as for the mutations
+	LLVMFuzzerTestOneInput(data, size);
+	saraR5FuzzInputs[saraR5FuzzCount] = data;
+	saraR5FuzzSizes[saraR5FuzzCount++] = size;
+}
+
+/**
+ * Loads a file, or every file of a directory.
+ */
+static void saraR5FuzzLoadPath(const char *path)
+{
+	DIR *dir = opendir(path);
+	struct dirent *entry;
+	char file[1024];
+
+	if (dir == NULL)
+	{
+		saraR5FuzzLoad(path);
+		return;
+	}
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (entry->d_name[0] != '.')
+		{
+			snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+			saraR5FuzzLoad(file);
+		}
+	}
+	closedir(dir);
+}
+
+/**
+ * Builds a mutation of a corpus input in 'data'.
+ * @return Its size.
+ */
+static size_t saraR5FuzzMutate(uint8_t *data)
+{
+	static const uint8_t special[] = {'\r', '\n', ',', '"', ':', '(', ')', '.', '-', '0', '9', 'F', ' ', 0x00, 0xF9, 0xFF};
+	size_t input = saraR5FuzzNext() % saraR5FuzzCount;
+	size_t size = saraR5FuzzSizes[input];
+	unsigned edits = 1 + saraR5FuzzNext() % 8;
+
+	memcpy(data, saraR5FuzzInputs[input], size);
+	for (unsigned e = 0; e < edits; e++)
+	{
+		size_t at = (size > 0) ? saraR5FuzzNext() % size : 0;
+		uint32_t kind = saraR5FuzzNext() % 5;
+
+		if (kind == 0 && size > 0)
+		{
+			data[at] ^= (uint8_t)(1u << (saraR5FuzzNext() % 8)); // Flip a bit
+		}
+		else if (kind == 1 && size > 0)
+		{
+			data[at] = special[saraR5FuzzNext() % sizeof(special)]; // Put a separator or a limit digit
+		}
+		else if (kind == 2 && size < SARA_R5_FUZZ_MAX_SIZE)
+		{
+			memmove(&data[at + 1], &data[at], size - at); // Insert a byte
+			data[at] = special[saraR5FuzzNext() % sizeof(special)];
+			size++;
+		}
+		else if (kind == 3 && size > 0)
+		{
+			memmove(&data[at], &data[at + 1], size - at - 1); // Drop a byte
+			size--;
+		}
+		else if (size > 0)
+		{
+			size = at; // Cut the input
+		}
+	}
+	return size;
+}
+
+int main(int argc, char **argv)
+{
+	static uint8_t data[SARA_R5_FUZZ_MAX_SIZE];
+	unsigned long runs = SARA_R5_FUZZ_RUNS;
+	uint8_t *input;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strncmp(argv[i], "-runs=", 6) == 0)
+		{
+			runs = strtoul(&argv[i][6], NULL, 10);
+		}
+		else if (argv[i][0] != '-')
+		{
+			saraR5FuzzLoadPath(argv[i]);
+		}
+	}
+	for (unsigned long run = 0; run < runs && saraR5FuzzCount > 0; run++)
+	{
+		size_t size = saraR5FuzzMutate(data);
+
+		// A copy of the exact size, so the address sanitizer sees a read past the input
+		input = malloc((size > 0) ? size : 1);
+		if (input == NULL)
+		{
+			break;
+		}
+		memcpy(input, data, size);
+		LLVMFuzzerTestOneInput(input, size);
+		free(input);
+	}
+	printf("%s: %u inputs, %lu mutations\n", argv[0], (unsigned)saraR5FuzzCount, (saraR5FuzzCount > 0) ? runs : 0ul);
+	for (size_t i = 0; i < saraR5FuzzCount; i++)
+	{
+		free(saraR5FuzzInputs[i]);
+	}
+	return 0;
+}
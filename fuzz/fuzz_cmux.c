@@ -0,0 +1,26 @@
+/*
+ * fuzz_cmux.c
+ *
+ * The CMUX frame decoder (saraR5CmuxParse) on an arbitrary byte stream: a frame is only reported with its
+ * information field complete and within SARA_R5_CMUX_FRAME_SIZE.
+ */
+
+// INCLUDES
+#include "Sara_R5_fuzz.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	static SARA_R5_cmux_parser parser;
+
+	memset(&parser, 0, sizeof(parser));
+	saraR5CmuxParserReset(&parser);
+	for (size_t i = 0; i < size; i++)
+	{
+		if (saraR5CmuxParse(&parser, data[i]))
+		{
+			SARA_R5_FUZZ_ASSERT(parser.length <= SARA_R5_CMUX_FRAME_SIZE && parser.received == parser.length);
+			SARA_R5_FUZZ_ASSERT(parser.headerLength >= 3 && parser.headerLength <= sizeof(parser.header));
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,249 @@
+/*
+ * fuzz_corpus.c
+ *
+ * Writes the seed corpora of the fuzz targets from the answers of the module emulator: a session of network,
+ * context, DNS, socket and CMUX commands runs against it, the bytes received after every command are kept, and
+ * each answer goes to the targets that parse it. Usage: fuzz_corpus <corpus directory>
+ */
+
+// INCLUDES
+#include <sys/stat.h>
+#include "Sara_R5_fuzz.h"
+#include "Sara_R5_emulator.h"
+
+#define SARA_R5_FUZZ_CAPTURE_SIZE 4096
+
+static SARA_R5_emulator emulator;
+static SARA_R5_transport transport;
+static bool (*saraR5FuzzEmulatorSend)(void *context, const uint8_t *data, size_t len);
+static size_t (*saraR5FuzzEmulatorReceive)(void *context, uint8_t *data, size_t len);
+static const char *saraR5FuzzDirectory;
+static uint8_t saraR5FuzzCapture[SARA_R5_FUZZ_CAPTURE_SIZE]; // Bytes received since the last command
+static size_t saraR5FuzzCaptureLength;
+static char saraR5FuzzCommand[16]; // Name of that command, e.g. "+CGDCONT"
+static unsigned saraR5FuzzFiles;
+static bool saraR5FuzzHex; // Sockets in hex mode
+static bool saraR5FuzzMux; // CMUX frames on the line
+
+/**
+ * Writes one seed: an optional first byte (the options of the target), then the bytes.
+ */
+static void saraR5FuzzWrite(const char *target, int first, const uint8_t *data, size_t len)
+{
+	char path[256];
+	FILE *file;
+
+	snprintf(path, sizeof(path), "%s/%s", saraR5FuzzDirectory, target);
+	mkdir(path, 0755);
+	snprintf(path, sizeof(path), "%s/%s/%03u-%s", saraR5FuzzDirectory, target, saraR5FuzzFiles++,
+			 (saraR5FuzzCommand[0] == '+') ? &saraR5FuzzCommand[1] : "AT");
+	file = fopen(path, "wb");
+	if (file == NULL)
+	{
+		return;
+	}
+	if (first >= 0)
+	{
+		fputc(first, file);
+	}
+	fwrite(data, 1, len, file);
+	fclose(file);
+}
+
+/**
+ * Hands the answer received since the last command to the targets that parse it.
+ */
+static void saraR5FuzzFlush(void)
+{
+	static const char *const schemaCommands[] = {"+USOCR", "+USOST", "+USOWR", "+USOCTL", "+UDNSRN"};
+	const uint8_t *data = saraR5FuzzCapture;
+	size_t len = saraR5FuzzCaptureLength;
+	char urcs[SARA_R5_FUZZ_CAPTURE_SIZE];
+	size_t urcLength = 0;
+
+	if (len == 0)
+	{
+		return;
+	}
+	if (saraR5FuzzMux)
+	{
+		saraR5FuzzWrite("fuzz_cmux", -1, data, len);
+		saraR5FuzzCaptureLength = 0;
+		return;
+	}
+	saraR5FuzzWrite("fuzz_tokenizer", 0x40 | 0x0F, data, len);
+	if (strcmp(saraR5FuzzCommand, "+COPS") == 0)
+	{
+		saraR5FuzzWrite("fuzz_operators", 0, data, len);
+	}
+	if (strcmp(saraR5FuzzCommand, "+CGDCONT") == 0)
+	{
+		saraR5FuzzWrite("fuzz_pdp", 0, data, len);
+	}
+	for (size_t i = 0; i < sizeof(schemaCommands) / sizeof(schemaCommands[0]); i++)
+	{
+		if (strcmp(saraR5FuzzCommand, schemaCommands[i]) == 0)
+		{
+			saraR5FuzzWrite("fuzz_schema", 0, data, len);
+		}
+	}
+	if (strcmp(saraR5FuzzCommand, "+USORD") == 0 || strcmp(saraR5FuzzCommand, "+USORF") == 0)
+	{
+		// Options byte, announced length, then the answer without its final "OK"
+		uint8_t seed[SARA_R5_FUZZ_CAPTURE_SIZE + 1];
+		const char *ok = strstr((const char *)data, "\r\nOK\r\n");
+		size_t answer = (ok != NULL) ? (size_t)((const uint8_t *)ok - data) : len;
+
+		seed[0] = 0xFF;
+		memcpy(&seed[1], data, answer);
+		saraR5FuzzWrite("fuzz_socket_rx", (saraR5FuzzHex ? 0x01 : 0x00) | (saraR5FuzzCommand[5] == 'F' ? 0x02 : 0x00), seed, answer + 1);
+	}
+
+	// The URC lines received with the answer
+	for (size_t start = 0, end = 0; end <= len; end++)
+	{
+		if (end < len && data[end] != '\n')
+		{
+			continue;
+		}
+		if (end - start > 3 && (strncmp((const char *)&data[start], "+UU", 3) == 0 || strncmp((const char *)&data[start], "+CEREG", 6) == 0))
+		{
+			memcpy(&urcs[urcLength], &data[start], end - start);
+			urcLength += end - start;
+			urcs[urcLength++] = '\n';
+		}
+		start = end + 1;
+	}
+	if (urcLength > 0)
+	{
+		saraR5FuzzWrite("fuzz_urc", -1, (const uint8_t *)urcs, urcLength);
+	}
+	saraR5FuzzCaptureLength = 0;
+}
+
+/**
+ * Starts a new capture on every command the library sends, then hands the bytes to the emulator.
+ */
+static bool saraR5FuzzSend(void *context, const uint8_t *data, size_t len)
+{
+	if (len > 2 && data[0] == 'A' && data[1] == 'T' && !saraR5FuzzMux)
+	{
+		size_t n = 0;
+
+		saraR5FuzzFlush();
+		for (size_t i = 2; i < len && n < sizeof(saraR5FuzzCommand) - 1 && data[i] != '=' && data[i] != '?' && data[i] != '\r'; i++)
+		{
+			saraR5FuzzCommand[n++] = (char)data[i];
+		}
+		saraR5FuzzCommand[n] = '\0';
+	}
+	return saraR5FuzzEmulatorSend(context, data, len);
+}
+
+/**
+ * Keeps a copy of what the emulator sends to the library.
+ */
+static size_t saraR5FuzzReceive(void *context, uint8_t *data, size_t len)
+{
+	size_t received = saraR5FuzzEmulatorReceive(context, data, len);
+	size_t room = sizeof(saraR5FuzzCapture) - 1 - saraR5FuzzCaptureLength;
+	size_t copied = (received < room) ? received : room;
+
+	memcpy(&saraR5FuzzCapture[saraR5FuzzCaptureLength], data, copied);
+	saraR5FuzzCaptureLength += copied;
+	saraR5FuzzCapture[saraR5FuzzCaptureLength] = '\0';
+	return received;
+}
+
+/**
+ * Takes every operator of the scan.
+ */
+static bool saraR5FuzzOperator(const SARA_R5_operator_stats *op, void *context)
+{
+	(void)op;
+	(void)context;
+	return true;
+}
+
+/**
+ * Runs the command queue for a while, so the URCs and the socket reads come in.
+ */
+static void saraR5FuzzIdle(void)
+{
+	for (uint32_t start = saraR5NowMs(); saraR5NowMs() - start < 500;)
+	{
+		saraR5Poll();
+		transport.wait(transport.context, 50);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	static const uint8_t payload[] = "{\"temp\":21.5,\"hum\":48}";
+	char response[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+	uint8_t received[64];
+	myApn apn[MAX_APN];
+	Ip_adress ip[MAX_APN];
+	SARA_R5_pdp_type pdpType;
+	SARA_R5_cmux mux;
+	size_t unacked;
+	int socket;
+
+	if (argc != 2)
+	{
+		printf("usage: %s <corpus directory>\n", argv[0]);
+		return 1;
+	}
+	saraR5FuzzDirectory = argv[1];
+	mkdir(saraR5FuzzDirectory, 0755);
+
+	saraR5EmulatorInit(&emulator, &transport, NULL);
+	saraR5FuzzEmulatorSend = transport.send;
+	saraR5FuzzEmulatorReceive = transport.receive;
+	transport.send = saraR5FuzzSend;
+	transport.receive = saraR5FuzzReceive;
+	saraR5SetTransport(&transport);
+
+	// Network and contexts
+	saraR5Init(SARA_RESPONSE_OK, response);
+	saraR5ScanOperators(saraR5FuzzOperator, NULL);
+	saraR5GetAPN(0, apn, ip, &pdpType);
+	saraR5ResolveHost("broker.example.com", &ip[0]);
+	saraR5ResolveHost("nowhere.invalid", &ip[0]);
+
+	// TCP socket in text mode: write, data from the remote end, URCs, close by the remote end
+	emulator.config.socketEcho = true;
+	socket = saraR5SocketOpen(SARA_R5_TCP, 0);
+	saraR5SocketConnect2(socket, "192.0.2.10", 7000, NULL, 0);
+	saraR5SocketWrite(socket, payload, sizeof(payload) - 1, NULL);
+	saraR5SocketUnacked(socket, &unacked);
+	saraR5EmulatorScheduleUrc(&emulator, "+CEREG: 5", 10);
+	saraR5FuzzIdle();
+	saraR5SocketRead(socket, received, sizeof(received));
+	saraR5EmulatorSocketClose(&emulator, socket, 10);
+	saraR5FuzzIdle();
+
+	// UDP socket in hex mode
+	saraR5SocketSetHexMode(true);
+	saraR5FuzzHex = true;
+	socket = saraR5SocketOpen(SARA_R5_UDP, 0);
+	saraR5SocketWriteDatagram(socket, "192.0.2.20", 5000, payload, sizeof(payload) - 1);
+	saraR5FuzzIdle();
+	saraR5SocketRead(socket, received, sizeof(received));
+	saraR5socketClose(socket, SARA_R5_STANDARD_RESPONSE_TIMEOUT, NULL, 0);
+	saraR5SocketSetHexMode(false);
+	saraR5FuzzHex = false;
+
+	// CMUX: the frames of the channel setup and of a command
+	if (saraR5StartCmux(&mux) == SARA_R5_ERROR_SUCCESS)
+	{
+		saraR5FuzzFlush();
+		saraR5FuzzMux = true;
+		saraR5GetAPN(0, apn, ip, &pdpType);
+		saraR5FuzzFlush();
+		saraR5StopCmux(&mux);
+	}
+	saraR5FuzzFlush();
+	printf("%s: %u seeds\n", saraR5FuzzDirectory, saraR5FuzzFiles);
+	return 0;
+}
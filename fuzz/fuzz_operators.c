@@ -0,0 +1,33 @@
+/*
+ * fuzz_operators.c
+ *
+ * The AT+COPS=? operator parser (saraR5OperatorParserFeed) on arbitrary answers: every operator handed to the
+ * callback must have its names terminated within their arrays.
+ */
+
+// INCLUDES
+#include "Sara_R5_fuzz.h"
+
+/**
+ * Checks an operator as the application would read it.
+ */
+static bool saraR5FuzzOperator(const SARA_R5_operator_stats *op, void *context)
+{
+	size_t *count = (size_t *)context;
+
+	SARA_R5_FUZZ_ASSERT(memchr(op->longOp, '\0', sizeof(op->longOp)) != NULL);
+	SARA_R5_FUZZ_ASSERT(memchr(op->shortOp, '\0', sizeof(op->shortOp)) != NULL);
+	(*count)++;
+	return true;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	SARA_R5_operator_parser parser;
+	size_t count = 0;
+
+	saraR5OperatorParserInit(&parser, saraR5FuzzOperator, &count);
+	saraR5FuzzFeedLines(data, size, saraR5OperatorParserFeed, &parser);
+	SARA_R5_FUZZ_ASSERT(parser.count == count);
+	return 0;
+}
@@ -0,0 +1,29 @@
+/*
+ * fuzz_pdp.c
+ *
+ * The AT+CGDCONT? parser (saraR5PdpParserFeed) on arbitrary answers, for every context and for a single one:
+ * no more contexts than entries, and every APN terminated within its array.
+ */
+
+// INCLUDES
+#include "Sara_R5_fuzz.h"
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	SARA_R5_pdp_context contexts[MAX_APN];
+	SARA_R5_pdp_parser parser;
+
+	for (uint8_t cid = 0; cid <= 1; cid++)
+	{
+		saraR5PdpParserInit(&parser, contexts, (cid == 0) ? MAX_APN : 1, cid);
+		saraR5FuzzFeedLines(data, size, saraR5PdpParserFeed, &parser);
+		SARA_R5_FUZZ_ASSERT(parser.count <= parser.maxContexts && parser.count <= parser.found);
+		for (size_t i = 0; i < parser.count; i++)
+		{
+			SARA_R5_FUZZ_ASSERT(memchr(contexts[i].apn, '\0', sizeof(contexts[i].apn)) != NULL);
+			SARA_R5_FUZZ_ASSERT(contexts[i].paramCount <= SARA_R5_PDP_PARAMS);
+			SARA_R5_FUZZ_ASSERT(cid == 0 || contexts[i].cid == cid);
+		}
+	}
+	return 0;
+}
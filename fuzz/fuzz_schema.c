@@ -0,0 +1,87 @@
+/*
+ * fuzz_schema.c
+ *
+ * The schema parser (saraR5SchemaParserFeed) on arbitrary answers, with the layouts of the library (+USOCR,
+ * +USOST, +USOCTL, +UDNSRN) and one holding every field type: no more records than entries, strings terminated
+ * and hex lengths within their members.
+ */
+
+// INCLUDES
+#include "Sara_R5_fuzz.h"
+
+#define SARA_R5_FUZZ_RECORDS 2
+
+// Record of the layout with every field type
+typedef struct
+{
+  int8_t i8;
+  int16_t i16;
+  int32_t i32;
+  int64_t i64;
+  char text[8];
+  uint8_t ipv4[4];
+  uint8_t ipv6[16];
+  uint8_t bytes[6];
+  size_t length;
+} SARA_R5_fuzz_record;
+
+// Record of the layouts of the library, whose fields are all integers or one address
+typedef struct
+{
+  int socket;
+  uint8_t ip[4];
+  long value[2];
+} SARA_R5_fuzz_answer;
+
+static const SARA_R5_field saraR5FuzzAllFields[] = {
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_fuzz_record, i8),
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_fuzz_record, i16),
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_fuzz_record, i32),
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_fuzz_record, i64),
+	SARA_R5_FIELD(SARA_R5_FIELD_STRING, SARA_R5_fuzz_record, text),
+	SARA_R5_FIELD(SARA_R5_FIELD_IP, SARA_R5_fuzz_record, ipv4),
+	SARA_R5_FIELD(SARA_R5_FIELD_IP, SARA_R5_fuzz_record, ipv6),
+	SARA_R5_FIELD_BYTES(SARA_R5_fuzz_record, bytes, length),
+	SARA_R5_FIELD_SKIPPED,
+};
+static const SARA_R5_field saraR5FuzzSocketFields[] = {
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_fuzz_answer, socket),
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_fuzz_answer, value[0]),
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_fuzz_answer, value[1]),
+};
+static const SARA_R5_field saraR5FuzzDnsFields[] = {
+	SARA_R5_FIELD(SARA_R5_FIELD_IP, SARA_R5_fuzz_answer, ip),
+};
+
+static const SARA_R5_response_schema saraR5FuzzSchemas[] = {
+	SARA_R5_SCHEMA("+FUZZ:", SARA_R5_fuzz_record, saraR5FuzzAllFields),
+	{"+USOCR:", saraR5FuzzSocketFields, 1, sizeof(SARA_R5_fuzz_answer)},
+	{"+USOST:", saraR5FuzzSocketFields, 2, sizeof(SARA_R5_fuzz_answer)},
+	{"+USOWR:", saraR5FuzzSocketFields, 2, sizeof(SARA_R5_fuzz_answer)},
+	SARA_R5_SCHEMA("+USOCTL:", SARA_R5_fuzz_answer, saraR5FuzzSocketFields),
+	SARA_R5_SCHEMA("+UDNSRN:", SARA_R5_fuzz_answer, saraR5FuzzDnsFields),
+};
+
+#define SARA_R5_FUZZ_SCHEMAS (sizeof(saraR5FuzzSchemas) / sizeof(saraR5FuzzSchemas[0]))
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	SARA_R5_fuzz_record records[SARA_R5_FUZZ_RECORDS];
+	SARA_R5_schema_parser parser;
+
+	for (size_t s = 0; s < SARA_R5_FUZZ_SCHEMAS; s++)
+	{
+		saraR5SchemaParserInit(&parser, &saraR5FuzzSchemas[s], records, SARA_R5_FUZZ_RECORDS);
+		saraR5FuzzFeedLines(data, size, saraR5SchemaParserFeed, &parser);
+		SARA_R5_FUZZ_ASSERT(parser.count <= SARA_R5_FUZZ_RECORDS);
+		for (size_t i = 0; s == 0 && i < parser.count; i++)
+		{
+			SARA_R5_FUZZ_ASSERT(memchr(records[i].text, '\0', sizeof(records[i].text)) != NULL);
+			SARA_R5_FUZZ_ASSERT(records[i].length <= sizeof(records[i].bytes));
+		}
+	}
+
+	// The whole buffer parser splits the lines itself
+	SARA_R5_FUZZ_ASSERT(saraR5SchemaParse(&saraR5FuzzSchemas[0], (const char *)data, size, records, SARA_R5_FUZZ_RECORDS) <= SARA_R5_FUZZ_RECORDS);
+	return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * fuzz_socket_rx.c
+ *
+ * The socket reception path (the AT+USORD / AT+USORF response handler and its ring) on arbitrary answers: a
+ * loopback module opens socket 0, announces data with +UUSORD / +UUSORF, and answers the read with the input.
+ * The first byte picks text or hex mode and TCP or UDP, the second the length announced.
+ */
+
+// INCLUDES
+#include "Sara_R5_fuzz.h"
+
+#define SARA_R5_FUZZ_ANSWER_SIZE 1024 // Longest answer, the rest of the loopback buffer takes the URC and "OK"
+#define SARA_R5_FUZZ_POLLS 8
+
+// Module on the other end of the loopback transport
+typedef struct
+{
+  SARA_R5_loopback_transport port;
+  char line[64];        // Start of the command being received
+  size_t lineLength;    // Characters of the command received
+  const uint8_t *input; // Answer to AT+USORD / AT+USORF
+  size_t inputLength;   // Its length
+} SARA_R5_fuzz_module;
+
+static SARA_R5_fuzz_module saraR5FuzzModule;
+static SARA_R5_transport saraR5FuzzTransport;
+
+/**
+ * Queues a string for the library.
+ */
+static void saraR5FuzzInject(const char *text)
+{
+	saraR5LoopbackInject(&saraR5FuzzModule.port, (const uint8_t *)text, strlen(text));
+}
+
+/**
+ * Answers every command once its '\r' is received: the socket ID to AT+USOCR, the input to the reads, OK to the rest.
+ */
+static void saraR5FuzzPeer(void *peer, const uint8_t *data, size_t len)
+{
+	SARA_R5_fuzz_module *module = (SARA_R5_fuzz_module *)peer;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		if (data[i] != '\r')
+		{
+			if (module->lineLength < sizeof(module->line) - 1)
+			{
+				module->line[module->lineLength++] = (char)data[i];
+			}
+			continue;
+		}
+		module->line[module->lineLength] = '\0';
+		if (strncmp(module->line, "AT+USOCR=", 9) == 0)
+		{
+			saraR5FuzzInject("\r\n+USOCR: 0\r\n");
+		}
+		else if (strncmp(module->line, "AT+USORD=", 9) == 0 || strncmp(module->line, "AT+USORF=", 9) == 0)
+		{
+			saraR5FuzzInject("\r\n");
+			saraR5LoopbackInject(&module->port, module->input, module->inputLength);
+			saraR5FuzzInject("\r\n");
+		}
+		saraR5FuzzInject("\r\nOK\r\n");
+		module->lineLength = 0;
+	}
+}
+
+/**
+ * Runs the command queue until it is empty, the virtual clock moving on while the library waits.
+ */
+static void saraR5FuzzPoll(void)
+{
+	for (int i = 0; i < SARA_R5_FUZZ_POLLS && saraR5Poll(); i++)
+	{
+		saraR5FuzzTransport.wait(saraR5FuzzTransport.context, SARA_R5_SOCKET_READ_TIMEOUT / 4);
+	}
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	uint8_t received[256];
+	char urc[32];
+	bool hex;
+	bool udp;
+	int socket;
+
+	if (size < 2)
+	{
+		return 0;
+	}
+	hex = (data[0] & 0x01) != 0;
+	udp = (data[0] & 0x02) != 0;
+	saraR5FuzzModule.input = &data[2];
+	saraR5FuzzModule.inputLength = (size - 2 < SARA_R5_FUZZ_ANSWER_SIZE) ? size - 2 : SARA_R5_FUZZ_ANSWER_SIZE;
+	saraR5FuzzModule.lineLength = 0;
+	saraR5TransportLoopbackInit(&saraR5FuzzTransport, &saraR5FuzzModule.port, saraR5FuzzPeer, &saraR5FuzzModule);
+	saraR5SetTransport(&saraR5FuzzTransport);
+
+	SARA_R5_FUZZ_ASSERT(saraR5SocketSetHexMode(hex) == SARA_R5_ERROR_SUCCESS);
+	socket = saraR5SocketOpen(udp ? SARA_R5_UDP : SARA_R5_TCP, 0);
+	SARA_R5_FUZZ_ASSERT(socket == 0);
+
+	// The module announces the data, saraR5Poll reads it and the application empties the ring
+	snprintf(urc, sizeof(urc), "\r\n%s: 0,%u\r\n", udp ? "+UUSORF" : "+UUSORD", 1u + data[1] * 4u);
+	saraR5FuzzInject(urc);
+	saraR5FuzzPoll();
+	for (int i = 0; i < SARA_R5_FUZZ_POLLS && saraR5SocketRead(socket, received, sizeof(received)) > 0; i++)
+	{
+		saraR5FuzzPoll(); // Every read the ring makes room for is answered with the input again
+	}
+
+	saraR5socketClose(socket, SARA_R5_STANDARD_RESPONSE_TIMEOUT, NULL, 0);
+	saraR5FuzzPoll();
+	return 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * fuzz_tokenizer.c
+ *
+ * The AT tokenizer (saraR5AtTokenizerFeed) on arbitrary module output, handed over in pieces, with and without a
+ * partial line handler and the '@' prompt expected, and a URC filter in front of the line handler. After a final
+ * result code it is reset and fed the rest, as the command queue does.
+ */
+
+// INCLUDES
+#include "Sara_R5_fuzz.h"
+
+/**
+ * Checks every line handed over: within the line buffer and null terminated.
+ */
+static void saraR5FuzzLine(const char *line, size_t len, void *context)
+{
+	(void)context;
+	SARA_R5_FUZZ_ASSERT(len < SARA_R5_AT_LINE_BUFFER_SIZE && line[len] == '\0');
+}
+
+/**
+ * Takes the lines the URC table knows, as the library does between command answers.
+ */
+static bool saraR5FuzzUrc(const char *line, size_t len, void *context)
+{
+	return saraR5UrcDispatch((SARA_R5_urc_table *)context, line, len);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	static SARA_R5_urc_table urcs;
+	SARA_R5_at_tokenizer tokenizer;
+	size_t piece;
+	size_t at = 1;
+
+	if (size == 0)
+	{
+		return 0;
+	}
+	saraR5UrcTableInit(&urcs);
+	saraR5UrcRegister(&urcs, "+UUSORD", NULL, NULL);
+	saraR5UrcRegister(&urcs, "+CEREG", NULL, NULL);
+
+	// First byte: size of the pieces, partial handler, prompt expected
+	piece = 1 + (data[0] & 0x3F);
+	saraR5AtTokenizerInit(&tokenizer, saraR5FuzzLine, NULL);
+	saraR5AtTokenizerSetUrcFilter(&tokenizer, saraR5FuzzUrc, &urcs);
+	if (data[0] & 0x40)
+	{
+		saraR5AtTokenizerSetPartialHandler(&tokenizer, saraR5FuzzLine);
+	}
+	if (data[0] & 0x80)
+	{
+		saraR5AtTokenizerExpectPrompt(&tokenizer);
+	}
+	while (at < size)
+	{
+		size_t n = (size - at < piece) ? size - at : piece;
+		size_t used = saraR5AtTokenizerFeed(&tokenizer, &data[at], n);
+
+		SARA_R5_FUZZ_ASSERT(used > 0 && used <= n && tokenizer.lineLength < SARA_R5_AT_LINE_BUFFER_SIZE);
+		if (saraR5AtTokenizerDone(&tokenizer))
+		{
+			SARA_R5_FUZZ_ASSERT(tokenizer.result != SARA_R5_AT_RESULT_NONE);
+			saraR5AtTokenizerReset(&tokenizer);
+			if (data[0] & 0x80)
+			{
+				saraR5AtTokenizerExpectPrompt(&tokenizer);
+			}
+		}
+		else
+		{
+			SARA_R5_FUZZ_ASSERT(used == n);
+		}
+		at += used;
+	}
+	return 0;
+}
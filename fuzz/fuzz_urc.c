@@ -0,0 +1,66 @@
+/*
+ * fuzz_urc.c
+ *
+ * The URC dispatcher (saraR5UrcDispatch) on arbitrary lines, with the prefixes the library registers: every
+ * field handed to a handler lies in the field storage of the table and reads as a number or the fallback.
+ */
+
+// INCLUDES
+#include "Sara_R5_fuzz.h"
+
+static const char *const saraR5FuzzPrefixes[] = {"+UUSORD", "+UUSORF", "+UUSOCL", "+UUMQTTC", "+UUPSDA", "+CEREG", "+UUPING"};
+
+#define SARA_R5_FUZZ_PREFIXES (sizeof(saraR5FuzzPrefixes) / sizeof(saraR5FuzzPrefixes[0]))
+
+/**
+ * Reads every field of a URC, as the handlers of the library do.
+ */
+static void saraR5FuzzHandler(const SARA_R5_urc *urc, void *context)
+{
+	SARA_R5_urc_table *table = (SARA_R5_urc_table *)context;
+	const char *storage = table->fieldStorage;
+
+	SARA_R5_FUZZ_ASSERT(urc->fieldCount <= SARA_R5_URC_MAX_FIELDS);
+	for (size_t i = 0; i <= urc->fieldCount; i++)
+	{
+		if (i < urc->fieldCount)
+		{
+			const char *field = urc->fields[i];
+
+			SARA_R5_FUZZ_ASSERT(field >= storage && field + strlen(field) < storage + sizeof(table->fieldStorage));
+		}
+		(void)saraR5UrcFieldInt(urc, i, -1);
+	}
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	static SARA_R5_urc_table table;
+	const char *text = (const char *)data;
+	size_t start = 0;
+
+	saraR5UrcTableInit(&table);
+	for (size_t i = 0; i < SARA_R5_FUZZ_PREFIXES; i++)
+	{
+		saraR5UrcRegister(&table, saraR5FuzzPrefixes[i], saraR5FuzzHandler, &table);
+	}
+
+	// One URC per line, no longer than the tokenizer hands them
+	for (size_t end = 0; end <= size; end++)
+	{
+		size_t len;
+
+		if (end < size && text[end] != '\r' && text[end] != '\n')
+		{
+			continue;
+		}
+		len = end - start;
+		if (len >= SARA_R5_AT_LINE_BUFFER_SIZE)
+		{
+			len = SARA_R5_AT_LINE_BUFFER_SIZE - 1;
+		}
+		SARA_R5_FUZZ_ASSERT(saraR5UrcIsKnown(&table, &text[start], len) == saraR5UrcDispatch(&table, &text[start], len));
+		start = end + 1;
+	}
+	return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * Sara_R5_example_flows.c
+ *
+ * The flows of the examples 01 to 05 without the STM32 set up, shared by the host tests and benchmarks.
+ */
+
+// INCLUDES
+#include <stdio.h>
+#include <string.h>
+#include "Sara_R5_example_flows.h"
+
+/**
+ * Example 01: switches the echo off and checks the module answers AT.
+ */
+int saraR5ExampleFlow01(SARA_R5_transport *transport)
+{
+	char resposta[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+
+	(void)transport;
+	return saraR5Init(SARA_RESPONSE_OK, resposta) ? 0 : 1;
+}
+
+/**
+ * Example 02: reads the APN and the IP address of the contexts.
+ */
+int saraR5ExampleFlow02(SARA_R5_transport *transport)
+{
+	Ip_adress ip[MAX_OPS];
+	myApn apn[MAX_OPS];
+	SARA_R5_pdp_type pdpType;
+
+	(void)transport;
+	memset(ip, 0, sizeof(ip));
+	memset(apn, 0, sizeof(apn));
+	if (saraR5GetAPN(0, apn, ip, &pdpType) != SARA_R5_ERROR_SUCCESS)
+	{
+		return 1;
+	}
+	return (apn[0].apn[0] != '\0') ? 0 : 2;
+}
+
+/**
+ * Runs the PDP actions of the examples 03 to 05 in one batch: deactivate (may fail), load and activate.
+ */
+static bool saraR5ExamplePdpBatch(void)
+{
+	SARA_R5_command_result pdp[3] = {0};
+
+	saraR5BatchBegin();
+	saraR5PerformPDPactionAsync(1, SARA_R5_PSD_ACTION_DESACTIVATE, NULL, 0, saraR5StoreResult, &pdp[0]);
+	saraR5PerformPDPactionAsync(1, SARA_R5_PSD_ACTION_LOAD, NULL, 0, saraR5StoreResult, &pdp[1]);
+	saraR5PerformPDPactionAsync(1, SARA_R5_PSD_ACTION_ACTIVATE, NULL, 0, saraR5StoreResult, &pdp[2]);
+	saraR5BatchRun();
+	return (pdp[1].error == SARA_R5_ERROR_SUCCESS && pdp[2].error == SARA_R5_ERROR_SUCCESS);
+}
+
+/**
+ * Example 03: lists the operators, then runs the PDP actions.
+ */
+int saraR5ExampleFlow03(SARA_R5_transport *transport)
+{
+	SARA_R5_operator_stats opRet[MAX_OPS];
+	char resposta[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+
+	(void)transport;
+	if (saraR5GetOperators(opRet, MAX_OPS, resposta, sizeof(resposta)) <= 0)
+	{
+		return 1;
+	}
+	return saraR5ExamplePdpBatch() ? 0 : 2;
+}
+
+/**
+ * Example 04: initialises, reads the APN, runs the PDP actions and sends "Hello, World!" over UDP.
+ */
+int saraR5ExampleFlow04(SARA_R5_transport *transport)
+{
+	Ip_adress ip[MAX_OPS];
+	myApn apn[MAX_OPS];
+	SARA_R5_pdp_type type;
+	char resposta[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+	const char *message = "Hello, World!";
+
+	(void)transport;
+	if (!saraR5Init(SARA_RESPONSE_OK, resposta))
+	{
+		return 1;
+	}
+	if (saraR5GetAPN(0, apn, ip, &type) != SARA_R5_ERROR_SUCCESS)
+	{
+		return 2;
+	}
+	if (!saraR5ExamplePdpBatch())
+	{
+		return 3;
+	}
+	if (saraR5SocketSend(SARA_R5_UDP, "35.180.39.173", 55055, (const uint8_t *)message, strlen(message)) != SARA_R5_ERROR_SUCCESS)
+	{
+		return 4;
+	}
+	return 0;
+}
+
+/**
+ * Example 05: initialises, reads the APN, runs the PDP actions, logs in to the MQTT broker and publishes
+ * five temperatures, 20 seconds apart.
+ */
+int saraR5ExampleFlow05(SARA_R5_transport *transport)
+{
+	Ip_adress ip[MAX_OPS];
+	myApn apn[MAX_OPS];
+	SARA_R5_pdp_type type;
+	char resposta[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+	SARA_R5_command_result client = {0}, server = {0}, login = {0};
+	const char *topic = "/uoc/iulian";
+
+	if (!saraR5Init(SARA_RESPONSE_OK, resposta))
+	{
+		return 1;
+	}
+	if (saraR5GetAPN(0, apn, ip, &type) != SARA_R5_ERROR_SUCCESS)
+	{
+		return 2;
+	}
+	if (!saraR5ExamplePdpBatch())
+	{
+		return 3;
+	}
+	saraR5MQTTdisconnect(resposta, sizeof(resposta)); // May fail when no profile was active
+
+	saraR5BatchBegin();
+	saraR5SetMQTTclientIdAsync("IulianCellular", NULL, 0, saraR5StoreResult, &client);
+	saraR5SetMQTTserverAsync("test.mosquitto.org", 1883, NULL, 0, saraR5StoreResult, &server);
+	saraR5MQTTconectAsync(resposta, sizeof(resposta), saraR5StoreResult, &login);
+	saraR5BatchRun();
+	if (client.error != SARA_R5_ERROR_SUCCESS || server.error != SARA_R5_ERROR_SUCCESS || login.error != SARA_R5_ERROR_SUCCESS)
+	{
+		return 4;
+	}
+
+	for (int i = 0; i < 5; i++)
+	{
+		char message[50];
+
+		transport->wait(transport->context, 20000);
+		snprintf(message, sizeof(message), "Temperatura actual: %d", 15 + 5 * i);
+		if (saraR5PublishMQTT(topic, strlen(topic), resposta, sizeof(resposta), 0, 0, 0, (const uint8_t *)message, strlen(message)) != SARA_R5_ERROR_SUCCESS)
+		{
+			return 5 + i;
+		}
+	}
+	return 0;
+}
+
+const SARA_R5_example_flow saraR5ExampleFlows[SARA_R5_EXAMPLE_FLOWS] = {
+	saraR5ExampleFlow01, saraR5ExampleFlow02, saraR5ExampleFlow03, saraR5ExampleFlow04, saraR5ExampleFlow05,
+};
@@ -0,0 +1,22 @@
+#ifndef SARA_R5_EXAMPLE_FLOWS_H
+#define SARA_R5_EXAMPLE_FLOWS_H
+
+// INCLUDES
+#include "Sara_R5_library.h"
+
+// The flow of one of the examples 01 to 05, run on the transport installed with saraR5SetTransport.
+// Returns 0 if it went through, otherwise the step that failed. 'transport' gives the flows their waits.
+typedef int (*SARA_R5_example_flow)(SARA_R5_transport *transport);
+
+#define SARA_R5_EXAMPLE_FLOWS 5
+
+// FUNCTIONS FOR THE EXAMPLE FLOWS
+int saraR5ExampleFlow01(SARA_R5_transport *transport);
+int saraR5ExampleFlow02(SARA_R5_transport *transport);
+int saraR5ExampleFlow03(SARA_R5_transport *transport);
+int saraR5ExampleFlow04(SARA_R5_transport *transport);
+int saraR5ExampleFlow05(SARA_R5_transport *transport);
+
+extern const SARA_R5_example_flow saraR5ExampleFlows[SARA_R5_EXAMPLE_FLOWS];
+
+#endif // SARA_R5_EXAMPLE_FLOWS_H
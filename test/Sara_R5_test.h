@@ -0,0 +1,91 @@
+#ifndef SARA_R5_TEST_H
+#define SARA_R5_TEST_H
+
+// INCLUDES
+#include <stdio.h>
+#include <string.h>
+#include "Sara_R5_library.h"
+#include "Sara_R5_emulator.h"
+
+// Checks of the host tests: a failed check is reported with its line and the test goes on
+static unsigned saraR5TestChecks = 0;
+static unsigned saraR5TestFailures = 0;
+
+#define SARA_R5_CHECK(condition)                                                        \
+	do                                                                                    \
+	{                                                                                     \
+		saraR5TestChecks++;                                                                 \
+		if (!(condition))                                                                   \
+		{                                                                                   \
+			saraR5TestFailures++;                                                             \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);            \
+		}                                                                                   \
+	} while (0)
+
+#define SARA_R5_CHECK_EQUAL(actual, expected)                                           \
+	do                                                                                    \
+	{                                                                                     \
+		long long saraR5Actual = (long long)(actual);                                       \
+		long long saraR5Expected = (long long)(expected);                                   \
+		saraR5TestChecks++;                                                                 \
+		if (saraR5Actual != saraR5Expected)                                                 \
+		{                                                                                   \
+			saraR5TestFailures++;                                                             \
+			printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual,        \
+				   saraR5Actual, saraR5Expected);                                                \
+		}                                                                                   \
+	} while (0)
+
+#define SARA_R5_TEST_LINE_SIZE 2048 // Bytes sent by the library kept by saraR5TestCapture()
+
+// What the library sent since the last saraR5TestClear(), when the transport is captured
+static bool (*saraR5TestEmulatorSend)(void *context, const uint8_t *data, size_t len);
+static char saraR5TestLine[SARA_R5_TEST_LINE_SIZE];
+static size_t saraR5TestLineLength;
+
+/**
+ * Keeps a copy of what the library sends, then hands it to the emulator.
+ */
+static inline bool saraR5TestCaptureSend(void *context, const uint8_t *data, size_t len)
+{
+	size_t room = sizeof(saraR5TestLine) - 1 - saraR5TestLineLength;
+	size_t copied = (len < room) ? len : room;
+
+	memcpy(&saraR5TestLine[saraR5TestLineLength], data, copied);
+	saraR5TestLineLength += copied;
+	saraR5TestLine[saraR5TestLineLength] = '\0';
+	return saraR5TestEmulatorSend(context, data, len);
+}
+
+/**
+ * Forgets what the library sent so far.
+ */
+static inline void saraR5TestClear(void)
+{
+	saraR5TestLineLength = 0;
+	saraR5TestLine[0] = '\0';
+}
+
+/**
+ * Makes the bytes sent on a transport of the emulator show up in saraR5TestLine.
+ * @param transport The transport filled by saraR5EmulatorInit, before it is handed to the library.
+ */
+static inline void saraR5TestCapture(SARA_R5_transport *transport)
+{
+	saraR5TestEmulatorSend = transport->send;
+	transport->send = saraR5TestCaptureSend;
+	saraR5TestClear();
+}
+
+/**
+ * Prints the outcome of the checks of a test program.
+ * @param name The name of the program.
+ * @return The exit status: 0 if every check passed.
+ */
+static inline int saraR5TestSummary(const char *name)
+{
+	printf("%s: %u checks, %u failed\n", name, saraR5TestChecks, saraR5TestFailures);
+	return (saraR5TestFailures == 0) ? 0 : 1;
+}
+
+#endif // SARA_R5_TEST_H
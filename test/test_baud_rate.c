@@ -0,0 +1,105 @@
+/*
+ * test_baud_rate.c
+ *
+ * saraR5NegotiateBaudRate against the module emulator: the ladder falls back from 921600 to 460800 when the wiring
+ * carries no more, a rate kept in the SARA_R5_baud_store skips the ladder, and the link stays at 115200 when the
+ * module refuses RTS/CTS flow control.
+ */
+
+// INCLUDES
+#include "Sara_R5_test.h"
+
+static SARA_R5_emulator emulator;
+static SARA_R5_transport transport;
+static uint32_t saraR5TestStored; // Rate kept by the store, 0 for none
+static unsigned saraR5TestSaves;  // Calls to saraR5TestSave
+
+/**
+ * Reads the rate kept by the test store.
+ */
+static bool saraR5TestLoad(uint32_t *baud, void *context)
+{
+	(void)context;
+	*baud = saraR5TestStored;
+	return saraR5TestStored != 0;
+}
+
+/**
+ * Keeps the rate handed to the test store.
+ */
+static void saraR5TestSave(uint32_t baud, void *context)
+{
+	(void)context;
+	saraR5TestStored = baud;
+	saraR5TestSaves++;
+}
+
+/**
+ * Powers a new module on at 115200 baud, on wiring that carries 'maxBaud' at most.
+ */
+static void saraR5TestPowerOn(uint32_t maxBaud, bool noFlowControl)
+{
+	SARA_R5_emulator_config config;
+
+	saraR5EmulatorDefaultConfig(&config);
+	config.maxBaud = maxBaud;
+	config.noFlowControl = noFlowControl;
+	saraR5EmulatorInit(&emulator, &transport, &config);
+	saraR5TestCapture(&transport);
+	saraR5SetTransport(&transport);
+	saraR5TestSaves = 0;
+}
+
+int main(void)
+{
+	static const uint32_t rates[] = SARA_R5_BAUD_LADDER;
+	const SARA_R5_baud_store store = {saraR5TestLoad, saraR5TestSave, NULL};
+	char response[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+	uint32_t selected = 0;
+
+	// The ladder: 921600 reaches the library as noise, the module is sent back to 115200, then 460800 holds
+	saraR5TestPowerOn(460800, false);
+	SARA_R5_CHECK(saraR5Init(SARA_RESPONSE_OK, response));
+	saraR5TestClear();
+	SARA_R5_CHECK_EQUAL(saraR5NegotiateBaudRate(rates, sizeof(rates) / sizeof(rates[0]), &store, &selected), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(selected, 460800);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+IFC=2,2\r") != NULL);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+IPR=921600\r") != NULL);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+IPR=115200\r") != NULL);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+IPR=460800\r") != NULL);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT&W\r") != NULL);
+	SARA_R5_CHECK_EQUAL(emulator.moduleBaud, 460800);
+	SARA_R5_CHECK_EQUAL(emulator.hostBaud, 460800);
+	SARA_R5_CHECK_EQUAL(saraR5TestStored, 460800);
+	SARA_R5_CHECK_EQUAL(saraR5TestSaves, 1);
+
+	// The stored rate: one AT probe at 460800, no AT+IFC nor AT+IPR, nothing stored again
+	saraR5TestClear();
+	SARA_R5_CHECK_EQUAL(saraR5NegotiateBaudRate(rates, sizeof(rates) / sizeof(rates[0]), &store, &selected), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(selected, 460800);
+	SARA_R5_CHECK(strcmp(saraR5TestLine, "AT\r") == 0);
+	SARA_R5_CHECK_EQUAL(saraR5TestSaves, 1);
+	SARA_R5_CHECK(saraR5SendCommandWithResponse(SARA_R5_COMMAND_AT, SARA_RESPONSE_OK, response, sizeof(response), SARA_R5_STANDARD_RESPONSE_TIMEOUT));
+
+	// A stored rate the module lost (e.g. a factory reset): its probes fail, the ladder runs from 115200
+	saraR5TestPowerOn(460800, false);
+	saraR5TestClear();
+	SARA_R5_CHECK_EQUAL(saraR5NegotiateBaudRate(rates, sizeof(rates) / sizeof(rates[0]), &store, &selected), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(selected, 460800);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+IFC=2,2\r") != NULL);
+	SARA_R5_CHECK_EQUAL(saraR5TestSaves, 1);
+
+	// RTS/CTS refused by the module: no AT+IPR, the link stays at 115200
+	saraR5TestPowerOn(0, true);
+	saraR5TestClear();
+	SARA_R5_CHECK_EQUAL(saraR5NegotiateBaudRate(rates, sizeof(rates) / sizeof(rates[0]), NULL, &selected), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(selected, SARA_R5_DEFAULT_BAUD_RATE);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+IFC=2,2\r") != NULL);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+IPR=") == NULL);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT&W\r") != NULL);
+	SARA_R5_CHECK_EQUAL(emulator.moduleBaud, SARA_R5_DEFAULT_BAUD_RATE);
+	SARA_R5_CHECK_EQUAL(emulator.hostBaud, SARA_R5_DEFAULT_BAUD_RATE);
+	SARA_R5_CHECK(saraR5SendCommandWithResponse(SARA_R5_COMMAND_AT, SARA_RESPONSE_OK, response, sizeof(response), SARA_R5_STANDARD_RESPONSE_TIMEOUT));
+
+	return saraR5TestSummary("test_baud_rate");
+}
@@ -0,0 +1,64 @@
+/*
+ * test_binary_datagram.c
+ *
+ * A UDP datagram holding NUL, '\r', '\n', '"', '\' and "OK" bytes sent with saraR5SocketWriteDatagram to the
+ * module emulator, after the '@' prompt (text mode) and as hex digits in the command (hex mode): the emulator must
+ * receive the bytes written. In hex mode the remote end also sends it back, and the bytes read must match.
+ */
+
+// INCLUDES
+#include "Sara_R5_test.h"
+
+static SARA_R5_emulator emulator;
+static SARA_R5_transport transport;
+
+static const uint8_t saraR5TestDatagram[] = {'A', 0x00, 'B', '\r', '\n', '"', ',', '\\', 0xFF, 0x00, '\r', '"', 'O', 'K', '\r', '\n'};
+
+/**
+ * Sends the datagram, checks what the emulator received, and when the remote end sends it back, what is read.
+ */
+static void saraR5TestSend(int socket)
+{
+	uint8_t received[sizeof(saraR5TestDatagram) + 8];
+
+	memset(emulator.payload, 0, sizeof(emulator.payload));
+	SARA_R5_CHECK_EQUAL(saraR5SocketWriteDatagram(socket, "192.0.2.20", 5000, saraR5TestDatagram, sizeof(saraR5TestDatagram)), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(emulator.payloadLength, sizeof(saraR5TestDatagram));
+	SARA_R5_CHECK(memcmp(emulator.payload, saraR5TestDatagram, sizeof(saraR5TestDatagram)) == 0);
+	if (!emulator.config.socketEcho)
+	{
+		return;
+	}
+
+	for (uint32_t start = saraR5NowMs(); saraR5NowMs() - start < 5000 && saraR5SocketAvailable(socket) < sizeof(saraR5TestDatagram);)
+	{
+		saraR5Poll();
+		transport.wait(transport.context, 50);
+	}
+	SARA_R5_CHECK_EQUAL(saraR5SocketRead(socket, received, sizeof(received)), sizeof(saraR5TestDatagram));
+	SARA_R5_CHECK(memcmp(received, saraR5TestDatagram, sizeof(saraR5TestDatagram)) == 0);
+}
+
+int main(void)
+{
+	char response[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+	int socket;
+
+	saraR5EmulatorInit(&emulator, &transport, NULL);
+	saraR5SetTransport(&transport);
+	SARA_R5_CHECK(saraR5Init(SARA_RESPONSE_OK, response));
+	socket = saraR5SocketOpen(SARA_R5_UDP, 0);
+	SARA_R5_CHECK(socket >= 0);
+
+	// Text mode: the datagram follows the '@' prompt as it is. Received data with line breaks needs hex mode.
+	saraR5TestSend(socket);
+	SARA_R5_CHECK(!emulator.hexMode);
+
+	// Hex mode: the datagram is in the command, and comes back as hex digits
+	SARA_R5_CHECK_EQUAL(saraR5SocketSetHexMode(true), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK(emulator.hexMode);
+	emulator.config.socketEcho = true;
+	saraR5TestSend(socket);
+
+	return saraR5TestSummary("test_binary_datagram");
+}
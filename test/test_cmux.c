@@ -0,0 +1,196 @@
+/*
+ * test_cmux.c
+ *
+ * The 27.010 multiplexer against the module emulator, the CMUX peer: saraR5StartCmux and saraR5StopCmux, commands
+ * and URCs on DLCI 1, a second AT session on DLCI 2, MSC flow control in both directions, and frames with a wrong
+ * FCS dropped and counted on either side.
+ */
+
+// INCLUDES
+#include "Sara_R5_test.h"
+
+static SARA_R5_emulator emulator;
+static SARA_R5_transport transport;
+static SARA_R5_cmux mux;
+
+/**
+ * Builds a frame of the basic option in 'frame'.
+ * @return The number of bytes of the frame, flags included.
+ */
+static size_t saraR5TestFrame(uint8_t *frame, uint8_t dlci, uint8_t control, const uint8_t *info, size_t len)
+{
+	size_t count = 1;
+	size_t headerLength;
+
+	frame[0] = SARA_R5_CMUX_FLAG;
+	headerLength = saraR5CmuxHeader(&frame[count], dlci, control, true, len);
+	memcpy(&frame[count + headerLength], info, len);
+	// The FCS of a UI frame covers the information field too
+	frame[count + headerLength + len] = saraR5CmuxFcs(&frame[count], headerLength + ((control == SARA_R5_CMUX_UI) ? len : 0));
+	count += headerLength + len + 1;
+	frame[count++] = SARA_R5_CMUX_FLAG;
+	return count;
+}
+
+/**
+ * Feeds a frame to a decoder.
+ * @return The number of complete frames it reported.
+ */
+static int saraR5TestParse(SARA_R5_cmux_parser *parser, const uint8_t *frame, size_t len)
+{
+	int frames = 0;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		frames += saraR5CmuxParse(parser, frame[i]);
+	}
+	return frames;
+}
+
+/**
+ * Polls the multiplexer until the MSC of the module has reached DLCI 2, or 1 s went by.
+ */
+static void saraR5TestPollFlow(bool stopped)
+{
+	for (uint32_t start = saraR5NowMs(); saraR5NowMs() - start < 1000 && mux.channels[2].peerStopped != stopped;)
+	{
+		transport.wait(transport.context, 10);
+		saraR5CmuxPoll(&mux);
+	}
+}
+
+/**
+ * Reads what DLCI 2 received until 'count' final "OK" came, or 5 s went by.
+ * @return The number of "OK" read.
+ */
+static int saraR5TestReadOk(SARA_R5_transport *channel, int count)
+{
+	static char answer[2048];
+	size_t length = 0;
+	int found = 0;
+
+	for (uint32_t start = saraR5NowMs(); saraR5NowMs() - start < 5000 && found < count;)
+	{
+		length += channel->receive(channel->context, (uint8_t *)&answer[length], sizeof(answer) - 1 - length);
+		answer[length] = '\0';
+		found = 0;
+		for (const char *ok = strstr(answer, "\r\nOK\r\n"); ok != NULL; ok = strstr(ok + 1, "\r\nOK\r\n"))
+		{
+			found++;
+		}
+		channel->wait(channel->context, 10);
+	}
+	return found;
+}
+
+int main(void)
+{
+	static const uint8_t info[] = "AT\r";
+	char response[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+	uint8_t frame[SARA_R5_CMUX_FRAME_SIZE + 7];
+	size_t len;
+	SARA_R5_cmux_parser parser;
+	SARA_R5_transport *second;
+	uint8_t received[16];
+	uint32_t start;
+	int socket;
+
+	// Frame decoder: UIH and UI frames, a wrong FCS and a missing closing flag
+	memset(&parser, 0, sizeof(parser));
+	saraR5CmuxParserReset(&parser);
+	len = saraR5TestFrame(frame, 1, SARA_R5_CMUX_UIH, info, 3);
+	SARA_R5_CHECK_EQUAL(saraR5TestParse(&parser, frame, len), 1);
+	SARA_R5_CHECK(parser.dlci == 1 && parser.length == 3 && memcmp(parser.info, info, 3) == 0);
+	len = saraR5TestFrame(frame, 2, SARA_R5_CMUX_UI, info, 3);
+	SARA_R5_CHECK_EQUAL(saraR5TestParse(&parser, frame, len), 1);
+	SARA_R5_CHECK_EQUAL(parser.dlci, 2);
+	frame[len - 2] ^= 0x01;
+	SARA_R5_CHECK_EQUAL(saraR5TestParse(&parser, frame, len), 0);
+	SARA_R5_CHECK_EQUAL(parser.badFcs, 1);
+	len = saraR5TestFrame(frame, 1, SARA_R5_CMUX_UIH, info, 3);
+	frame[len - 1] = 0x00;
+	SARA_R5_CHECK_EQUAL(saraR5TestParse(&parser, frame, len), 0);
+	SARA_R5_CHECK_EQUAL(parser.badFrames, 1);
+
+	saraR5EmulatorInit(&emulator, &transport, NULL);
+	saraR5TestCapture(&transport);
+	saraR5SetTransport(&transport);
+	SARA_R5_CHECK(saraR5Init(SARA_RESPONSE_OK, response));
+
+	// Start: AT+CMUX in plain text, then SABM / UA on every channel, the library goes on on DLCI 1
+	SARA_R5_CHECK_EQUAL(saraR5StartCmux(&mux), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+CMUX=0,0,,127\r") != NULL);
+	SARA_R5_CHECK(emulator.mux);
+	SARA_R5_CHECK(saraR5GetTransport() == saraR5CmuxChannel(&mux, 1));
+	for (uint8_t dlci = 0; dlci <= SARA_R5_CMUX_CHANNELS; dlci++)
+	{
+		SARA_R5_CHECK(mux.channels[dlci].open);
+	}
+
+	// Commands on DLCI 1, and the +UUSORD URC that announces the data of the remote end
+	socket = saraR5SocketOpen(SARA_R5_TCP, 0);
+	SARA_R5_CHECK(socket >= 0);
+	SARA_R5_CHECK(saraR5EmulatorSocketData(&emulator, socket, (const uint8_t *)"muxed", 5, 20));
+	for (start = saraR5NowMs(); saraR5NowMs() - start < 5000 && saraR5SocketAvailable(socket) < 5;)
+	{
+		saraR5Poll();
+		transport.wait(transport.context, 50);
+	}
+	SARA_R5_CHECK_EQUAL(saraR5SocketRead(socket, received, sizeof(received)), 5);
+	SARA_R5_CHECK(memcmp(received, "muxed", 5) == 0);
+
+	// The module stops DLCI 2: a send there waits SARA_R5_CMUX_FLOW_TIMEOUT and fails, DLCI 1 goes on
+	second = saraR5CmuxChannel(&mux, 2);
+	SARA_R5_CHECK(saraR5EmulatorMuxFlow(&emulator, 2, true));
+	saraR5TestPollFlow(true);
+	SARA_R5_CHECK(mux.channels[2].peerStopped);
+	start = saraR5NowMs();
+	SARA_R5_CHECK(!second->send(second->context, info, 3));
+	SARA_R5_CHECK(saraR5NowMs() - start >= SARA_R5_CMUX_FLOW_TIMEOUT);
+	SARA_R5_CHECK_EQUAL(saraR5socketClose(socket, SARA_R5_STANDARD_RESPONSE_TIMEOUT, response, sizeof(response)), SARA_R5_ERROR_SUCCESS);
+
+	// ... and resumes it
+	SARA_R5_CHECK(saraR5EmulatorMuxFlow(&emulator, 2, false));
+	saraR5TestPollFlow(false);
+	SARA_R5_CHECK(!mux.channels[2].peerStopped);
+	SARA_R5_CHECK(second->send(second->context, info, 3));
+	SARA_R5_CHECK_EQUAL(saraR5TestReadOk(second, 1), 1);
+
+	// Answers left unread on DLCI 2 fill its buffer: the library stops the module, and resumes it once read
+	for (int i = 0; i < 3; i++)
+	{
+		SARA_R5_CHECK(second->send(second->context, (const uint8_t *)"AT+CGDCONT?\r", 12));
+	}
+	for (start = saraR5NowMs(); saraR5NowMs() - start < 5000 && !emulator.muxStopped[2];)
+	{
+		transport.wait(transport.context, 10);
+		saraR5CmuxPoll(&mux);
+	}
+	SARA_R5_CHECK(mux.channels[2].stopped);
+	SARA_R5_CHECK(emulator.muxStopped[2]);
+	SARA_R5_CHECK_EQUAL(saraR5TestReadOk(second, 3), 3);
+	SARA_R5_CHECK(!mux.channels[2].stopped);
+	SARA_R5_CHECK(!emulator.muxStopped[2]);
+
+	// A frame with a wrong FCS is dropped by either side, which goes on with the next one
+	len = saraR5TestFrame(frame, 2, SARA_R5_CMUX_UIH, info, 3);
+	frame[len - 2] ^= 0x80;
+	SARA_R5_CHECK(transport.send(transport.context, frame, len));
+	SARA_R5_CHECK_EQUAL(emulator.muxParser.badFcs, 1);
+	SARA_R5_CHECK_EQUAL(mux.parser.badFcs, 0);
+	SARA_R5_CHECK_EQUAL(saraR5TestParse(&mux.parser, frame, len), 0);
+	SARA_R5_CHECK_EQUAL(mux.parser.badFcs, 1);
+	SARA_R5_CHECK(second->send(second->context, info, 3));
+	SARA_R5_CHECK_EQUAL(saraR5TestReadOk(second, 1), 1);
+
+	// Stop: CLD, then plain AT commands on the serial line again
+	SARA_R5_CHECK_EQUAL(saraR5StopCmux(&mux), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK(!emulator.mux);
+	SARA_R5_CHECK(saraR5GetTransport() == &transport);
+	saraR5TestClear();
+	socket = saraR5SocketOpen(SARA_R5_UDP, 0);
+	SARA_R5_CHECK(socket >= 0);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+USOCR=17") != NULL);
+
+	return saraR5TestSummary("test_cmux");
+}
@@ -0,0 +1,86 @@
+/*
+ * test_direct_link.c
+ *
+ * Leaving the socket direct link against the module emulator: a confirmed escape, a DISCONNECT and an AT probe
+ * cut on the line, and a "+++" taken as data. Until the module is known to take commands, the link and the held
+ * command queue are kept, and the escape tried again gets the module back.
+ */
+
+// INCLUDES
+#include "Sara_R5_test.h"
+
+static SARA_R5_emulator emulator;
+static SARA_R5_transport transport;
+
+/**
+ * Enters the direct link on a connected socket and sends some data.
+ */
+static void saraR5TestEnterLink(int socket)
+{
+	SARA_R5_CHECK_EQUAL(saraR5SocketDirectLink(socket), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK(saraR5DirectLinkWrite((const uint8_t *)"ping", 4));
+}
+
+/**
+ * Tells if the module takes commands.
+ */
+static bool saraR5TestCommandMode(void)
+{
+	char response[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+
+	return saraR5SendCommandWithResponse(SARA_R5_COMMAND_AT, SARA_RESPONSE_OK, response, sizeof(response), SARA_R5_STANDARD_RESPONSE_TIMEOUT);
+}
+
+int main(void)
+{
+	char response[STANDARD_RESPONSE_BUFFER_SIZE];
+	SARA_R5_direct_link_stats stats;
+	unsigned long faults;
+	int socket;
+
+	saraR5EmulatorInit(&emulator, &transport, NULL);
+	saraR5SetTransport(&transport);
+	SARA_R5_CHECK(saraR5Init(SARA_RESPONSE_OK, response));
+	socket = saraR5SocketOpen(SARA_R5_TCP, 0);
+	SARA_R5_CHECK(socket >= 0);
+	SARA_R5_CHECK_EQUAL(saraR5SocketConnect2(socket, "192.0.2.10", 80, response, sizeof(response)), SARA_R5_ERROR_SUCCESS);
+
+	// The module confirms with DISCONNECT
+	saraR5TestEnterLink(socket);
+	SARA_R5_CHECK_EQUAL(saraR5DirectLinkExit(&stats), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(stats.sent, 4);
+	SARA_R5_CHECK(!emulator.directLink);
+	SARA_R5_CHECK(saraR5TestCommandMode());
+
+	// Every answer is cut, DISCONNECT and the OK of the AT probe included: the library cannot tell the module left
+	saraR5TestEnterLink(socket);
+	faults = emulator.stats.faults;
+	emulator.config.truncatePercent = 100;
+	SARA_R5_CHECK_EQUAL(saraR5DirectLinkExit(&stats), SARA_R5_ERROR_NO_RESPONSE);
+	emulator.config.truncatePercent = 0;
+	SARA_R5_CHECK_EQUAL(emulator.stats.faults, faults + 2);
+	SARA_R5_CHECK(!emulator.directLink);
+
+	// Tried again, the "+++" lands in command mode and the AT probe finds the module out of the link
+	SARA_R5_CHECK_EQUAL(saraR5DirectLinkExit(&stats), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK(saraR5TestCommandMode());
+
+	// "+++" taken as data: the module is still in the link, so are the library and its queue
+	saraR5TestEnterLink(socket);
+	faults = emulator.stats.faults;
+	emulator.config.escapeMissPercent = 100;
+	SARA_R5_CHECK_EQUAL(saraR5DirectLinkExit(&stats), SARA_R5_ERROR_NO_RESPONSE);
+	emulator.config.escapeMissPercent = 0;
+	SARA_R5_CHECK_EQUAL(emulator.stats.faults, faults + 1);
+	SARA_R5_CHECK(emulator.directLink);
+	SARA_R5_CHECK_EQUAL(saraR5SetMQTTclientId("client", response, sizeof(response)), SARA_R5_ERROR_ERROR);
+
+	// The escape tried again gets the module out
+	SARA_R5_CHECK_EQUAL(saraR5DirectLinkExit(&stats), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK(!emulator.directLink);
+	SARA_R5_CHECK(saraR5TestCommandMode());
+	SARA_R5_CHECK_EQUAL(saraR5SetMQTTclientId("client", response, sizeof(response)), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(saraR5DirectLinkExit(&stats), SARA_R5_ERROR_ERROR);
+
+	return saraR5TestSummary("test_direct_link");
+}
@@ -0,0 +1,137 @@
+/*
+ * test_examples.c
+ *
+ * Runs the flows of the examples 01 to 05 against the module emulator, with the default configuration and
+ * with fault injection, at fixed seeds. Each run starts from a fresh library in a child process; its outcome
+ * and the statistics of the emulator are checked, and a second run with the same seed must match them exactly.
+ */
+
+// INCLUDES
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "Sara_R5_test.h"
+#include "Sara_R5_example_flows.h"
+
+// Outcome of one flow, sent back by the child process
+typedef struct
+{
+  int failedStep;               // 0 if the flow went through, otherwise the step that failed
+  uint32_t virtualMs;           // Virtual time at the end of the flow
+  SARA_R5_emulator_stats stats; // Statistics of the emulator
+} SARA_R5_test_report;
+
+// Emulator configuration of a run
+typedef struct
+{
+  const char *name;
+  uint32_t seed;                                         // Seed of the emulator
+  uint8_t garbagePercent;                                // Faults injected, see SARA_R5_emulator_config
+  uint8_t truncatePercent;
+  uint8_t errorPercent;
+  int expectedStep[SARA_R5_EXAMPLE_FLOWS];               // Step each flow fails at with this seed (0: it goes through)
+  unsigned long expectedCommands[SARA_R5_EXAMPLE_FLOWS]; // Command lines each flow sends with this seed
+} SARA_R5_test_config;
+
+static const SARA_R5_test_config saraR5TestConfigs[] = {
+	{"default", 1, 0, 0, 0, {0, 0, 0, 0, 0}, {2, 1, 5, 9, 15}},
+	{"seed 7", 7, 0, 0, 0, {0, 0, 0, 0, 0}, {2, 1, 5, 9, 15}},
+	{"garbage", 0x9E3779B9, 30, 0, 0, {1, 0, 0, 1, 1}, {2, 1, 5, 2, 2}},
+	{"truncate", 0x85EBCA6B, 0, 20, 0, {0, 0, 0, 0, 6}, {2, 1, 5, 9, 12}},
+	{"error", 0xC2B2AE35, 0, 0, 15, {1, 0, 0, 1, 1}, {2, 1, 5, 2, 2}},
+	{"all faults", 0x27D4EB2F, 10, 10, 10, {0, 0, 0, 0, 8}, {2, 1, 5, 9, 14}},
+};
+
+#define SARA_R5_TEST_CONFIGS (sizeof(saraR5TestConfigs) / sizeof(saraR5TestConfigs[0]))
+
+/**
+ * Runs a flow on a fresh emulator and library, in a child process.
+ * @return true if the child reported its outcome.
+ */
+static bool saraR5TestRun(SARA_R5_example_flow flow, const SARA_R5_test_config *config, SARA_R5_test_report *report)
+{
+	int pipeFd[2];
+	pid_t child;
+	int status;
+	bool received;
+
+	if (pipe(pipeFd) != 0)
+	{
+		return false;
+	}
+	fflush(stdout);
+	child = fork();
+	if (child < 0)
+	{
+		return false;
+	}
+	if (child == 0)
+	{
+		static SARA_R5_emulator emulator;
+		SARA_R5_emulator_config emulatorConfig;
+		SARA_R5_transport transport;
+		SARA_R5_test_report childReport;
+
+		saraR5EmulatorDefaultConfig(&emulatorConfig);
+		emulatorConfig.seed = config->seed;
+		emulatorConfig.garbagePercent = config->garbagePercent;
+		emulatorConfig.truncatePercent = config->truncatePercent;
+		emulatorConfig.errorPercent = config->errorPercent;
+		saraR5EmulatorInit(&emulator, &transport, &emulatorConfig);
+		saraR5SetTransport(&transport);
+
+		memset(&childReport, 0, sizeof(childReport));
+		childReport.failedStep = flow(&transport);
+		childReport.virtualMs = saraR5NowMs();
+		childReport.stats = emulator.stats;
+		_exit(write(pipeFd[1], &childReport, sizeof(childReport)) == (ssize_t)sizeof(childReport) ? 0 : 1);
+	}
+
+	close(pipeFd[1]);
+	received = (read(pipeFd[0], report, sizeof(*report)) == (ssize_t)sizeof(*report));
+	close(pipeFd[0]);
+	waitpid(child, &status, 0);
+	return received && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(void)
+{
+	for (size_t c = 0; c < SARA_R5_TEST_CONFIGS; c++)
+	{
+		const SARA_R5_test_config *config = &saraR5TestConfigs[c];
+		bool faulty = config->garbagePercent > 0 || config->truncatePercent > 0 || config->errorPercent > 0;
+		unsigned long faults = 0;
+
+		for (size_t f = 0; f < SARA_R5_EXAMPLE_FLOWS; f++)
+		{
+			SARA_R5_test_report first;
+			SARA_R5_test_report second;
+
+			SARA_R5_CHECK(saraR5TestRun(saraR5ExampleFlows[f], config, &first));
+			SARA_R5_CHECK(saraR5TestRun(saraR5ExampleFlows[f], config, &second));
+			printf("flow %02u, %-10s: step %d, %6lu ms, %3lu commands, %2lu faults, %5lu bytes out, %5lu bytes in\n",
+				   (unsigned)(f + 1), config->name, first.failedStep, (unsigned long)first.virtualMs, first.stats.commands,
+				   first.stats.faults, first.stats.bytesToModule, first.stats.bytesFromModule);
+
+			// Same seed, same run
+			SARA_R5_CHECK_EQUAL(second.failedStep, first.failedStep);
+			SARA_R5_CHECK_EQUAL(second.virtualMs, first.virtualMs);
+			SARA_R5_CHECK(memcmp(&second.stats, &first.stats, sizeof(first.stats)) == 0);
+
+			// The outcome of the seed, faults included
+			SARA_R5_CHECK_EQUAL(first.failedStep, config->expectedStep[f]);
+			SARA_R5_CHECK_EQUAL(first.stats.commands, config->expectedCommands[f]);
+			faults += first.stats.faults;
+			if (!faulty)
+			{
+				SARA_R5_CHECK_EQUAL(first.stats.faults, 0);
+			}
+		}
+		if (faulty)
+		{
+			SARA_R5_CHECK(faults > 0);
+		}
+	}
+
+	return saraR5TestSummary("test_examples");
+}
@@ -0,0 +1,80 @@
+/*
+ * test_footprint.c
+ *
+ * saraR5GetFootprint against the module emulator: the static parts add up to the total, the static response pool
+ * counts only in a SARA_R5_NO_HEAP build, and the response buffers of saraR5CallocChar and of a command function are
+ * counted while held, in the peak, and in the failures once they do not fit.
+ */
+
+// INCLUDES
+#include "Sara_R5_test.h"
+
+static SARA_R5_emulator emulator;
+static SARA_R5_transport transport;
+
+int main(void)
+{
+	// 59 bytes of JSON, 12 quotes: 83 bytes once escaped
+	static const char json[] = "{\"device\":\"sara-r5\",\"temp\":21,\"hum\":480,\"status\":\"running\"}";
+	char response[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+	SARA_R5_footprint footprint;
+	unsigned long allocations;
+	char *first;
+	char *second;
+
+	saraR5EmulatorInit(&emulator, &transport, NULL);
+	saraR5SetTransport(&transport);
+	SARA_R5_CHECK(saraR5Init(SARA_RESPONSE_OK, response));
+
+	// The static parts
+	saraR5GetFootprint(&footprint);
+	SARA_R5_CHECK(footprint.receive > 0 && footprint.commandQueue > 0 && footprint.urcTable > 0);
+	SARA_R5_CHECK(footprint.sockets > 0 && footprint.udpQueue > 0 && footprint.dnsCache > 0);
+	SARA_R5_CHECK_EQUAL(footprint.total, footprint.receive + footprint.commandQueue + footprint.urcTable + footprint.sockets + footprint.udpQueue + footprint.dnsCache + footprint.scratch);
+#ifdef SARA_R5_NO_HEAP
+	SARA_R5_CHECK_EQUAL(footprint.scratch, SARA_R5_SCRATCH_SIZE);
+#else
+	SARA_R5_CHECK_EQUAL(footprint.scratch, 0);
+#endif
+	SARA_R5_CHECK_EQUAL(footprint.scratchInUse, 0);
+	SARA_R5_CHECK_EQUAL(footprint.failures, 0);
+
+	// Buffers held, then given back
+	allocations = footprint.allocations;
+	first = saraR5CallocChar(100);
+	second = saraR5CallocChar(50);
+	SARA_R5_CHECK(first != NULL && second != NULL);
+	saraR5GetFootprint(&footprint);
+	SARA_R5_CHECK_EQUAL(footprint.scratchInUse, 150);
+	SARA_R5_CHECK(footprint.scratchPeak >= 150);
+	SARA_R5_CHECK_EQUAL(footprint.allocations, allocations + 2);
+	saraR5FreeChar(second, 50);
+	saraR5FreeChar(first, 100);
+	saraR5GetFootprint(&footprint);
+	SARA_R5_CHECK_EQUAL(footprint.scratchInUse, 0);
+	SARA_R5_CHECK(footprint.scratchPeak >= 150);
+
+	// A command function: its escaped message is held while the command runs, and given back before it returns
+	SARA_R5_CHECK_EQUAL(saraR5MQTTconect(response, sizeof(response)), SARA_R5_ERROR_SUCCESS);
+	allocations = footprint.allocations;
+	SARA_R5_CHECK_EQUAL(saraR5PublishMQTT("t", 1, response, sizeof(response), 0, 0, 0, (const uint8_t *)json, sizeof(json) - 1), SARA_R5_ERROR_SUCCESS);
+	saraR5GetFootprint(&footprint);
+	SARA_R5_CHECK_EQUAL(footprint.scratchInUse, 0);
+	SARA_R5_CHECK_EQUAL(footprint.allocations, allocations + 1);
+	SARA_R5_CHECK(footprint.scratchPeak >= 83);
+
+#ifdef SARA_R5_NO_HEAP
+	// More than the pool holds
+	SARA_R5_CHECK(saraR5CallocChar(SARA_R5_SCRATCH_SIZE + 1) == NULL);
+	first = saraR5CallocChar(SARA_R5_SCRATCH_SIZE);
+	SARA_R5_CHECK(first != NULL);
+	SARA_R5_CHECK(saraR5CallocChar(1) == NULL);
+	saraR5FreeChar(first, SARA_R5_SCRATCH_SIZE);
+	saraR5GetFootprint(&footprint);
+	SARA_R5_CHECK_EQUAL(footprint.failures, 2);
+	SARA_R5_CHECK_EQUAL(footprint.scratchPeak, SARA_R5_SCRATCH_SIZE);
+	SARA_R5_CHECK_EQUAL(footprint.scratchInUse, 0);
+#endif
+
+	return saraR5TestSummary("test_footprint");
+}
@@ -0,0 +1,169 @@
+/*
+ * test_pdp_parser.c
+ *
+ * The AT+CGDCONT? parser on IPv4, IPv6 (dotted and colon notation) and dual-stack contexts, context identifiers
+ * past MAX_OPS, answers fed in pieces, and saraR5GetAPN against the module emulator.
+ */
+
+// INCLUDES
+#include "Sara_R5_test.h"
+
+#define SARA_R5_TEST_CONTEXTS 8
+
+static const char *const saraR5TestAnswer[] = {
+	"+CGDCONT: 1,\"IP\",\"payandgo.o2.co.uk.mnc010.mcc234.gprs\",\"10.160.182.234\",0,0,0,2,0,0,0,0,0,0",
+	"+CGDCONT: 2,\"IPV4V6\",\"ims\",\"10.64.12.8 32.1.13.184.0.0.0.0.0.0.0.0.0.0.0.1\",0,0,0,2,0,0,0,0,0,0",
+	"+CGDCONT: 3,\"IPV6\",\"v6.example\",\"32.1.13.184.0.0.0.0.0.0.0.0.0.0.0.2\",0,0,0,0",
+	"+CGDCONT: 7,\"IPV6\",\"colon.example\",\"2001:db8::7\",0,0",
+	"+CGDCONT: 12,\"IP\",\"\",\"\",0,0",
+};
+
+#define SARA_R5_TEST_LINES (sizeof(saraR5TestAnswer) / sizeof(saraR5TestAnswer[0]))
+
+static const uint8_t saraR5TestIpv6[16] = {0x20, 0x01, 0x0D, 0xB8};
+
+/**
+ * Feeds the answer to a parser, each line in pieces of 'piece' characters (0: whole lines).
+ */
+static size_t saraR5TestParse(SARA_R5_pdp_context *contexts, size_t maxContexts, uint8_t cid, size_t piece)
+{
+	SARA_R5_pdp_parser parser;
+
+	memset(contexts, 0xA5, maxContexts * sizeof(*contexts));
+	saraR5PdpParserInit(&parser, contexts, maxContexts, cid);
+	saraR5PdpParserFeed("", 0, true, &parser); // Empty line before the answer
+	for (size_t l = 0; l < SARA_R5_TEST_LINES; l++)
+	{
+		const char *line = saraR5TestAnswer[l];
+		size_t len = strlen(line);
+		size_t step = (piece == 0) ? len : piece;
+
+		for (size_t i = 0; i < len; i += step)
+		{
+			size_t n = (len - i < step) ? len - i : step;
+
+			saraR5PdpParserFeed(&line[i], n, i + n == len, &parser);
+		}
+	}
+	saraR5PdpParserFeed("OK", 2, true, &parser);
+	SARA_R5_CHECK_EQUAL(parser.found, SARA_R5_TEST_LINES);
+	return parser.count;
+}
+
+/**
+ * Checks the contexts of the whole answer.
+ */
+static void saraR5TestCheckAll(const SARA_R5_pdp_context *contexts)
+{
+	uint8_t ipv6[16];
+
+	// IPv4
+	SARA_R5_CHECK_EQUAL(contexts[0].cid, 1);
+	SARA_R5_CHECK_EQUAL(contexts[0].pdpType, PDP_TYPE_IP);
+	SARA_R5_CHECK(strcmp(contexts[0].apn, "payandgo.o2.co.uk.mnc010.mcc234.gprs") == 0);
+	SARA_R5_CHECK(contexts[0].hasIpv4 && !contexts[0].hasIpv6);
+	SARA_R5_CHECK(memcmp(contexts[0].ipv4, (const uint8_t[]){10, 160, 182, 234}, 4) == 0);
+	SARA_R5_CHECK_EQUAL(contexts[0].paramCount, SARA_R5_PDP_PARAMS);
+	SARA_R5_CHECK_EQUAL(contexts[0].params[3], 2);
+
+	// Dual-stack: both addresses in one field
+	memcpy(ipv6, saraR5TestIpv6, sizeof(ipv6));
+	ipv6[15] = 1;
+	SARA_R5_CHECK_EQUAL(contexts[1].cid, 2);
+	SARA_R5_CHECK_EQUAL(contexts[1].pdpType, PDP_TYPE_IPV4V6);
+	SARA_R5_CHECK(contexts[1].hasIpv4 && contexts[1].hasIpv6);
+	SARA_R5_CHECK(memcmp(contexts[1].ipv4, (const uint8_t[]){10, 64, 12, 8}, 4) == 0);
+	SARA_R5_CHECK(memcmp(contexts[1].ipv6, ipv6, sizeof(ipv6)) == 0);
+
+	// IPv6, dotted notation
+	ipv6[15] = 2;
+	SARA_R5_CHECK_EQUAL(contexts[2].cid, 3);
+	SARA_R5_CHECK_EQUAL(contexts[2].pdpType, PDP_TYPE_IPV6);
+	SARA_R5_CHECK(!contexts[2].hasIpv4 && contexts[2].hasIpv6);
+	SARA_R5_CHECK(memcmp(contexts[2].ipv6, ipv6, sizeof(ipv6)) == 0);
+	SARA_R5_CHECK_EQUAL(contexts[2].paramCount, 4);
+
+	// IPv6, colon notation with a gap, on a context past MAX_OPS
+	ipv6[15] = 7;
+	SARA_R5_CHECK_EQUAL(contexts[3].cid, 7);
+	SARA_R5_CHECK(!contexts[3].hasIpv4 && contexts[3].hasIpv6);
+	SARA_R5_CHECK(memcmp(contexts[3].ipv6, ipv6, sizeof(ipv6)) == 0);
+	SARA_R5_CHECK(strcmp(contexts[3].apn, "colon.example") == 0);
+
+	// No APN nor address
+	SARA_R5_CHECK_EQUAL(contexts[4].cid, 12);
+	SARA_R5_CHECK(!contexts[4].hasIpv4 && !contexts[4].hasIpv6);
+	SARA_R5_CHECK_EQUAL(contexts[4].apn[0], '\0');
+}
+
+int main(void)
+{
+	static SARA_R5_emulator emulator;
+	SARA_R5_transport transport;
+	SARA_R5_pdp_context contexts[SARA_R5_TEST_CONTEXTS];
+	char response[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+	myApn apn[MAX_APN];
+	Ip_adress ip[MAX_APN];
+	SARA_R5_pdp_type pdpType;
+
+	// Whole lines, then the same answer in pieces down to single characters
+	SARA_R5_CHECK_EQUAL(saraR5TestParse(contexts, SARA_R5_TEST_CONTEXTS, 0, 0), SARA_R5_TEST_LINES);
+	saraR5TestCheckAll(contexts);
+	for (size_t piece = 1; piece < 16; piece++)
+	{
+		SARA_R5_CHECK_EQUAL(saraR5TestParse(contexts, SARA_R5_TEST_CONTEXTS, 0, piece), SARA_R5_TEST_LINES);
+		saraR5TestCheckAll(contexts);
+	}
+
+	// More contexts than entries: the first ones are kept, every line is counted
+	SARA_R5_CHECK_EQUAL(saraR5TestParse(contexts, MAX_OPS, 0, 0), MAX_OPS);
+	SARA_R5_CHECK_EQUAL(contexts[MAX_OPS - 1].cid, MAX_OPS);
+
+	// A single context picked past MAX_OPS, and one the module does not report
+	SARA_R5_CHECK_EQUAL(saraR5TestParse(contexts, 1, 7, 0), 1);
+	SARA_R5_CHECK_EQUAL(contexts[0].cid, 7);
+	SARA_R5_CHECK(contexts[0].hasIpv6);
+	SARA_R5_CHECK_EQUAL(saraR5TestParse(contexts, 1, 12, 5), 1);
+	SARA_R5_CHECK_EQUAL(contexts[0].cid, 12);
+	SARA_R5_CHECK_EQUAL(saraR5TestParse(contexts, 1, 9, 0), 0);
+
+	// An APN longer than the entry is cut, in one piece or in several
+	for (size_t piece = 0; piece < 64; piece += 7)
+	{
+		SARA_R5_pdp_parser parser;
+		char apnText[201];
+		char line[300];
+		size_t len;
+
+		memset(apnText, 'a', sizeof(apnText) - 1);
+		apnText[sizeof(apnText) - 1] = '\0';
+		len = (size_t)snprintf(line, sizeof(line), "+CGDCONT: 4,\"IP\",\"%s\",\"10.0.0.4\",0", apnText);
+		saraR5PdpParserInit(&parser, contexts, 1, 0);
+		for (size_t i = 0; i < len; i += (piece == 0) ? len : piece)
+		{
+			size_t n = (piece == 0 || len - i < piece) ? len - i : piece;
+
+			saraR5PdpParserFeed(&line[i], n, i + n == len, &parser);
+		}
+		SARA_R5_CHECK_EQUAL(parser.count, 1);
+		SARA_R5_CHECK_EQUAL(strlen(contexts[0].apn), SIZE_APN - 1);
+		SARA_R5_CHECK(contexts[0].hasIpv4 && contexts[0].ipv4[3] == 4);
+	}
+
+	// saraR5GetAPN on the answer of the emulator
+	saraR5EmulatorInit(&emulator, &transport, NULL);
+	saraR5SetTransport(&transport);
+	SARA_R5_CHECK(saraR5Init(SARA_RESPONSE_OK, response));
+	SARA_R5_CHECK_EQUAL(saraR5GetAPN(2, apn, ip, &pdpType), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(pdpType, PDP_TYPE_IPV4V6);
+	SARA_R5_CHECK(strcmp(apn[0].apn, "ims") == 0);
+	SARA_R5_CHECK(ip[0].first_ip == 10 && ip[0].second_ip == 64 && ip[0].third_ip == 12 && ip[0].fourth_ip == 8);
+	SARA_R5_CHECK_EQUAL(saraR5GetAPN(0, apn, ip, &pdpType), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(pdpType, PDP_TYPE_IP);
+	SARA_R5_CHECK(strcmp(apn[1].apn, "ims") == 0);
+	SARA_R5_CHECK_EQUAL(apn[2].apn[0], '\0');
+	SARA_R5_CHECK_EQUAL(saraR5GetAPN(MAX_OPS + 6, apn, ip, &pdpType), SARA_R5_ERROR_NO_RESPONSE);
+	SARA_R5_CHECK_EQUAL(pdpType, PDP_TYPE_INVALID);
+
+	return saraR5TestSummary("test_pdp_parser");
+}
@@ -0,0 +1,100 @@
+/*
+ * test_ring_buffer.c
+ *
+ * The byte ring of Sara_R5_ring_buffer.c: writes, reads and peeks across the end of the storage, and the bytes
+ * dropped and counted once it is full. Then the reception ring of the library, fed with saraR5RxFeed over the
+ * loopback transport, whose virtual clock shows saraR5ReceiveDataUART returning after SARA_R5_RX_IDLE_TIME of
+ * silence rather than at its timeout.
+ */
+
+// INCLUDES
+#include "Sara_R5_test.h"
+#include "Sara_R5_transport_loopback.h"
+
+#define SARA_R5_TEST_RING_SIZE 8 // Holds 7 bytes
+
+int main(void)
+{
+	static uint8_t fed[SARA_R5_RX_RING_BUFFER_SIZE + 10];
+	static uint8_t received[SARA_R5_RX_RING_BUFFER_SIZE + 10];
+	uint8_t storage[SARA_R5_TEST_RING_SIZE];
+	uint8_t data[SARA_R5_TEST_RING_SIZE];
+	SARA_R5_ring_buffer ring;
+	SARA_R5_loopback_transport port;
+	SARA_R5_transport transport;
+	uint32_t start;
+
+	// Empty
+	saraR5RingBufferInit(&ring, storage, sizeof(storage));
+	SARA_R5_CHECK_EQUAL(saraR5RingBufferAvailable(&ring), 0);
+	SARA_R5_CHECK_EQUAL(saraR5RingBufferFree(&ring), SARA_R5_TEST_RING_SIZE - 1);
+	SARA_R5_CHECK_EQUAL(saraR5RingBufferRead(&ring, data, sizeof(data)), 0);
+
+	// Wraparound: 5 in, 3 out, then 5 more go across the end of the storage
+	SARA_R5_CHECK_EQUAL(saraR5RingBufferWrite(&ring, (const uint8_t *)"abcde", 5), 5);
+	SARA_R5_CHECK_EQUAL(saraR5RingBufferRead(&ring, data, 3), 3);
+	SARA_R5_CHECK(memcmp(data, "abc", 3) == 0);
+	SARA_R5_CHECK_EQUAL(saraR5RingBufferWrite(&ring, (const uint8_t *)"fghij", 5), 5);
+	SARA_R5_CHECK(ring.head < ring.tail);
+	SARA_R5_CHECK_EQUAL(saraR5RingBufferAvailable(&ring), 7);
+	SARA_R5_CHECK_EQUAL(saraR5RingBufferFree(&ring), 0);
+
+	// Full: the bytes that do not fit are dropped and counted
+	SARA_R5_CHECK_EQUAL(saraR5RingBufferWrite(&ring, (const uint8_t *)"kl", 2), 0);
+	SARA_R5_CHECK_EQUAL(ring.dropped, 2);
+
+	// Peek across the end leaves the bytes in place, read takes them in order
+	memset(data, 0, sizeof(data));
+	SARA_R5_CHECK_EQUAL(saraR5RingBufferPeek(&ring, data, sizeof(data)), 7);
+	SARA_R5_CHECK(memcmp(data, "defghij", 7) == 0);
+	SARA_R5_CHECK_EQUAL(saraR5RingBufferAvailable(&ring), 7);
+	SARA_R5_CHECK_EQUAL(saraR5RingBufferRead(&ring, NULL, 2), 2);
+	memset(data, 0, sizeof(data));
+	SARA_R5_CHECK_EQUAL(saraR5RingBufferRead(&ring, data, sizeof(data)), 5);
+	SARA_R5_CHECK(memcmp(data, "fghij", 5) == 0);
+	SARA_R5_CHECK_EQUAL(saraR5RingBufferAvailable(&ring), 0);
+
+	// A write partly taken
+	SARA_R5_CHECK_EQUAL(saraR5RingBufferWrite(&ring, (const uint8_t *)"0123456789", 10), 7);
+	SARA_R5_CHECK_EQUAL(ring.dropped, 5);
+	saraR5RingBufferClear(&ring);
+	SARA_R5_CHECK_EQUAL(saraR5RingBufferAvailable(&ring), 0);
+
+	// The reception ring of the library: an answer fed in one go ends after SARA_R5_RX_IDLE_TIME of silence
+	saraR5TransportLoopbackInit(&transport, &port, NULL, NULL);
+	saraR5SetTransport(&transport);
+	saraR5RxFlush();
+	saraR5RxFeed((const uint8_t *)"\r\nOK\r\n", 6);
+	SARA_R5_CHECK_EQUAL(saraR5RxAvailable(), 6);
+	start = saraR5NowMs();
+	SARA_R5_CHECK(saraR5ReceiveDataUART(received, sizeof(received), 1000));
+	SARA_R5_CHECK(strcmp((const char *)received, "\r\nOK\r\n") == 0);
+	SARA_R5_CHECK_EQUAL(saraR5NowMs() - start, SARA_R5_RX_IDLE_TIME);
+
+	// Nothing fed: false at the timeout
+	start = saraR5NowMs();
+	SARA_R5_CHECK(!saraR5ReceiveDataUART(received, sizeof(received), 100));
+	SARA_R5_CHECK_EQUAL(received[0], '\0');
+	SARA_R5_CHECK_EQUAL(saraR5NowMs() - start, 100);
+
+	// A buffer shorter than the bytes fed: the rest waits for the next call
+	saraR5RxFeed((const uint8_t *)"hello", 5);
+	SARA_R5_CHECK(saraR5ReceiveDataUART(received, 4, 1000));
+	SARA_R5_CHECK(strcmp((const char *)received, "hel") == 0);
+	SARA_R5_CHECK(saraR5ReceiveDataUART(received, sizeof(received), 1000));
+	SARA_R5_CHECK(strcmp((const char *)received, "lo") == 0);
+
+	// More than the ring holds: the first SARA_R5_RX_RING_BUFFER_SIZE - 1 bytes are kept
+	for (size_t i = 0; i < sizeof(fed); i++)
+	{
+		fed[i] = (uint8_t)('A' + i % 26);
+	}
+	saraR5RxFeed(fed, sizeof(fed));
+	SARA_R5_CHECK_EQUAL(saraR5RxAvailable(), SARA_R5_RX_RING_BUFFER_SIZE - 1);
+	SARA_R5_CHECK(saraR5ReceiveDataUART(received, sizeof(received), 1000));
+	SARA_R5_CHECK_EQUAL(strlen((const char *)received), SARA_R5_RX_RING_BUFFER_SIZE - 1);
+	SARA_R5_CHECK(memcmp(received, fed, SARA_R5_RX_RING_BUFFER_SIZE - 1) == 0);
+	SARA_R5_CHECK_EQUAL(saraR5RxAvailable(), 0);
+
+	return saraR5TestSummary("test_ring_buffer");
+}
@@ -0,0 +1,100 @@
+/*
+ * test_scan_abort.c
+ *
+ * The AT+COPS=? network scan against the module emulator, which answers after scanLatency: aborted with
+ * saraR5AbortCommand before the answer, ended by the operator callback in the middle of the list, and run to its
+ * end. The module takes the next AT command after each of them.
+ */
+
+// INCLUDES
+#include "Sara_R5_test.h"
+
+#define SARA_R5_TEST_SCAN_MS 4000 // Scan of the emulator
+#define SARA_R5_TEST_OPERATORS 7  // Operators it finds
+
+static SARA_R5_emulator emulator;
+static SARA_R5_transport transport;
+
+// Operator callback state: the operators seen, and the one that ends the scan
+typedef struct
+{
+	int count;
+	const char *last;
+} SARA_R5_test_scan;
+
+/**
+ * Counts the operators, and ends the scan at the one named 'last'.
+ */
+static bool saraR5TestOperator(const SARA_R5_operator_stats *op, void *context)
+{
+	SARA_R5_test_scan *scan = (SARA_R5_test_scan *)context;
+
+	scan->count++;
+	return scan->last == NULL || strcmp(op->shortOp, scan->last) != 0;
+}
+
+/**
+ * Checks that the module answers a plain AT after the scan.
+ */
+static void saraR5TestNextAt(void)
+{
+	char response[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+
+	SARA_R5_CHECK(saraR5SendCommandWithResponse(SARA_R5_COMMAND_AT, SARA_RESPONSE_OK, response, sizeof(response), SARA_R5_STANDARD_RESPONSE_TIMEOUT));
+}
+
+int main(void)
+{
+	SARA_R5_emulator_config config;
+	SARA_R5_operator_parser parser;
+	SARA_R5_command_result result = {false, SARA_R5_ERROR_NO_RESPONSE, SARA_R5_AT_RESULT_NONE, -1};
+	SARA_R5_test_scan scan = {0, NULL};
+	char response[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+	uint32_t start;
+
+	saraR5EmulatorDefaultConfig(&config);
+	config.scanLatency = (SARA_R5_emulator_latency){SARA_R5_TEST_SCAN_MS, SARA_R5_TEST_SCAN_MS};
+	saraR5EmulatorInit(&emulator, &transport, &config);
+	saraR5SetTransport(&transport);
+	SARA_R5_CHECK(saraR5Init(SARA_RESPONSE_OK, response));
+
+	// Aborted half way through the scan: ABORTED long before the list is due
+	start = saraR5NowMs();
+	SARA_R5_CHECK_EQUAL(saraR5ScanOperatorsAsync(&parser, saraR5TestOperator, &scan, saraR5StoreResult, &result), SARA_R5_ERROR_SUCCESS);
+	while (saraR5NowMs() - start < SARA_R5_TEST_SCAN_MS / 2)
+	{
+		saraR5Poll();
+		transport.wait(transport.context, 50);
+	}
+	SARA_R5_CHECK(emulator.scanDueUs != 0);
+	SARA_R5_CHECK(saraR5AbortCommand());
+	for (; saraR5NowMs() - start < 2 * SARA_R5_TEST_SCAN_MS && !result.done;)
+	{
+		saraR5Poll();
+		transport.wait(transport.context, 50);
+	}
+	SARA_R5_CHECK(result.done);
+	SARA_R5_CHECK_EQUAL(result.error, SARA_R5_ERROR_ERROR);
+	SARA_R5_CHECK_EQUAL(result.result, SARA_R5_AT_RESULT_ABORTED);
+	SARA_R5_CHECK(saraR5NowMs() - start < SARA_R5_TEST_SCAN_MS);
+	SARA_R5_CHECK_EQUAL(emulator.scanDueUs, 0);
+	SARA_R5_CHECK_EQUAL(scan.count, 0);
+	SARA_R5_CHECK(!parser.stopped);
+	saraR5TestNextAt();
+
+	// Ended by the callback at the fourth operator: the rest of the list is not handed over
+	scan = (SARA_R5_test_scan){0, "RP1"};
+	start = saraR5NowMs();
+	SARA_R5_CHECK_EQUAL(saraR5ScanOperators(saraR5TestOperator, &scan), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(scan.count, 4);
+	SARA_R5_CHECK(saraR5NowMs() - start >= SARA_R5_TEST_SCAN_MS);
+	saraR5TestNextAt();
+
+	// Run to its end: every operator, none of the supported values that follow the list
+	scan = (SARA_R5_test_scan){0, NULL};
+	SARA_R5_CHECK_EQUAL(saraR5ScanOperators(saraR5TestOperator, &scan), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(scan.count, SARA_R5_TEST_OPERATORS);
+	saraR5TestNextAt();
+
+	return saraR5TestSummary("test_scan_abort");
+}
@@ -0,0 +1,152 @@
+/*
+ * test_schema.c
+ *
+ * Edge cases of the schema parser: integers at the limits of members of 1, 2, 4 and 8 bytes, an odd number of hex
+ * digits, a line cut in a quoted field, a missing field, more matching lines than records, and lines fed in pieces.
+ */
+
+// INCLUDES
+#include "Sara_R5_test.h"
+
+typedef struct
+{
+  uint8_t u8;
+  uint16_t u16;
+  uint32_t u32;
+  uint64_t u64;
+} SARA_R5_test_ints;
+
+typedef struct
+{
+  int id;
+  char name[8];
+  uint8_t ip[4];
+  uint8_t bytes[4];
+  size_t length;
+} SARA_R5_test_record;
+
+static const SARA_R5_field saraR5TestIntFields[] = {
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_test_ints, u8),
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_test_ints, u16),
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_test_ints, u32),
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_test_ints, u64),
+};
+static const SARA_R5_response_schema saraR5TestIntSchema = SARA_R5_SCHEMA("+INT:", SARA_R5_test_ints, saraR5TestIntFields);
+
+static const SARA_R5_field saraR5TestRecordFields[] = {
+	SARA_R5_FIELD(SARA_R5_FIELD_INT, SARA_R5_test_record, id),
+	SARA_R5_FIELD(SARA_R5_FIELD_STRING, SARA_R5_test_record, name),
+	SARA_R5_FIELD(SARA_R5_FIELD_IP, SARA_R5_test_record, ip),
+	SARA_R5_FIELD_BYTES(SARA_R5_test_record, bytes, length),
+};
+static const SARA_R5_response_schema saraR5TestRecordSchema = SARA_R5_SCHEMA("+REC:", SARA_R5_test_record, saraR5TestRecordFields);
+
+// Line of integers, and whether it fits the members
+typedef struct
+{
+  const char *line;
+  bool kept;
+} SARA_R5_test_int_case;
+
+static const SARA_R5_test_int_case saraR5TestIntCases[] = {
+	{"+INT: 255,65535,4294967295,18446744073709551615", true},
+	{"+INT: -128,-32768,-2147483648,-9223372036854775808", true},
+	{"+INT: 256,0,0,0", false},
+	{"+INT: -129,0,0,0", false},
+	{"+INT: 0,65536,0,0", false},
+	{"+INT: 0,-32769,0,0", false},
+	{"+INT: 0,0,4294967296,0", false},
+	{"+INT: 0,0,-2147483649,0", false},
+	{"+INT: 0,0,0,18446744073709551616", false},
+	{"+INT: 0,0,0,-9223372036854775809", false},
+	{"+INT: 0,0,0,99999999999999999999999999", false},
+	{"+INT: 0,0,0,-", false},
+	{"+INT: 0,0,0,1-2", false},
+	{"+INT: 0,0,0,", false},
+};
+
+#define SARA_R5_TEST_INT_CASES (sizeof(saraR5TestIntCases) / sizeof(saraR5TestIntCases[0]))
+
+/**
+ * Parses one line fed in pieces of 'piece' characters, the last one ending the line.
+ */
+static size_t saraR5TestFeed(const SARA_R5_response_schema *schema, const char *line, size_t piece, void *records, size_t maxRecords)
+{
+	SARA_R5_schema_parser parser;
+	size_t len = strlen(line);
+
+	saraR5SchemaParserInit(&parser, schema, records, maxRecords);
+	for (size_t i = 0; i < len; i += piece)
+	{
+		size_t n = (len - i < piece) ? len - i : piece;
+
+		saraR5SchemaParserFeed(&line[i], n, i + n == len, &parser);
+	}
+	return parser.count;
+}
+
+int main(void)
+{
+	SARA_R5_test_ints ints;
+	SARA_R5_test_record records[3];
+
+	// Integers at the limits, whole lines and one character at a time
+	for (size_t c = 0; c < SARA_R5_TEST_INT_CASES; c++)
+	{
+		const SARA_R5_test_int_case *test = &saraR5TestIntCases[c];
+
+		SARA_R5_CHECK_EQUAL(saraR5SchemaParse(&saraR5TestIntSchema, test->line, strlen(test->line), &ints, 1), test->kept ? 1 : 0);
+		SARA_R5_CHECK_EQUAL(saraR5TestFeed(&saraR5TestIntSchema, test->line, 1, &ints, 1), test->kept ? 1 : 0);
+	}
+	saraR5TestFeed(&saraR5TestIntSchema, saraR5TestIntCases[0].line, 3, &ints, 1);
+	SARA_R5_CHECK(ints.u8 == UINT8_MAX && ints.u16 == UINT16_MAX && ints.u32 == UINT32_MAX && ints.u64 == UINT64_MAX);
+	saraR5TestFeed(&saraR5TestIntSchema, saraR5TestIntCases[1].line, 5, &ints, 1);
+	SARA_R5_CHECK_EQUAL((int8_t)ints.u8, INT8_MIN);
+	SARA_R5_CHECK_EQUAL((int16_t)ints.u16, INT16_MIN);
+	SARA_R5_CHECK_EQUAL((int32_t)ints.u32, INT32_MIN);
+	SARA_R5_CHECK((int64_t)ints.u64 == INT64_MIN);
+
+	// A well formed record, the string cut to its member, the hex digits quoted or bare
+	SARA_R5_CHECK_EQUAL(saraR5TestFeed(&saraR5TestRecordSchema, "+REC: 7,\"a, long name\",10.64.12.7,\"0aFf\"", 64, records, 1), 1);
+	SARA_R5_CHECK_EQUAL(records[0].id, 7);
+	SARA_R5_CHECK(strcmp(records[0].name, "a, long") == 0);
+	SARA_R5_CHECK(memcmp(records[0].ip, (const uint8_t[]){10, 64, 12, 7}, 4) == 0);
+	SARA_R5_CHECK_EQUAL(records[0].length, 2);
+	SARA_R5_CHECK(records[0].bytes[0] == 0x0A && records[0].bytes[1] == 0xFF);
+	SARA_R5_CHECK_EQUAL(saraR5TestFeed(&saraR5TestRecordSchema, "+REC: 1,x,1.2.3.4,01020304,extra", 1, records, 1), 1);
+	SARA_R5_CHECK_EQUAL(records[0].length, 4);
+
+	// Odd number of hex digits, more bytes than the member, a digit that is not hex
+	SARA_R5_CHECK_EQUAL(saraR5TestFeed(&saraR5TestRecordSchema, "+REC: 1,x,1.2.3.4,\"0aF\"", 2, records, 1), 0);
+	SARA_R5_CHECK_EQUAL(saraR5TestFeed(&saraR5TestRecordSchema, "+REC: 1,x,1.2.3.4,0102030405", 4, records, 1), 0);
+	SARA_R5_CHECK_EQUAL(saraR5TestFeed(&saraR5TestRecordSchema, "+REC: 1,x,1.2.3.4,0g", 64, records, 1), 0);
+
+	// Cut in a quoted field, a missing field, a short or out of range address
+	SARA_R5_CHECK_EQUAL(saraR5TestFeed(&saraR5TestRecordSchema, "+REC: 1,x,1.2.3.4,\"0102", 1, records, 1), 0);
+	SARA_R5_CHECK_EQUAL(saraR5TestFeed(&saraR5TestRecordSchema, "+REC: 1,\"x,1.2.3.4,0102", 64, records, 1), 0);
+	SARA_R5_CHECK_EQUAL(saraR5TestFeed(&saraR5TestRecordSchema, "+REC: 1,x,1.2.3.4", 64, records, 1), 0);
+	SARA_R5_CHECK_EQUAL(saraR5TestFeed(&saraR5TestRecordSchema, "+REC: 1,x,1.2.3,01", 64, records, 1), 0);
+	SARA_R5_CHECK_EQUAL(saraR5TestFeed(&saraR5TestRecordSchema, "+REC: 1,x,1.2.3.256,01", 64, records, 1), 0);
+	SARA_R5_CHECK_EQUAL(saraR5TestFeed(&saraR5TestRecordSchema, "+REC: 1,x,1.2.3.4.5,01", 64, records, 1), 0);
+
+	// Records full: the lines past the last record are skipped, the next entry is left alone
+	{
+		static const char answer[] = "+REC: 1,a,1.1.1.1,01\r\n+OTHER: 9\r\n+REC: 2,b,2.2.2.2,02\r\n+REC: 3,c,3.3.3.3,03\r\nOK\r\n";
+
+		memset(records, 0xA5, sizeof(records));
+		SARA_R5_CHECK_EQUAL(saraR5SchemaParse(&saraR5TestRecordSchema, answer, sizeof(answer) - 1, records, 2), 2);
+		SARA_R5_CHECK(records[0].id == 1 && records[1].id == 2);
+		SARA_R5_CHECK_EQUAL(records[2].name[0], (char)0xA5);
+		SARA_R5_CHECK_EQUAL(saraR5SchemaParse(&saraR5TestRecordSchema, answer, sizeof(answer) - 1, records, 0), 0);
+	}
+
+	// A malformed line does not take a record, the next one gets it
+	{
+		static const char answer[] = "+REC: 1,a,1.1.1,01\r\n+REC: 2,b,2.2.2.2,02\r\n";
+
+		SARA_R5_CHECK_EQUAL(saraR5SchemaParse(&saraR5TestRecordSchema, answer, sizeof(answer) - 1, records, 1), 1);
+		SARA_R5_CHECK_EQUAL(records[0].id, 2);
+	}
+
+	return saraR5TestSummary("test_schema");
+}
@@ -0,0 +1,144 @@
+/*
+ * test_security.c
+ *
+ * TLS security profiles against the module emulator: the AT+USECPRF lines of saraR5SecurityProfileSet, the cipher
+ * suite as its IANA number, and the full and resumed handshakes counted and timed by saraR5SecurityGetStats for
+ * secure sockets (AT+USOSEC) and for the secure MQTT login (+UUMQTTC).
+ */
+
+// INCLUDES
+#include "Sara_R5_test.h"
+
+#define SARA_R5_TEST_FULL_MS 2000    // Full handshake of the emulator
+#define SARA_R5_TEST_RESUMED_MS 400  // Resumed handshake
+#define SARA_R5_TEST_SLACK_MS 100    // Command latencies and line time around a handshake
+#define SARA_R5_TEST_SOCKET_PROFILE 1
+#define SARA_R5_TEST_MQTT_PROFILE 2
+
+static SARA_R5_emulator emulator;
+static SARA_R5_transport transport;
+
+/**
+ * Opens a TCP socket on a security profile and connects it, which runs a handshake, then closes it.
+ */
+static void saraR5TestSecureSocket(int profile)
+{
+	int socket = saraR5SocketOpen(SARA_R5_TCP, 0);
+	char expected[32];
+
+	SARA_R5_CHECK(socket >= 0);
+	saraR5TestClear();
+	SARA_R5_CHECK_EQUAL(saraR5SocketSetSecurity(socket, profile), SARA_R5_ERROR_SUCCESS);
+	snprintf(expected, sizeof(expected), "AT+USOSEC=%d,1,%d\r", socket, profile);
+	SARA_R5_CHECK(strstr(saraR5TestLine, expected) != NULL);
+	SARA_R5_CHECK_EQUAL(saraR5SocketConnect2(socket, "192.0.2.50", 443, NULL, 0), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(saraR5socketClose(socket, SARA_R5_STANDARD_RESPONSE_TIMEOUT, NULL, 0), SARA_R5_ERROR_SUCCESS);
+}
+
+/**
+ * Logs the MQTT client in, polls until the +UUMQTTC of the handshake is counted, then logs it out.
+ */
+static void saraR5TestMqttLogin(void)
+{
+	char response[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+	SARA_R5_security_stats before;
+	SARA_R5_security_stats stats;
+
+	saraR5SecurityGetStats(SARA_R5_TEST_MQTT_PROFILE, &before);
+	SARA_R5_CHECK_EQUAL(saraR5MQTTconect(response, sizeof(response)), SARA_R5_ERROR_SUCCESS);
+	stats = before;
+	for (uint32_t start = saraR5NowMs(); saraR5NowMs() - start < 10000 && stats.fullHandshakes + stats.resumedHandshakes == before.fullHandshakes + before.resumedHandshakes;)
+	{
+		saraR5Poll();
+		transport.wait(transport.context, 50);
+		saraR5SecurityGetStats(SARA_R5_TEST_MQTT_PROFILE, &stats);
+	}
+	SARA_R5_CHECK_EQUAL(stats.fullHandshakes + stats.resumedHandshakes, before.fullHandshakes + before.resumedHandshakes + 1);
+	SARA_R5_CHECK_EQUAL(saraR5MQTTdisconnect(response, sizeof(response)), SARA_R5_ERROR_SUCCESS);
+}
+
+int main(void)
+{
+	static const SARA_R5_security_profile settings = {
+		.validation = 3,
+		.tlsVersion = 3,
+		.cipherSuite = 0xC02F,
+		.rootCa = "root.pem",
+		.hostname = "broker.example.com",
+		.sni = "broker.example.com",
+		.sessionResumption = true,
+	};
+	SARA_R5_emulator_config config;
+	SARA_R5_security_stats stats;
+	char response[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+
+	// Fixed handshake times, so the averages can be checked
+	saraR5EmulatorDefaultConfig(&config);
+	config.handshakeLatency = (SARA_R5_emulator_latency){SARA_R5_TEST_FULL_MS, SARA_R5_TEST_FULL_MS};
+	config.resumedLatency = (SARA_R5_emulator_latency){SARA_R5_TEST_RESUMED_MS, SARA_R5_TEST_RESUMED_MS};
+	config.urcLatency = (SARA_R5_emulator_latency){20, 20};
+	saraR5EmulatorInit(&emulator, &transport, &config);
+	saraR5TestCapture(&transport);
+	saraR5SetTransport(&transport);
+	SARA_R5_CHECK(saraR5Init(SARA_RESPONSE_OK, response));
+
+	// The profile is reset, then every parameter set goes in its own AT+USECPRF
+	SARA_R5_CHECK_EQUAL(saraR5SecurityProfileSet(SARA_R5_SECURITY_PROFILES, &settings), SARA_R5_ERROR_UNEXPECTED_PARAM);
+	saraR5TestClear();
+	SARA_R5_CHECK_EQUAL(saraR5SecurityProfileSet(SARA_R5_TEST_SOCKET_PROFILE, &settings), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK(strcmp(saraR5TestLine,
+						 "AT+USECPRF=1\r"
+						 "AT+USECPRF=1,0,3\r"
+						 "AT+USECPRF=1,1,3\r"
+						 "AT+USECPRF=1,2,99,\"C0;2F\"\r"
+						 "AT+USECPRF=1,3,\"root.pem\"\r"
+						 "AT+USECPRF=1,4,\"broker.example.com\"\r"
+						 "AT+USECPRF=1,10,\"broker.example.com\"\r"
+						 "AT+USECPRF=1,13,1\r") == 0);
+	SARA_R5_CHECK(emulator.tlsResumption[SARA_R5_TEST_SOCKET_PROFILE]);
+
+	// Sockets: the first connection runs a full handshake, the next ones resume its session
+	for (int i = 0; i < 3; i++)
+	{
+		saraR5TestSecureSocket(SARA_R5_TEST_SOCKET_PROFILE);
+	}
+	SARA_R5_CHECK_EQUAL(saraR5SecurityGetStats(SARA_R5_TEST_SOCKET_PROFILE, &stats), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(stats.fullHandshakes, 1);
+	SARA_R5_CHECK_EQUAL(stats.resumedHandshakes, 2);
+	SARA_R5_CHECK_EQUAL(stats.failures, 0);
+	SARA_R5_CHECK(stats.fullAverageMs >= SARA_R5_TEST_FULL_MS && stats.fullAverageMs < SARA_R5_TEST_FULL_MS + SARA_R5_TEST_SLACK_MS);
+	SARA_R5_CHECK(stats.resumedAverageMs >= SARA_R5_TEST_RESUMED_MS && stats.resumedAverageMs < SARA_R5_TEST_RESUMED_MS + SARA_R5_TEST_SLACK_MS);
+	SARA_R5_CHECK_EQUAL(stats.resumedAverageMs, stats.resumedMs / 2);
+	SARA_R5_CHECK_EQUAL(emulator.stats.tlsHandshakes, 3);
+	SARA_R5_CHECK_EQUAL(emulator.stats.tlsResumed, 2);
+
+	// MQTT without session resumption: every login is a full handshake, timed up to its +UUMQTTC
+	SARA_R5_CHECK_EQUAL(saraR5SecurityProfileSet(SARA_R5_TEST_MQTT_PROFILE, &(SARA_R5_security_profile){.validation = 1, .rootCa = "root.pem"}), SARA_R5_ERROR_SUCCESS);
+	saraR5TestClear();
+	SARA_R5_CHECK_EQUAL(saraR5SetMQTTsecurity(SARA_R5_TEST_MQTT_PROFILE, response, sizeof(response)), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+UMQTT=11,1,2\r") != NULL);
+	saraR5TestMqttLogin();
+	saraR5TestMqttLogin();
+	SARA_R5_CHECK_EQUAL(saraR5SecurityGetStats(SARA_R5_TEST_MQTT_PROFILE, &stats), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(stats.fullHandshakes, 2);
+	SARA_R5_CHECK_EQUAL(stats.resumedHandshakes, 0);
+	SARA_R5_CHECK(stats.fullAverageMs >= SARA_R5_TEST_FULL_MS && stats.fullAverageMs < SARA_R5_TEST_FULL_MS + 2 * SARA_R5_TEST_SLACK_MS);
+
+	// With session resumption: the second login resumes the session of the first
+	SARA_R5_CHECK_EQUAL(saraR5SecurityProfileSet(SARA_R5_TEST_MQTT_PROFILE, &settings), SARA_R5_ERROR_SUCCESS);
+	saraR5TestMqttLogin();
+	saraR5TestMqttLogin();
+	SARA_R5_CHECK_EQUAL(saraR5SecurityGetStats(SARA_R5_TEST_MQTT_PROFILE, &stats), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(stats.fullHandshakes, 3);
+	SARA_R5_CHECK_EQUAL(stats.resumedHandshakes, 1);
+	SARA_R5_CHECK(stats.resumedAverageMs >= SARA_R5_TEST_RESUMED_MS && stats.resumedAverageMs < SARA_R5_TEST_RESUMED_MS + 2 * SARA_R5_TEST_SLACK_MS);
+	SARA_R5_CHECK(stats.lastMs == stats.resumedMs);
+
+	// Back to plain MQTT: no handshake to count
+	saraR5TestClear();
+	SARA_R5_CHECK_EQUAL(saraR5SetMQTTsecurity(SARA_R5_SECURITY_NONE, response, sizeof(response)), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+UMQTT=11,0\r") != NULL);
+	SARA_R5_CHECK_EQUAL(saraR5SecurityGetStats(SARA_R5_SECURITY_PROFILES, &stats), SARA_R5_ERROR_UNEXPECTED_PARAM);
+
+	return saraR5TestSummary("test_security");
+}
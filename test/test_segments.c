@@ -0,0 +1,101 @@
+/*
+ * test_segments.c
+ *
+ * String parameters longer than the stack buffers of the commands, and full of characters to escape, against
+ * the module emulator: the escaped copies are sized from the strings, and a queued command longer than
+ * SARA_R5_COMMAND_LINE_SIZE is copied to the heap, or refused by a SARA_R5_NO_HEAP build. The line sent is checked
+ * byte for byte.
+ */
+
+// INCLUDES
+#include "Sara_R5_test.h"
+
+
+static SARA_R5_emulator emulator;
+static SARA_R5_transport transport;
+
+// Outcome of an asynchronous command
+typedef struct
+{
+  bool done;
+  uint8_t error;
+} SARA_R5_test_outcome;
+
+static void saraR5TestDone(uint8_t error, SARA_R5_at_result_t result, int errorCode, const char *response, void *context)
+{
+	SARA_R5_test_outcome *outcome = (SARA_R5_test_outcome *)context;
+
+	(void)result;
+	(void)errorCode;
+	(void)response;
+	outcome->done = true;
+	outcome->error = error;
+}
+
+int main(void)
+{
+	// 59 bytes of JSON, 12 quotes: 83 bytes once escaped
+	static const char json[] = "{\"device\":\"sara-r5\",\"temp\":21,\"hum\":480,\"status\":\"running\"}";
+	static const char jsonEscaped[] = "{\\22device\\22:\\22sara-r5\\22,\\22temp\\22:21,\\22hum\\22:480,\\22status\\22:\\22running\\22}";
+	char response[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+	char expected[SARA_R5_TEST_LINE_SIZE];
+	char longText[201];
+	SARA_R5_test_outcome outcome = {false, 0xFF};
+
+	saraR5EmulatorInit(&emulator, &transport, NULL);
+	saraR5TestCapture(&transport);
+	saraR5SetTransport(&transport);
+	SARA_R5_CHECK(saraR5Init(SARA_RESPONSE_OK, response));
+	SARA_R5_CHECK_EQUAL(sizeof(json) - 1, 59);
+
+	// A queued client ID whose command does not fit the queue storage
+	memset(longText, 'c', 150);
+	memcpy(longText, "\"id\"", 4);
+	longText[150] = '\0';
+	saraR5TestClear();
+	snprintf(expected, sizeof(expected), "AT+UMQTT=0,\"\\22id\\22%s\"\r", &longText[4]);
+	SARA_R5_CHECK(strlen(expected) > SARA_R5_COMMAND_LINE_SIZE);
+#ifdef SARA_R5_NO_HEAP
+	// Without a heap the copy has nowhere to go: the command is refused, nothing is sent
+	SARA_R5_CHECK_EQUAL(saraR5SetMQTTclientIdAsync(longText, response, sizeof(response), saraR5TestDone, &outcome), SARA_R5_ERROR_UNEXPECTED_PARAM);
+	while (saraR5Poll())
+	{
+		transport.wait(transport.context, 10);
+	}
+	SARA_R5_CHECK(!outcome.done);
+	SARA_R5_CHECK_EQUAL(saraR5TestLineLength, 0);
+#else
+	SARA_R5_CHECK_EQUAL(saraR5SetMQTTclientIdAsync(longText, response, sizeof(response), saraR5TestDone, &outcome), SARA_R5_ERROR_SUCCESS);
+	while (saraR5Poll())
+	{
+		transport.wait(transport.context, 10);
+	}
+	SARA_R5_CHECK(outcome.done);
+	SARA_R5_CHECK_EQUAL(outcome.error, SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK(strcmp(saraR5TestLine, expected) == 0);
+#endif
+
+	// Publishing and subscribing need the login
+	SARA_R5_CHECK_EQUAL(saraR5MQTTconect(response, sizeof(response)), SARA_R5_ERROR_SUCCESS);
+
+	// A JSON message with its quotes
+	saraR5TestClear();
+	SARA_R5_CHECK_EQUAL(saraR5PublishMQTT("sensors/room \"A\"", 16, response, sizeof(response), 0, 0, 0, (const uint8_t *)json, sizeof(json) - 1), SARA_R5_ERROR_SUCCESS);
+	snprintf(expected, sizeof(expected), "AT+UMQTTC=2,0,0,0,\"sensors/room \\22A\\22\",\"%s\"\r", jsonEscaped);
+	SARA_R5_CHECK(strcmp(saraR5TestLine, expected) == 0);
+
+	// 200 quotes, three times as long once escaped
+	memset(longText, '"', sizeof(longText) - 1);
+	longText[sizeof(longText) - 1] = '\0';
+	saraR5TestClear();
+	SARA_R5_CHECK_EQUAL(saraR5PublishMQTT("t", 1, response, sizeof(response), 0, 0, 0, (const uint8_t *)longText, strlen(longText)), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(saraR5TestLineLength, strlen("AT+UMQTTC=2,0,0,0,\"t\",\"\"\r") + 3 * strlen(longText));
+
+	// An APN and a subscription topic past the old 64 byte cap
+	saraR5TestClear();
+	SARA_R5_CHECK_EQUAL(saraR5SetAPN(1, PDP_TYPE_IP, "internet.operator\\corporate.example.mnc001.mcc999.gprs.long", response, sizeof(response)), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK(strcmp(saraR5TestLine, "AT+CGDCONT=1,\"IP\",\"internet.operator\\5Ccorporate.example.mnc001.mcc999.gprs.long\"\r") == 0);
+	SARA_R5_CHECK_EQUAL(saraR5SubscribeMQTTtopic(1, "building/\"north wing\"/floor 3/room 301/sensors/temperature/#"), SARA_R5_ERROR_SUCCESS);
+
+	return saraR5TestSummary("test_segments");
+}
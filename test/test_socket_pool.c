@@ -0,0 +1,103 @@
+/*
+ * test_socket_pool.c
+ *
+ * The socket pool of saraR5SocketAcquire against the module emulator: an idle socket is reused for its endpoint,
+ * the oldest idle one is closed when every ID is taken, and a socket the remote end closed (+UUSOCL) is connected
+ * again with its ID, or replaced by a new socket when the module freed the ID.
+ */
+
+// INCLUDES
+#include "Sara_R5_test.h"
+
+#define SARA_R5_TEST_PORT 7000
+
+static SARA_R5_emulator emulator;
+static SARA_R5_transport transport;
+
+/**
+ * Acquires a TCP socket to 192.0.2.<host>, and gives it back to the pool at once.
+ * @return The socket ID, -1 on error.
+ */
+static int saraR5TestUse(int host)
+{
+	char address[SARA_R5_SOCKET_ADDRESS_SIZE];
+	int socket = -1;
+
+	snprintf(address, sizeof(address), "192.0.2.%d", host);
+	saraR5TestClear();
+	SARA_R5_CHECK_EQUAL(saraR5SocketAcquire(SARA_R5_TCP, address, SARA_R5_TEST_PORT, &socket), SARA_R5_ERROR_SUCCESS);
+	saraR5SocketRelease(socket);
+	return socket;
+}
+
+/**
+ * Makes the remote end close a socket, and polls until the library has seen the +UUSOCL.
+ */
+static void saraR5TestRemoteClose(int socket)
+{
+	SARA_R5_CHECK(saraR5EmulatorSocketClose(&emulator, socket, 10));
+	for (uint32_t start = saraR5NowMs(); saraR5NowMs() - start < 5000 && saraR5SocketGetSlot(socket)->state != SARA_R5_SOCKET_CLOSED;)
+	{
+		saraR5Poll();
+		transport.wait(transport.context, 50);
+	}
+	SARA_R5_CHECK_EQUAL(saraR5SocketGetSlot(socket)->state, SARA_R5_SOCKET_CLOSED);
+}
+
+int main(void)
+{
+	char response[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+	int sockets[SARA_R5_NUM_SOCKETS];
+	int socket;
+
+	saraR5EmulatorInit(&emulator, &transport, NULL);
+	saraR5TestCapture(&transport);
+	saraR5SetTransport(&transport);
+	SARA_R5_CHECK(saraR5Init(SARA_RESPONSE_OK, response));
+
+	// Reuse: the second acquire of an endpoint sends nothing
+	socket = saraR5TestUse(1);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+USOCR=6") != NULL && strstr(saraR5TestLine, "AT+USOCO=") != NULL);
+	SARA_R5_CHECK_EQUAL(saraR5TestUse(1), socket);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+USOCR") == NULL && strstr(saraR5TestLine, "AT+USOCO") == NULL);
+
+	// Eviction: with every ID taken, the idle socket unused for the longest time makes room
+	for (int i = 1; i < SARA_R5_NUM_SOCKETS; i++)
+	{
+		sockets[i] = saraR5TestUse(1 + i);
+		SARA_R5_CHECK(sockets[i] >= 0 && sockets[i] != socket);
+	}
+	SARA_R5_CHECK_EQUAL(saraR5TestUse(1), socket); // The first endpoint is now the most recent
+	SARA_R5_CHECK_EQUAL(saraR5TestUse(1 + SARA_R5_NUM_SOCKETS), sockets[1]);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+USOCL=") != NULL);
+	SARA_R5_CHECK(strcmp(saraR5SocketGetSlot(sockets[1])->address, "192.0.2.7") == 0);
+
+	// Every socket held: no room
+	for (int i = 0; i < SARA_R5_NUM_SOCKETS; i++)
+	{
+		SARA_R5_CHECK_EQUAL(saraR5SocketAcquire(SARA_R5_TCP, saraR5SocketGetSlot(i)->address, SARA_R5_TEST_PORT, &sockets[i]), SARA_R5_ERROR_SUCCESS);
+	}
+	SARA_R5_CHECK_EQUAL(saraR5SocketAcquire(SARA_R5_TCP, "192.0.2.99", SARA_R5_TEST_PORT, &socket), SARA_R5_ERROR_OUT_OF_MEMORY);
+	for (int i = 0; i < SARA_R5_NUM_SOCKETS; i++)
+	{
+		saraR5SocketRelease(sockets[i]);
+	}
+
+	// Closed by the remote end, the module keeps the ID: AT+USOCO on the same socket, no AT+USOCR
+	emulator.config.closeKeepsId = true;
+	saraR5TestRemoteClose(2);
+	SARA_R5_CHECK_EQUAL(saraR5TestUse(3), 2);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+USOCO=2,") != NULL && strstr(saraR5TestLine, "AT+USOCR") == NULL);
+	SARA_R5_CHECK_EQUAL(saraR5SocketGetSlot(2)->state, SARA_R5_SOCKET_CONNECTED);
+	SARA_R5_CHECK(emulator.socketConnected[2]);
+
+	// The module freed the ID: AT+USOCO fails, AT+USOCR gets the ID back for a new socket
+	emulator.config.closeKeepsId = false;
+	saraR5TestRemoteClose(2);
+	SARA_R5_CHECK_EQUAL(saraR5TestUse(3), 2);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+USOCR=6") != NULL);
+	SARA_R5_CHECK_EQUAL(saraR5SocketGetSlot(2)->state, SARA_R5_SOCKET_CONNECTED);
+	SARA_R5_CHECK(emulator.socketOpen[2] && emulator.socketConnected[2]);
+
+	return saraR5TestSummary("test_socket_pool");
+}
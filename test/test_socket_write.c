@@ -0,0 +1,119 @@
+/*
+ * test_socket_write.c
+ *
+ * saraR5SocketWrite against the module emulator: a write longer than SARA_R5_SOCKET_MAX_WRITE is split into
+ * AT+USOWR chunks, the call waits on AT+USOCTL once SARA_R5_SOCKET_MAX_UNACKED bytes may be in flight, stops when
+ * the module takes no byte of a chunk, and gives up after SARA_R5_SOCKET_FLOW_TIMEOUT without acknowledgements.
+ */
+
+// INCLUDES
+#include "Sara_R5_test.h"
+
+#define SARA_R5_TEST_LENGTH 20000
+
+static SARA_R5_emulator emulator;
+static SARA_R5_transport transport;
+static bool (*saraR5TestEmulatorWrite)(void *context, const uint8_t *data, size_t len);
+static unsigned saraR5TestWrites;  // AT+USOWR sent
+static unsigned saraR5TestQueries; // AT+USOCTL sent
+
+/**
+ * Counts the AT+USOWR and AT+USOCTL commands, then hands the bytes to the emulator.
+ */
+static bool saraR5TestCount(void *context, const uint8_t *data, size_t len)
+{
+	if (len >= 9 && memcmp(data, "AT+USOWR=", 9) == 0)
+	{
+		saraR5TestWrites++;
+	}
+	if (len >= 10 && memcmp(data, "AT+USOCTL=", 10) == 0)
+	{
+		saraR5TestQueries++;
+	}
+	return saraR5TestEmulatorWrite(context, data, len);
+}
+
+/**
+ * Opens a TCP socket connected to the remote end, and sets the counters back to 0.
+ * @return The socket ID, -1 on error.
+ */
+static int saraR5TestConnect(void)
+{
+	int socket = saraR5SocketOpen(SARA_R5_TCP, 0);
+
+	SARA_R5_CHECK(socket >= 0);
+	SARA_R5_CHECK_EQUAL(saraR5SocketConnect2(socket, "192.0.2.30", 7000, NULL, 0), SARA_R5_ERROR_SUCCESS);
+	saraR5TestWrites = 0;
+	saraR5TestQueries = 0;
+	emulator.stats.socketBytes = 0;
+	return socket;
+}
+
+int main(void)
+{
+	static uint8_t data[SARA_R5_TEST_LENGTH];
+	char response[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+	size_t written;
+	uint32_t start;
+	int socket;
+
+	for (size_t i = 0; i < sizeof(data); i++)
+	{
+		data[i] = (uint8_t)(i * 31u);
+	}
+	saraR5EmulatorInit(&emulator, &transport, NULL);
+	saraR5TestEmulatorWrite = transport.send;
+	transport.send = saraR5TestCount;
+	saraR5SetTransport(&transport);
+	SARA_R5_CHECK(saraR5Init(SARA_RESPONSE_OK, response));
+
+	// Acknowledged at once: one AT+USOWR per SARA_R5_SOCKET_MAX_WRITE bytes, an AT+USOCTL each time the bytes sent
+	// by the call reach SARA_R5_SOCKET_MAX_UNACKED
+	socket = saraR5TestConnect();
+	SARA_R5_CHECK_EQUAL(saraR5SocketWrite(socket, data, sizeof(data), &written), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(written, sizeof(data));
+	SARA_R5_CHECK_EQUAL(emulator.stats.socketBytes, sizeof(data));
+	SARA_R5_CHECK_EQUAL(saraR5TestWrites, (sizeof(data) + SARA_R5_SOCKET_MAX_WRITE - 1) / SARA_R5_SOCKET_MAX_WRITE);
+	SARA_R5_CHECK_EQUAL(saraR5TestQueries, (sizeof(data) - 1) / SARA_R5_SOCKET_MAX_UNACKED);
+	SARA_R5_CHECK(memcmp(emulator.payload, &data[sizeof(data) - sizeof(data) % SARA_R5_SOCKET_MAX_WRITE], sizeof(data) % SARA_R5_SOCKET_MAX_WRITE) == 0);
+	saraR5socketClose(socket, SARA_R5_STANDARD_RESPONSE_TIMEOUT, NULL, 0);
+
+	// Acknowledged at 2000 B/s: the call waits on AT+USOCTL until the remote end catches up
+	emulator.config.ackBytesPerSec = 2000;
+	socket = saraR5TestConnect();
+	start = saraR5NowMs();
+	SARA_R5_CHECK_EQUAL(saraR5SocketWrite(socket, data, 2 * SARA_R5_SOCKET_MAX_UNACKED, &written), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(written, 2 * SARA_R5_SOCKET_MAX_UNACKED);
+	SARA_R5_CHECK_EQUAL(saraR5TestWrites, 2 * SARA_R5_SOCKET_MAX_UNACKED / SARA_R5_SOCKET_MAX_WRITE);
+	SARA_R5_CHECK(saraR5TestQueries > 1);
+	// The last chunk leaves once SARA_R5_SOCKET_MAX_UNACKED bytes are acknowledged
+	SARA_R5_CHECK(saraR5NowMs() - start >= SARA_R5_SOCKET_MAX_UNACKED * 1000u / 2000u);
+	SARA_R5_CHECK(saraR5NowMs() - start < SARA_R5_SOCKET_MAX_UNACKED * 1000u / 2000u + 1000u);
+	saraR5socketClose(socket, SARA_R5_STANDARD_RESPONSE_TIMEOUT, NULL, 0);
+
+	// The send buffer of the module is full before SARA_R5_SOCKET_MAX_UNACKED: AT+USOWR takes no byte
+	emulator.config.ackBytesPerSec = 1;
+	emulator.config.sendBufferBytes = 2 * SARA_R5_SOCKET_MAX_WRITE;
+	socket = saraR5TestConnect();
+	SARA_R5_CHECK_EQUAL(saraR5SocketWrite(socket, data, 3 * SARA_R5_SOCKET_MAX_WRITE, &written), SARA_R5_ERROR_ERROR);
+	SARA_R5_CHECK_EQUAL(written, 2 * SARA_R5_SOCKET_MAX_WRITE);
+	SARA_R5_CHECK_EQUAL(saraR5TestWrites, 3);
+	SARA_R5_CHECK_EQUAL(emulator.stats.socketBytes, 2 * SARA_R5_SOCKET_MAX_WRITE);
+	saraR5socketClose(socket, SARA_R5_STANDARD_RESPONSE_TIMEOUT, NULL, 0);
+
+	// Hardly any acknowledgement: the call gives up after SARA_R5_SOCKET_FLOW_TIMEOUT
+	emulator.config.sendBufferBytes = 0;
+	socket = saraR5TestConnect();
+	start = saraR5NowMs();
+	SARA_R5_CHECK_EQUAL(saraR5SocketWrite(socket, data, 2 * SARA_R5_SOCKET_MAX_UNACKED, &written), SARA_R5_ERROR_TIMEOUT);
+	SARA_R5_CHECK_EQUAL(written, SARA_R5_SOCKET_MAX_UNACKED);
+	SARA_R5_CHECK(saraR5NowMs() - start >= SARA_R5_SOCKET_FLOW_TIMEOUT);
+	SARA_R5_CHECK(saraR5NowMs() - start < SARA_R5_SOCKET_FLOW_TIMEOUT + 2000);
+	saraR5socketClose(socket, SARA_R5_STANDARD_RESPONSE_TIMEOUT, NULL, 0);
+
+	// A socket that does not exist
+	SARA_R5_CHECK_EQUAL(saraR5SocketWrite(SARA_R5_NUM_SOCKETS, data, 1, &written), SARA_R5_ERROR_INVALID_SOCKET);
+	SARA_R5_CHECK_EQUAL(written, 0);
+
+	return saraR5TestSummary("test_socket_write");
+}
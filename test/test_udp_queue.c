@@ -0,0 +1,117 @@
+/*
+ * test_udp_queue.c
+ *
+ * The UDP send queue against the module emulator: records to one destination coalesced up to the MTU and split
+ * once it is reached, the datagram that waits for more records sent by saraR5Poll at the end of the latency
+ * budget, every slot taken, and the coalescing and records per second statistics.
+ */
+
+// INCLUDES
+#include "Sara_R5_test.h"
+
+#define SARA_R5_TEST_ADDRESS "192.0.2.40"
+#define SARA_R5_TEST_PORT 5000
+#define SARA_R5_TEST_MTU 100
+#define SARA_R5_TEST_LATENCY 1000
+#define SARA_R5_TEST_RECORD 30 // Three records fit in a datagram of SARA_R5_TEST_MTU bytes, not four
+
+static SARA_R5_emulator emulator;
+static SARA_R5_transport transport;
+
+/**
+ * Polls the library for 'ms' milliseconds.
+ */
+static void saraR5TestPoll(uint32_t ms)
+{
+	for (uint32_t start = saraR5NowMs(); saraR5NowMs() - start < ms;)
+	{
+		saraR5Poll();
+		transport.wait(transport.context, 10);
+	}
+}
+
+int main(void)
+{
+	char response[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+	uint8_t records[SARA_R5_UDP_QUEUE_DATAGRAMS + 1][SARA_R5_TEST_RECORD];
+	SARA_R5_udp_queue_stats stats;
+	uint32_t queued;
+	int socket;
+
+	for (size_t r = 0; r < SARA_R5_UDP_QUEUE_DATAGRAMS + 1; r++)
+	{
+		memset(records[r], 'a' + (int)r, SARA_R5_TEST_RECORD);
+	}
+	saraR5EmulatorInit(&emulator, &transport, NULL);
+	saraR5TestCapture(&transport);
+	saraR5SetTransport(&transport);
+	SARA_R5_CHECK(saraR5Init(SARA_RESPONSE_OK, response));
+	socket = saraR5SocketOpen(SARA_R5_UDP, 0);
+	SARA_R5_CHECK(socket >= 0);
+
+	SARA_R5_CHECK_EQUAL(saraR5UdpQueueConfigure(true, 0, SARA_R5_TEST_LATENCY), SARA_R5_ERROR_UNEXPECTED_PARAM);
+	SARA_R5_CHECK_EQUAL(saraR5UdpQueueConfigure(true, SARA_R5_UDP_QUEUE_MTU + 1, SARA_R5_TEST_LATENCY), SARA_R5_ERROR_UNEXPECTED_PARAM);
+	SARA_R5_CHECK_EQUAL(saraR5UdpQueueConfigure(true, SARA_R5_TEST_MTU, SARA_R5_TEST_LATENCY), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(saraR5UdpQueueSend(socket, SARA_R5_TEST_ADDRESS, SARA_R5_TEST_PORT, records[0], SARA_R5_TEST_MTU + 1), SARA_R5_ERROR_UNEXPECTED_PARAM);
+	saraR5UdpQueueResetStats();
+
+	// Coalescing: three records share a datagram, the fourth does not fit and starts the next one
+	for (size_t r = 0; r < 4; r++)
+	{
+		SARA_R5_CHECK_EQUAL(saraR5UdpQueueSend(socket, SARA_R5_TEST_ADDRESS, SARA_R5_TEST_PORT, records[r], SARA_R5_TEST_RECORD), SARA_R5_ERROR_SUCCESS);
+	}
+	queued = saraR5NowMs();
+	saraR5TestClear();
+	saraR5TestPoll(SARA_R5_TEST_LATENCY / 2);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+USOST=0,\"" SARA_R5_TEST_ADDRESS "\",5000,90\r") != NULL);
+	SARA_R5_CHECK_EQUAL(emulator.payloadLength, 3 * SARA_R5_TEST_RECORD);
+	SARA_R5_CHECK(memcmp(emulator.payload, records[0], SARA_R5_TEST_RECORD) == 0);
+	SARA_R5_CHECK(memcmp(&emulator.payload[2 * SARA_R5_TEST_RECORD], records[2], SARA_R5_TEST_RECORD) == 0);
+	saraR5UdpQueueGetStats(&stats);
+	SARA_R5_CHECK_EQUAL(stats.datagrams, 1);
+	SARA_R5_CHECK_EQUAL(stats.records, 4);
+
+	// The fourth record waits for more until the latency budget is over, then saraR5Poll sends it alone
+	saraR5TestClear();
+	for (; saraR5NowMs() - queued < 5000 && stats.datagrams < 2; saraR5UdpQueueGetStats(&stats))
+	{
+		saraR5Poll();
+		transport.wait(transport.context, 10);
+	}
+	SARA_R5_CHECK_EQUAL(stats.datagrams, 2);
+	SARA_R5_CHECK(saraR5NowMs() - queued >= SARA_R5_TEST_LATENCY);
+	SARA_R5_CHECK(strstr(saraR5TestLine, "AT+USOST=0,\"" SARA_R5_TEST_ADDRESS "\",5000,30\r") != NULL);
+	SARA_R5_CHECK(memcmp(emulator.payload, records[3], SARA_R5_TEST_RECORD) == 0);
+
+	// Statistics: 4 records in 2 datagrams
+	saraR5UdpQueueGetStats(&stats);
+	SARA_R5_CHECK_EQUAL(stats.recordsSent, 4);
+	SARA_R5_CHECK_EQUAL(stats.bytes, 4 * SARA_R5_TEST_RECORD);
+	SARA_R5_CHECK_EQUAL(stats.failures, 0);
+	SARA_R5_CHECK_EQUAL(stats.coalescing, 200);
+	SARA_R5_CHECK(stats.elapsedMs >= SARA_R5_TEST_LATENCY);
+	SARA_R5_CHECK_EQUAL(stats.recordsPerSecond, 4u * 1000u / stats.elapsedMs);
+
+	// Without coalescing every record is a datagram of its own: once every slot is taken, the queue is full
+	SARA_R5_CHECK_EQUAL(saraR5UdpQueueConfigure(false, SARA_R5_TEST_MTU, SARA_R5_TEST_LATENCY), SARA_R5_ERROR_SUCCESS);
+	saraR5UdpQueueResetStats();
+	for (size_t r = 0; r < SARA_R5_UDP_QUEUE_DATAGRAMS; r++)
+	{
+		SARA_R5_CHECK_EQUAL(saraR5UdpQueueSend(socket, SARA_R5_TEST_ADDRESS, SARA_R5_TEST_PORT, records[r], SARA_R5_TEST_RECORD), SARA_R5_ERROR_SUCCESS);
+	}
+	SARA_R5_CHECK_EQUAL(saraR5UdpQueueSend(socket, SARA_R5_TEST_ADDRESS, SARA_R5_TEST_PORT, records[SARA_R5_UDP_QUEUE_DATAGRAMS], SARA_R5_TEST_RECORD), SARA_R5_ERROR_OUT_OF_MEMORY);
+	saraR5UdpQueueFlush();
+	saraR5UdpQueueGetStats(&stats);
+	SARA_R5_CHECK_EQUAL(stats.records, SARA_R5_UDP_QUEUE_DATAGRAMS);
+	SARA_R5_CHECK_EQUAL(stats.datagrams, SARA_R5_UDP_QUEUE_DATAGRAMS);
+	SARA_R5_CHECK_EQUAL(stats.coalescing, 100);
+	SARA_R5_CHECK(memcmp(emulator.payload, records[SARA_R5_UDP_QUEUE_DATAGRAMS - 1], SARA_R5_TEST_RECORD) == 0);
+
+	// The slots are free again
+	SARA_R5_CHECK_EQUAL(saraR5UdpQueueSend(socket, SARA_R5_TEST_ADDRESS, SARA_R5_TEST_PORT, records[SARA_R5_UDP_QUEUE_DATAGRAMS], SARA_R5_TEST_RECORD), SARA_R5_ERROR_SUCCESS);
+	saraR5UdpQueueFlush();
+	saraR5UdpQueueGetStats(&stats);
+	SARA_R5_CHECK_EQUAL(stats.datagrams, SARA_R5_UDP_QUEUE_DATAGRAMS + 1);
+
+	return saraR5TestSummary("test_udp_queue");
+}
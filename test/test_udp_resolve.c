@@ -0,0 +1,61 @@
+/*
+ * test_udp_resolve.c
+ *
+ * UDP messages of saraR5SocketSend to a host name, against the module emulator: AT+USOST carries the address of
+ * the resolution cache, so the name costs a single DNS lookup. With the cache off the name goes to AT+USOST as it
+ * is, and the module looks it up for every message.
+ */
+
+// INCLUDES
+#include "Sara_R5_test.h"
+
+#define SARA_R5_TEST_HOST "telemetry.example.com"
+
+static SARA_R5_emulator emulator;
+static SARA_R5_transport transport;
+
+int main(void)
+{
+	static const uint8_t message[] = "temperature=21.5";
+	char response[STANDARD_RESPONSE_BUFFER_SIZE] = "";
+	char command[SARA_R5_TEST_LINE_SIZE];
+	Ip_adress ip;
+
+	saraR5EmulatorInit(&emulator, &transport, NULL);
+	saraR5TestCapture(&transport);
+	saraR5SetTransport(&transport);
+	SARA_R5_CHECK(saraR5Init(SARA_RESPONSE_OK, response));
+
+	// Cache on: the first message resolves the name, both go to its address
+	SARA_R5_CHECK_EQUAL(saraR5DnsCacheConfigure(SARA_R5_DNS_CACHE_SIZE, 60000, 0), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(saraR5ResolveHost(SARA_R5_TEST_HOST, &ip), SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(emulator.stats.dnsLookups, 1);
+	snprintf(command, sizeof(command), ",\"%u.%u.%u.%u\",5000,%u", ip.first_ip, ip.second_ip, ip.third_ip, ip.fourth_ip,
+			 (unsigned)(sizeof(message) - 1));
+	for (int i = 0; i < 2; i++)
+	{
+		saraR5TestClear();
+		SARA_R5_CHECK_EQUAL(saraR5SocketSend(SARA_R5_UDP, SARA_R5_TEST_HOST, 5000, message, sizeof(message) - 1), SARA_R5_ERROR_SUCCESS);
+		SARA_R5_CHECK(strstr(saraR5TestLine, "AT+USOST=") != NULL);
+		SARA_R5_CHECK(strstr(saraR5TestLine, command) != NULL);
+		SARA_R5_CHECK(strstr(saraR5TestLine, SARA_R5_TEST_HOST) == NULL);
+		SARA_R5_CHECK(memcmp(emulator.payload, message, sizeof(message) - 1) == 0);
+	}
+	SARA_R5_CHECK_EQUAL(emulator.stats.dnsLookups, 1);
+
+	// Cache off: the name goes to AT+USOST, and the emulator looks it up for each message
+	SARA_R5_CHECK_EQUAL(saraR5DnsCacheConfigure(0, 0, 0), SARA_R5_ERROR_SUCCESS);
+	for (int i = 0; i < 2; i++)
+	{
+		saraR5TestClear();
+		SARA_R5_CHECK_EQUAL(saraR5SocketSend(SARA_R5_UDP, SARA_R5_TEST_HOST, 5000, message, sizeof(message) - 1), SARA_R5_ERROR_SUCCESS);
+		SARA_R5_CHECK(strstr(saraR5TestLine, ",\"" SARA_R5_TEST_HOST "\",5000,") != NULL);
+	}
+	SARA_R5_CHECK_EQUAL(emulator.stats.dnsLookups, 3);
+
+	// A name that does not resolve: the module answers ERROR
+	SARA_R5_CHECK(saraR5SocketSend(SARA_R5_UDP, "nowhere.invalid", 5000, message, sizeof(message) - 1) != SARA_R5_ERROR_SUCCESS);
+	SARA_R5_CHECK_EQUAL(emulator.stats.dnsLookups, 4);
+
+	return saraR5TestSummary("test_udp_resolve");
+}